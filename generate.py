@@ -40,31 +40,69 @@ def parse_unicode_data(file_path):
     
     return to_lower, to_upper
 
+# Codepoints are grouped into blocks of 2^CASE_BLOCK_SHIFT. Identical blocks are stored once
+CASE_BLOCK_SHIFT = 6
+
+def c_uint_type(max_value):
+    return "uint8_t" if max_value < 256 else "uint16_t" if max_value < 65536 else "uint32_t"
+
+def build_case_table(mappings):
+    """Build a two level table of (block index per block, delta index per codepoint, deltas)."""
+    block_size = 1 << CASE_BLOCK_SHIFT
+    deltas = [0]
+    delta_indices = {0: 0}
+    block_count = (max(source for source, _ in mappings) >> CASE_BLOCK_SHIFT) + 1
+    codepoint_indices = [0] * (block_count * block_size)
+    for source, target in mappings:
+        delta = (target - source) & 0xFFFFFFFF
+        if delta not in delta_indices:
+            delta_indices[delta] = len(deltas)
+            deltas.append(delta)
+        codepoint_indices[source] = delta_indices[delta]
+
+    blocks = []
+    unique_blocks = {}
+    block_data = []
+    for block in range(block_count):
+        content = tuple(codepoint_indices[block * block_size:(block + 1) * block_size])
+        if content not in unique_blocks:
+            unique_blocks[content] = len(unique_blocks)
+            block_data.extend(content)
+        blocks.append(unique_blocks[content])
+    return blocks, block_data, deltas
+
+def write_case_table(f, name, mappings):
+    blocks, block_data, deltas = build_case_table(mappings)
+    f.write(f"static const {c_uint_type(max(blocks))} {name}Blocks[{len(blocks)}] = {{")
+    for i, block in enumerate(blocks):
+        f.write(("\n    " if i % 16 == 0 else " ") + f"{block},")
+    f.write("\n};\n\n")
+    f.write(f"static const {c_uint_type(max(block_data))} {name}Indices[{len(block_data)}] = {{")
+    for i, index in enumerate(block_data):
+        f.write(("\n    " if i % 16 == 0 else " ") + f"{index},")
+    f.write("\n};\n\n")
+    f.write(f"static const uint32_t {name}Deltas[{len(deltas)}] = {{")
+    for i, delta in enumerate(deltas):
+        f.write(("\n    " if i % 8 == 0 else " ") + f"0x{delta:08X},")
+    f.write("\n};\n\n")
+
 def generate_header_file(output_file, to_lower, to_upper):
-    """Generate the C header file with toLower and toUpper tables."""
+    """Generate the C header file with two level toLower and toUpper tables."""
     with open(output_file, 'w', encoding='utf-8') as f:
         # Write the preamble and header
         f.write("#ifndef UNICODE_MAPPINGS_H\n")
         f.write("#define UNICODE_MAPPINGS_H\n\n")
-        f.write("#include <stdint.h>\n\n");
-        
-        # Define the struct for the mappings
-        f.write("typedef struct {\n")
-        f.write("    uint32_t source;\n")
-        f.write("    uint32_t target;\n")
-        f.write("} UnicodeMapping;\n\n")
-        
-        # Define the toLower and toUpper tables as constants
-        f.write("static const UnicodeMapping toLower[] = {\n")
-        for codepoint, target in sorted(to_lower):
-            f.write(f"    {{0x{codepoint:08X}, 0x{target:08X}}},\n")
-        f.write("};\n\n")
-        
-        f.write("static const UnicodeMapping toUpper[] = {\n")
-        for codepoint, target in sorted(to_upper):
-            f.write(f"    {{0x{codepoint:08X}, 0x{target:08X}}},\n")
-        f.write("};\n\n")
-        
+        f.write("#include <stdint.h>\n\n")
+
+        f.write("// Two level case mapping tables. Generated by generate.py\n")
+        f.write("// The mapping of codepoint c is c + Deltas[Indices[(Blocks[c >> UNICODE_CASE_BLOCK_SHIFT] << UNICODE_CASE_BLOCK_SHIFT) + (c & UNICODE_CASE_BLOCK_MASK)]]\n")
+        f.write("// with wrapping unsigned arithmetic. Delta index 0 means the codepoint has no mapping. Codepoints past the end of Blocks have none either\n")
+        f.write(f"#define UNICODE_CASE_BLOCK_SHIFT {CASE_BLOCK_SHIFT}\n")
+        f.write("#define UNICODE_CASE_BLOCK_MASK ((1 << UNICODE_CASE_BLOCK_SHIFT) - 1)\n\n")
+
+        write_case_table(f, "toLower", to_lower)
+        write_case_table(f, "toUpper", to_upper)
+
         # Closing header guard
         f.write("#endif // UNICODE_MAPPINGS_H\n")
     
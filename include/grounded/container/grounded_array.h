@@ -0,0 +1,92 @@
+#ifndef GROUNDED_ARRAY_H
+#define GROUNDED_ARRAY_H
+
+#include "../grounded.h"
+#include "../memory/grounded_arena.h"
+#include "../memory/grounded_heap.h"
+
+// Growable array of fixed size elements.
+// Memory comes either from an arena or from a heap. Arena backed arrays grow in place as long as they are the
+// last allocation of the arena. Otherwise the elements are copied to a new allocation twice the size and the
+// old memory stays in the arena until it is popped. Heap backed arrays use groundedHeapReallocate and free their memory on destroy.
+// Element pointers are invalidated by every operation that can grow the array.
+
+typedef struct GroundedArray {
+    u8* data;
+    u64 count;
+    u64 capacity;
+    u64 elementSize;
+    u64 alignment;
+    // Exactly one of them is set
+    MemoryArena* arena;
+    GroundedHeap* heap;
+} GroundedArray;
+
+#define GROUNDED_ARRAY_CREATE(arena, type, initialCapacity) groundedCreateArray(arena, 0, sizeof(type), ALIGNMENT_OF(type), initialCapacity)
+#define GROUNDED_ARRAY_CREATE_ON_HEAP(heap, type, initialCapacity) groundedCreateArray(0, heap, sizeof(type), ALIGNMENT_OF(type), initialCapacity)
+// The new element is cleared
+#define GROUNDED_ARRAY_PUSH(array, type) (ASSERT(sizeof(type) == (array)->elementSize), (type*)groundedArrayPush(array))
+#define GROUNDED_ARRAY_GET(array, type, index) (ASSERT(sizeof(type) == (array)->elementSize), (type*)groundedArrayGet(array, index))
+#define GROUNDED_ARRAY_FOR_EACH(array, type, it) for(type* it = (type*)(array)->data; it < (type*)(array)->data + (array)->count; ++it)
+
+// No memory is allocated before the first push if initialCapacity is 0
+GROUNDED_FUNCTION GroundedArray groundedCreateArray(MemoryArena* arena, GroundedHeap* heap, u64 elementSize, u64 alignment, u64 initialCapacity);
+// Frees heap memory. Arena memory is popped if the array is the last allocation of the arena
+GROUNDED_FUNCTION void groundedDestroyArray(GroundedArray* array);
+// Returns false if the allocator is out of memory
+GROUNDED_FUNCTION bool groundedArrayReserve(GroundedArray* array, u64 capacity);
+// Appends count uninitialized elements and returns a pointer to the first one. Returns 0 if the allocator is out of memory
+GROUNDED_FUNCTION void* groundedArrayPushUninitialized(GroundedArray* array, u64 count);
+// Inserts an uninitialized element at index by moving all following elements
+GROUNDED_FUNCTION void* groundedArrayInsert(GroundedArray* array, u64 index);
+// Keeps the order of the remaining elements
+GROUNDED_FUNCTION void groundedArrayRemoveOrdered(GroundedArray* array, u64 index);
+
+GROUNDED_FUNCTION_INLINE void* groundedArrayGet(GroundedArray* array, u64 index) {
+    ASSERT(index < array->count);
+    return array->data + index * array->elementSize;
+}
+
+GROUNDED_FUNCTION_INLINE void* groundedArrayPush(GroundedArray* array) {
+    void* result = 0;
+    if(array->count < array->capacity) {
+        result = array->data + array->count * array->elementSize;
+        array->count++;
+    } else {
+        result = groundedArrayPushUninitialized(array, 1);
+    }
+    if(result) {
+        groundedClearMemory(result, array->elementSize);
+    }
+    return result;
+}
+
+GROUNDED_FUNCTION_INLINE void* groundedArrayPushCopy(GroundedArray* array, const void* element) {
+    void* result = groundedArrayPushUninitialized(array, 1);
+    if(result) {
+        memcpy(result, element, array->elementSize);
+    }
+    return result;
+}
+
+// Returns a pointer to the removed element which stays valid until the next push. Returns 0 if the array is empty
+GROUNDED_FUNCTION_INLINE void* groundedArrayPop(GroundedArray* array) {
+    if(!array->count) return 0;
+    array->count--;
+    return array->data + array->count * array->elementSize;
+}
+
+// Moves the last element into the removed slot
+GROUNDED_FUNCTION_INLINE void groundedArrayRemoveSwap(GroundedArray* array, u64 index) {
+    ASSERT(index < array->count);
+    array->count--;
+    if(index != array->count) {
+        memcpy(array->data + index * array->elementSize, array->data + array->count * array->elementSize, array->elementSize);
+    }
+}
+
+GROUNDED_FUNCTION_INLINE void groundedArrayClear(GroundedArray* array) {
+    array->count = 0;
+}
+
+#endif // GROUNDED_ARRAY_H
@@ -0,0 +1,87 @@
+#ifndef GROUNDED_HASH_MAP_H
+#define GROUNDED_HASH_MAP_H
+
+#include "../grounded.h"
+#include "../memory/grounded_arena.h"
+#include "../memory/grounded_heap.h"
+
+// Open addressing hash map in the style of Swiss tables.
+// Every slot has a control byte that is either empty, deleted or holds 7 bits of the hash of its key.
+// Lookups compare the control bytes of a whole group of slots at once (with SSE2 where available)
+// so keys only have to be compared for slots whose hash bits match.
+// Keys and values are stored by value with a fixed size. Keys are hashed and compared bytewise unless
+// custom functions are given. For String8 keys groundedHashString8 and groundedHashString8Equal compare the contents.
+// Memory comes either from an arena or from a heap. When an arena backed map grows the old table stays in the arena.
+// Tombstones left by removals are cleaned up inside the current table so insert/remove churn does not allocate.
+// Key and value pointers are invalidated by every insert.
+
+#define GROUNDED_HASH_MAP_GROUP_WIDTH 16
+
+typedef u64 GroundedHashFunc(const void* key, u64 keySize);
+typedef bool GroundedHashEqualFunc(const void* a, const void* b, u64 keySize);
+
+typedef struct GroundedHashMap {
+    u8* control; // capacity + GROUNDED_HASH_MAP_GROUP_WIDTH bytes. The first group is mirrored at the end
+    u8* slots;
+    u64 capacity; // Power of 2 or 0
+    u64 count;
+    u64 growthLeft; // Inserts into empty slots that are possible before the table has to grow
+    u64 keySize;
+    u64 valueOffset;
+    u64 valueSize;
+    u64 slotSize;
+    u64 slotAlignment;
+    GroundedHashFunc* hash;
+    GroundedHashEqualFunc* equal;
+    // Exactly one of them is set
+    MemoryArena* arena;
+    GroundedHeap* heap;
+} GroundedHashMap;
+
+// A map without values
+typedef struct GroundedHashSet {
+    GroundedHashMap map;
+} GroundedHashSet;
+
+#define GROUNDED_HASH_MAP_CREATE(arena, keyType, valueType) groundedCreateHashMap(arena, 0, sizeof(keyType), ALIGNMENT_OF(keyType), sizeof(valueType), ALIGNMENT_OF(valueType), 0, 0)
+#define GROUNDED_HASH_MAP_CREATE_ON_HEAP(heap, keyType, valueType) groundedCreateHashMap(0, heap, sizeof(keyType), ALIGNMENT_OF(keyType), sizeof(valueType), ALIGNMENT_OF(valueType), 0, 0)
+#define GROUNDED_HASH_MAP_GET(map, key, valueType) ((valueType*)groundedHashMapGet(map, key))
+#define GROUNDED_HASH_SET_CREATE(arena, keyType) groundedCreateHashSet(arena, 0, sizeof(keyType), ALIGNMENT_OF(keyType), 0, 0)
+#define GROUNDED_HASH_SET_CREATE_ON_HEAP(heap, keyType) groundedCreateHashSet(0, heap, sizeof(keyType), ALIGNMENT_OF(keyType), 0, 0)
+
+// Default hash and comparison for keys that can be compared bytewise. Keys must not contain padding
+GROUNDED_FUNCTION u64 groundedHashBytes(const void* key, u64 keySize);
+GROUNDED_FUNCTION bool groundedHashBytesEqual(const void* a, const void* b, u64 keySize);
+// For String8 keys. Only the string pointer is stored so the string contents must outlive the map
+GROUNDED_FUNCTION u64 groundedHashString8(const void* key, u64 keySize);
+GROUNDED_FUNCTION bool groundedHashString8Equal(const void* a, const void* b, u64 keySize);
+
+// hash and equal of 0 select groundedHashBytes and groundedHashBytesEqual
+GROUNDED_FUNCTION GroundedHashMap groundedCreateHashMap(MemoryArena* arena, GroundedHeap* heap, u64 keySize, u64 keyAlignment, u64 valueSize, u64 valueAlignment, GroundedHashFunc* hash, GroundedHashEqualFunc* equal);
+// Frees heap memory. Arena memory is only reclaimed by the arena
+GROUNDED_FUNCTION void groundedDestroyHashMap(GroundedHashMap* map);
+// Makes sure count elements fit without growing. Returns false if the allocator is out of memory
+GROUNDED_FUNCTION bool groundedHashMapReserve(GroundedHashMap* map, u64 count);
+// Returns a pointer to the value or 0 if the key is not in the map
+GROUNDED_FUNCTION void* groundedHashMapGet(GroundedHashMap* map, const void* key);
+// Returns a pointer to the value of key. New values are cleared. existed is optional. Returns 0 if the allocator is out of memory
+GROUNDED_FUNCTION void* groundedHashMapGetOrInsert(GroundedHashMap* map, const void* key, bool* existed);
+// Inserts or overwrites the value of key. Returns false if the allocator is out of memory
+GROUNDED_FUNCTION bool groundedHashMapPut(GroundedHashMap* map, const void* key, const void* value);
+// Returns false if the key was not in the map
+GROUNDED_FUNCTION bool groundedHashMapRemove(GroundedHashMap* map, const void* key);
+GROUNDED_FUNCTION void groundedHashMapClear(GroundedHashMap* map);
+// Iterates over all elements in unspecified order. iterator must be initialized to 0. value is optional
+// Removing the current element while iterating is allowed, inserting is not
+GROUNDED_FUNCTION bool groundedHashMapNext(GroundedHashMap* map, u64* iterator, void** key, void** value);
+
+GROUNDED_FUNCTION GroundedHashSet groundedCreateHashSet(MemoryArena* arena, GroundedHeap* heap, u64 keySize, u64 keyAlignment, GroundedHashFunc* hash, GroundedHashEqualFunc* equal);
+GROUNDED_FUNCTION void groundedDestroyHashSet(GroundedHashSet* set);
+// Returns true if the key was newly inserted
+GROUNDED_FUNCTION bool groundedHashSetInsert(GroundedHashSet* set, const void* key);
+GROUNDED_FUNCTION bool groundedHashSetContains(GroundedHashSet* set, const void* key);
+GROUNDED_FUNCTION bool groundedHashSetRemove(GroundedHashSet* set, const void* key);
+GROUNDED_FUNCTION void groundedHashSetClear(GroundedHashSet* set);
+GROUNDED_FUNCTION bool groundedHashSetNext(GroundedHashSet* set, u64* iterator, void** key);
+
+#endif // GROUNDED_HASH_MAP_H
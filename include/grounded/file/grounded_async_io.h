@@ -0,0 +1,95 @@
+#ifndef GROUNDED_ASYNC_IO_H
+#define GROUNDED_ASYNC_IO_H
+
+#include "grounded_file.h"
+#include "../threading/grounded_async.h"
+
+// Asynchronous file I/O. Reads and writes are queued as requests and complete in the background.
+// On Linux requests go through io_uring so many requests are handed to the kernel with a single system call.
+// If io_uring is not available (old kernel, seccomp filters, other platforms) requests are executed with blocking
+// positional I/O on a thread pool instead. Both backends behave the same from the outside.
+//
+// A GroundedAsyncIo must only be used from the thread that created it. Buffers must stay valid until the request has finished.
+// A request keeps its slot until its result has been retrieved with groundedAsyncIoWait or groundedAsyncIoWaitForAll.
+
+typedef u64 GroundedAsyncIoRequest;
+
+typedef struct GroundedAsyncIoParameters {
+    u32 maxRequestCount; // Maximum number of requests in flight. 0 defaults to 256
+    u32 fallbackThreadCount; // Threads of the fallback thread pool. 0 defaults to 4
+    GroundedAsyncSystem* fallbackSystem; // Use this async system for the fallback instead of creating a thread pool
+    bool forceFallback; // Never use io_uring
+} GroundedAsyncIoParameters;
+
+struct AsyncIoRequestSlot;
+struct AsyncIoRing;
+
+typedef struct GroundedAsyncIo {
+    struct AsyncIoRequestSlot* requests;
+    u32* freeRequests; // Stack of free request indices
+    u32 freeRequestCount;
+    u32 requestCount;
+    struct AsyncIoRing* ring; // 0 if the fallback is used
+    GroundedAsyncSystem* fallbackSystem;
+    bool ownsFallbackSystem;
+    // Fallback only. Pool threads finish requests while holding the mutex and signal the condition variable
+    GroundedMutex completionMutex;
+    GroundedConditionVariable completionCondition;
+    MemoryArena arena;
+} GroundedAsyncIo;
+
+// Parameters might be 0 in which case defaults are used
+GROUNDED_FUNCTION bool groundedCreateAsyncIo(GroundedAsyncIo* io, GroundedAsyncIoParameters* parameters);
+// Waits for all requests to finish
+GROUNDED_FUNCTION void groundedDestroyAsyncIo(GroundedAsyncIo* io);
+GROUNDED_FUNCTION bool groundedAsyncIoUsesIoUring(GroundedAsyncIo* io);
+
+// Return 0 if there is no free request slot left. Requests are only guaranteed to start after groundedAsyncIoSubmit
+GROUNDED_FUNCTION GroundedAsyncIoRequest groundedAsyncIoRead(GroundedAsyncIo* io, GroundedFile file, u8* buffer, u64 size, u64 offset);
+GROUNDED_FUNCTION GroundedAsyncIoRequest groundedAsyncIoWrite(GroundedAsyncIo* io, GroundedFile file, const u8* buffer, u64 size, u64 offset);
+// Hands all queued requests to the backend at once
+GROUNDED_FUNCTION void groundedAsyncIoSubmit(GroundedAsyncIo* io);
+
+// Submits queued requests but does not block. The request remains valid
+GROUNDED_FUNCTION bool groundedAsyncIoIsFinished(GroundedAsyncIo* io, GroundedAsyncIoRequest request);
+// Submits queued requests and blocks until the request has finished. Frees the request.
+// Returns false on error. Reads past the end of file are not an error but transfer fewer bytes
+GROUNDED_FUNCTION bool groundedAsyncIoWait(GroundedAsyncIo* io, GroundedAsyncIoRequest request, u64* bytesTransferred);
+// Waits for and frees all requests
+GROUNDED_FUNCTION void groundedAsyncIoWaitForAll(GroundedAsyncIo* io);
+
+// Batched loading of whole files
+typedef struct GroundedFileLoad {
+    String8 filename;
+    // Filled in by groundedAsyncIoLoadFiles
+    u8* data;
+    u64 size;
+    bool success;
+} GroundedFileLoad;
+
+// Opens, reads and closes all files with as few submissions as possible. Contents are allocated on arena.
+// Memory of files that failed to load is not given back to the arena. Returns the number of successfully loaded files
+GROUNDED_FUNCTION u64 groundedAsyncIoLoadFiles(GroundedAsyncIo* io, MemoryArena* arena, GroundedFileLoad* loads, u64 loadCount);
+
+// Stream reader that keeps the next bufferCount - 1 buffers loading in the background while the current one is parsed.
+// The file is read from the start with positional reads so this only works for regular files.
+// If io is 0 the reader creates its own. Otherwise the io must belong to the thread that reads the stream and needs
+// bufferCount free requests. bufferSize 0 picks a size based on the file size. At least 2 buffers are used.
+// Closing the stream closes the file
+GROUNDED_FUNCTION BufferedStreamReader groundedFileGetReadAheadStreamReaderFromFile(MemoryArena* arena, GroundedAsyncIo* io, GroundedFile* file, u64 bufferSize, u32 bufferCount);
+GROUNDED_FUNCTION BufferedStreamReader groundedFileGetReadAheadStreamReaderFromFilename(MemoryArena* arena, GroundedAsyncIo* io, String8 filename, u64 bufferSize, u32 bufferCount);
+
+// Stream writer that hands every full buffer to the background and continues with the next free buffer of a small pool.
+// The writer only blocks if all buffers are still being written. Writes start at the beginning of the file.
+// The same rules for io apply as for the read ahead reader. Closing the stream waits for all writes and closes the file
+typedef struct GroundedWriteBehindParameters {
+    u64 bufferSize; // 0 defaults to 64KB
+    u32 bufferCount; // 0 defaults to 4. At least 2 buffers are used
+    bool syncOnClose; // Make sure the data has reached the disk before the file is closed
+} GroundedWriteBehindParameters;
+
+// Parameters might be 0 in which case defaults are used
+GROUNDED_FUNCTION BufferedStreamWriter groundedFileGetWriteBehindStreamWriterFromFile(MemoryArena* arena, GroundedAsyncIo* io, GroundedFile* file, GroundedWriteBehindParameters* parameters);
+GROUNDED_FUNCTION BufferedStreamWriter groundedFileGetWriteBehindStreamWriterFromFilename(MemoryArena* arena, GroundedAsyncIo* io, String8 filename, GroundedWriteBehindParameters* parameters);
+
+#endif // GROUNDED_ASYNC_IO_H
@@ -8,6 +8,10 @@ GROUNDED_FUNCTION u8* groundedReadFileImmutable(String8 filename, u64* size);
 GROUNDED_FUNCTION void groundedFreeFileImmutable(u8* file, u64 size);
 
 GROUNDED_FUNCTION bool groundedWriteFile(String8 filename, const void* data, u64 size);
+// Crash safe replacement of filename. The data is written to a temporary file in the same directory which is synced
+// and then renamed over the target so readers and crashes only ever see the old or the new contents.
+// On Linux the permissions of an existing target are kept. Returns false and leaves the target untouched on error
+GROUNDED_FUNCTION bool groundedWriteFileAtomic(String8 filename, const void* data, u64 size);
 
 enum FileMode {
     FILE_MODE_READ,
@@ -26,10 +30,32 @@ typedef struct GroundedFile {
 GROUNDED_FUNCTION GroundedFile groundedOpenFile(String8 filename, enum FileMode);
 GROUNDED_FUNCTION u64 groundedFileRead(GroundedFile file, u8* buffer, u64 size);
 GROUNDED_FUNCTION u64 groundedFileWrite(GroundedFile file, u8* buffer, u64 size);
+// Positional I/O does not use or modify the current file position on Linux. Both retry until size bytes have been
+// transferred or the end of file is reached. Return false on error, bytesTransferred might be 0
+GROUNDED_FUNCTION bool groundedFileReadAt(GroundedFile file, u8* buffer, u64 size, u64 offset, u64* bytesRead);
+GROUNDED_FUNCTION bool groundedFileWriteAt(GroundedFile file, const u8* buffer, u64 size, u64 offset, u64* bytesWritten);
+GROUNDED_FUNCTION u64 groundedFileGetSize(GroundedFile file);
+GROUNDED_FUNCTION bool groundedFileIsValid(GroundedFile file);
+// Blocks until written data has reached the disk. dataOnly skips metadata that is not required to read the data back
+GROUNDED_FUNCTION bool groundedFileSync(GroundedFile file, bool dataOnly);
+// Buffer size for reading the whole file as a stream. Small files fit into a single buffer, larger files get up to 1MB
+GROUNDED_FUNCTION u64 groundedFileGetStreamBufferSize(GroundedFile file);
 GROUNDED_FUNCTION BufferedStreamWriter groundedFileGetStreamWriterFromFilename(MemoryArena* arena, String8 filename, u64 bufferSize);
 GROUNDED_FUNCTION BufferedStreamWriter groundedFileGetStreamWriterFromFile(MemoryArena* arena, GroundedFile* file, u64 bufferSize);
+// Streaming variant of groundedWriteFileAtomic. The target is only replaced when the stream is closed without error.
+// Setting error of the writer to anything but GROUNDED_STREAM_SUCCESS before closing discards the written data.
+// After closing error tells whether the target has been replaced. expectedSize reserves disk space up front, 0 if unknown
+GROUNDED_FUNCTION BufferedStreamWriter groundedFileGetAtomicStreamWriter(MemoryArena* arena, String8 filename, u64 bufferSize, u64 expectedSize);
 GROUNDED_FUNCTION BufferedStreamReader groundedFileGetStreamReaderFromFilename(MemoryArena* arena, String8 filename, u64 bufferSize);
 GROUNDED_FUNCTION BufferedStreamReader groundedFileGetStreamReaderFromFile(MemoryArena* arena, GroundedFile* file, u64 bufferSize);
+// Stream reader over a read-only mapping of the file so refills never copy.
+// windowSize 0 hands out the whole file as a single buffer. Otherwise the file is handed out in windows of windowSize
+// bytes (rounded up to the page size) and consumed windows are given back to the OS.
+// Files larger than GROUNDED_MAPPED_STREAM_MAX_REGION_SIZE are mapped in regions of that size one after another
+#ifndef GROUNDED_MAPPED_STREAM_MAX_REGION_SIZE
+#define GROUNDED_MAPPED_STREAM_MAX_REGION_SIZE GB(1ull)
+#endif
+GROUNDED_FUNCTION BufferedStreamReader groundedFileGetMappedStreamReader(MemoryArena* arena, String8 filename, u64 windowSize);
 GROUNDED_FUNCTION void groundedCloseFile(GroundedFile* file);
 
 GROUNDED_FUNCTION bool groundedDoesFileExist(String8 filename);
@@ -284,6 +284,53 @@ GROUNDED_FUNCTION_INLINE u32 groundedNextPow2u32(u32 value) {
     return value + 1;
 }
 
+// Bit scans. Value must not be 0 except for groundedPopCount64
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+GROUNDED_FUNCTION_INLINE u32 groundedCountTrailingZeros32(u32 value) {
+    ASSERT(value);
+    unsigned long result;
+    _BitScanForward(&result, value);
+    return (u32)result;
+}
+GROUNDED_FUNCTION_INLINE u32 groundedCountTrailingZeros64(u64 value) {
+    ASSERT(value);
+    unsigned long result;
+    _BitScanForward64(&result, value);
+    return (u32)result;
+}
+GROUNDED_FUNCTION_INLINE u32 groundedCountLeadingZeros64(u64 value) {
+    ASSERT(value);
+    unsigned long result;
+    _BitScanReverse64(&result, value);
+    return 63 - (u32)result;
+}
+GROUNDED_FUNCTION_INLINE u32 groundedPopCount64(u64 value) {
+    return (u32)__popcnt64(value);
+}
+#else
+GROUNDED_FUNCTION_INLINE u32 groundedCountTrailingZeros32(u32 value) {
+    ASSERT(value);
+    return (u32)__builtin_ctz(value);
+}
+GROUNDED_FUNCTION_INLINE u32 groundedCountTrailingZeros64(u64 value) {
+    ASSERT(value);
+    return (u32)__builtin_ctzll(value);
+}
+GROUNDED_FUNCTION_INLINE u32 groundedCountLeadingZeros64(u64 value) {
+    ASSERT(value);
+    return (u32)__builtin_clzll(value);
+}
+GROUNDED_FUNCTION_INLINE u32 groundedPopCount64(u64 value) {
+    return (u32)__builtin_popcountll(value);
+}
+#endif
+
+// Index of the most significant set bit. Value must not be 0
+GROUNDED_FUNCTION_INLINE u32 groundedLog2u64(u64 value) {
+    return 63 - groundedCountLeadingZeros64(value);
+}
+
 ////////////////
 // Scratch arena
 
@@ -44,6 +44,36 @@ GROUNDED_FUNCTION_INLINE void arenaRelease(MemoryArena* arena);
 GROUNDED_FUNCTION void enableDebugMemoryLoggingForArena(MemoryArena* arena);
 GROUNDED_FUNCTION void enableDebugMemoryOverflowDetectForArena(MemoryArena* arena);
 GROUNDED_FUNCTION void enableDebugMemoryUnderflowDetectForArena(MemoryArena* arena);
+// Attributes allocated and live bytes to the ARENA_PUSH_* call site. Cheap enough to stay enabled in staging builds.
+// Call sites of all profiled arenas are aggregated in a single thread safe process wide table.
+// The profiler of each arena is not synchronized so a profiled arena must only be used by one thread at a time.
+// Different profiled arenas can be used from different threads
+GROUNDED_FUNCTION void enableDebugMemoryProfilingForArena(MemoryArena* arena);
+
+// Arena profiling
+typedef struct {
+    String8 filename;
+    u64 line;
+    u64 allocationCount; // Number of allocations since the start of the process
+    u64 allocatedSize; // Bytes allocated since the start of the process
+    u64 liveCount; // Allocations that have not been popped yet
+    u64 liveSize;
+    u64 peakLiveSize;
+} ArenaProfileSite;
+
+typedef enum {
+    ARENA_PROFILE_SORT_LIVE_SIZE,
+    ARENA_PROFILE_SORT_PEAK_LIVE_SIZE,
+    ARENA_PROFILE_SORT_ALLOCATED_SIZE,
+    ARENA_PROFILE_SORT_ALLOCATION_COUNT,
+} ArenaProfileSortKey;
+
+// All call sites in descending order of sortKey. Can be called from any thread while profiled arenas are in use
+GROUNDED_FUNCTION ArenaProfileSite* arenaProfileGetSnapshot(MemoryArena* arena, ArenaProfileSortKey sortKey, u64* siteCount);
+// Human readable table of the maxSites largest call sites. maxSites of 0 includes all call sites
+GROUNDED_FUNCTION String8 arenaProfileFormatReport(MemoryArena* arena, ArenaProfileSortKey sortKey, u64 maxSites);
+// Header line followed by one line per call site with filename,line,allocationCount,allocatedSize,liveCount,liveSize,peakLiveSize
+GROUNDED_FUNCTION String8 arenaProfileFormatCsv(MemoryArena* arena, ArenaProfileSortKey sortKey);
 
 // Temporary Memroy and Arena Markers basically do the same thing.
 // However both variants exist so the user can express his intent more precisely.
@@ -72,6 +102,20 @@ typedef struct {
 GROUNDED_FUNCTION_INLINE ArenaMarker arenaCreateMarker(MemoryArena* arena);
 GROUNDED_FUNCTION_INLINE void arenaResetToMarker(ArenaMarker marker);
 
+// Statistics and retention
+typedef struct {
+    u64 usedSize; // Bytes up to the current head including alignment padding and unused ends of previous blocks
+    u64 committedSize; // Bytes of memory the arena currently holds including retained blocks
+    u64 peakUsedSize; // Largest usedSize since creation or the last arenaResetPeak
+} MemoryArenaStats;
+GROUNDED_FUNCTION_INLINE MemoryArenaStats arenaGetStats(MemoryArena* arena);
+GROUNDED_FUNCTION_INLINE void arenaResetPeak(MemoryArena* arena);
+// Every trimResetCount calls to arenaResetToMarker, memory above the peak usage of those resets is given back to the system.
+// In between, popped memory stays committed so workloads that push and pop every frame do not pay for page faults. 0 disables trimming
+GROUNDED_FUNCTION_INLINE void arenaSetTrimPolicy(MemoryArena* arena, u32 trimResetCount);
+// Gives back retained memory as long as keepSize bytes stay usable without growing. Only supported by some arena types
+GROUNDED_FUNCTION_INLINE void arenaTrim(MemoryArena* arena, u64 keepSize);
+
 
 
 
@@ -79,21 +123,26 @@ GROUNDED_FUNCTION_INLINE void arenaResetToMarker(ArenaMarker marker);
 // Implementors API
 
 // Size should point to the request size and is filled out with the actual returned size.
-// If return is non-null size is guaranteed to be >= requested size.
+// If return is non-null size is usually >= requested size. If it is not, the arena calls grow again until the allocation fits.
 // Memory returned may not be zeroed
 // Alignment is always <= 4096
 typedef void* ArenaGrowFunc(MemoryArena* arena, u64* size, u64 alignment);
 // Is called once a reset point is out of current block which would also mean it is never called for a single contigous arena. 
 // If this is called with a null pointer the arena should be completely reset and not be used afterwards
 typedef void ArenaShrinkFunc(MemoryArena* arena, u8* newHead);
+// Optional. Releases retained memory that is not required to hold keepSize bytes in total
+typedef void ArenaTrimFunc(MemoryArena* arena, u64 keepSize);
 
 // Memory Debugging functionality. If those are present they are called for every single allocation
 typedef void* ArenaDebugAllocate(MemoryArena* arena, u64 size, u64 alignment, bool clear, u64 line, String8 filename);
 typedef void ArenaDebugDeallocate(MemoryArena* arena, u8* newHead);
+// Optional. Called by arenaRelease instead of the shrink function so the debug mode can free its own bookkeeping
+typedef void ArenaDebugRelease(MemoryArena* arena);
 
 struct MemoryArenaDebugData {
     ArenaDebugAllocate* debugAllocate;
     ArenaDebugDeallocate* debugDeallocate;
+    ArenaDebugRelease* debugRelease;
     void* data;
 };
 
@@ -108,6 +157,7 @@ struct MemoryArena {
     // It would be possible to use a pointer to a function table containing both of the functions (more indirection but less memory requirement for main arena). Or do both in a single function which has a dispatch based on a parameter
     ArenaGrowFunc* grow;
     ArenaShrinkFunc* shrink;
+    ArenaTrimFunc* trim; // 0 if the arena does not retain memory
     struct MemoryArenaDebugData* debugData; // 0 for non-debug arenas
 
     /*
@@ -126,6 +176,14 @@ struct MemoryArena {
         void* additionalPointer;
     };
 
+    // Statistics. Grow, shrink and trim functions are responsible for committedSize and for usedSizeBeforeBlock when they pop blocks
+    u64 committedSize;
+    u64 usedSizeBeforeBlock; // Sum of the heads of all previous blocks
+    u64 peakUsedSize; // Only updated when popping. Use arenaGetStats
+    u64 trimPeakUsedSize; // Peak since the last trim
+    u32 trimResetCount;
+    u32 resetsSinceTrim;
+
 #ifdef GROUNDED_ARENA_TEMP_MEMORY_CHECK
     u32 tempStackIndex;
 #endif
@@ -138,7 +196,7 @@ GROUNDED_FUNCTION_INLINE void* _arenaPushSizeImpl(MemoryArena* arena, u64 size,
     void* result = 0;
     u64 alignedPos = ALIGN_UP_POW2(arena->pos, alignment);
     ASSERT(alignedPos >= arena->pos);
-    if(alignedPos + size > arena->commitPos) {
+    while(alignedPos + size > arena->commitPos) {
         // Grow
         u64 newSize = MAX(size, arena->commitPos);
         u8* newBlock = (u8*)arena->grow(arena, &newSize, alignment);
@@ -148,6 +206,7 @@ GROUNDED_FUNCTION_INLINE void* _arenaPushSizeImpl(MemoryArena* arena, u64 size,
             arena->commitPos += newSize;
         } else {
             // This is a completely new block
+            arena->usedSizeBeforeBlock += arena->pos;
             arena->memory = newBlock;
             arena->pos = 0;
             arena->commitPos = newSize;
@@ -197,7 +256,9 @@ GROUNDED_FUNCTION_INLINE void* _arenaPushCopy(MemoryArena* arena, u64 size, u64
 
 // Arena will release all memory after this function and should not be used anymore
 GROUNDED_FUNCTION_INLINE void arenaRelease(MemoryArena* arena) {
-    if(arena->memory) {
+    if(arena->debugData && arena->debugData->debugRelease) {
+        arena->debugData->debugRelease(arena);
+    } else if(arena->memory) {
         arena->shrink(arena, 0);
     }
 }
@@ -218,6 +279,11 @@ GROUNDED_FUNCTION_INLINE void _arenaPopTo(MemoryArena* arena, u8* newHead) {
 }
 
 GROUNDED_FUNCTION_INLINE void arenaPopTo(MemoryArena* arena, u8* newHead) {
+    // Usage only decreases when popping so this is enough to catch the peak
+    u64 usedSize = arena->usedSizeBeforeBlock + arena->pos;
+    if(usedSize > arena->peakUsedSize) arena->peakUsedSize = usedSize;
+    if(usedSize > arena->trimPeakUsedSize) arena->trimPeakUsedSize = usedSize;
+
     if(arena->debugData) {
         arena->debugData->debugDeallocate(arena, newHead);
     } else {
@@ -265,7 +331,38 @@ GROUNDED_FUNCTION_INLINE ArenaMarker arenaCreateMarker(MemoryArena* arena) {
 }
 
 GROUNDED_FUNCTION_INLINE void arenaResetToMarker(ArenaMarker marker) {
-    arenaPopTo(marker.arena, marker.base + marker.pos);
+    MemoryArena* arena = marker.arena;
+    arenaPopTo(arena, marker.base + marker.pos);
+    if(arena->trimResetCount && ++arena->resetsSinceTrim >= arena->trimResetCount) {
+        arenaTrim(arena, arena->trimPeakUsedSize);
+        arena->resetsSinceTrim = 0;
+        arena->trimPeakUsedSize = arena->usedSizeBeforeBlock + arena->pos;
+    }
+}
+
+GROUNDED_FUNCTION_INLINE MemoryArenaStats arenaGetStats(MemoryArena* arena) {
+    MemoryArenaStats result = {0};
+    result.usedSize = arena->usedSizeBeforeBlock + arena->pos;
+    result.committedSize = arena->committedSize;
+    result.peakUsedSize = MAX(arena->peakUsedSize, result.usedSize);
+    return result;
+}
+
+GROUNDED_FUNCTION_INLINE void arenaResetPeak(MemoryArena* arena) {
+    arena->peakUsedSize = arena->usedSizeBeforeBlock + arena->pos;
+}
+
+GROUNDED_FUNCTION_INLINE void arenaSetTrimPolicy(MemoryArena* arena, u32 trimResetCount) {
+    arena->trimResetCount = trimResetCount;
+    arena->resetsSinceTrim = 0;
+    arena->trimPeakUsedSize = arena->usedSizeBeforeBlock + arena->pos;
+}
+
+GROUNDED_FUNCTION_INLINE void arenaTrim(MemoryArena* arena, u64 keepSize) {
+    // Debug modes manage their blocks themselves
+    if(arena->trim && !arena->debugData) {
+        arena->trim(arena, keepSize);
+    }
 }
 
 #endif // GROUNDED_ARENA_H
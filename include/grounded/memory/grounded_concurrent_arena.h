@@ -0,0 +1,81 @@
+#ifndef GROUNDED_CONCURRENT_ARENA_H
+#define GROUNDED_CONCURRENT_ARENA_H
+
+#include "grounded_arena.h"
+#include "../threading/grounded_threading.h"
+
+// A bump allocator that can be pushed to from many threads at the same time.
+// The fast path is a single atomic fetch add on the offset of the current block.
+// Only once a block is exhausted, the allocating thread takes a lock and pushes a new block onto the backing arena.
+// Individual allocations can not be freed. All memory is reclaimed at once with concurrentArenaReset.
+// The backing arena must not be used by anyone else while the concurrent arena is alive.
+//
+// For many small allocations from the same thread, concurrentArenaCreateThreadArena returns a regular
+// single threaded MemoryArena that takes whole chunks from the concurrent arena.
+// Allocations from such a thread arena do not touch any shared state until its chunk is exhausted.
+
+#define CONCURRENT_ARENA_PUSH_STRUCT(arena, type) (type*)_concurrentArenaPushSize(arena, sizeof(type), ALIGNMENT_OF(type), true, __LINE__, STR8_LITERAL(__FILE__))
+#define CONCURRENT_ARENA_PUSH_ARRAY(arena, count, type) (type*)_concurrentArenaPushSize(arena, sizeof(type)*(count), ALIGNMENT_OF(type), true, __LINE__, STR8_LITERAL(__FILE__))
+#define CONCURRENT_ARENA_PUSH_ARRAY_ALIGNED(arena, count, type, alignment) (type*)_concurrentArenaPushSize(arena, sizeof(type)*(count), alignment, true, __LINE__, STR8_LITERAL(__FILE__))
+#define CONCURRENT_ARENA_PUSH_STRUCT_NO_CLEAR(arena, type) (type*)_concurrentArenaPushSize(arena, sizeof(type), ALIGNMENT_OF(type), false, __LINE__, STR8_LITERAL(__FILE__))
+#define CONCURRENT_ARENA_PUSH_ARRAY_NO_CLEAR(arena, count, type) (type*)_concurrentArenaPushSize(arena, sizeof(type)*(count), ALIGNMENT_OF(type), false, __LINE__, STR8_LITERAL(__FILE__))
+
+typedef struct ConcurrentArenaBlock {
+    u8* memory;
+    u64 size;
+    alignas(64) volatile u64 offset; // Might grow beyond size when concurrent allocations fail
+} ConcurrentArenaBlock;
+
+typedef struct ConcurrentMemoryArena {
+    ConcurrentArenaBlock* volatile currentBlock;
+    u64 blockSize;
+
+    // Everything below is only accessed while holding the mutex
+    GroundedMutex mutex;
+    MemoryArena* backingArena;
+    ArenaMarker resetMarker;
+} ConcurrentMemoryArena;
+
+// Blocks of blockSize bytes are pushed onto the backing arena. Allocations larger than a quarter of the block size get their own block
+GROUNDED_FUNCTION void createConcurrentArena(ConcurrentMemoryArena* arena, MemoryArena* backingArena, u64 blockSize);
+// Pops the backing arena back to where it was at creation time. No thread must allocate from the arena or any of its thread arenas during this
+GROUNDED_FUNCTION void concurrentArenaReset(ConcurrentMemoryArena* arena);
+GROUNDED_FUNCTION void destroyConcurrentArena(ConcurrentMemoryArena* arena);
+
+// The returned arena must only be used by a single thread. Memory is owned by the concurrent arena so the thread arena does not have to be released.
+// It supports temporary memory and markers like every other arena
+GROUNDED_FUNCTION MemoryArena concurrentArenaCreateThreadArena(ConcurrentMemoryArena* arena);
+
+// line and filename are the call site that is reported by debug modes of the backing arena for large allocations
+GROUNDED_FUNCTION void* _concurrentArenaPushSizeSlow(ConcurrentMemoryArena* arena, u64 size, u64 alignment, u64 line, String8 filename);
+
+GROUNDED_FUNCTION_INLINE void* _concurrentArenaTryPushToBlock(ConcurrentArenaBlock* block, u64 size, u64 alignment) {
+    // Reserve enough space so the allocation can be aligned without a compare exchange loop
+    u64 offset = groundedAtomicFetchAdd64(&block->offset, size + alignment - 1, GROUNDED_MEMORY_ORDER_RELAXED);
+    u8* result = (u8*)ALIGN_POINTER_UP_POW2(block->memory + offset, alignment);
+    if(offset > block->size || (u64)(result - block->memory) + size > block->size) {
+        return 0;
+    }
+    return result;
+}
+
+GROUNDED_FUNCTION_INLINE void* _concurrentArenaPushSize(ConcurrentMemoryArena* arena, u64 size, u64 alignment, bool clear, u64 line, String8 filename) {
+    ASSERT(IS_POW2(alignment));
+    ASSERT(alignment <= 4096);
+
+    void* result = 0;
+    ConcurrentArenaBlock* block = (ConcurrentArenaBlock*)groundedAtomicLoadPointer((void* volatile*)&arena->currentBlock, GROUNDED_MEMORY_ORDER_ACQUIRE);
+    if(block) {
+        result = _concurrentArenaTryPushToBlock(block, size, alignment);
+    }
+    if(!result) {
+        result = _concurrentArenaPushSizeSlow(arena, size, alignment, line, filename);
+    }
+
+    // This branch should get optimized out if clear is a compile time constant
+    if(result && clear) { groundedClearMemory(result, size); }
+
+    return result;
+}
+
+#endif // GROUNDED_CONCURRENT_ARENA_H
@@ -0,0 +1,101 @@
+#ifndef GROUNDED_HEAP_H
+#define GROUNDED_HEAP_H
+
+#include "grounded_memory.h"
+#include "../threading/grounded_threading.h"
+
+// General purpose allocator for allocations with individual lifetimes.
+// Implemented as a two level segregated fit (TLSF) allocator: free blocks are kept in size classes that are
+// found with two bit scans, so allocating and freeing are O(1) and fragmentation stays bounded.
+// Memory is reserved from a MemorySubsystem in pools of at least poolSize bytes. A pool is given back to the memory
+// subsystem as soon as it is completely free unless it is the only pool left.
+// All heap functions are thread safe. Threads that allocate many small objects can additionally use a GroundedHeapCache.
+//
+// The heap supports the same debug modes as arenas. They must be enabled before the first allocation.
+
+#define GROUNDED_HEAP_ALIGNMENT 16
+#define GROUNDED_HEAP_SECOND_LEVEL_COUNT_LOG2 5
+#define GROUNDED_HEAP_SECOND_LEVEL_COUNT (1 << GROUNDED_HEAP_SECOND_LEVEL_COUNT_LOG2)
+#define GROUNDED_HEAP_FIRST_LEVEL_SHIFT 9 // Log2 of second level count * alignment
+#define GROUNDED_HEAP_FIRST_LEVEL_COUNT 32 // Largest size class starts at 2^40 bytes
+
+#define GROUNDED_HEAP_CACHE_CLASS_COUNT 16 // Cached classes are multiples of GROUNDED_HEAP_ALIGNMENT up to 256 bytes
+#define GROUNDED_HEAP_CACHE_BATCH_SIZE 16
+
+#define HEAP_ALLOCATE_STRUCT(heap, type) (type*)_groundedHeapAllocate(heap, sizeof(type), ALIGNMENT_OF(type), true, __LINE__, STR8_LITERAL(__FILE__))
+#define HEAP_ALLOCATE_ARRAY(heap, count, type) (type*)_groundedHeapAllocate(heap, sizeof(type)*(count), ALIGNMENT_OF(type), true, __LINE__, STR8_LITERAL(__FILE__))
+#define HEAP_ALLOCATE_ARRAY_ALIGNED(heap, count, type, alignment) (type*)_groundedHeapAllocate(heap, sizeof(type)*(count), alignment, true, __LINE__, STR8_LITERAL(__FILE__))
+#define HEAP_ALLOCATE_STRUCT_NO_CLEAR(heap, type) (type*)_groundedHeapAllocate(heap, sizeof(type), ALIGNMENT_OF(type), false, __LINE__, STR8_LITERAL(__FILE__))
+#define HEAP_ALLOCATE_ARRAY_NO_CLEAR(heap, count, type) (type*)_groundedHeapAllocate(heap, sizeof(type)*(count), ALIGNMENT_OF(type), false, __LINE__, STR8_LITERAL(__FILE__))
+#define HEAP_ALLOCATE_SIZE(heap, size) _groundedHeapAllocate(heap, size, GROUNDED_HEAP_ALIGNMENT, false, __LINE__, STR8_LITERAL(__FILE__))
+// Newly added elements are not cleared
+#define HEAP_REALLOCATE_ARRAY(heap, pointer, count, type) (type*)_groundedHeapReallocate(heap, pointer, sizeof(type)*(count), ALIGNMENT_OF(type), __LINE__, STR8_LITERAL(__FILE__))
+#define HEAP_CACHE_ALLOCATE_STRUCT(heap, cache, type) (type*)_groundedHeapCacheAllocate(heap, cache, sizeof(type), ALIGNMENT_OF(type), __LINE__, STR8_LITERAL(__FILE__))
+#define HEAP_CACHE_ALLOCATE_SIZE(heap, cache, size) _groundedHeapCacheAllocate(heap, cache, size, GROUNDED_HEAP_ALIGNMENT, __LINE__, STR8_LITERAL(__FILE__))
+
+typedef enum GroundedHeapDebugMode {
+    GROUNDED_HEAP_DEBUG_NONE,
+    GROUNDED_HEAP_DEBUG_LOG, // Logs every allocation and free and reports leaks when the heap is destroyed
+    GROUNDED_HEAP_DEBUG_OVERFLOW_DETECT, // Every allocation ends directly before a guard page
+    GROUNDED_HEAP_DEBUG_UNDERFLOW_DETECT, // Every allocation starts directly after a guard page
+} GroundedHeapDebugMode;
+
+typedef struct GroundedHeapBlock GroundedHeapBlock;
+typedef struct GroundedHeapPool GroundedHeapPool;
+typedef struct GroundedHeapDebugAllocation GroundedHeapDebugAllocation;
+
+typedef struct GroundedHeap {
+    GroundedMutex mutex;
+    MemorySubsystem* memorySubsystem;
+    u64 poolSize;
+    GroundedHeapDebugMode debugMode;
+
+    // Everything below is protected by the mutex
+    GroundedHeapPool* pools;
+    u64 reservedSize; // Bytes reserved from the memory subsystem
+    u64 allocatedSize; // Bytes in blocks currently handed out or held by caches including block headers
+    u64 allocationCount;
+    u32 firstLevelBitmap;
+    u32 secondLevelBitmap[GROUNDED_HEAP_FIRST_LEVEL_COUNT];
+    GroundedHeapBlock* freeBlocks[GROUNDED_HEAP_FIRST_LEVEL_COUNT][GROUNDED_HEAP_SECOND_LEVEL_COUNT];
+
+    // Only used in debug modes. Keeps track of all live allocations
+    MemoryArena debugArena;
+    GroundedHeapDebugAllocation** debugAllocations;
+    GroundedHeapDebugAllocation* freeDebugAllocations;
+} GroundedHeap;
+
+// Small blocks owned by a single thread. Must only be used by one thread at a time.
+// Blocks are taken from the heap in batches of GROUNDED_HEAP_CACHE_BATCH_SIZE per class and a batch is given back once a class
+// holds twice that many. Cached blocks count as allocated and keep their pool alive until the cache is flushed.
+// Destroying the heap releases cached blocks as well so a cache must not be used or flushed afterwards. Debug modes bypass caches
+typedef struct GroundedHeapCache {
+    GroundedHeapBlock* freeBlocks[GROUNDED_HEAP_CACHE_CLASS_COUNT];
+    u32 counts[GROUNDED_HEAP_CACHE_CLASS_COUNT];
+} GroundedHeapCache;
+
+// poolSize of 0 defaults to 1MB. Returns false if the first pool could not be reserved
+GROUNDED_FUNCTION bool groundedCreateHeap(GroundedHeap* heap, MemorySubsystem* memorySubsystem, u64 poolSize);
+// Releases all pools. Outstanding allocations and blocks held by caches become invalid
+GROUNDED_FUNCTION void groundedDestroyHeap(GroundedHeap* heap);
+
+GROUNDED_FUNCTION void enableDebugMemoryLoggingForHeap(GroundedHeap* heap);
+GROUNDED_FUNCTION void enableDebugMemoryOverflowDetectForHeap(GroundedHeap* heap);
+GROUNDED_FUNCTION void enableDebugMemoryUnderflowDetectForHeap(GroundedHeap* heap);
+
+// Alignment must be a power of 2. Returns 0 if the memory subsystem is out of memory
+GROUNDED_FUNCTION void* _groundedHeapAllocate(GroundedHeap* heap, u64 size, u64 alignment, bool clear, u64 line, String8 filename);
+// Grows or shrinks in place if possible. Alignment must match the original allocation. A null pointer behaves like an allocation
+GROUNDED_FUNCTION void* _groundedHeapReallocate(GroundedHeap* heap, void* pointer, u64 size, u64 alignment, u64 line, String8 filename);
+// Null pointers are ignored
+GROUNDED_FUNCTION void groundedHeapFree(GroundedHeap* heap, void* pointer);
+// Usable size of an allocation which might be larger than the requested size
+GROUNDED_FUNCTION u64 groundedHeapGetAllocationSize(GroundedHeap* heap, void* pointer);
+
+// Memory is not cleared. Sizes above the cached classes fall back to the heap
+GROUNDED_FUNCTION void* _groundedHeapCacheAllocate(GroundedHeap* heap, GroundedHeapCache* cache, u64 size, u64 alignment, u64 line, String8 filename);
+GROUNDED_FUNCTION void groundedHeapCacheFree(GroundedHeap* heap, GroundedHeapCache* cache, void* pointer);
+// Gives all cached blocks back to the heap
+GROUNDED_FUNCTION void groundedHeapCacheFlush(GroundedHeap* heap, GroundedHeapCache* cache);
+
+#endif // GROUNDED_HEAP_H
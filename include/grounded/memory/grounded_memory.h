@@ -104,8 +104,22 @@ typedef struct {
     bool allowsSeparateCommit;
 } MemorySubsystem;
 
+// Placement hints for virtual memory reservations
+typedef enum GroundedVirtualMemoryFlags {
+    GROUNDED_VIRTUAL_MEMORY_HUGE_PAGES = 0x1, // Transparent huge pages. Uses normal pages if the system does not support them
+    GROUNDED_VIRTUAL_MEMORY_HUGE_PAGES_EXPLICIT = 0x2, // Pages from the reserved huge page pool. Falls back to transparent huge pages
+    GROUNDED_VIRTUAL_MEMORY_PREFAULT = 0x4, // Committed memory is faulted in immediately instead of on first access
+    GROUNDED_VIRTUAL_MEMORY_NUMA_BIND = 0x8, // Physical memory is taken from the given NUMA node only
+} GroundedVirtualMemoryFlags;
+#define GROUNDED_VIRTUAL_MEMORY_FLAG_MASK 0xF
+#define GROUNDED_VIRTUAL_MEMORY_MAX_NUMA_NODE 255
+#define GROUNDED_HUGE_PAGE_SIZE MB(2)
+
 GROUNDED_FUNCTION void* osAllocateMemory(u64 size);
 GROUNDED_FUNCTION void* osReserveMemory(u64 size);
+// With huge page flags the size is rounded up to GROUNDED_HUGE_PAGE_SIZE and the result is aligned to it.
+// numaNode is ignored without GROUNDED_VIRTUAL_MEMORY_NUMA_BIND
+GROUNDED_FUNCTION void* osReserveMemoryWithFlags(u64 size, u32 flags, u32 numaNode);
 GROUNDED_FUNCTION void* osAllocateGuardedMemory(u64 size, u64 alignment, bool overflow);
 GROUNDED_FUNCTION void osFreeGuardedMemory(void* memory, u64 size, bool overflow);
 
@@ -115,7 +129,14 @@ GROUNDED_FUNCTION MemorySubsystem* getMallocMemorySubsystem();
 // If Overflow or Underflow protection is enabled fixed size behaves like a growing arena
 GROUNDED_FUNCTION struct MemoryArena createFixedSizeArena(MemorySubsystem* memorySubsystem, u64 size);
 GROUNDED_FUNCTION struct MemoryArena createGrowingArena(MemorySubsystem* memorySubsystem, u64 minBlockSize);
+// Blocks that are popped are kept for reuse instead of being released, up to spareBlockCount. arenaTrim releases them
+GROUNDED_FUNCTION struct MemoryArena createGrowingArenaWithSpareBlocks(MemorySubsystem* memorySubsystem, u64 minBlockSize, u32 spareBlockCount);
+// Reserves reserveSize bytes of address space once and commits it in power of two steps, so memory stays contiguous
+// and popping never has to walk blocks. Only if the reservation is exhausted another one is chained
+GROUNDED_FUNCTION struct MemoryArena createVirtualMemoryGrowingArena(u64 reserveSize);
 GROUNDED_FUNCTION struct MemoryArena createContigousVirtualMemoryArena(u64 maxVirtualMemorySize);
+// Commits in units of GROUNDED_HUGE_PAGE_SIZE if huge pages are requested
+GROUNDED_FUNCTION struct MemoryArena createContigousVirtualMemoryArenaWithFlags(u64 maxVirtualMemorySize, u32 flags, u32 numaNode);
 
 // Circular Buffer aka. Ring buffer
 typedef struct {
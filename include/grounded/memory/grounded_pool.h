@@ -0,0 +1,78 @@
+#ifndef GROUNDED_POOL_H
+#define GROUNDED_POOL_H
+
+#include "grounded_arena.h"
+#include "../threading/grounded_threading.h"
+
+// Pool allocator for objects of a single fixed size. Slots are taken from chunks that are pushed onto the backing arena
+// and freed slots are kept in an intrusive free list, so allocating and freeing are O(1).
+// Chunk k holds slotsPerChunk << k slots so at most GROUNDED_POOL_MAX_CHUNKS chunks are ever required.
+// Memory is only given back to the backing arena by destroying the pool.
+// The pool itself is protected by a mutex. Threads that allocate a lot can additionally use a GroundedPoolCache
+// which takes slots from the pool in batches of GROUNDED_POOL_CACHE_BATCH_SIZE and gives a batch back once it holds twice that many.
+//
+// Handles are stable ids of a slot. The lower 32 bits hold the slot index + 1 and the upper 32 bits the generation of the slot.
+// Only with GROUNDED_POOL_HANDLE_CHECK the generation is tracked. It is incremented on allocation and free so stale
+// handles and double frees are detected. Without it the upper bits are 0 and ignored.
+
+// Enables handle checking project wide for debug builds. Only changes the behaviour of grounded_pool.c
+#ifdef GROUNDED_ARENA_DEBUG
+#define GROUNDED_POOL_HANDLE_CHECK
+#endif
+
+#define GROUNDED_POOL_MAX_CHUNKS 32
+#define GROUNDED_POOL_CACHE_BATCH_SIZE 32
+
+typedef u64 GroundedPoolHandle;
+
+typedef struct GroundedPoolFreeSlot {
+    struct GroundedPoolFreeSlot* next;
+} GroundedPoolFreeSlot;
+
+typedef struct GroundedPool {
+    GroundedMutex mutex;
+    MemoryArena* arena;
+    ArenaMarker arenaMarker;
+    u64 stride;
+    u64 alignment;
+    u64 slotsPerChunk;
+
+    // Everything below is protected by the mutex
+    GroundedPoolFreeSlot* freeList;
+    u64 usedSlotCount; // Number of slots ever taken from chunks
+    u64 allocatedCount; // Number of slots currently handed out or held by caches
+    u8* volatile chunks[GROUNDED_POOL_MAX_CHUNKS];
+    // Even generation means free. Odd generation means allocated.
+    // Always part of the struct so the layout does not depend on GROUNDED_POOL_HANDLE_CHECK but only allocated if it is defined
+    volatile u32* generations[GROUNDED_POOL_MAX_CHUNKS];
+} GroundedPool;
+
+// Free slots owned by a single thread. Must only be used by one thread at a time.
+// Cached slots count as allocated so every cache must be flushed before the pool is destroyed
+typedef struct GroundedPoolCache {
+    GroundedPoolFreeSlot* freeList;
+    u32 count;
+} GroundedPoolCache;
+
+#define GROUNDED_CREATE_POOL_FOR_TYPE(pool, arena, type, slotsPerChunk) groundedCreatePool(pool, arena, sizeof(type), ALIGNMENT_OF(type), slotsPerChunk)
+
+// The backing arena must not be used by anything else while the pool is alive. slotsPerChunk of 0 defaults to 64
+GROUNDED_FUNCTION void groundedCreatePool(GroundedPool* pool, MemoryArena* arena, u64 objectSize, u64 alignment, u64 slotsPerChunk);
+// Resets the backing arena to the state at pool creation
+GROUNDED_FUNCTION void groundedDestroyPool(GroundedPool* pool);
+
+// Returned memory is cleared. Returns 0 if the backing arena is out of memory
+GROUNDED_FUNCTION void* groundedPoolAllocate(GroundedPool* pool);
+GROUNDED_FUNCTION void groundedPoolFree(GroundedPool* pool, void* object);
+
+GROUNDED_FUNCTION void* groundedPoolCacheAllocate(GroundedPool* pool, GroundedPoolCache* cache);
+GROUNDED_FUNCTION void groundedPoolCacheFree(GroundedPool* pool, GroundedPoolCache* cache, void* object);
+// Gives all cached slots back to the pool
+GROUNDED_FUNCTION void groundedPoolCacheFlush(GroundedPool* pool, GroundedPoolCache* cache);
+
+// Handle of an allocated object. Never 0
+GROUNDED_FUNCTION GroundedPoolHandle groundedPoolGetHandle(GroundedPool* pool, void* object);
+// Returns 0 if the handle is invalid. With GROUNDED_POOL_HANDLE_CHECK this includes handles of objects that have been freed
+GROUNDED_FUNCTION void* groundedPoolGet(GroundedPool* pool, GroundedPoolHandle handle);
+
+#endif // GROUNDED_POOL_H
@@ -0,0 +1,62 @@
+#ifndef GROUNDED_INTERN_H
+#define GROUNDED_INTERN_H
+
+#include "../grounded.h"
+#include "grounded_string.h"
+#include "../memory/grounded_arena.h"
+#include "../threading/grounded_threading.h"
+
+// String interning. Every distinct string is copied once into the arena of the table and gets a stable id,
+// so strings can be compared by comparing ids. Ids are dense and start at 1. 0 is never a valid id.
+// Lookups do not take any lock. Only inserting a string that is not in the table yet takes the mutex.
+// Grown hash tables are published atomically and old ones stay in the arena so concurrent readers are never invalidated.
+// Interned strings are null terminated.
+
+#define GROUNDED_INTERN_MAX_CHUNKS 26
+#define GROUNDED_INTERN_FIRST_CHUNK_SIZE 64
+
+typedef u32 GroundedStringId;
+
+typedef struct GroundedInternEntry {
+    String8 string;
+    u64 hash;
+} GroundedInternEntry;
+
+typedef struct GroundedInternHashTable {
+    u64 capacity;
+    u32 capacityLog2;
+    // Upper 32 bits of the hash and the id. 0 for empty slots
+    volatile u64 slots[];
+} GroundedInternHashTable;
+
+typedef struct GroundedInternTable {
+    GroundedInternHashTable* volatile hashTable;
+    // Chunk k holds GROUNDED_INTERN_FIRST_CHUNK_SIZE << k entries so entries never move
+    GroundedInternEntry* volatile chunks[GROUNDED_INTERN_MAX_CHUNKS];
+    volatile u32 count;
+
+    // Everything below is only accessed while holding the mutex
+    GroundedMutex mutex;
+    MemoryArena* arena;
+    ArenaMarker arenaMarker;
+} GroundedInternTable;
+
+// The arena must not be used by anything else while the table is alive
+GROUNDED_FUNCTION void groundedCreateInternTable(GroundedInternTable* table, MemoryArena* arena);
+// Resets the arena to the state at creation. All ids and interned strings become invalid
+GROUNDED_FUNCTION void groundedDestroyInternTable(GroundedInternTable* table);
+
+// Returns the id of the string and inserts a copy if it is not in the table yet. Returns 0 if the arena is out of memory
+GROUNDED_FUNCTION GroundedStringId groundedInternString(GroundedInternTable* table, String8 string);
+// Same as groundedInternString but reuses the hash of the atom
+GROUNDED_FUNCTION GroundedStringId groundedInternAtom(GroundedInternTable* table, StringAtom atom);
+// Returns 0 if the string has not been interned
+GROUNDED_FUNCTION GroundedStringId groundedInternFind(GroundedInternTable* table, String8 string);
+// The returned string stays valid until the table is destroyed
+GROUNDED_FUNCTION String8 groundedInternGetString(GroundedInternTable* table, GroundedStringId id);
+GROUNDED_FUNCTION u32 groundedInternGetCount(GroundedInternTable* table);
+
+// Process wide table that is created on first use and lives until the process exits
+GROUNDED_FUNCTION GroundedInternTable* groundedGetGlobalInternTable();
+
+#endif // GROUNDED_INTERN_H
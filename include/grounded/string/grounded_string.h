@@ -56,6 +56,7 @@ GROUNDED_FUNCTION int str8Compare(String8 a, String8 b);
 GROUNDED_FUNCTION int str8CompareCaseInsensitive(String8 a, String8 b);
 GROUNDED_FUNCTION u64 str8GetFirstOccurence(String8 str, char c); // Returns UINT64_MAX if not found
 GROUNDED_FUNCTION u64 str8GetLastOccurence(String8 str, char c); // Returns UINT64_MAX if not found
+GROUNDED_FUNCTION u64 str8GetFirstOccurenceOfSubstring(String8 str, String8 substring); // Returns UINT64_MAX if not found
 GROUNDED_FUNCTION bool str8IsPrefixOf(String8 prefix, String8 str);
 GROUNDED_FUNCTION bool str8IsPrefixOfCaseInsensitive(String8 prefix, String8 str);
 GROUNDED_FUNCTION bool str8IsPostfixOf(String8 postfix, String8 str);
@@ -90,6 +91,33 @@ GROUNDED_FUNCTION String8List str8Split(struct MemoryArena* arena, String8 str,
 GROUNDED_FUNCTION String8* str8ListToArray(struct MemoryArena* arena, String8List* list);
 GROUNDED_FUNCTION String8* str8SplitToArray(struct MemoryArena* arena, String8 str, u8* splitCharacters, u64 splitCharacterCount, u64* outCount);
 
+// String builder
+// Appends in place at the head of the arena as long as the builder made the last allocation of the arena, so the result
+// is contiguous without copying. If anything else is pushed onto the arena in between, the current chunk is closed and
+// appending continues in a new chunk. str8BuilderFinish joins the chunks once if there is more than one.
+// Formatting streams directly into the builder in a single pass.
+typedef struct String8Builder {
+    struct MemoryArena* arena;
+    u8* chunk;
+    u64 chunkSize;
+    u64 chunkCapacity;
+    String8List closedChunks;
+    bool outOfMemory; // Set once an append failed. Later appends are ignored
+} String8Builder;
+
+// Nothing is allocated before the first append
+GROUNDED_FUNCTION String8Builder str8BuilderCreate(struct MemoryArena* arena);
+// All appends return false if the arena is out of memory
+GROUNDED_FUNCTION bool str8BuilderAppend(String8Builder* builder, String8 str);
+GROUNDED_FUNCTION bool str8BuilderAppendCharacter(String8Builder* builder, u8 character);
+GROUNDED_FUNCTION bool str8BuilderAppendFormat(String8Builder* builder, const char* format, ...);
+// Returns space for size bytes that can be written directly. Only the bytes passed to str8BuilderCommit become part of the string
+GROUNDED_FUNCTION u8* str8BuilderReserve(String8Builder* builder, u64 size);
+GROUNDED_FUNCTION void str8BuilderCommit(String8Builder* builder, u64 size);
+GROUNDED_FUNCTION u64 str8BuilderGetSize(String8Builder* builder);
+// Returns the 0-terminated result and gives unused space back to the arena. The builder must not be used afterwards
+GROUNDED_FUNCTION String8 str8BuilderFinish(String8Builder* builder);
+
 // Size in number of u16
 GROUNDED_FUNCTION_INLINE String16 str16FromBlock(u16* str, u64 size) {
     String16 result = {str, size};
@@ -121,6 +149,7 @@ GROUNDED_FUNCTION_INLINE String32 str32FromRange(u32* first, u32* opl) {
 
 //////////
 // Unicode
+// Validates according to RFC 3629 so overlong encodings, surrogates and codepoints above U+10FFFF are rejected
 GROUNDED_FUNCTION bool str8IsValidUtf8(String8 str);
 
 // Single codepoint encoding/decoding
@@ -133,11 +162,12 @@ GROUNDED_FUNCTION StringDecode strDecodeUtf16(u16* string, s64 capacity); // res
 // dst must have at least 4 bytes (2 u16) of space available
 GROUNDED_FUNCTION u32 strEncodeUtf16(u16* dst, u32 codepoint); // Returns u16 advanced in dst. Maximum possible advance is 2
 
-// Returns UINT32_MAX if codepoint can not be converted (not applicable or already correct case)
+// Returns the codepoint itself if it has no mapping (not applicable or already correct case). Constant time table lookup
 GROUNDED_FUNCTION u32 strCodepointToLower(u32 codepoint);
 GROUNDED_FUNCTION u32 strCodepointToUpper(u32 codepoint);
 
-// All functions 0-terminate the result string
+// All functions 0-terminate the result string. The exact result size is computed first so nothing is left over on the arena.
+// Invalid UTF-8 is converted like strDecodeUtf8 does it. UTF-16 conversion stops at the first unpaired surrogate
 GROUNDED_FUNCTION String8 str8FromStr16(struct MemoryArena* arena, String16 str);
 GROUNDED_FUNCTION String8 str8FromStr32(struct MemoryArena* arena, String32 str);
 GROUNDED_FUNCTION String16 str16FromStr8(struct MemoryArena* arena, String8 str);
@@ -0,0 +1,88 @@
+#ifndef GROUNDED_TEXT_BUFFER_H
+#define GROUNDED_TEXT_BUFFER_H
+
+#include "../grounded.h"
+#include "grounded_string.h"
+#include "../memory/grounded_arena.h"
+
+// Editable UTF-8 text implemented as a piece table.
+// The text is a sequence of pieces that point into immutable blocks of bytes. Inserted text is appended to the
+// current block and deleting only removes pieces so no text is ever moved.
+// Pieces are kept in a treap ordered by position. Every node caches the byte, codepoint and line count of its subtree so
+// inserting, deleting and converting between byte offsets, codepoint indices and lines is O(log n) in the number of pieces.
+// Pieces are at most GROUNDED_TEXT_BUFFER_MAX_PIECE_SIZE bytes so splitting a piece is cheap.
+// Typing at the end of the most recently inserted text extends its piece instead of creating a new one.
+//
+// All positions are byte offsets unless stated otherwise. Lines are separated by '\n'.
+// Nodes and text blocks come from the arena. Nodes of deleted pieces are reused but deleted text stays in the arena
+// until the buffer is destroyed.
+
+#define GROUNDED_TEXT_BUFFER_MAX_PIECE_SIZE 4096
+#define GROUNDED_TEXT_BUFFER_BLOCK_SIZE KB(64)
+
+typedef struct GroundedTextPiece {
+    struct GroundedTextPiece* left;
+    struct GroundedTextPiece* right;
+    u8* base;
+    u64 size;
+    u64 codepointCount;
+    u64 lineCount; // Number of '\n'
+    // Including this piece
+    u64 subtreeSize;
+    u64 subtreeCodepointCount;
+    u64 subtreeLineCount;
+    u32 priority;
+} GroundedTextPiece;
+
+typedef struct GroundedTextBuffer {
+    GroundedTextPiece* root;
+    GroundedTextPiece* freePieces; // Linked with left
+    u64 freePieceCount;
+    MemoryArena* arena;
+    ArenaMarker arenaMarker;
+    u8* block;
+    u64 blockSize;
+    u64 blockUsed;
+    u32 randomState;
+} GroundedTextBuffer;
+
+typedef struct GroundedTextIterator {
+    GroundedTextBuffer* buffer;
+    u64 offset;
+    u64 end;
+} GroundedTextIterator;
+
+// The arena must not be used by anything else while the buffer is alive. The initial text is copied. Returns false if the arena is out of memory
+GROUNDED_FUNCTION bool groundedCreateTextBuffer(GroundedTextBuffer* buffer, MemoryArena* arena, String8 text);
+// Resets the arena to the state at creation
+GROUNDED_FUNCTION void groundedDestroyTextBuffer(GroundedTextBuffer* buffer);
+
+// Both return false without modifying the buffer if the arena is out of memory
+GROUNDED_FUNCTION bool groundedTextBufferInsert(GroundedTextBuffer* buffer, u64 offset, String8 text);
+GROUNDED_FUNCTION bool groundedTextBufferDelete(GroundedTextBuffer* buffer, u64 offset, u64 size);
+// Convenience for delete followed by insert
+GROUNDED_FUNCTION bool groundedTextBufferReplace(GroundedTextBuffer* buffer, u64 offset, u64 size, String8 text);
+
+GROUNDED_FUNCTION u64 groundedTextBufferGetSize(GroundedTextBuffer* buffer);
+GROUNDED_FUNCTION u64 groundedTextBufferGetCodepointCount(GroundedTextBuffer* buffer);
+// Number of '\n' plus one. An empty buffer has one line
+GROUNDED_FUNCTION u64 groundedTextBufferGetLineCount(GroundedTextBuffer* buffer);
+
+// Codepoints are counted as bytes that are not UTF-8 continuation bytes.
+// Offsets past the end are clamped to the size of the buffer
+GROUNDED_FUNCTION u64 groundedTextBufferGetOffsetOfCodepoint(GroundedTextBuffer* buffer, u64 codepointIndex);
+GROUNDED_FUNCTION u64 groundedTextBufferGetCodepointIndex(GroundedTextBuffer* buffer, u64 offset);
+// Offset of the first byte of line. Lines are 0 based
+GROUNDED_FUNCTION u64 groundedTextBufferGetOffsetOfLine(GroundedTextBuffer* buffer, u64 line);
+GROUNDED_FUNCTION u64 groundedTextBufferGetLineIndex(GroundedTextBuffer* buffer, u64 offset);
+
+// Contiguous bytes starting at offset up to the end of the piece that contains offset. Empty at the end of the buffer.
+// Slices are valid until the buffer is destroyed
+GROUNDED_FUNCTION String8 groundedTextBufferGetSlice(GroundedTextBuffer* buffer, u64 offset);
+// Iterates over the range as slices. The buffer must not be modified while iterating
+GROUNDED_FUNCTION GroundedTextIterator groundedTextBufferIterate(GroundedTextBuffer* buffer, u64 offset, u64 size);
+GROUNDED_FUNCTION bool groundedTextIteratorNext(GroundedTextIterator* iterator, String8* slice);
+// 0 terminated copy of the range
+GROUNDED_FUNCTION String8 groundedTextBufferCopy(GroundedTextBuffer* buffer, MemoryArena* arena, u64 offset, u64 size);
+
+#endif // GROUNDED_TEXT_BUFFER_H
@@ -1,9 +1,20 @@
+#ifndef GROUNDED_ASYNC_H
+#define GROUNDED_ASYNC_H
+
 #include "grounded_threading.h"
 #include <grounded/memory/grounded_memory.h>
 
-// Very simple async system. Tasks are handled asynchronously in order.
+// Work stealing async system. Tasks are executed by a set of worker threads.
+// Every worker owns a Chase-Lev deque. Tasks pushed from inside a worker go into the deque of that worker,
+// tasks pushed from any other thread go into a lock-free injection queue. Idle workers first drain their own deque,
+// then the injection queue and finally try to steal from the deques of other workers.
+// There is no ordering guarantee between tasks unless it is expressed with dependencies.
+// A task can depend on up to GROUNDED_ASYNC_MAX_DEPENDENCIES other tasks and does not start before all of them have finished.
+// Child tasks keep their parent unfinished until they themselves have finished.
+// Waiting threads execute pending tasks while waiting so fork-join style waits from inside tasks do not deadlock.
 
 struct AsyncTaskData;
+struct GroundedAsyncSystem;
 
 typedef u64 GroundedAsyncTask;
 
@@ -14,185 +25,87 @@ struct AsyncTaskData {
     GroundedAsyncProc* proc;
     u8* userData;
     u64 userDataSize;
+    struct GroundedAsyncSystem* system; // The system this task is running on. Can be used to push further tasks
+    GroundedAsyncTask task; // Handle of this task
 };
 
-struct AsyncNode {
-    struct AsyncNode* next;
-    struct AsyncTaskData data;
-    GroundedAsyncTask task;
-};
+typedef struct GroundedAsyncSystemParameters {
+    u32 workerCount; // 0 creates one worker per logical core
+    u64 maxTaskCount; // Maximum number of tasks in flight. 0 defaults to 4096
+    u64 maxUserDataSize; // Maximum size of userData that can be passed with a task. 0 defaults to 128 bytes
+} GroundedAsyncSystemParameters;
 
-typedef struct GroundedAsyncSystem {
-    GroundedConditionVariable taskAcquireConditionVariable;
-    GroundedConditionVariable taskWaitConditionVariable;
-    GroundedMutex mutex;
-    GroundedAsyncTask nextTaskIndex;
-    struct AsyncNode tasksSentinel;
-    struct AsyncNode freeTasksSentinel;
+#ifndef GROUNDED_ASYNC_MAX_DEPENDENCIES
+#define GROUNDED_ASYNC_MAX_DEPENDENCIES 8
+#endif
 
-    GroundedAsyncTask runningTask;
+struct AsyncNode;
+struct AsyncDependencyLink;
+struct AsyncWorker;
+struct AsyncSharedState;
 
-    // Circular buffer to store tasks
-    GroundedCircularBufferReadWriter circularBuffer;
-    GroundedThread* thread;
+typedef struct GroundedAsyncSystem {
+    struct AsyncSharedState* shared; // Counters that are modified by many threads. Each on its own cache line
+    struct AsyncNode* nodes;
+    struct AsyncDependencyLink* links; // GROUNDED_ASYNC_MAX_DEPENDENCIES per node
+    u8* nodeUserData;
+    u64 nodeCount;
+    u64 maxUserDataSize;
+    u64 queueMask; // Size of injection queue and worker deques - 1
+
+    struct AsyncWorker* workers;
+    u32 workerCount;
+    GroundedSemaphore wakeSemaphore;
+    GroundedLogFunction* logFunction;
 
     MemoryArena arena;
 } GroundedAsyncSystem;
 
-GROUNDED_THREAD_PROC(asyncSystemThreadProc) {
-    MemoryArena* scratch = threadContextGetScratch(0);
-
-    GroundedAsyncSystem* system = (GroundedAsyncSystem*)userData;
-
-    groundedLockMutex(&system->mutex);
-    while(true) {
-        while(!system->tasksSentinel.next) {
-            if(groundedThreadShouldStop(system->thread)) {
-                groundedUnlockMutex(&system->mutex);
-                return;
-            }
-            groundedConditionVariableWait(&system->taskAcquireConditionVariable, &system->mutex);
-        }
-        struct AsyncNode* node = system->tasksSentinel.next;
-        system->tasksSentinel.next = node->next;
-        node->next = 0;
-        system->runningTask = node->task;
-        groundedUnlockMutex(&system->mutex);
-
-        node->data.proc(&node->data);
-
-        groundedLockMutex(&system->mutex);
-        readFromCircularBuffer(&system->circularBuffer, node->data.userDataSize);
-        system->runningTask = 0;
-        node->next = system->freeTasksSentinel.next;
-        system->freeTasksSentinel.next = node;
-        groundedConditionVariableSignal(&system->taskWaitConditionVariable);
-    }
-    groundedUnlockMutex(&system->mutex);
-}
-
-GROUNDED_FUNCTION_INLINE bool createAsyncSystem(GroundedAsyncSystem* system, u64 ringBufferSize, u64 entryCount) {
-    *system = (GroundedAsyncSystem){0};
-    if(ringBufferSize == 0) ringBufferSize = KB(4);
-    system->circularBuffer.buffer = groundedCreateCircularBuffer(ringBufferSize);
-    system->circularBuffer.readHead = system->circularBuffer.buffer.buffer;
-    system->circularBuffer.writeHead = system->circularBuffer.buffer.buffer;
-    system->arena = createGrowingArena(osGetMemorySubsystem(), KB(64));
-    enableDebugMemoryOverflowDetectForArena(&system->arena);
-    struct AsyncNode* nodes = ARENA_PUSH_ARRAY(&system->arena, entryCount, struct AsyncNode);
-    for(u64 i = 0; i < entryCount; ++i) {
-        nodes[i].next = system->freeTasksSentinel.next;
-        system->freeTasksSentinel.next = &nodes[i];
-    }
-    system->nextTaskIndex = 1;
-    system->mutex = groundedCreateMutex();
-    groundedLockMutex(&system->mutex);
-    system->taskAcquireConditionVariable = groundedCreateConditionVariable();
-    system->taskWaitConditionVariable = groundedCreateConditionVariable();
-    //groundedDispatchThread(&arena, &asyncSystemThreadProc, system, "AsyncSystemThread");
-    system->thread = groundedStartThread(&system->arena, &asyncSystemThreadProc, system, "AsyncSystemThread");
-    groundedUnlockMutex(&system->mutex);
-    return true;
-}
-
-GROUNDED_FUNCTION_INLINE void destroyAsyncSystem(GroundedAsyncSystem* system) {
-    if(system->thread) {
-        groundedThreadRequestStop(system->thread);
-        // "Tickle" the thread by signaling the task acquire variable
-        groundedConditionVariableSignal(&system->taskAcquireConditionVariable);
-        groundedThreadWaitForFinish(system->thread, 0);
-        groundedDestroyThread(system->thread);
-    }
-    
-    groundedDestroyCircularBuffer(&system->circularBuffer.buffer);
-    groundedDestroyMutex(&system->mutex);
-    groundedDestroyConditionVariable(&system->taskAcquireConditionVariable);
-    groundedDestroyConditionVariable(&system->taskWaitConditionVariable);
-}
-
-//TODO: It would be possible to store the AsyncNodes in the circular buffer. This would remove the need for the freeSentinel and the additional buffer allocated form the arena
-
-// Return 0 means that the task could not be pushed onto queue
-GROUNDED_FUNCTION_INLINE GroundedAsyncTask groundedPushAsyncTask(GroundedAsyncSystem* system, GroundedAsyncProc* proc, void* userData, u64 userDataSize) {
-    GroundedAsyncTask result = 0;
-    groundedLockMutex(&system->mutex);
-
-    struct AsyncNode* node = system->freeTasksSentinel.next;
-    if(node) {
-        node->data.userData = writeToCircularBuffer(&system->circularBuffer, (u8*)userData, userDataSize);
-        if(node->data.userData) {
-            system->freeTasksSentinel.next = node->next;
-            node->next = 0;
-
-            result = system->nextTaskIndex++;
-            node->task = result;
-            node->data.proc = proc;
-            node->data.userDataSize = userDataSize;
-
-            // Insert at back of tasks
-            struct AsyncNode* taskNode = &system->tasksSentinel;
-            while(taskNode->next) {
-                taskNode = taskNode->next;
-            }
-            taskNode->next = node;
-            groundedConditionVariableSignal(&system->taskAcquireConditionVariable);
-        }
-    }
-
-    groundedUnlockMutex(&system->mutex);
-    return result;
-}
-
-GROUNDED_FUNCTION_INLINE bool groundedAsyncTaskIsRunning(GroundedAsyncSystem* system, GroundedAsyncTask task) {
-    ASSERT(false);
-    return false;
-}
-
-GROUNDED_FUNCTION_INLINE bool groundedAsyncTaskIsPending(GroundedAsyncSystem* system, GroundedAsyncTask task) {
-    ASSERT(false);
-    return false;
-}
-
-GROUNDED_FUNCTION_INLINE bool _groundedAsyncIsTaskFinished(GroundedAsyncSystem* system, GroundedAsyncTask task) {
-    bool result = true;
-    if(system->runningTask == task) result = false;
-    if(result) {
-        struct AsyncNode* taskNode = &system->tasksSentinel;
-        while(taskNode->next) {
-            if(taskNode->task == task) {
-                result = false;
-                break;
-            }
-            taskNode = taskNode->next;
-        }
-    }
-    return result;
-}
-
-GROUNDED_FUNCTION_INLINE bool groundedAsyncTaskWait(GroundedAsyncSystem* system, GroundedAsyncTask task, u64 timeout) {
-    //TRACY_ZONE_HELPER(groundedAsyncTaskWait);
-
-    //TODO: timeout
-    groundedLockMutex(&system->mutex);
-    while(!_groundedAsyncIsTaskFinished(system, task)) {
-        groundedConditionVariableWait(&system->taskWaitConditionVariable, &system->mutex);
-    }
-    groundedUnlockMutex(&system->mutex);
-    return true;
-}
-
-GROUNDED_FUNCTION_INLINE void groundedAsyncTaskCancel(GroundedAsyncSystem* system, GroundedAsyncTask task) {
-    ASSERT(false);
-}
-
-GROUNDED_FUNCTION_INLINE bool groundedAsyncWaitForAll(GroundedAsyncSystem* system, u64 timeout) {
-    //TRACY_ZONE_HELPER(groundedAsyncWaitForAll);
-
-    groundedLockMutex(&system->mutex);
-    while(system->runningTask || system->tasksSentinel.next) {
-        groundedConditionVariableWait(&system->taskWaitConditionVariable, &system->mutex);
-    }
-    groundedUnlockMutex(&system->mutex);
-    
-    return true;
-}
\ No newline at end of file
+// Parameters might be 0 in which case defaults are used
+GROUNDED_FUNCTION bool createAsyncSystem(GroundedAsyncSystem* system, GroundedAsyncSystemParameters* parameters);
+// Waits for all pending tasks to finish and stops all workers
+GROUNDED_FUNCTION void destroyAsyncSystem(GroundedAsyncSystem* system);
+
+// userData is copied into task local storage. Return 0 means that the task could not be pushed onto queue
+GROUNDED_FUNCTION GroundedAsyncTask groundedPushAsyncTask(GroundedAsyncSystem* system, GroundedAsyncProc* proc, void* userData, u64 userDataSize);
+// The task is not started before all dependencies have finished. Canceled dependencies count as finished
+GROUNDED_FUNCTION GroundedAsyncTask groundedPushAsyncTaskWithDependencies(GroundedAsyncSystem* system, GroundedAsyncProc* proc, void* userData, u64 userDataSize, GroundedAsyncTask* dependencies, u32 dependencyCount);
+// The parent is only considered finished once the child has finished. Fails if the parent has already finished
+GROUNDED_FUNCTION GroundedAsyncTask groundedPushAsyncChildTask(GroundedAsyncSystem* system, GroundedAsyncTask parent, GroundedAsyncProc* proc, void* userData, u64 userDataSize);
+
+GROUNDED_FUNCTION bool groundedAsyncTaskIsRunning(GroundedAsyncSystem* system, GroundedAsyncTask task);
+GROUNDED_FUNCTION bool groundedAsyncTaskIsPending(GroundedAsyncSystem* system, GroundedAsyncTask task);
+GROUNDED_FUNCTION bool groundedAsyncTaskIsFinished(GroundedAsyncSystem* system, GroundedAsyncTask task);
+
+// Executes other pending tasks while waiting. Timeout is in milliseconds, 0 waits indefinitely. Returns false on timeout
+GROUNDED_FUNCTION bool groundedAsyncTaskWait(GroundedAsyncSystem* system, GroundedAsyncTask task, u64 timeout);
+
+// A task that has not started executing yet is skipped. Running tasks are not interrupted
+GROUNDED_FUNCTION void groundedAsyncTaskCancel(GroundedAsyncSystem* system, GroundedAsyncTask task);
+
+// Same as groundedAsyncTaskWait but for all tasks of the system
+GROUNDED_FUNCTION bool groundedAsyncWaitForAll(GroundedAsyncSystem* system, u64 timeout);
+
+///////////////////////////
+// Parallel for and reduce
+// The range [first, opl) is split recursively in halves until a chunk is at most grainSize elements large.
+// Chunks are distributed over all workers. The calling thread helps executing chunks until the whole range is processed.
+// A grainSize of 0 picks a grain size based on the worker count.
+// The scratch arena passed to the procs is the scratch arena of the executing thread and is reset after the proc returns.
+
+#define GROUNDED_PARALLEL_FOR_PROC(name) void name(u64 first, u64 opl, MemoryArena* scratch, void* userData)
+typedef GROUNDED_PARALLEL_FOR_PROC(GroundedParallelForProc);
+
+// accumulator initially contains a copy of the identity value
+#define GROUNDED_PARALLEL_REDUCE_PROC(name) void name(u64 first, u64 opl, void* accumulator, MemoryArena* scratch, void* userData)
+typedef GROUNDED_PARALLEL_REDUCE_PROC(GroundedParallelReduceProc);
+
+// Must combine other into accumulator. other always covers the range directly after accumulator so the operation only has to be associative
+#define GROUNDED_PARALLEL_COMBINE_PROC(name) void name(void* accumulator, void* other, void* userData)
+typedef GROUNDED_PARALLEL_COMBINE_PROC(GroundedParallelCombineProc);
+
+GROUNDED_FUNCTION void groundedParallelFor(GroundedAsyncSystem* system, u64 first, u64 opl, u64 grainSize, GroundedParallelForProc* proc, void* userData);
+// result and identity point to resultSize bytes. result is overwritten with the reduction of the whole range
+GROUNDED_FUNCTION void groundedParallelReduce(GroundedAsyncSystem* system, u64 first, u64 opl, u64 grainSize, void* result, void* identity, u64 resultSize, GroundedParallelReduceProc* reduceProc, GroundedParallelCombineProc* combineProc, void* userData);
+
+#endif // GROUNDED_ASYNC_H
@@ -12,6 +12,145 @@ GROUNDED_FUNCTION_INLINE void groundedSleep(u32 millis) {
     usleep(millis * 1000);
 }
 
+#ifndef GROUNDED_THREADING_PTHREAD
+// By default synchronization primitives are built directly on futexes. Uncontended operations never leave user space
+// and contended operations spin for a short while before they go to sleep in the kernel.
+// Define GROUNDED_THREADING_PTHREAD to use the pthread primitives instead.
+
+// Number of spin iterations before a thread goes to sleep
+#ifndef GROUNDED_FUTEX_SPIN_COUNT
+#define GROUNDED_FUTEX_SPIN_COUNT 128
+#endif
+
+// Sleeps as long as *address == expectedValue. Might wake up spuriously
+GROUNDED_FUNCTION void groundedFutexWait(volatile u32* address, u32 expectedValue);
+// Wakes up to count threads waiting on address
+GROUNDED_FUNCTION void groundedFutexWake(volatile u32* address, u32 count);
+
+// 0: unlocked, 1: locked, 2: locked and there might be waiters
+struct GroundedMutex {
+    volatile u32 state;
+};
+
+GROUNDED_FUNCTION_INLINE GroundedMutex groundedCreateMutex() {
+    GroundedMutex result = {0};
+    return result;
+}
+
+GROUNDED_FUNCTION_INLINE void groundedDestroyMutex(GroundedMutex* mutex) {
+    ASSERT(mutex->state == 0);
+}
+
+GROUNDED_FUNCTION_INLINE void groundedLockMutex(GroundedMutex* mutex) {
+    u32 expected = 0;
+    if(groundedAtomicCompareExchange32(&mutex->state, &expected, 1, GROUNDED_MEMORY_ORDER_ACQUIRE)) {
+        return;
+    }
+    for(u32 i = 0; i < GROUNDED_FUTEX_SPIN_COUNT; ++i) {
+        groundedPause();
+        expected = 0;
+        if(groundedAtomicLoad32(&mutex->state, GROUNDED_MEMORY_ORDER_RELAXED) == 0 && groundedAtomicCompareExchange32(&mutex->state, &expected, 1, GROUNDED_MEMORY_ORDER_ACQUIRE)) {
+            return;
+        }
+    }
+    // We can not know whether we are the only waiter so mark as contended
+    while(groundedAtomicExchange32(&mutex->state, 2, GROUNDED_MEMORY_ORDER_ACQUIRE) != 0) {
+        groundedFutexWait(&mutex->state, 2);
+    }
+}
+
+GROUNDED_FUNCTION_INLINE void groundedUnlockMutex(GroundedMutex* mutex) {
+    if(groundedAtomicExchange32(&mutex->state, 0, GROUNDED_MEMORY_ORDER_RELEASE) == 2) {
+        groundedFutexWake(&mutex->state, 1);
+    }
+}
+
+
+struct GroundedSemaphore {
+    volatile u32 count;
+    volatile u32 waiterCount;
+};
+
+GROUNDED_FUNCTION_INLINE GroundedSemaphore groundedCreateSemaphore(u32 initValue, u32 maxCount) {
+    // Like POSIX semaphores the count is not limited on Linux
+    (void)maxCount;
+    GroundedSemaphore result = {0};
+    result.count = initValue;
+    return result;
+}
+
+GROUNDED_FUNCTION_INLINE void groundedDestroySemaphore(GroundedSemaphore* semaphore) {
+    ASSERT(semaphore->waiterCount == 0);
+}
+
+GROUNDED_FUNCTION_INLINE bool _groundedSemaphoreTryDecrement(GroundedSemaphore* semaphore) {
+    u32 count = groundedAtomicLoad32(&semaphore->count, GROUNDED_MEMORY_ORDER_RELAXED);
+    while(count > 0) {
+        if(groundedAtomicCompareExchange32(&semaphore->count, &count, count - 1, GROUNDED_MEMORY_ORDER_ACQUIRE)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+GROUNDED_FUNCTION_INLINE void groundedIncrementSemaphore(GroundedSemaphore* semaphore) {
+    groundedAtomicFetchAdd32(&semaphore->count, 1, GROUNDED_MEMORY_ORDER_SEQ_CST);
+    if(groundedAtomicLoad32(&semaphore->waiterCount, GROUNDED_MEMORY_ORDER_SEQ_CST) > 0) {
+        groundedFutexWake(&semaphore->count, 1);
+    }
+}
+
+GROUNDED_FUNCTION_INLINE void groundedDecrementSemaphore(GroundedSemaphore* semaphore) {
+    for(u32 i = 0; i < GROUNDED_FUTEX_SPIN_COUNT; ++i) {
+        if(_groundedSemaphoreTryDecrement(semaphore)) {
+            return;
+        }
+        groundedPause();
+    }
+    groundedAtomicFetchAdd32(&semaphore->waiterCount, 1, GROUNDED_MEMORY_ORDER_SEQ_CST);
+    while(!_groundedSemaphoreTryDecrement(semaphore)) {
+        groundedFutexWait(&semaphore->count, 0);
+    }
+    groundedAtomicFetchSub32(&semaphore->waiterCount, 1, GROUNDED_MEMORY_ORDER_RELAXED);
+}
+
+// Waiters sleep on the sequence number and every signal increments it
+struct GroundedConditionVariable {
+    volatile u32 sequence;
+    volatile u32 waiterCount;
+};
+
+GROUNDED_FUNCTION_INLINE GroundedConditionVariable groundedCreateConditionVariable() {
+    GroundedConditionVariable result = {0};
+    return result;
+}
+
+GROUNDED_FUNCTION_INLINE void groundedDestroyConditionVariable(GroundedConditionVariable* conditionVariable) {
+    ASSERT(conditionVariable->waiterCount == 0);
+}
+
+GROUNDED_FUNCTION_INLINE void groundedConditionVariableSignal(GroundedConditionVariable* conditionVariable) {
+    groundedAtomicFetchAdd32(&conditionVariable->sequence, 1, GROUNDED_MEMORY_ORDER_SEQ_CST);
+    if(groundedAtomicLoad32(&conditionVariable->waiterCount, GROUNDED_MEMORY_ORDER_SEQ_CST) > 0) {
+        groundedFutexWake(&conditionVariable->sequence, 1);
+    }
+}
+
+GROUNDED_FUNCTION_INLINE void groundedConditionVariableWait(GroundedConditionVariable* conditionVariable, GroundedMutex* mutex) {
+    groundedAtomicFetchAdd32(&conditionVariable->waiterCount, 1, GROUNDED_MEMORY_ORDER_SEQ_CST);
+    u32 sequence = groundedAtomicLoad32(&conditionVariable->sequence, GROUNDED_MEMORY_ORDER_SEQ_CST);
+    groundedUnlockMutex(mutex);
+    // Returns immediately if a signal arrived after the mutex was released
+    groundedFutexWait(&conditionVariable->sequence, sequence);
+    groundedAtomicFetchSub32(&conditionVariable->waiterCount, 1, GROUNDED_MEMORY_ORDER_RELAXED);
+    // Other waiters might have been woken up as well so the mutex must be considered contended
+    while(groundedAtomicExchange32(&mutex->state, 2, GROUNDED_MEMORY_ORDER_ACQUIRE) != 0) {
+        groundedFutexWait(&mutex->state, 2);
+    }
+}
+
+#else // GROUNDED_THREADING_PTHREAD
+
 struct GroundedMutex {
     pthread_mutex_t mutex;
 };
@@ -41,6 +180,8 @@ struct GroundedSemaphore {
 };
 
 GROUNDED_FUNCTION_INLINE GroundedSemaphore groundedCreateSemaphore(u32 initValue, u32 maxCount) {
+    // POSIX semaphores have no maximum count
+    (void)maxCount;
     GroundedSemaphore result = {0};
 
     sem_init(&result.semaphore, 0, initValue);
@@ -82,13 +223,4 @@ GROUNDED_FUNCTION_INLINE void groundedConditionVariableWait(GroundedConditionVar
     pthread_cond_wait(&conditionVariable->conditionVariable, &mutex->mutex);
 }
 
-// Returns incremented value eg. a pre increment
-GROUNDED_FUNCTION_INLINE u64 groundedInterlockedIncrement64(volatile u64* value) {
-    return __sync_add_and_fetch(value, 1);
-}
-
-// Note that the compare exchange intrinsics can't detect ABA problems!
-// Returns initial value of value
-GROUNDED_FUNCTION_INLINE u64 groundedInterlockedCompareExchange(volatile u64* value, u64 originalValue, u64 newValue) {
-    return __sync_val_compare_and_swap(value, originalValue, newValue);
-}
\ No newline at end of file
+#endif // GROUNDED_THREADING_PTHREAD
@@ -0,0 +1,285 @@
+#ifndef GROUNDED_RING_QUEUE_H
+#define GROUNDED_RING_QUEUE_H
+
+#include "grounded_threading.h"
+#include "../memory/grounded_memory.h"
+
+// Lock-free bounded queues of variable sized records on top of GroundedCircularBuffer.
+// Every record consists of a u64 size header followed by the payload padded to 8 bytes.
+// As the circular buffer maps its memory twice in a row, every record is contiguous in memory even if it wraps around
+// so records can be written and read in place without copying.
+// Positions are monotonically increasing byte offsets. Head and tail counters of producers and consumers live on separate cache lines.
+//
+// Usage for writing: Reserve -> fill record.data -> Commit
+// Usage for reading: Acquire -> read record.data -> Release
+// A reservation or acquisition must be committed or released before the same thread starts the next one.
+
+#define GROUNDED_RING_QUEUE_CACHE_LINE_SIZE 64
+#define GROUNDED_RING_QUEUE_RECORD_HEADER_SIZE 8
+
+typedef struct GroundedRingQueueRecord {
+    u8* data;
+    u64 size; // Payload size in bytes
+    u64 position; // Queue position of the record header
+    u64 nextPosition; // Queue position directly after the record
+} GroundedRingQueueRecord;
+
+GROUNDED_FUNCTION_INLINE u64 _groundedRingQueueRecordSize(u64 payloadSize) {
+    return GROUNDED_RING_QUEUE_RECORD_HEADER_SIZE + ALIGN_UP_POW2(payloadSize, 8);
+}
+
+GROUNDED_FUNCTION_INLINE bool _groundedCreateRingQueueBuffer(GroundedCircularBuffer* buffer, u64 minimumSize) {
+    // Power of 2 size allows masking positions. Page sizes are powers of 2 so the circular buffer keeps the size
+    minimumSize = MAX(minimumSize, 64);
+    u64 size = 1;
+    while(size < minimumSize) size <<= 1;
+    *buffer = groundedCreateCircularBuffer(size);
+    if(!buffer->buffer) {
+        return false;
+    }
+    ASSERT(IS_POW2(buffer->size));
+    return true;
+}
+
+//////////////////////////////////////
+// Single producer single consumer queue
+
+typedef struct GroundedSpscRingQueue {
+    GroundedCircularBuffer buffer;
+    u64 mask;
+
+    // Only modified by the producer
+    alignas(GROUNDED_RING_QUEUE_CACHE_LINE_SIZE) volatile u64 writePosition;
+    u64 cachedReadPosition;
+
+    // Only modified by the consumer
+    alignas(GROUNDED_RING_QUEUE_CACHE_LINE_SIZE) volatile u64 readPosition;
+    u64 cachedWritePosition;
+} GroundedSpscRingQueue;
+
+// Capacity is rounded up to a power of 2 and at least the page size
+GROUNDED_FUNCTION_INLINE bool groundedCreateSpscRingQueue(GroundedSpscRingQueue* queue, u64 minimumSize) {
+    *queue = (GroundedSpscRingQueue){0};
+    if(!_groundedCreateRingQueueBuffer(&queue->buffer, minimumSize)) {
+        return false;
+    }
+    queue->mask = queue->buffer.size - 1;
+    return true;
+}
+
+GROUNDED_FUNCTION_INLINE void groundedDestroySpscRingQueue(GroundedSpscRingQueue* queue) {
+    groundedDestroyCircularBuffer(&queue->buffer);
+    *queue = (GroundedSpscRingQueue){0};
+}
+
+// Returns false if there is not enough space left. Only call from the producer thread
+GROUNDED_FUNCTION_INLINE bool groundedSpscRingQueueReserve(GroundedSpscRingQueue* queue, u64 size, GroundedRingQueueRecord* record) {
+    u64 recordSize = _groundedRingQueueRecordSize(size);
+    ASSERT(recordSize <= queue->buffer.size);
+    u64 position = groundedAtomicLoad64(&queue->writePosition, GROUNDED_MEMORY_ORDER_RELAXED);
+    if(position + recordSize - queue->cachedReadPosition > queue->buffer.size) {
+        // Only look at the shared read position if the cached one says that the queue is full
+        queue->cachedReadPosition = groundedAtomicLoad64(&queue->readPosition, GROUNDED_MEMORY_ORDER_ACQUIRE);
+        if(position + recordSize - queue->cachedReadPosition > queue->buffer.size) {
+            return false;
+        }
+    }
+    u8* header = queue->buffer.buffer + (position & queue->mask);
+    *(u64*)header = size;
+    record->data = header + GROUNDED_RING_QUEUE_RECORD_HEADER_SIZE;
+    record->size = size;
+    record->position = position;
+    record->nextPosition = position + recordSize;
+    return true;
+}
+
+GROUNDED_FUNCTION_INLINE void groundedSpscRingQueueCommit(GroundedSpscRingQueue* queue, GroundedRingQueueRecord* record) {
+    groundedAtomicStore64(&queue->writePosition, record->nextPosition, GROUNDED_MEMORY_ORDER_RELEASE);
+}
+
+// Returns false if the queue is empty. Only call from the consumer thread
+GROUNDED_FUNCTION_INLINE bool groundedSpscRingQueueAcquire(GroundedSpscRingQueue* queue, GroundedRingQueueRecord* record) {
+    u64 position = groundedAtomicLoad64(&queue->readPosition, GROUNDED_MEMORY_ORDER_RELAXED);
+    if(position == queue->cachedWritePosition) {
+        queue->cachedWritePosition = groundedAtomicLoad64(&queue->writePosition, GROUNDED_MEMORY_ORDER_ACQUIRE);
+        if(position == queue->cachedWritePosition) {
+            return false;
+        }
+    }
+    u8* header = queue->buffer.buffer + (position & queue->mask);
+    record->size = *(u64*)header;
+    record->data = header + GROUNDED_RING_QUEUE_RECORD_HEADER_SIZE;
+    record->position = position;
+    record->nextPosition = position + _groundedRingQueueRecordSize(record->size);
+    return true;
+}
+
+GROUNDED_FUNCTION_INLINE void groundedSpscRingQueueRelease(GroundedSpscRingQueue* queue, GroundedRingQueueRecord* record) {
+    groundedAtomicStore64(&queue->readPosition, record->nextPosition, GROUNDED_MEMORY_ORDER_RELEASE);
+}
+
+// Copies data into the queue. Returns false if there is not enough space left
+GROUNDED_FUNCTION_INLINE bool groundedSpscRingQueuePush(GroundedSpscRingQueue* queue, void* data, u64 size) {
+    GroundedRingQueueRecord record;
+    if(!groundedSpscRingQueueReserve(queue, size, &record)) {
+        return false;
+    }
+    MEMORY_COPY(record.data, data, size);
+    groundedSpscRingQueueCommit(queue, &record);
+    return true;
+}
+
+//////////////////////////////////////////
+// Multi producer multi consumer queue
+// Space is claimed with a compare exchange on the producer head and records are taken with a compare exchange on the consumer head.
+// Instead of handing a tail over in claim order, every record carries a sequence stamp in its header: the record position
+// together with its state. Committing and releasing only store the stamp so a thread that stalls between claim and commit
+// or between acquire and release never blocks other threads. A stalled producer only delays consumers from reading past its record
+// and a stalled consumer only keeps its own memory from being reused.
+// The consumer tail is the end of the released prefix of the queue. Any thread advances it over released records.
+//
+// Stale memory must never look like a valid stamp so released payloads are cleared and the size word has its top bit set.
+// Stamps contain the full position so headers of previous laps never match.
+
+#define GROUNDED_MPMC_RING_QUEUE_RECORD_HEADER_SIZE 16
+#define GROUNDED_MPMC_RING_QUEUE_STATE_COMMITTED 1
+#define GROUNDED_MPMC_RING_QUEUE_STATE_RELEASED 2
+#define GROUNDED_MPMC_RING_QUEUE_SIZE_TAG (1ull << 63)
+
+typedef struct GroundedMpmcRingQueue {
+    GroundedCircularBuffer buffer;
+    u64 mask;
+
+    alignas(GROUNDED_RING_QUEUE_CACHE_LINE_SIZE) volatile u64 producerHead;
+    alignas(GROUNDED_RING_QUEUE_CACHE_LINE_SIZE) volatile u64 consumerHead;
+    alignas(GROUNDED_RING_QUEUE_CACHE_LINE_SIZE) volatile u64 consumerTail;
+} GroundedMpmcRingQueue;
+
+GROUNDED_FUNCTION_INLINE u64 _groundedMpmcRingQueueRecordSize(u64 payloadSize) {
+    return GROUNDED_MPMC_RING_QUEUE_RECORD_HEADER_SIZE + ALIGN_UP_POW2(payloadSize, 8);
+}
+
+GROUNDED_FUNCTION_INLINE u64 _groundedMpmcRingQueueStamp(u64 position, u64 state) {
+    return (position << 2) | state;
+}
+
+GROUNDED_FUNCTION_INLINE volatile u64* _groundedMpmcRingQueueHeader(GroundedMpmcRingQueue* queue, u64 position) {
+    return (volatile u64*)(queue->buffer.buffer + (position & queue->mask));
+}
+
+// Capacity is rounded up to a power of 2 and at least the page size
+GROUNDED_FUNCTION_INLINE bool groundedCreateMpmcRingQueue(GroundedMpmcRingQueue* queue, u64 minimumSize) {
+    *queue = (GroundedMpmcRingQueue){0};
+    // Fresh mappings are zeroed which is never a valid stamp
+    if(!_groundedCreateRingQueueBuffer(&queue->buffer, minimumSize)) {
+        return false;
+    }
+    queue->mask = queue->buffer.size - 1;
+    return true;
+}
+
+GROUNDED_FUNCTION_INLINE void groundedDestroyMpmcRingQueue(GroundedMpmcRingQueue* queue) {
+    groundedDestroyCircularBuffer(&queue->buffer);
+    *queue = (GroundedMpmcRingQueue){0};
+}
+
+// Moves the consumer tail over all records at its position that have been released
+GROUNDED_FUNCTION_INLINE void _groundedMpmcRingQueueAdvanceConsumerTail(GroundedMpmcRingQueue* queue) {
+    u64 tail = groundedAtomicLoad64(&queue->consumerTail, GROUNDED_MEMORY_ORDER_ACQUIRE);
+    while(true) {
+        volatile u64* header = _groundedMpmcRingQueueHeader(queue, tail);
+        if(groundedAtomicLoad64(&header[0], GROUNDED_MEMORY_ORDER_ACQUIRE) != _groundedMpmcRingQueueStamp(tail, GROUNDED_MPMC_RING_QUEUE_STATE_RELEASED)) {
+            return;
+        }
+        // If tail is outdated the size might be garbage but then the compare exchange fails
+        u64 next = tail + _groundedMpmcRingQueueRecordSize(header[1] & ~GROUNDED_MPMC_RING_QUEUE_SIZE_TAG);
+        if(groundedAtomicCompareExchange64(&queue->consumerTail, &tail, next, GROUNDED_MEMORY_ORDER_ACQ_REL)) {
+            tail = next;
+        }
+    }
+}
+
+// Returns false if there is not enough space left
+GROUNDED_FUNCTION_INLINE bool groundedMpmcRingQueueReserve(GroundedMpmcRingQueue* queue, u64 size, GroundedRingQueueRecord* record) {
+    u64 recordSize = _groundedMpmcRingQueueRecordSize(size);
+    ASSERT(recordSize <= queue->buffer.size);
+    u64 position = groundedAtomicLoad64(&queue->producerHead, GROUNDED_MEMORY_ORDER_RELAXED);
+    bool helped = false;
+    while(true) {
+        u64 consumerTail = groundedAtomicLoad64(&queue->consumerTail, GROUNDED_MEMORY_ORDER_ACQUIRE);
+        if(position + recordSize - consumerTail > queue->buffer.size) {
+            // The releasing consumer might not have advanced the tail yet
+            if(helped) {
+                return false;
+            }
+            _groundedMpmcRingQueueAdvanceConsumerTail(queue);
+            helped = true;
+            continue;
+        }
+        if(groundedAtomicCompareExchange64(&queue->producerHead, &position, position + recordSize, GROUNDED_MEMORY_ORDER_RELAXED)) {
+            break;
+        }
+    }
+    volatile u64* header = _groundedMpmcRingQueueHeader(queue, position);
+    header[1] = size | GROUNDED_MPMC_RING_QUEUE_SIZE_TAG;
+    record->data = (u8*)header + GROUNDED_MPMC_RING_QUEUE_RECORD_HEADER_SIZE;
+    record->size = size;
+    record->position = position;
+    record->nextPosition = position + recordSize;
+    return true;
+}
+
+// Publishes the record. Does not wait for other producers
+GROUNDED_FUNCTION_INLINE void groundedMpmcRingQueueCommit(GroundedMpmcRingQueue* queue, GroundedRingQueueRecord* record) {
+    volatile u64* header = _groundedMpmcRingQueueHeader(queue, record->position);
+    groundedAtomicStore64(&header[0], _groundedMpmcRingQueueStamp(record->position, GROUNDED_MPMC_RING_QUEUE_STATE_COMMITTED), GROUNDED_MEMORY_ORDER_RELEASE);
+}
+
+// Returns false if the queue is empty or the next record has not been committed yet
+GROUNDED_FUNCTION_INLINE bool groundedMpmcRingQueueAcquire(GroundedMpmcRingQueue* queue, GroundedRingQueueRecord* record) {
+    u64 position = groundedAtomicLoad64(&queue->consumerHead, GROUNDED_MEMORY_ORDER_RELAXED);
+    u64 size = 0;
+    while(true) {
+        volatile u64* header = _groundedMpmcRingQueueHeader(queue, position);
+        if(groundedAtomicLoad64(&header[0], GROUNDED_MEMORY_ORDER_ACQUIRE) != _groundedMpmcRingQueueStamp(position, GROUNDED_MPMC_RING_QUEUE_STATE_COMMITTED)) {
+            u64 current = groundedAtomicLoad64(&queue->consumerHead, GROUNDED_MEMORY_ORDER_RELAXED);
+            if(current == position) {
+                return false;
+            }
+            // Another consumer took the record
+            position = current;
+            continue;
+        }
+        // The memory can not be reused before this record has been released so the size is valid if the compare exchange succeeds
+        size = header[1] & ~GROUNDED_MPMC_RING_QUEUE_SIZE_TAG;
+        if(groundedAtomicCompareExchange64(&queue->consumerHead, &position, position + _groundedMpmcRingQueueRecordSize(size), GROUNDED_MEMORY_ORDER_RELAXED)) {
+            break;
+        }
+    }
+    record->data = queue->buffer.buffer + (position & queue->mask) + GROUNDED_MPMC_RING_QUEUE_RECORD_HEADER_SIZE;
+    record->size = size;
+    record->position = position;
+    record->nextPosition = position + _groundedMpmcRingQueueRecordSize(size);
+    return true;
+}
+
+// Gives the memory of the record back to producers. Does not wait for other consumers
+GROUNDED_FUNCTION_INLINE void groundedMpmcRingQueueRelease(GroundedMpmcRingQueue* queue, GroundedRingQueueRecord* record) {
+    MEMORY_CLEAR(record->data, ALIGN_UP_POW2(record->size, 8));
+    volatile u64* header = _groundedMpmcRingQueueHeader(queue, record->position);
+    groundedAtomicStore64(&header[0], _groundedMpmcRingQueueStamp(record->position, GROUNDED_MPMC_RING_QUEUE_STATE_RELEASED), GROUNDED_MEMORY_ORDER_RELEASE);
+    _groundedMpmcRingQueueAdvanceConsumerTail(queue);
+}
+
+// Copies data into the queue. Returns false if there is not enough space left
+GROUNDED_FUNCTION_INLINE bool groundedMpmcRingQueuePush(GroundedMpmcRingQueue* queue, void* data, u64 size) {
+    GroundedRingQueueRecord record;
+    if(!groundedMpmcRingQueueReserve(queue, size, &record)) {
+        return false;
+    }
+    MEMORY_COPY(record.data, data, size);
+    groundedMpmcRingQueueCommit(queue, &record);
+    return true;
+}
+
+#endif // GROUNDED_RING_QUEUE_H
@@ -56,6 +56,8 @@ GROUNDED_FUNCTION bool groundedThreadWaitForFinish(GroundedThread* thread, u32 t
 GROUNDED_FUNCTION bool groundedThreadIsRunning(GroundedThread* thread);
 GROUNDED_FUNCTION void groundedThreadRequestStop(GroundedThread* thread);
 GROUNDED_FUNCTION bool groundedThreadShouldStop(GroundedThread* thread);
+// Number of logical cores currently available to this process
+GROUNDED_FUNCTION u32 groundedGetLogicalCoreCount();
 //TODO: Maybe implement a function which allows to get the current thread from somewhere in threadlocal storage?
 
 
@@ -96,67 +98,308 @@ GROUNDED_FUNCTION_INLINE void groundedConditionVariableSignal(GroundedConditionV
 GROUNDED_FUNCTION_INLINE void groundedConditionVariableWait(GroundedConditionVariable* conditionVariable, GroundedMutex* mutex);
 
 
-/////////
-// Fences
-// All fences prevent compiler and cpu instruction reordering across the fence
-// volatile disables register caching and rereads every time - When memory barriers are used volatile has no additional effect. 
-// volatile DOES NOT imply ANY memory ordering constraints and is of fairly limited use in multithreaded code
+//////////
+// Atomics
+// Atomic operations on naturally aligned u32, u64 and pointer values. Every operation takes an explicit memory order.
+// Relaxed only guarantees atomicity. Acquire on loads and release on stores order surrounding memory accesses
+// in the usual way. SeqCst additionally establishes a single total order of all SeqCst operations.
+// Compare exchange functions are strong and write the current value to expected on failure.
+// volatile disables register caching and rereads every time. volatile DOES NOT imply ANY memory ordering constraints.
+
+typedef enum GroundedMemoryOrder {
+    GROUNDED_MEMORY_ORDER_RELAXED,
+    GROUNDED_MEMORY_ORDER_ACQUIRE,
+    GROUNDED_MEMORY_ORDER_RELEASE,
+    GROUNDED_MEMORY_ORDER_ACQ_REL,
+    GROUNDED_MEMORY_ORDER_SEQ_CST,
+} GroundedMemoryOrder;
+
+// Value for 128 bit compare exchange. Must be 16 byte aligned
+typedef struct GroundedAtomicU128 {
+    alignas(16) u64 low;
+    u64 high;
+} GroundedAtomicU128;
 
 #if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
-#include <emmintrin.h> // For _mm_mfence
+#include <emmintrin.h> // For _mm_mfence and _mm_pause
 
-// Full fence ensures no reads and writes can pass this fence
-// This type of fence is quite costly and should only be used whilte testing.
-// Nearly always there are cheaper options available
-GROUNDED_FUNCTION_INLINE void groundedFullFence() {
-    _mm_mfence();
+// Pause tries to use special CPU instructions for more efficient busy looping. Should be used in hot busy loops.
+GROUNDED_FUNCTION_INLINE void groundedPause() {
+    _mm_pause();
 }
 
-// Write Release - when writing a shared value. Makes sure all reads and writes before it happen before it.
-GROUNDED_FUNCTION_INLINE void groundedWriteReleaseFence() {
-    _mm_sfence();
+#elif defined(__aarch64__) || defined(__arm__) || defined(_M_ARM64)
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#else
+#include <arm_acle.h>
+#endif
+
+// Pause tries to use special CPU instructions for more efficient busy looping. Should be used in hot busy loops.
+GROUNDED_FUNCTION_INLINE void groundedPause() {
+#if defined(__aarch64__) || defined(_M_ARM64)
+    __yield();  // intrinsic for 'yield' instruction
+#else
+    __nop();    // fallback to NOP
+#endif
 }
 
-// Read Acquire - when reading a shared value. Says that all reads and writes after it must be executed after it
-GROUNDED_FUNCTION_INLINE void groundedReadAcquireFence() {
-    _mm_lfence();
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+
+GROUNDED_FUNCTION_INLINE int _groundedMemoryOrderToGcc(GroundedMemoryOrder order) {
+    switch(order) {
+        case GROUNDED_MEMORY_ORDER_RELAXED: return __ATOMIC_RELAXED;
+        case GROUNDED_MEMORY_ORDER_ACQUIRE: return __ATOMIC_ACQUIRE;
+        case GROUNDED_MEMORY_ORDER_RELEASE: return __ATOMIC_RELEASE;
+        case GROUNDED_MEMORY_ORDER_ACQ_REL: return __ATOMIC_ACQ_REL;
+        default: return __ATOMIC_SEQ_CST;
+    }
 }
 
-// Pause tries to use special CPU instructions for more efficient busy looping. Should be used in hot busy loops.
-GROUNDED_FUNCTION_INLINE void groundedPause() {
-    _mm_pause();
+// The failure order of a compare exchange must not contain a release
+GROUNDED_FUNCTION_INLINE int _groundedFailureMemoryOrderToGcc(GroundedMemoryOrder order) {
+    switch(order) {
+        case GROUNDED_MEMORY_ORDER_RELAXED: return __ATOMIC_RELAXED;
+        case GROUNDED_MEMORY_ORDER_RELEASE: return __ATOMIC_RELAXED;
+        case GROUNDED_MEMORY_ORDER_ACQUIRE: return __ATOMIC_ACQUIRE;
+        case GROUNDED_MEMORY_ORDER_ACQ_REL: return __ATOMIC_ACQUIRE;
+        default: return __ATOMIC_SEQ_CST;
+    }
 }
 
-#elif defined(__aarch64__) || defined(__arm__)
-#include <arm_acle.h>
+// The order argument is almost always a constant so after inlining the switch disappears
+#define _GROUNDED_ATOMIC_FUNCTIONS(suffix, type, volatileType) \
+GROUNDED_FUNCTION_INLINE type groundedAtomicLoad##suffix(volatileType* value, GroundedMemoryOrder order) { \
+    return __atomic_load_n(value, _groundedMemoryOrderToGcc(order)); \
+} \
+GROUNDED_FUNCTION_INLINE void groundedAtomicStore##suffix(volatileType* value, type newValue, GroundedMemoryOrder order) { \
+    __atomic_store_n(value, newValue, _groundedMemoryOrderToGcc(order)); \
+} \
+GROUNDED_FUNCTION_INLINE type groundedAtomicExchange##suffix(volatileType* value, type newValue, GroundedMemoryOrder order) { \
+    return __atomic_exchange_n(value, newValue, _groundedMemoryOrderToGcc(order)); \
+} \
+GROUNDED_FUNCTION_INLINE bool groundedAtomicCompareExchange##suffix(volatileType* value, type* expected, type desired, GroundedMemoryOrder order) { \
+    return __atomic_compare_exchange_n(value, expected, desired, false, _groundedMemoryOrderToGcc(order), _groundedFailureMemoryOrderToGcc(order)); \
+}
+
+#define _GROUNDED_ATOMIC_INTEGER_FUNCTIONS(suffix, type) \
+_GROUNDED_ATOMIC_FUNCTIONS(suffix, type, volatile type) \
+GROUNDED_FUNCTION_INLINE type groundedAtomicFetchAdd##suffix(volatile type* value, type addend, GroundedMemoryOrder order) { \
+    return __atomic_fetch_add(value, addend, _groundedMemoryOrderToGcc(order)); \
+} \
+GROUNDED_FUNCTION_INLINE type groundedAtomicFetchSub##suffix(volatile type* value, type subtrahend, GroundedMemoryOrder order) { \
+    return __atomic_fetch_sub(value, subtrahend, _groundedMemoryOrderToGcc(order)); \
+} \
+GROUNDED_FUNCTION_INLINE type groundedAtomicFetchAnd##suffix(volatile type* value, type mask, GroundedMemoryOrder order) { \
+    return __atomic_fetch_and(value, mask, _groundedMemoryOrderToGcc(order)); \
+} \
+GROUNDED_FUNCTION_INLINE type groundedAtomicFetchOr##suffix(volatile type* value, type mask, GroundedMemoryOrder order) { \
+    return __atomic_fetch_or(value, mask, _groundedMemoryOrderToGcc(order)); \
+}
+
+_GROUNDED_ATOMIC_INTEGER_FUNCTIONS(32, u32)
+_GROUNDED_ATOMIC_INTEGER_FUNCTIONS(64, u64)
+_GROUNDED_ATOMIC_FUNCTIONS(Pointer, void*, void* volatile)
+
+GROUNDED_FUNCTION_INLINE void groundedAtomicThreadFence(GroundedMemoryOrder order) {
+    __atomic_thread_fence(_groundedMemoryOrderToGcc(order));
+}
+
+// Only prevents compiler reordering
+GROUNDED_FUNCTION_INLINE void groundedCompilerFence() {
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+}
+
+#if defined(__x86_64__)
+#define GROUNDED_ATOMIC_HAS_CAS128 1
+// Implemented with inline assembly so it does not depend on -mcx16 or libatomic
+GROUNDED_FUNCTION_INLINE bool groundedAtomicCompareExchange128(volatile GroundedAtomicU128* value, GroundedAtomicU128* expected, GroundedAtomicU128 desired) {
+    bool result;
+    __asm__ __volatile__(
+        "lock cmpxchg16b %1"
+        : "=@ccz"(result), "+m"(*value), "+a"(expected->low), "+d"(expected->high)
+        : "b"(desired.low), "c"(desired.high)
+        : "memory");
+    return result;
+}
+#elif defined(__aarch64__)
+#define GROUNDED_ATOMIC_HAS_CAS128 1
+GROUNDED_FUNCTION_INLINE bool groundedAtomicCompareExchange128(volatile GroundedAtomicU128* value, GroundedAtomicU128* expected, GroundedAtomicU128 desired) {
+    unsigned __int128 expectedValue = ((unsigned __int128)expected->high << 64) | expected->low;
+    unsigned __int128 desiredValue = ((unsigned __int128)desired.high << 64) | desired.low;
+    unsigned __int128 previous = __sync_val_compare_and_swap((volatile unsigned __int128*)value, expectedValue, desiredValue);
+    if(previous == expectedValue) {
+        return true;
+    }
+    expected->low = (u64)previous;
+    expected->high = (u64)(previous >> 64);
+    return false;
+}
+#endif
+
+#elif defined(_MSC_VER)
+#include <intrin.h>
+
+// Interlocked functions are full barriers. Plain aligned loads and stores are atomic and get their ordering from fences
+
+GROUNDED_FUNCTION_INLINE void groundedCompilerFence() {
+    _ReadWriteBarrier();
+}
+
+GROUNDED_FUNCTION_INLINE void groundedAtomicThreadFence(GroundedMemoryOrder order) {
+    if(order == GROUNDED_MEMORY_ORDER_RELAXED) return;
+#if defined(_M_IX86) || defined(_M_X64)
+    // x86 only reorders stores with later loads so only seq cst requires a hardware fence
+    if(order == GROUNDED_MEMORY_ORDER_SEQ_CST) {
+        _mm_mfence();
+    } else {
+        _ReadWriteBarrier();
+    }
+#else
+    __dmb(_ARM64_BARRIER_ISH);
+#endif
+}
+
+GROUNDED_FUNCTION_INLINE u32 groundedAtomicLoad32(volatile u32* value, GroundedMemoryOrder order) {
+    u32 result = *value;
+    if(order != GROUNDED_MEMORY_ORDER_RELAXED) groundedAtomicThreadFence(GROUNDED_MEMORY_ORDER_ACQUIRE);
+    return result;
+}
+GROUNDED_FUNCTION_INLINE u64 groundedAtomicLoad64(volatile u64* value, GroundedMemoryOrder order) {
+    u64 result = *value;
+    if(order != GROUNDED_MEMORY_ORDER_RELAXED) groundedAtomicThreadFence(GROUNDED_MEMORY_ORDER_ACQUIRE);
+    return result;
+}
+GROUNDED_FUNCTION_INLINE void* groundedAtomicLoadPointer(void* volatile* value, GroundedMemoryOrder order) {
+    void* result = *value;
+    if(order != GROUNDED_MEMORY_ORDER_RELAXED) groundedAtomicThreadFence(GROUNDED_MEMORY_ORDER_ACQUIRE);
+    return result;
+}
+
+GROUNDED_FUNCTION_INLINE void groundedAtomicStore32(volatile u32* value, u32 newValue, GroundedMemoryOrder order) {
+    if(order == GROUNDED_MEMORY_ORDER_SEQ_CST) {
+        _InterlockedExchange((volatile long*)value, (long)newValue);
+    } else {
+        if(order != GROUNDED_MEMORY_ORDER_RELAXED) groundedAtomicThreadFence(GROUNDED_MEMORY_ORDER_RELEASE);
+        *value = newValue;
+    }
+}
+GROUNDED_FUNCTION_INLINE void groundedAtomicStore64(volatile u64* value, u64 newValue, GroundedMemoryOrder order) {
+    if(order == GROUNDED_MEMORY_ORDER_SEQ_CST) {
+        _InterlockedExchange64((volatile long long*)value, (long long)newValue);
+    } else {
+        if(order != GROUNDED_MEMORY_ORDER_RELAXED) groundedAtomicThreadFence(GROUNDED_MEMORY_ORDER_RELEASE);
+        *value = newValue;
+    }
+}
+GROUNDED_FUNCTION_INLINE void groundedAtomicStorePointer(void* volatile* value, void* newValue, GroundedMemoryOrder order) {
+    if(order == GROUNDED_MEMORY_ORDER_SEQ_CST) {
+        _InterlockedExchangePointer(value, newValue);
+    } else {
+        if(order != GROUNDED_MEMORY_ORDER_RELAXED) groundedAtomicThreadFence(GROUNDED_MEMORY_ORDER_RELEASE);
+        *value = newValue;
+    }
+}
+
+GROUNDED_FUNCTION_INLINE u32 groundedAtomicExchange32(volatile u32* value, u32 newValue, GroundedMemoryOrder order) {
+    return (u32)_InterlockedExchange((volatile long*)value, (long)newValue);
+}
+GROUNDED_FUNCTION_INLINE u64 groundedAtomicExchange64(volatile u64* value, u64 newValue, GroundedMemoryOrder order) {
+    return (u64)_InterlockedExchange64((volatile long long*)value, (long long)newValue);
+}
+GROUNDED_FUNCTION_INLINE void* groundedAtomicExchangePointer(void* volatile* value, void* newValue, GroundedMemoryOrder order) {
+    return _InterlockedExchangePointer(value, newValue);
+}
+
+GROUNDED_FUNCTION_INLINE bool groundedAtomicCompareExchange32(volatile u32* value, u32* expected, u32 desired, GroundedMemoryOrder order) {
+    u32 previous = (u32)_InterlockedCompareExchange((volatile long*)value, (long)desired, (long)*expected);
+    bool result = previous == *expected;
+    *expected = previous;
+    return result;
+}
+GROUNDED_FUNCTION_INLINE bool groundedAtomicCompareExchange64(volatile u64* value, u64* expected, u64 desired, GroundedMemoryOrder order) {
+    u64 previous = (u64)_InterlockedCompareExchange64((volatile long long*)value, (long long)desired, (long long)*expected);
+    bool result = previous == *expected;
+    *expected = previous;
+    return result;
+}
+GROUNDED_FUNCTION_INLINE bool groundedAtomicCompareExchangePointer(void* volatile* value, void** expected, void* desired, GroundedMemoryOrder order) {
+    void* previous = _InterlockedCompareExchangePointer(value, desired, *expected);
+    bool result = previous == *expected;
+    *expected = previous;
+    return result;
+}
+
+GROUNDED_FUNCTION_INLINE u32 groundedAtomicFetchAdd32(volatile u32* value, u32 addend, GroundedMemoryOrder order) {
+    return (u32)_InterlockedExchangeAdd((volatile long*)value, (long)addend);
+}
+GROUNDED_FUNCTION_INLINE u64 groundedAtomicFetchAdd64(volatile u64* value, u64 addend, GroundedMemoryOrder order) {
+    return (u64)_InterlockedExchangeAdd64((volatile long long*)value, (long long)addend);
+}
+GROUNDED_FUNCTION_INLINE u32 groundedAtomicFetchSub32(volatile u32* value, u32 subtrahend, GroundedMemoryOrder order) {
+    return (u32)_InterlockedExchangeAdd((volatile long*)value, -(long)subtrahend);
+}
+GROUNDED_FUNCTION_INLINE u64 groundedAtomicFetchSub64(volatile u64* value, u64 subtrahend, GroundedMemoryOrder order) {
+    return (u64)_InterlockedExchangeAdd64((volatile long long*)value, -(long long)subtrahend);
+}
+GROUNDED_FUNCTION_INLINE u32 groundedAtomicFetchAnd32(volatile u32* value, u32 mask, GroundedMemoryOrder order) {
+    return (u32)_InterlockedAnd((volatile long*)value, (long)mask);
+}
+GROUNDED_FUNCTION_INLINE u64 groundedAtomicFetchAnd64(volatile u64* value, u64 mask, GroundedMemoryOrder order) {
+    return (u64)_InterlockedAnd64((volatile long long*)value, (long long)mask);
+}
+GROUNDED_FUNCTION_INLINE u32 groundedAtomicFetchOr32(volatile u32* value, u32 mask, GroundedMemoryOrder order) {
+    return (u32)_InterlockedOr((volatile long*)value, (long)mask);
+}
+GROUNDED_FUNCTION_INLINE u64 groundedAtomicFetchOr64(volatile u64* value, u64 mask, GroundedMemoryOrder order) {
+    return (u64)_InterlockedOr64((volatile long long*)value, (long long)mask);
+}
+
+#if defined(_M_X64) || defined(_M_ARM64)
+#define GROUNDED_ATOMIC_HAS_CAS128 1
+GROUNDED_FUNCTION_INLINE bool groundedAtomicCompareExchange128(volatile GroundedAtomicU128* value, GroundedAtomicU128* expected, GroundedAtomicU128 desired) {
+    // Comparand is updated with the current value on failure
+    return _InterlockedCompareExchange128((volatile long long*)value, (long long)desired.high, (long long)desired.low, (long long*)expected) != 0;
+}
+#endif
+
+#else
+#error "Unsupported compiler for atomic operations"
+#endif
+
+/////////
+// Fences
+// All fences prevent compiler and cpu instruction reordering across the fence
 
 // Full fence ensures no reads and writes can pass this fence
-// This type of fence is quite costly and should only be used whilte testing.
-// Nearly always there are cheaper options available
+// This type of fence is quite costly. Nearly always there are cheaper options available
 GROUNDED_FUNCTION_INLINE void groundedFullFence() {
-    __dmb(0xF);
+    groundedAtomicThreadFence(GROUNDED_MEMORY_ORDER_SEQ_CST);
 }
 
-// Write Release - when writing a shared value. Makes sure all reads and writes before it happen before it.
+// Write Release - when writing a shared value. Makes sure all reads and writes before it happen before the following writes.
 GROUNDED_FUNCTION_INLINE void groundedWriteReleaseFence() {
-    __dmb(0xE);
+    groundedAtomicThreadFence(GROUNDED_MEMORY_ORDER_RELEASE);
 }
 
-// Read Acquire - when reading a shared value. Says that all reads and writes after it must be executed after it
+// Read Acquire - when reading a shared value. Says that all reads and writes after it must be executed after the preceding reads
 GROUNDED_FUNCTION_INLINE void groundedReadAcquireFence() {
-    __dmb(0xB);
+    groundedAtomicThreadFence(GROUNDED_MEMORY_ORDER_ACQUIRE);
 }
 
-// Pause tries to use special CPU instructions for more efficient busy looping. Should be used in hot busy loops.
-GROUNDED_FUNCTION_INLINE void groundedPause() {
-#if defined(__aarch64__)
-    __yield();  // intrinsic for 'yield' instruction
-#else
-    __nop();    // fallback to NOP
-#endif
+// Returns incremented value eg. a pre increment
+GROUNDED_FUNCTION_INLINE u64 groundedInterlockedIncrement64(volatile u64* value) {
+    return groundedAtomicFetchAdd64(value, 1, GROUNDED_MEMORY_ORDER_SEQ_CST) + 1;
 }
 
-#endif
+// Note that the compare exchange intrinsics can't detect ABA problems!
+// Returns initial value of value
+GROUNDED_FUNCTION_INLINE u64 groundedInterlockedCompareExchange(volatile u64* value, u64 originalValue, u64 newValue) {
+    groundedAtomicCompareExchange64(value, &originalValue, newValue, GROUNDED_MEMORY_ORDER_SEQ_CST);
+    return originalValue;
+}
 
 // Yield can yield execution to another thread
 GROUNDED_FUNCTION_INLINE void groundedYield();
@@ -166,11 +166,19 @@ project "GroundedStatic"
     targetdir "bin/static/%{cfg.buildcfg}"
     files
     {
+        "src/container/grounded_array.c",
+        "src/container/grounded_hash_map.c",
+        "src/file/grounded_async_io.c",
         "src/file/grounded_file.c",
         "src/logger/grounded_logger.c",
         "src/memory/grounded_arena.c",
         "src/memory/grounded_memory.c",
+        "src/memory/grounded_pool.c",
+        "src/memory/grounded_heap.c",
+        "src/string/grounded_intern.c",
         "src/string/grounded_string.c",
+        "src/string/grounded_text_buffer.c",
+        "src/threading/grounded_async.c",
         "src/threading/grounded_threading.c",
         "src/window/grounded_window.c",
         "src/window/grounded_window_extra.c",
@@ -181,11 +189,19 @@ project "GroundedDynamic"
     targetdir "bin/dynamic/%{cfg.buildcfg}"
     files
     {
+        "src/container/grounded_array.c",
+        "src/container/grounded_hash_map.c",
+        "src/file/grounded_async_io.c",
         "src/file/grounded_file.c",
         "src/logger/grounded_logger.c",
         "src/memory/grounded_arena.c",
         "src/memory/grounded_memory.c",
+        "src/memory/grounded_pool.c",
+        "src/memory/grounded_heap.c",
+        "src/string/grounded_intern.c",
         "src/string/grounded_string.c",
+        "src/string/grounded_text_buffer.c",
+        "src/threading/grounded_async.c",
         "src/threading/grounded_threading.c",
         "src/window/grounded_window.c",
         "src/window/grounded_window_extra.c",
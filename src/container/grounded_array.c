@@ -0,0 +1,114 @@
+#include <grounded/container/grounded_array.h>
+#include <grounded/logger/grounded_logger.h>
+
+GROUNDED_FUNCTION GroundedArray groundedCreateArray(MemoryArena* arena, GroundedHeap* heap, u64 elementSize, u64 alignment, u64 initialCapacity) {
+    ASSERT((arena == 0) != (heap == 0));
+    ASSERT(IS_POW2(alignment));
+    ASSERT(elementSize > 0);
+    GroundedArray result = {0};
+    result.elementSize = elementSize;
+    result.alignment = alignment;
+    result.arena = arena;
+    result.heap = heap;
+    if(initialCapacity) {
+        groundedArrayReserve(&result, initialCapacity);
+    }
+    return result;
+}
+
+GROUNDED_FUNCTION void groundedDestroyArray(GroundedArray* array) {
+    if(array->heap) {
+        groundedHeapFree(array->heap, array->data);
+    } else if(array->data && array->arena->memory + array->arena->pos == array->data + array->capacity * array->elementSize) {
+        arenaPopTo(array->arena, array->data);
+    }
+    array->data = 0;
+    array->count = 0;
+    array->capacity = 0;
+}
+
+static bool arrayTryGrowInPlace(GroundedArray* array, u64 newSize) {
+    MemoryArena* arena = array->arena;
+    u64 oldSize = array->capacity * array->elementSize;
+    u8* end = array->data + oldSize;
+    // Debug modes place every allocation separately so nothing is ever adjacent
+    if(!array->data || arena->debugData || arena->memory + arena->pos != end) {
+        return false;
+    }
+    u64 additionalSize = newSize - oldSize;
+    while(arena->pos + additionalSize > arena->commitPos) {
+        // Ask for room for the whole array. Arenas that can extend the current block in place do so.
+        // Otherwise the new block becomes the current one and receives the copy so nothing is allocated twice
+        u64 growSize = MAX(newSize, arena->commitPos);
+        u8* newBlock = (u8*)arena->grow(arena, &growSize, array->alignment);
+        if(newBlock == 0) return false;
+        if(newBlock == arena->memory + arena->commitPos) {
+            arena->commitPos += growSize;
+        } else {
+            arena->usedSizeBeforeBlock += arena->pos;
+            arena->memory = newBlock;
+            arena->pos = 0;
+            arena->commitPos = growSize;
+            return false;
+        }
+    }
+    // Fits into the committed part of the current block so this always extends the array
+    u8* extension = (u8*)_arenaPushSize(arena, additionalSize, 1, false, __LINE__, STR8_LITERAL(__FILE__));
+    ASSERT(extension == end);
+    return true;
+}
+
+GROUNDED_FUNCTION bool groundedArrayReserve(GroundedArray* array, u64 capacity) {
+    if(capacity <= array->capacity) {
+        return true;
+    }
+    if(capacity > UINT64_MAX / array->elementSize) {
+        GROUNDED_LOG_ERROR("Array capacity overflows the addressable size");
+        return false;
+    }
+    u64 newSize = capacity * array->elementSize;
+    if(array->heap) {
+        u8* data = (u8*)_groundedHeapReallocate(array->heap, array->data, newSize, array->alignment, __LINE__, STR8_LITERAL(__FILE__));
+        if(!data) return false;
+        array->data = data;
+    } else if(!arrayTryGrowInPlace(array, newSize)) {
+        u8* data = ARENA_PUSH_ARRAY_NO_CLEAR_ALIGNED(array->arena, newSize, u8, array->alignment);
+        if(!data) return false;
+        if(array->count) {
+            memcpy(data, array->data, array->count * array->elementSize);
+        }
+        array->data = data;
+    }
+    array->capacity = capacity;
+    return true;
+}
+
+GROUNDED_FUNCTION void* groundedArrayPushUninitialized(GroundedArray* array, u64 count) {
+    if(array->count + count > array->capacity) {
+        u64 capacity = MAX(MAX(array->capacity * 2, array->count + count), 8);
+        if(!groundedArrayReserve(array, capacity)) {
+            GROUNDED_LOG_ERROR("Could not grow array");
+            return 0;
+        }
+    }
+    void* result = array->data + array->count * array->elementSize;
+    array->count += count;
+    return result;
+}
+
+GROUNDED_FUNCTION void* groundedArrayInsert(GroundedArray* array, u64 index) {
+    ASSERT(index <= array->count);
+    if(!groundedArrayPushUninitialized(array, 1)) {
+        return 0;
+    }
+    u8* result = array->data + index * array->elementSize;
+    memmove(result + array->elementSize, result, (array->count - 1 - index) * array->elementSize);
+    return result;
+}
+
+GROUNDED_FUNCTION void groundedArrayRemoveOrdered(GroundedArray* array, u64 index) {
+    ASSERT(index < array->count);
+    u8* removed = array->data + index * array->elementSize;
+    array->count--;
+    memmove(removed, removed + array->elementSize, (array->count - index) * array->elementSize);
+}
@@ -0,0 +1,384 @@
+#include <grounded/container/grounded_hash_map.h>
+#include <grounded/logger/grounded_logger.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GROUNDED_HASH_MAP_SSE2
+#include <emmintrin.h>
+#endif
+
+// Control bytes. Full slots store the low 7 bits of the hash so the high bit tells free and full slots apart
+#define HASH_MAP_CONTROL_EMPTY 0x80
+#define HASH_MAP_CONTROL_DELETED 0xFE
+
+// At most 7/8 of the slots are full
+#define HASH_MAP_MAX_LOAD(capacity) ((capacity) - (capacity) / 8)
+
+// Bit i of the returned masks is set if slot i of the group matches
+#if defined(GROUNDED_HASH_MAP_SSE2)
+static u32 hashMapGroupMatch(const u8* group, u8 h2) {
+    __m128i control = _mm_loadu_si128((const __m128i*)group);
+    return (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(control, _mm_set1_epi8((char)h2)));
+}
+static u32 hashMapGroupMatchEmpty(const u8* group) {
+    return hashMapGroupMatch(group, HASH_MAP_CONTROL_EMPTY);
+}
+static u32 hashMapGroupMatchEmptyOrDeleted(const u8* group) {
+    // Both have the high bit set
+    return (u32)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)group));
+}
+#else
+static u32 hashMapGroupMatch(const u8* group, u8 h2) {
+    u32 result = 0;
+    for(u32 i = 0; i < GROUNDED_HASH_MAP_GROUP_WIDTH; ++i) {
+        result |= (u32)(group[i] == h2) << i;
+    }
+    return result;
+}
+static u32 hashMapGroupMatchEmpty(const u8* group) {
+    return hashMapGroupMatch(group, HASH_MAP_CONTROL_EMPTY);
+}
+static u32 hashMapGroupMatchEmptyOrDeleted(const u8* group) {
+    u32 result = 0;
+    for(u32 i = 0; i < GROUNDED_HASH_MAP_GROUP_WIDTH; ++i) {
+        result |= (u32)(group[i] >> 7) << i;
+    }
+    return result;
+}
+#endif
+
+GROUNDED_FUNCTION u64 groundedHashBytes(const void* key, u64 keySize) {
+    return atomHashBytes(key, keySize);
+}
+
+GROUNDED_FUNCTION bool groundedHashBytesEqual(const void* a, const void* b, u64 keySize) {
+    return memcmp(a, b, keySize) == 0;
+}
+
+GROUNDED_FUNCTION u64 groundedHashString8(const void* key, u64 keySize) {
+    ASSERT(keySize == sizeof(String8));
+    const String8* string = (const String8*)key;
+    return atomHashBytes(string->base, string->size);
+}
+
+GROUNDED_FUNCTION bool groundedHashString8Equal(const void* a, const void* b, u64 keySize) {
+    ASSERT(keySize == sizeof(String8));
+    return str8IsEqual(*(const String8*)a, *(const String8*)b);
+}
+
+// The table uses the low bits for the position and the high bits for the control byte so both have to be well mixed
+static u64 hashMapHash(GroundedHashMap* map, const void* key) {
+    u64 hash = map->hash(key, map->keySize);
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDull;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+static u8 hashMapH2(u64 hash) {
+    return (u8)(hash >> 57);
+}
+
+static u8* hashMapSlot(GroundedHashMap* map, u64 index) {
+    return map->slots + index * map->slotSize;
+}
+
+static void hashMapSetControl(GroundedHashMap* map, u64 index, u8 control) {
+    map->control[index] = control;
+    // Keeps the mirrored first group at the end up to date so groups can be loaded without wrapping
+    map->control[((index - (GROUNDED_HASH_MAP_GROUP_WIDTH - 1)) & (map->capacity - 1)) + (GROUNDED_HASH_MAP_GROUP_WIDTH - 1)] = control;
+}
+
+static void* hashMapAllocate(GroundedHashMap* map, u64 size, u64 alignment) {
+    if(map->heap) {
+        return _groundedHeapAllocate(map->heap, size, alignment, false, __LINE__, STR8_LITERAL(__FILE__));
+    } else {
+        return _arenaPushSize(map->arena, size, alignment, false, __LINE__, STR8_LITERAL(__FILE__));
+    }
+}
+
+static void hashMapFree(GroundedHashMap* map, void* memory) {
+    if(map->heap) {
+        groundedHeapFree(map->heap, memory);
+    }
+}
+
+// Returns the first free slot in the probe sequence of hash. There is always at least one
+static u64 hashMapFindFreeSlot(GroundedHashMap* map, u64 hash) {
+    u64 mask = map->capacity - 1;
+    u64 position = hash & mask;
+    u64 step = 0;
+    while(true) {
+        u32 freeSlots = hashMapGroupMatchEmptyOrDeleted(map->control + position);
+        if(freeSlots) {
+            return (position + groundedCountTrailingZeros32(freeSlots)) & mask;
+        }
+        // Triangular probing visits every group exactly once for power of 2 capacities
+        step += GROUNDED_HASH_MAP_GROUP_WIDTH;
+        position = (position + step) & mask;
+    }
+}
+
+// Returns slot index + 1 or 0 if the key is not in the map
+static u64 hashMapFind(GroundedHashMap* map, const void* key, u64 hash) {
+    if(!map->capacity) return 0;
+    u64 mask = map->capacity - 1;
+    u64 position = hash & mask;
+    u64 step = 0;
+    u8 h2 = hashMapH2(hash);
+    while(true) {
+        const u8* group = map->control + position;
+        u32 matches = hashMapGroupMatch(group, h2);
+        while(matches) {
+            u64 index = (position + groundedCountTrailingZeros32(matches)) & mask;
+            if(map->equal(hashMapSlot(map, index), key, map->keySize)) {
+                return index + 1;
+            }
+            matches &= matches - 1;
+        }
+        // An empty slot ends every probe sequence that could contain the key
+        if(hashMapGroupMatchEmpty(group)) {
+            return 0;
+        }
+        step += GROUNDED_HASH_MAP_GROUP_WIDTH;
+        position = (position + step) & mask;
+        ASSERT(step <= map->capacity);
+    }
+}
+
+static bool hashMapResize(GroundedHashMap* map, u64 capacity) {
+    ASSERT(IS_POW2(capacity) && capacity >= GROUNDED_HASH_MAP_GROUP_WIDTH);
+    u64 slotsOffset = ALIGN_UP_POW2(capacity + GROUNDED_HASH_MAP_GROUP_WIDTH, map->slotAlignment);
+    u8* memory = (u8*)hashMapAllocate(map, slotsOffset + capacity * map->slotSize, MAX(map->slotAlignment, GROUNDED_HASH_MAP_GROUP_WIDTH));
+    if(!memory) {
+        GROUNDED_LOG_ERROR("Could not grow hash map");
+        return false;
+    }
+
+    GroundedHashMap old = *map;
+    map->control = memory;
+    map->slots = memory + slotsOffset;
+    map->capacity = capacity;
+    map->growthLeft = HASH_MAP_MAX_LOAD(capacity) - map->count;
+    memset(map->control, HASH_MAP_CONTROL_EMPTY, capacity + GROUNDED_HASH_MAP_GROUP_WIDTH);
+
+    for(u64 i = 0; i < old.capacity; ++i) {
+        if(!(old.control[i] & 0x80)) {
+            u8* oldSlot = old.slots + i * old.slotSize;
+            u64 hash = hashMapHash(map, oldSlot);
+            u64 index = hashMapFindFreeSlot(map, hash);
+            hashMapSetControl(map, index, hashMapH2(hash));
+            memcpy(hashMapSlot(map, index), oldSlot, map->slotSize);
+        }
+    }
+    if(old.control) {
+        hashMapFree(map, old.control);
+    }
+    return true;
+}
+
+static void hashMapSwapSlots(GroundedHashMap* map, u64 a, u64 b) {
+    u8* slotA = hashMapSlot(map, a);
+    u8* slotB = hashMapSlot(map, b);
+    u8 buffer[64];
+    for(u64 offset = 0; offset < map->slotSize; offset += sizeof(buffer)) {
+        u64 size = MIN(sizeof(buffer), map->slotSize - offset);
+        memcpy(buffer, slotA + offset, size);
+        memcpy(slotA + offset, slotB + offset, size);
+        memcpy(slotB + offset, buffer, size);
+    }
+}
+
+// Rehashes within the current table to turn all tombstones back into empty slots without allocating
+static void hashMapDropDeleted(GroundedHashMap* map) {
+    u64 mask = map->capacity - 1;
+    // Tombstones become empty and full slots are marked deleted which means "not yet placed" during the rehash
+    for(u64 i = 0; i < map->capacity; ++i) {
+        map->control[i] = (map->control[i] & 0x80) ? HASH_MAP_CONTROL_EMPTY : HASH_MAP_CONTROL_DELETED;
+    }
+    memcpy(map->control + map->capacity, map->control, GROUNDED_HASH_MAP_GROUP_WIDTH - 1);
+
+    for(u64 i = 0; i < map->capacity; ++i) {
+        if(map->control[i] != HASH_MAP_CONTROL_DELETED) {
+            continue;
+        }
+        u64 hash = hashMapHash(map, hashMapSlot(map, i));
+        u64 target = hashMapFindFreeSlot(map, hash);
+        u8 h2 = hashMapH2(hash);
+        // Slots in the same probe group are found equally fast so the element can stay where it is
+        u64 probeStart = hash & mask;
+        if(((i - probeStart) & mask) / GROUNDED_HASH_MAP_GROUP_WIDTH == ((target - probeStart) & mask) / GROUNDED_HASH_MAP_GROUP_WIDTH) {
+            hashMapSetControl(map, i, h2);
+            continue;
+        }
+        if(map->control[target] == HASH_MAP_CONTROL_EMPTY) {
+            memcpy(hashMapSlot(map, target), hashMapSlot(map, i), map->slotSize);
+            hashMapSetControl(map, target, h2);
+            hashMapSetControl(map, i, HASH_MAP_CONTROL_EMPTY);
+        } else {
+            // The target holds an element that has not been placed yet. Swap and place that one next
+            hashMapSwapSlots(map, i, target);
+            hashMapSetControl(map, target, h2);
+            --i;
+        }
+    }
+    map->growthLeft = HASH_MAP_MAX_LOAD(map->capacity) - map->count;
+}
+
+GROUNDED_FUNCTION GroundedHashMap groundedCreateHashMap(MemoryArena* arena, GroundedHeap* heap, u64 keySize, u64 keyAlignment, u64 valueSize, u64 valueAlignment, GroundedHashFunc* hash, GroundedHashEqualFunc* equal) {
+    ASSERT((arena == 0) != (heap == 0));
+    ASSERT(IS_POW2(keyAlignment) && IS_POW2(valueAlignment));
+    ASSERT(keySize > 0);
+    GroundedHashMap result = {0};
+    result.arena = arena;
+    result.heap = heap;
+    result.keySize = keySize;
+    result.valueSize = valueSize;
+    result.valueOffset = ALIGN_UP_POW2(keySize, valueAlignment);
+    result.slotAlignment = MAX(keyAlignment, valueAlignment);
+    result.slotSize = ALIGN_UP_POW2(result.valueOffset + valueSize, result.slotAlignment);
+    result.hash = hash ? hash : groundedHashBytes;
+    result.equal = equal ? equal : groundedHashBytesEqual;
+    return result;
+}
+
+GROUNDED_FUNCTION void groundedDestroyHashMap(GroundedHashMap* map) {
+    if(map->control) {
+        hashMapFree(map, map->control);
+    }
+    map->control = 0;
+    map->slots = 0;
+    map->capacity = 0;
+    map->count = 0;
+    map->growthLeft = 0;
+}
+
+GROUNDED_FUNCTION bool groundedHashMapReserve(GroundedHashMap* map, u64 count) {
+    if(map->count + map->growthLeft >= count) {
+        return true;
+    }
+    u64 capacity = GROUNDED_HASH_MAP_GROUP_WIDTH;
+    while(HASH_MAP_MAX_LOAD(capacity) < count) {
+        capacity *= 2;
+    }
+    return hashMapResize(map, capacity);
+}
+
+GROUNDED_FUNCTION void* groundedHashMapGet(GroundedHashMap* map, const void* key) {
+    u64 index = hashMapFind(map, key, hashMapHash(map, key));
+    if(!index) return 0;
+    return hashMapSlot(map, index - 1) + map->valueOffset;
+}
+
+GROUNDED_FUNCTION void* groundedHashMapGetOrInsert(GroundedHashMap* map, const void* key, bool* existed) {
+    u64 hash = hashMapHash(map, key);
+    u64 index = hashMapFind(map, key, hash);
+    if(existed) *existed = index != 0;
+    if(index) {
+        return hashMapSlot(map, index - 1) + map->valueOffset;
+    }
+
+    index = map->capacity ? hashMapFindFreeSlot(map, hash) : 0;
+    if(!map->capacity || (map->growthLeft == 0 && map->control[index] != HASH_MAP_CONTROL_DELETED)) {
+        if(map->capacity && map->count + 1 <= HASH_MAP_MAX_LOAD(map->capacity) / 2) {
+            // The table is mostly tombstones so they are dropped in place instead of growing
+            hashMapDropDeleted(map);
+        } else if(!hashMapResize(map, map->capacity ? map->capacity * 2 : GROUNDED_HASH_MAP_GROUP_WIDTH)) {
+            return 0;
+        }
+        index = hashMapFindFreeSlot(map, hash);
+    }
+
+    if(map->control[index] == HASH_MAP_CONTROL_EMPTY) {
+        map->growthLeft--;
+    }
+    hashMapSetControl(map, index, hashMapH2(hash));
+    map->count++;
+    u8* slot = hashMapSlot(map, index);
+    memcpy(slot, key, map->keySize);
+    groundedClearMemory(slot + map->valueOffset, map->valueSize);
+    return slot + map->valueOffset;
+}
+
+GROUNDED_FUNCTION bool groundedHashMapPut(GroundedHashMap* map, const void* key, const void* value) {
+    void* slotValue = groundedHashMapGetOrInsert(map, key, 0);
+    if(!slotValue) return false;
+    memcpy(slotValue, value, map->valueSize);
+    return true;
+}
+
+GROUNDED_FUNCTION bool groundedHashMapRemove(GroundedHashMap* map, const void* key) {
+    u64 index = hashMapFind(map, key, hashMapHash(map, key));
+    if(!index) return false;
+    index--;
+
+    // If no group containing this slot was ever completely full, no probe sequence went past it
+    // and it can become empty again instead of leaving a tombstone
+    u64 mask = map->capacity - 1;
+    u32 emptyBefore = hashMapGroupMatchEmpty(map->control + ((index - GROUNDED_HASH_MAP_GROUP_WIDTH) & mask));
+    u32 emptyAfter = hashMapGroupMatchEmpty(map->control + index);
+    bool wasNeverFull = emptyBefore && emptyAfter &&
+        groundedCountTrailingZeros32(emptyAfter) + (groundedCountLeadingZeros64(emptyBefore) - (64 - GROUNDED_HASH_MAP_GROUP_WIDTH)) < GROUNDED_HASH_MAP_GROUP_WIDTH;
+    if(wasNeverFull) {
+        hashMapSetControl(map, index, HASH_MAP_CONTROL_EMPTY);
+        map->growthLeft++;
+    } else {
+        hashMapSetControl(map, index, HASH_MAP_CONTROL_DELETED);
+    }
+    map->count--;
+    return true;
+}
+
+GROUNDED_FUNCTION void groundedHashMapClear(GroundedHashMap* map) {
+    if(map->capacity) {
+        memset(map->control, HASH_MAP_CONTROL_EMPTY, map->capacity + GROUNDED_HASH_MAP_GROUP_WIDTH);
+        map->growthLeft = HASH_MAP_MAX_LOAD(map->capacity);
+    }
+    map->count = 0;
+}
+
+GROUNDED_FUNCTION bool groundedHashMapNext(GroundedHashMap* map, u64* iterator, void** key, void** value) {
+    while(*iterator < map->capacity) {
+        u64 index = (*iterator)++;
+        if(!(map->control[index] & 0x80)) {
+            u8* slot = hashMapSlot(map, index);
+            *key = slot;
+            if(value) *value = slot + map->valueOffset;
+            return true;
+        }
+    }
+    return false;
+}
+
+GROUNDED_FUNCTION GroundedHashSet groundedCreateHashSet(MemoryArena* arena, GroundedHeap* heap, u64 keySize, u64 keyAlignment, GroundedHashFunc* hash, GroundedHashEqualFunc* equal) {
+    GroundedHashSet result;
+    result.map = groundedCreateHashMap(arena, heap, keySize, keyAlignment, 0, 1, hash, equal);
+    return result;
+}
+
+GROUNDED_FUNCTION void groundedDestroyHashSet(GroundedHashSet* set) {
+    groundedDestroyHashMap(&set->map);
+}
+
+GROUNDED_FUNCTION bool groundedHashSetInsert(GroundedHashSet* set, const void* key) {
+    bool existed = false;
+    groundedHashMapGetOrInsert(&set->map, key, &existed);
+    return !existed;
+}
+
+GROUNDED_FUNCTION bool groundedHashSetContains(GroundedHashSet* set, const void* key) {
+    return groundedHashMapGet(&set->map, key) != 0;
+}
+
+GROUNDED_FUNCTION bool groundedHashSetRemove(GroundedHashSet* set, const void* key) {
+    return groundedHashMapRemove(&set->map, key);
+}
+
+GROUNDED_FUNCTION void groundedHashSetClear(GroundedHashSet* set) {
+    groundedHashMapClear(&set->map);
+}
+
+GROUNDED_FUNCTION bool groundedHashSetNext(GroundedHashSet* set, u64* iterator, void** key) {
+    return groundedHashMapNext(&set->map, iterator, key, 0);
+}
@@ -0,0 +1,996 @@
+#include <grounded/file/grounded_async_io.h>
+#include <grounded/threading/grounded_threading.h>
+#include <grounded/memory/grounded_memory.h>
+#include <grounded/logger/grounded_logger.h>
+
+#ifdef __linux__
+#define ASYNC_IO_HAS_IO_URING 1
+#include <linux/io_uring.h>
+#include <linux/stat.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#endif
+
+// Larger transfers are split into several requests. Linux never transfers more than this in one call anyway
+#define ASYNC_IO_MAX_TRANSFER_SIZE 0x7ffff000ull
+
+////////////////
+// Internal data
+
+enum AsyncIoOperation {
+    ASYNC_IO_OPERATION_READ,
+    ASYNC_IO_OPERATION_WRITE,
+    ASYNC_IO_OPERATION_OPEN, // Opens for reading and gets the file size. Only used for loading files
+    ASYNC_IO_OPERATION_CLOSE,
+};
+
+enum AsyncIoRequestState {
+    ASYNC_IO_REQUEST_STATE_FREE,
+    ASYNC_IO_REQUEST_STATE_PENDING,
+    ASYNC_IO_REQUEST_STATE_FINISHED,
+};
+
+struct AsyncIoRequestSlot {
+    volatile u32 state;
+    u32 generation;
+    enum AsyncIoOperation operation;
+    u32 pendingCompletions; // io_uring only. Opening waits for openat and statx
+    GroundedFile file;
+    u8* buffer;
+    u64 size; // For open this receives the file size
+    u64 offset;
+    u64 transferred;
+    const char* path;
+    bool success;
+    GroundedAsyncTask task; // Fallback only. 0 if the request was executed inline
+};
+
+// Requests are referenced by index + 1 in the lower 32 bits and the generation in the upper 32 bits
+static inline GroundedAsyncIoRequest asyncIoMakeHandle(struct AsyncIoRequestSlot* slot, u32 index) {
+    return ((u64)slot->generation << 32) | (index + 1);
+}
+
+static struct AsyncIoRequestSlot* asyncIoGetSlot(GroundedAsyncIo* io, GroundedAsyncIoRequest request) {
+    u32 index = (u32)request;
+    if(index == 0 || index > io->requestCount) return 0;
+    struct AsyncIoRequestSlot* slot = &io->requests[index - 1];
+    if(slot->generation != (u32)(request >> 32) || slot->state == ASYNC_IO_REQUEST_STATE_FREE) return 0;
+    return slot;
+}
+
+static u32 asyncIoAllocateRequest(GroundedAsyncIo* io) {
+    if(!io->freeRequestCount) {
+        return UINT32_MAX;
+    }
+    u32 index = io->freeRequests[--io->freeRequestCount];
+    struct AsyncIoRequestSlot* slot = &io->requests[index];
+    u32 generation = slot->generation + 1;
+    *slot = (struct AsyncIoRequestSlot){0};
+    slot->generation = generation;
+    slot->state = ASYNC_IO_REQUEST_STATE_PENDING;
+    return index;
+}
+
+static void asyncIoFreeRequest(GroundedAsyncIo* io, struct AsyncIoRequestSlot* slot) {
+    ASSERT(slot->state == ASYNC_IO_REQUEST_STATE_FINISHED);
+    slot->state = ASYNC_IO_REQUEST_STATE_FREE;
+    io->freeRequests[io->freeRequestCount++] = (u32)(slot - io->requests);
+}
+
+static void asyncIoFinishRequest(struct AsyncIoRequestSlot* slot, bool success) {
+    slot->success = success;
+    groundedAtomicStore32(&slot->state, ASYNC_IO_REQUEST_STATE_FINISHED, GROUNDED_MEMORY_ORDER_RELEASE);
+}
+
+//////////////////////
+// Thread pool backend
+
+struct AsyncIoTaskData {
+    GroundedAsyncIo* io;
+    struct AsyncIoRequestSlot* slot;
+};
+
+// Returns whether the operation succeeded. The request is not finished
+static bool asyncIoExecuteBlocking(struct AsyncIoRequestSlot* slot) {
+    bool success = false;
+    switch(slot->operation) {
+        case ASYNC_IO_OPERATION_READ:
+            success = groundedFileReadAt(slot->file, slot->buffer, slot->size, slot->offset, &slot->transferred);
+            break;
+        case ASYNC_IO_OPERATION_WRITE:
+            success = groundedFileWriteAt(slot->file, slot->buffer, slot->size, slot->offset, &slot->transferred);
+            break;
+        case ASYNC_IO_OPERATION_OPEN:
+            slot->file = groundedOpenFile(str8FromCstr(slot->path), FILE_MODE_READ);
+            success = groundedFileIsValid(slot->file);
+            if(success) {
+                slot->size = groundedFileGetSize(slot->file);
+            }
+            break;
+        case ASYNC_IO_OPERATION_CLOSE:
+            groundedCloseFile(&slot->file);
+            success = true;
+            break;
+    }
+    return success;
+}
+
+static GROUNDED_ASYNC_PROC(asyncIoTask) {
+    struct AsyncIoTaskData* data = (struct AsyncIoTaskData*)task->userData;
+    GroundedAsyncIo* io = data->io;
+    bool success = asyncIoExecuteBlocking(data->slot);
+    // Finishing under the mutex means the waiting thread can not miss the signal
+    groundedLockMutex(&io->completionMutex);
+    asyncIoFinishRequest(data->slot, success);
+    groundedConditionVariableSignal(&io->completionCondition);
+    groundedUnlockMutex(&io->completionMutex);
+}
+
+static void asyncIoFallbackStart(GroundedAsyncIo* io, struct AsyncIoRequestSlot* slot) {
+    struct AsyncIoTaskData data = {io, slot};
+    slot->task = groundedPushAsyncTask(io->fallbackSystem, &asyncIoTask, &data, sizeof(data));
+    if(!slot->task) {
+        // The task queue is full so do the work on this thread
+        asyncIoFinishRequest(slot, asyncIoExecuteBlocking(slot));
+    }
+}
+
+//////////////////
+// io_uring backend
+#ifdef ASYNC_IO_HAS_IO_URING
+
+struct AsyncIoRing {
+    int fd;
+    volatile u32* sqHead;
+    volatile u32* sqTail;
+    u32* sqArray;
+    u32 sqMask;
+    u32 sqEntryCount;
+    struct io_uring_sqe* sqes;
+    volatile u32* cqHead;
+    volatile u32* cqTail;
+    u32 cqMask;
+    struct io_uring_cqe* cqes;
+
+    u8* sqRing;
+    u64 sqRingSize;
+    u8* cqRing;
+    u64 cqRingSize;
+    u64 sqesSize;
+
+    u32 sqLocalTail; // Written to sqTail on submit
+    u32 unsubmittedCount;
+    struct statx* stats; // One per request
+};
+
+static int asyncIoRingSetup(u32 entryCount, struct io_uring_params* params) {
+    return (int)syscall(__NR_io_uring_setup, entryCount, params);
+}
+
+static int asyncIoRingEnter(int fd, u32 submitCount, u32 minComplete, u32 flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, submitCount, minComplete, flags, 0, 0);
+}
+
+static bool asyncIoRingSupportsOperations(int fd) {
+    // Make sure the probe is aligned for struct io_uring_probe
+    u64 probeMemory[(sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op)) / sizeof(u64) + 1] = {0};
+    struct io_uring_probe* probe = (struct io_uring_probe*)probeMemory;
+    if(syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) < 0) {
+        // Probing was added at the same time as IORING_OP_READ so older kernels lack it anyway
+        return false;
+    }
+    u8 requiredOperations[] = {IORING_OP_READ, IORING_OP_WRITE, IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_CLOSE};
+    for(u32 i = 0; i < ARRAY_COUNT(requiredOperations); ++i) {
+        u8 operation = requiredOperations[i];
+        if(operation > probe->last_op || !(probe->ops[operation].flags & IO_URING_OP_SUPPORTED)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void asyncIoRingDestroy(struct AsyncIoRing* ring) {
+    if(ring->sqes) munmap(ring->sqes, ring->sqesSize);
+    if(ring->cqRing && ring->cqRing != ring->sqRing) munmap(ring->cqRing, ring->cqRingSize);
+    if(ring->sqRing) munmap(ring->sqRing, ring->sqRingSize);
+    close(ring->fd);
+}
+
+// Returns 0 if io_uring can not be used
+static struct AsyncIoRing* asyncIoRingCreate(MemoryArena* arena, u32 requestCount) {
+    struct io_uring_params params = {0};
+    // The completion queue has twice as many entries as the submission queue.
+    // Every request produces at most 2 completions so the completion queue can never overflow
+    int fd = asyncIoRingSetup(requestCount, &params);
+    if(fd < 0) {
+        return 0;
+    }
+    if(!asyncIoRingSupportsOperations(fd)) {
+        close(fd);
+        return 0;
+    }
+
+    struct AsyncIoRing* ring = ARENA_PUSH_STRUCT(arena, struct AsyncIoRing);
+    struct statx* stats = ARENA_PUSH_ARRAY(arena, requestCount, struct statx);
+    if(!ring || !stats) {
+        close(fd);
+        return 0;
+    }
+    ring->stats = stats;
+    ring->fd = fd;
+    ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(u32);
+    ring->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if(singleMap) {
+        ring->sqRingSize = ring->cqRingSize = MAX(ring->sqRingSize, ring->cqRingSize);
+    }
+
+    void* sqRing = mmap(0, ring->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if(sqRing == MAP_FAILED) {
+        close(fd);
+        return 0;
+    }
+    ring->sqRing = sqRing;
+    if(singleMap) {
+        ring->cqRing = ring->sqRing;
+    } else {
+        void* cqRing = mmap(0, ring->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if(cqRing == MAP_FAILED) {
+            asyncIoRingDestroy(ring);
+            return 0;
+        }
+        ring->cqRing = cqRing;
+    }
+    void* sqes = mmap(0, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if(sqes == MAP_FAILED) {
+        asyncIoRingDestroy(ring);
+        return 0;
+    }
+    ring->sqes = sqes;
+
+    ring->sqHead = (u32*)(ring->sqRing + params.sq_off.head);
+    ring->sqTail = (u32*)(ring->sqRing + params.sq_off.tail);
+    ring->sqMask = *(u32*)(ring->sqRing + params.sq_off.ring_mask);
+    ring->sqEntryCount = *(u32*)(ring->sqRing + params.sq_off.ring_entries);
+    ring->sqArray = (u32*)(ring->sqRing + params.sq_off.array);
+    ring->cqHead = (u32*)(ring->cqRing + params.cq_off.head);
+    ring->cqTail = (u32*)(ring->cqRing + params.cq_off.tail);
+    ring->cqMask = *(u32*)(ring->cqRing + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(ring->cqRing + params.cq_off.cqes);
+    ring->sqLocalTail = *ring->sqTail;
+    return ring;
+}
+
+// Hands all queued entries to the kernel. With minComplete > 0 this also waits for that many completions
+static void asyncIoRingSubmit(struct AsyncIoRing* ring, u32 minComplete) {
+    if(!ring->unsubmittedCount && !minComplete) return;
+    groundedAtomicStore32(ring->sqTail, ring->sqLocalTail, GROUNDED_MEMORY_ORDER_RELEASE);
+    u32 flags = minComplete ? IORING_ENTER_GETEVENTS : 0;
+    int submitted = asyncIoRingEnter(ring->fd, ring->unsubmittedCount, minComplete, flags);
+    if(submitted >= 0) {
+        ring->unsubmittedCount -= MIN((u32)submitted, ring->unsubmittedCount);
+    } else if(errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+        GROUNDED_LOG_ERROR("Could not submit io_uring requests");
+    }
+}
+
+static struct io_uring_sqe* asyncIoRingGetSqe(struct AsyncIoRing* ring) {
+    u32 head = groundedAtomicLoad32(ring->sqHead, GROUNDED_MEMORY_ORDER_ACQUIRE);
+    while(ring->sqLocalTail - head >= ring->sqEntryCount) {
+        // Submission queue is full. Without SQPOLL the kernel consumes all entries during enter
+        asyncIoRingSubmit(ring, 0);
+        head = groundedAtomicLoad32(ring->sqHead, GROUNDED_MEMORY_ORDER_ACQUIRE);
+    }
+    u32 index = ring->sqLocalTail & ring->sqMask;
+    struct io_uring_sqe* sqe = &ring->sqes[index];
+    MEMORY_CLEAR_STRUCT(sqe);
+    ring->sqArray[index] = index;
+    ring->sqLocalTail++;
+    ring->unsubmittedCount++;
+    return sqe;
+}
+
+// user_data is the request index shifted by one. The lowest bit distinguishes openat from statx
+static void asyncIoRingQueueTransfer(GroundedAsyncIo* io, u32 index) {
+    struct AsyncIoRequestSlot* slot = &io->requests[index];
+    struct io_uring_sqe* sqe = asyncIoRingGetSqe(io->ring);
+    sqe->opcode = slot->operation == ASYNC_IO_OPERATION_READ ? IORING_OP_READ : IORING_OP_WRITE;
+    sqe->fd = slot->file.fd;
+    sqe->addr = (u64)(slot->buffer + slot->transferred);
+    sqe->len = (u32)MIN(slot->size - slot->transferred, ASYNC_IO_MAX_TRANSFER_SIZE);
+    sqe->off = slot->offset + slot->transferred;
+    sqe->user_data = (u64)index << 1;
+}
+
+static void asyncIoRingStart(GroundedAsyncIo* io, u32 index) {
+    struct AsyncIoRing* ring = io->ring;
+    struct AsyncIoRequestSlot* slot = &io->requests[index];
+    slot->pendingCompletions = 1;
+    if(slot->operation == ASYNC_IO_OPERATION_READ || slot->operation == ASYNC_IO_OPERATION_WRITE) {
+        asyncIoRingQueueTransfer(io, index);
+    } else if(slot->operation == ASYNC_IO_OPERATION_OPEN) {
+        // Open and stat are independent so both run concurrently
+        slot->pendingCompletions = 2;
+        slot->success = true;
+        slot->file.fd = -1;
+        struct io_uring_sqe* sqe = asyncIoRingGetSqe(ring);
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = (u64)slot->path;
+        sqe->open_flags = O_RDONLY | O_CLOEXEC;
+        sqe->user_data = (u64)index << 1;
+
+        sqe = asyncIoRingGetSqe(ring);
+        sqe->opcode = IORING_OP_STATX;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = (u64)slot->path;
+        sqe->len = STATX_SIZE;
+        sqe->off = (u64)&ring->stats[index];
+        sqe->user_data = ((u64)index << 1) | 1;
+    } else if(slot->operation == ASYNC_IO_OPERATION_CLOSE) {
+        struct io_uring_sqe* sqe = asyncIoRingGetSqe(ring);
+        sqe->opcode = IORING_OP_CLOSE;
+        sqe->fd = slot->file.fd;
+        sqe->user_data = (u64)index << 1;
+    }
+}
+
+static void asyncIoRingHandleCompletion(GroundedAsyncIo* io, u64 userData, s32 result) {
+    u32 index = (u32)(userData >> 1);
+    ASSERT(index < io->requestCount);
+    struct AsyncIoRequestSlot* slot = &io->requests[index];
+    switch(slot->operation) {
+        case ASYNC_IO_OPERATION_READ:
+        case ASYNC_IO_OPERATION_WRITE: {
+            if(result == -EINTR || result == -EAGAIN) {
+                asyncIoRingQueueTransfer(io, index);
+            } else if(result < 0) {
+                asyncIoFinishRequest(slot, false);
+            } else if(result == 0) {
+                // End of file for reads. A write that makes no progress is an error
+                asyncIoFinishRequest(slot, slot->operation == ASYNC_IO_OPERATION_READ);
+            } else {
+                slot->transferred += result;
+                if(slot->transferred < slot->size) {
+                    // Short transfer so continue with the rest
+                    asyncIoRingQueueTransfer(io, index);
+                } else {
+                    asyncIoFinishRequest(slot, true);
+                }
+            }
+        } break;
+        case ASYNC_IO_OPERATION_OPEN: {
+            if(userData & 1) {
+                if(result < 0) {
+                    slot->success = false;
+                } else {
+                    slot->size = io->ring->stats[index].stx_size;
+                }
+            } else {
+                if(result < 0) {
+                    slot->success = false;
+                } else {
+                    slot->file.fd = result;
+                }
+            }
+            if(--slot->pendingCompletions == 0) {
+                if(!slot->success && slot->file.fd >= 0) {
+                    close(slot->file.fd);
+                    slot->file.fd = -1;
+                }
+                asyncIoFinishRequest(slot, slot->success);
+            }
+        } break;
+        case ASYNC_IO_OPERATION_CLOSE: {
+            asyncIoFinishRequest(slot, result >= 0);
+        } break;
+    }
+}
+
+static void asyncIoRingReap(GroundedAsyncIo* io) {
+    struct AsyncIoRing* ring = io->ring;
+    u32 head = *ring->cqHead;
+    u32 tail = groundedAtomicLoad32(ring->cqTail, GROUNDED_MEMORY_ORDER_ACQUIRE);
+    while(head != tail) {
+        struct io_uring_cqe* cqe = &ring->cqes[head & ring->cqMask];
+        u64 userData = cqe->user_data;
+        s32 result = cqe->res;
+        head++;
+        groundedAtomicStore32(ring->cqHead, head, GROUNDED_MEMORY_ORDER_RELEASE);
+        asyncIoRingHandleCompletion(io, userData, result);
+    }
+}
+
+#endif // ASYNC_IO_HAS_IO_URING
+
+/////////////////////
+// Backend dispatching
+
+static GroundedAsyncIoRequest asyncIoStart(GroundedAsyncIo* io, u32 index) {
+    struct AsyncIoRequestSlot* slot = &io->requests[index];
+    bool isTransfer = slot->operation == ASYNC_IO_OPERATION_READ || slot->operation == ASYNC_IO_OPERATION_WRITE;
+    if(isTransfer && slot->size == 0) {
+        asyncIoFinishRequest(slot, true);
+    } else if(io->ring) {
+        #ifdef ASYNC_IO_HAS_IO_URING
+        asyncIoRingStart(io, index);
+        #endif
+    } else {
+        asyncIoFallbackStart(io, slot);
+    }
+    return asyncIoMakeHandle(slot, index);
+}
+
+static GroundedAsyncIoRequest asyncIoQueue(GroundedAsyncIo* io, enum AsyncIoOperation operation, GroundedFile file, u8* buffer, u64 size, u64 offset, const char* path) {
+    u32 index = asyncIoAllocateRequest(io);
+    if(index == UINT32_MAX) {
+        GROUNDED_LOG_ERROR("No free async io request left");
+        return 0;
+    }
+    struct AsyncIoRequestSlot* slot = &io->requests[index];
+    slot->operation = operation;
+    slot->file = file;
+    slot->buffer = buffer;
+    slot->size = size;
+    slot->offset = offset;
+    slot->path = path;
+    return asyncIoStart(io, index);
+}
+
+// Blocks until the request has finished. The request is not freed
+static struct AsyncIoRequestSlot* asyncIoWaitForSlot(GroundedAsyncIo* io, GroundedAsyncIoRequest request) {
+    struct AsyncIoRequestSlot* slot = asyncIoGetSlot(io, request);
+    if(!slot) return 0;
+    if(io->ring) {
+        #ifdef ASYNC_IO_HAS_IO_URING
+        asyncIoRingReap(io);
+        while(groundedAtomicLoad32(&slot->state, GROUNDED_MEMORY_ORDER_ACQUIRE) != ASYNC_IO_REQUEST_STATE_FINISHED) {
+            asyncIoRingSubmit(io->ring, 1);
+            asyncIoRingReap(io);
+        }
+        #endif
+    } else if(slot->task) {
+        // A request that has not started yet is picked up by helping the pool. This also keeps a pool that runs on
+        // this thread from deadlocking. Once a worker is inside the blocking call this thread sleeps until it is done
+        while(groundedAsyncTaskIsPending(io->fallbackSystem, slot->task)) {
+            groundedAsyncTaskWait(io->fallbackSystem, slot->task, 1);
+        }
+        groundedLockMutex(&io->completionMutex);
+        while(groundedAtomicLoad32(&slot->state, GROUNDED_MEMORY_ORDER_ACQUIRE) != ASYNC_IO_REQUEST_STATE_FINISHED) {
+            groundedConditionVariableWait(&io->completionCondition, &io->completionMutex);
+        }
+        groundedUnlockMutex(&io->completionMutex);
+    }
+    ASSERT(groundedAtomicLoad32(&slot->state, GROUNDED_MEMORY_ORDER_ACQUIRE) == ASYNC_IO_REQUEST_STATE_FINISHED);
+    return slot;
+}
+
+/////////////
+// Public API
+
+GROUNDED_FUNCTION bool groundedCreateAsyncIo(GroundedAsyncIo* io, GroundedAsyncIoParameters* parameters) {
+    if(!parameters) {
+        static GroundedAsyncIoParameters defaultParameters = {0};
+        parameters = &defaultParameters;
+    }
+    *io = (GroundedAsyncIo){0};
+
+    u32 requestCount = parameters->maxRequestCount ? parameters->maxRequestCount : 256;
+    io->arena = createGrowingArena(osGetMemorySubsystem(), KB(16));
+    io->requests = ARENA_PUSH_ARRAY(&io->arena, requestCount, struct AsyncIoRequestSlot);
+    io->freeRequests = ARENA_PUSH_ARRAY(&io->arena, requestCount, u32);
+    if(!io->requests || !io->freeRequests) {
+        GROUNDED_LOG_ERROR("Could not allocate memory for async io");
+        arenaRelease(&io->arena);
+        *io = (GroundedAsyncIo){0};
+        return false;
+    }
+    io->requestCount = requestCount;
+    // Push in reverse so the first requests are handed out first
+    for(u32 i = requestCount; i > 0; --i) {
+        io->freeRequests[io->freeRequestCount++] = i - 1;
+    }
+
+    #ifdef ASYNC_IO_HAS_IO_URING
+    if(!parameters->forceFallback) {
+        io->ring = asyncIoRingCreate(&io->arena, requestCount);
+        if(!io->ring) {
+            GROUNDED_LOG_INFO("io_uring is not available. Falling back to thread pool for async io");
+        }
+    }
+    #endif
+
+    if(!io->ring) {
+        if(parameters->fallbackSystem) {
+            io->fallbackSystem = parameters->fallbackSystem;
+        } else {
+            io->fallbackSystem = ARENA_PUSH_STRUCT(&io->arena, GroundedAsyncSystem);
+            GroundedAsyncSystemParameters systemParameters = {
+                .workerCount = parameters->fallbackThreadCount ? parameters->fallbackThreadCount : 4,
+                .maxTaskCount = requestCount,
+            };
+            if(!io->fallbackSystem || !createAsyncSystem(io->fallbackSystem, &systemParameters)) {
+                GROUNDED_LOG_ERROR("Could not create thread pool for async io");
+                arenaRelease(&io->arena);
+                *io = (GroundedAsyncIo){0};
+                return false;
+            }
+            io->ownsFallbackSystem = true;
+        }
+        io->completionMutex = groundedCreateMutex();
+        io->completionCondition = groundedCreateConditionVariable();
+    }
+
+    return true;
+}
+
+GROUNDED_FUNCTION void groundedDestroyAsyncIo(GroundedAsyncIo* io) {
+    if(!io->requests) return;
+
+    groundedAsyncIoWaitForAll(io);
+    #ifdef ASYNC_IO_HAS_IO_URING
+    if(io->ring) {
+        asyncIoRingDestroy(io->ring);
+    }
+    #endif
+    if(io->ownsFallbackSystem) {
+        destroyAsyncSystem(io->fallbackSystem);
+    }
+    if(io->fallbackSystem) {
+        // A pool thread might still be about to leave the critical section in which it finished the last request
+        groundedLockMutex(&io->completionMutex);
+        groundedUnlockMutex(&io->completionMutex);
+        groundedDestroyConditionVariable(&io->completionCondition);
+        groundedDestroyMutex(&io->completionMutex);
+    }
+    arenaRelease(&io->arena);
+    *io = (GroundedAsyncIo){0};
+}
+
+GROUNDED_FUNCTION bool groundedAsyncIoUsesIoUring(GroundedAsyncIo* io) {
+    return io->ring != 0;
+}
+
+GROUNDED_FUNCTION GroundedAsyncIoRequest groundedAsyncIoRead(GroundedAsyncIo* io, GroundedFile file, u8* buffer, u64 size, u64 offset) {
+    return asyncIoQueue(io, ASYNC_IO_OPERATION_READ, file, buffer, size, offset, 0);
+}
+
+GROUNDED_FUNCTION GroundedAsyncIoRequest groundedAsyncIoWrite(GroundedAsyncIo* io, GroundedFile file, const u8* buffer, u64 size, u64 offset) {
+    // The buffer is only read from
+    return asyncIoQueue(io, ASYNC_IO_OPERATION_WRITE, file, (u8*)buffer, size, offset, 0);
+}
+
+GROUNDED_FUNCTION void groundedAsyncIoSubmit(GroundedAsyncIo* io) {
+    #ifdef ASYNC_IO_HAS_IO_URING
+    if(io->ring) {
+        asyncIoRingSubmit(io->ring, 0);
+    }
+    #endif
+    // The fallback starts requests as soon as they are queued
+}
+
+GROUNDED_FUNCTION bool groundedAsyncIoIsFinished(GroundedAsyncIo* io, GroundedAsyncIoRequest request) {
+    struct AsyncIoRequestSlot* slot = asyncIoGetSlot(io, request);
+    if(!slot) return false;
+    #ifdef ASYNC_IO_HAS_IO_URING
+    if(io->ring) {
+        // Polling must make progress even if the caller never submits explicitly
+        asyncIoRingSubmit(io->ring, 0);
+        asyncIoRingReap(io);
+    }
+    #endif
+    return groundedAtomicLoad32(&slot->state, GROUNDED_MEMORY_ORDER_ACQUIRE) == ASYNC_IO_REQUEST_STATE_FINISHED;
+}
+
+GROUNDED_FUNCTION bool groundedAsyncIoWait(GroundedAsyncIo* io, GroundedAsyncIoRequest request, u64* bytesTransferred) {
+    struct AsyncIoRequestSlot* slot = asyncIoWaitForSlot(io, request);
+    if(!slot) {
+        GROUNDED_LOG_ERROR("Invalid async io request");
+        return false;
+    }
+    if(bytesTransferred) {
+        *bytesTransferred = slot->transferred;
+    }
+    bool result = slot->success;
+    asyncIoFreeRequest(io, slot);
+    return result;
+}
+
+GROUNDED_FUNCTION void groundedAsyncIoWaitForAll(GroundedAsyncIo* io) {
+    for(u32 i = 0; i < io->requestCount; ++i) {
+        struct AsyncIoRequestSlot* slot = &io->requests[i];
+        if(slot->state != ASYNC_IO_REQUEST_STATE_FREE) {
+            asyncIoWaitForSlot(io, asyncIoMakeHandle(slot, i));
+            asyncIoFreeRequest(io, slot);
+        }
+    }
+}
+
+GROUNDED_FUNCTION u64 groundedAsyncIoLoadFiles(GroundedAsyncIo* io, MemoryArena* arena, GroundedFileLoad* loads, u64 loadCount) {
+    MemoryArena* scratch = threadContextGetScratch(arena);
+    u64 result = 0;
+    u64 batchSize = io->freeRequestCount;
+    if(!batchSize && loadCount) {
+        GROUNDED_LOG_ERROR("No free async io request left");
+        return 0;
+    }
+
+    // Every phase is submitted as a whole so each batch needs three round trips no matter how many files it contains
+    for(u64 first = 0; first < loadCount; first += batchSize) {
+        ArenaTempMemory temp = arenaBeginTemp(scratch);
+        u64 count = MIN(batchSize, loadCount - first);
+        GroundedFileLoad* batch = loads + first;
+        GroundedAsyncIoRequest* requests = ARENA_PUSH_ARRAY(scratch, count, GroundedAsyncIoRequest);
+        GroundedFile* files = ARENA_PUSH_ARRAY(scratch, count, GroundedFile);
+        bool* opened = ARENA_PUSH_ARRAY(scratch, count, bool);
+
+        // Open and get the size of all files
+        for(u64 i = 0; i < count; ++i) {
+            batch[i].data = 0;
+            batch[i].size = 0;
+            batch[i].success = false;
+            const char* path = str8GetCstr(scratch, batch[i].filename);
+            requests[i] = asyncIoQueue(io, ASYNC_IO_OPERATION_OPEN, (GroundedFile){0}, 0, 0, 0, path);
+        }
+        groundedAsyncIoSubmit(io);
+        for(u64 i = 0; i < count; ++i) {
+            struct AsyncIoRequestSlot* slot = asyncIoWaitForSlot(io, requests[i]);
+            if(slot) {
+                opened[i] = slot->success;
+                files[i] = slot->file;
+                batch[i].size = slot->size;
+                asyncIoFreeRequest(io, slot);
+            }
+        }
+
+        // Read all contents
+        for(u64 i = 0; i < count; ++i) {
+            requests[i] = 0;
+            if(!opened[i]) continue;
+            if(batch[i].size) {
+                batch[i].data = ARENA_PUSH_ARRAY_NO_CLEAR(arena, batch[i].size, u8);
+                if(!batch[i].data) {
+                    GROUNDED_LOG_ERROR("Could not allocate memory for file");
+                    continue;
+                }
+            }
+            requests[i] = groundedAsyncIoRead(io, files[i], batch[i].data, batch[i].size, 0);
+        }
+        groundedAsyncIoSubmit(io);
+        for(u64 i = 0; i < count; ++i) {
+            if(!requests[i]) continue;
+            u64 bytesRead = 0;
+            batch[i].success = groundedAsyncIoWait(io, requests[i], &bytesRead);
+            // The file might have been truncated in the meantime
+            batch[i].size = bytesRead;
+            if(batch[i].success) {
+                result++;
+            }
+        }
+
+        // Close everything that was opened
+        for(u64 i = 0; i < count; ++i) {
+            requests[i] = opened[i] ? asyncIoQueue(io, ASYNC_IO_OPERATION_CLOSE, files[i], 0, 0, 0, 0) : 0;
+        }
+        groundedAsyncIoSubmit(io);
+        for(u64 i = 0; i < count; ++i) {
+            if(requests[i]) {
+                groundedAsyncIoWait(io, requests[i], 0);
+            }
+        }
+        arenaEndTemp(temp);
+    }
+    return result;
+}
+
+//////////////////////////
+// Read ahead stream reader
+
+struct ReadAheadStream {
+    GroundedAsyncIo* io;
+    GroundedAsyncIo ownIo; // Used if no io was passed in
+    GroundedFile* file;
+    u8** buffers;
+    GroundedAsyncIoRequest* requests; // 0 if the buffer has no read in flight
+    u64* bytesRead; // Result of reads that had to be done synchronously
+    bool* readFailed;
+    u32 bufferCount;
+    u32 currentBuffer; // Next buffer to hand to the consumer
+    u32 consumedBuffer; // Buffer the consumer has just finished. UINT32_MAX before the first refill
+    u64 bufferSize;
+    u64 nextOffset; // File offset of the next read to start
+    bool reachedEnd;
+};
+
+static void readAheadStartRead(struct ReadAheadStream* stream, u32 index) {
+    u8* buffer = stream->buffers[index];
+    stream->bytesRead[index] = 0;
+    stream->readFailed[index] = false;
+    stream->requests[index] = 0;
+    if(stream->io->freeRequestCount) {
+        stream->requests[index] = groundedAsyncIoRead(stream->io, *stream->file, buffer, stream->bufferSize, stream->nextOffset);
+    }
+    if(!stream->requests[index]) {
+        // No request slot left so read synchronously
+        stream->readFailed[index] = !groundedFileReadAt(*stream->file, buffer, stream->bufferSize, stream->nextOffset, &stream->bytesRead[index]);
+    }
+    stream->nextOffset += stream->bufferSize;
+}
+
+static enum GroundedStreamErrorCode readAheadRefill(BufferedStreamReader* r) {
+    struct ReadAheadStream* stream = (struct ReadAheadStream*)r->implementationPointer;
+
+    // The buffer that has just been consumed receives the chunk after all buffers that are already loading
+    if(stream->consumedBuffer != UINT32_MAX) {
+        u32 consumed = stream->consumedBuffer;
+        stream->bytesRead[consumed] = 0;
+        if(!stream->reachedEnd) {
+            readAheadStartRead(stream, consumed);
+            groundedAsyncIoSubmit(stream->io);
+        }
+    }
+
+    u32 index = stream->currentBuffer;
+    u64 bytesRead = stream->bytesRead[index];
+    bool success = !stream->readFailed[index];
+    if(stream->requests[index]) {
+        success = groundedAsyncIoWait(stream->io, stream->requests[index], &bytesRead);
+        stream->requests[index] = 0;
+    }
+    if(!success || bytesRead == 0) {
+        refillZeros(r);
+        r->refill = refillZeros;
+        r->error = success ? GROUNDED_STREAM_PAST_EOF : GROUNDED_STREAM_IO_ERROR;
+        return r->error;
+    }
+    if(bytesRead < stream->bufferSize) {
+        // Short read means end of file so there is nothing left to prefetch
+        stream->reachedEnd = true;
+    }
+    stream->consumedBuffer = index;
+    stream->currentBuffer = (index + 1) % stream->bufferCount;
+
+    r->start = stream->buffers[index];
+    r->cursor = r->start;
+    r->end = r->start + bytesRead;
+    return GROUNDED_STREAM_SUCCESS;
+}
+
+static void readAheadClose(BufferedStreamReader* r) {
+    struct ReadAheadStream* stream = (struct ReadAheadStream*)r->implementationPointer;
+    // Buffers must not be released while a read might still write into them
+    for(u32 i = 0; i < stream->bufferCount; ++i) {
+        if(stream->requests[i]) {
+            groundedAsyncIoWait(stream->io, stream->requests[i], 0);
+            stream->requests[i] = 0;
+        }
+    }
+    if(stream->io == &stream->ownIo) {
+        groundedDestroyAsyncIo(&stream->ownIo);
+    }
+    groundedCloseFile(stream->file);
+}
+
+GROUNDED_FUNCTION BufferedStreamReader groundedFileGetReadAheadStreamReaderFromFile(MemoryArena* arena, GroundedAsyncIo* io, GroundedFile* file, u64 bufferSize, u32 bufferCount) {
+    BufferedStreamReader result = {
+        .error = GROUNDED_STREAM_IO_ERROR,
+        .refill = refillZeros,
+        .close = dummyBufferedStreamReaderClose,
+    };
+    if(!bufferSize) {
+        bufferSize = groundedFileGetStreamBufferSize(*file);
+    }
+    // Buffers larger than the file are never filled. An empty file still needs one byte to detect the end
+    bufferSize = MIN(bufferSize, MAX(groundedFileGetSize(*file), 1));
+    // At least one buffer is consumed while another one loads
+    bufferCount = MAX(bufferCount, 2);
+
+    struct ReadAheadStream* stream = ARENA_PUSH_STRUCT(arena, struct ReadAheadStream);
+    if(stream) {
+        stream->buffers = ARENA_PUSH_ARRAY(arena, bufferCount, u8*);
+        stream->requests = ARENA_PUSH_ARRAY(arena, bufferCount, GroundedAsyncIoRequest);
+        stream->bytesRead = ARENA_PUSH_ARRAY(arena, bufferCount, u64);
+        stream->readFailed = ARENA_PUSH_ARRAY(arena, bufferCount, bool);
+    }
+    bool allocated = stream && stream->buffers && stream->requests && stream->bytesRead && stream->readFailed;
+    for(u32 i = 0; allocated && i < bufferCount; ++i) {
+        stream->buffers[i] = ARENA_PUSH_ARRAY_NO_CLEAR(arena, bufferSize, u8);
+        allocated = stream->buffers[i] != 0;
+    }
+    if(!allocated) {
+        GROUNDED_LOG_ERROR("Could not allocate buffers for read ahead stream");
+        refillZeros(&result);
+        return result;
+    }
+
+    if(!io) {
+        GroundedAsyncIoParameters parameters = {
+            .maxRequestCount = bufferCount,
+            .fallbackThreadCount = 1,
+        };
+        if(!groundedCreateAsyncIo(&stream->ownIo, &parameters)) {
+            refillZeros(&result);
+            return result;
+        }
+        io = &stream->ownIo;
+    }
+    stream->io = io;
+    stream->file = file;
+    stream->bufferCount = bufferCount;
+    stream->bufferSize = bufferSize;
+    stream->consumedBuffer = UINT32_MAX;
+
+    // Start loading every buffer right away
+    for(u32 i = 0; i < bufferCount; ++i) {
+        readAheadStartRead(stream, i);
+    }
+    groundedAsyncIoSubmit(io);
+
+    result.implementationPointer = stream;
+    result.error = GROUNDED_STREAM_SUCCESS;
+    result.refill = readAheadRefill;
+    result.close = readAheadClose;
+    result.refill(&result);
+    return result;
+}
+
+GROUNDED_FUNCTION BufferedStreamReader groundedFileGetReadAheadStreamReaderFromFilename(MemoryArena* arena, GroundedAsyncIo* io, String8 filename, u64 bufferSize, u32 bufferCount) {
+    GroundedFile file = groundedOpenFile(filename, FILE_MODE_READ);
+    GroundedFile* filePointer = ARENA_PUSH_COPY(arena, GroundedFile, &file);
+    BufferedStreamReader result = groundedFileGetReadAheadStreamReaderFromFile(arena, io, filePointer, bufferSize, bufferCount);
+    if(!result.implementationPointer) {
+        // The stream has not taken ownership of the file
+        groundedCloseFile(filePointer);
+    }
+    return result;
+}
+
+///////////////////////////
+// Write behind stream writer
+
+struct WriteBehindStream {
+    GroundedAsyncIo* io;
+    GroundedAsyncIo ownIo; // Used if no io was passed in
+    GroundedFile* file;
+    u8** buffers;
+    GroundedAsyncIoRequest* requests; // 0 if the buffer is not being written
+    u32 bufferCount;
+    u32 currentBuffer; // Buffer the application is filling
+    u64 bufferSize;
+    u64 nextOffset; // File offset of the next write
+    bool syncOnClose;
+};
+
+static void writeBehindSetError(BufferedStreamWriter* w) {
+    if(w->error == GROUNDED_STREAM_SUCCESS) {
+        w->error = GROUNDED_STREAM_IO_ERROR;
+    }
+}
+
+static void writeBehindWaitForBuffer(BufferedStreamWriter* w, u32 index) {
+    struct WriteBehindStream* stream = (struct WriteBehindStream*)w->implementationPointer;
+    if(stream->requests[index]) {
+        if(!groundedAsyncIoWait(stream->io, stream->requests[index], 0)) {
+            writeBehindSetError(w);
+        }
+        stream->requests[index] = 0;
+    }
+}
+
+static enum GroundedStreamErrorCode writeBehindSubmit(BufferedStreamWriter* w, u8* opl) {
+    struct WriteBehindStream* stream = (struct WriteBehindStream*)w->implementationPointer;
+    u32 index = stream->currentBuffer;
+    u64 size = opl - w->start;
+    if(size == 0) {
+        return w->error;
+    }
+
+    GroundedAsyncIoRequest request = 0;
+    if(stream->io->freeRequestCount) {
+        request = groundedAsyncIoWrite(stream->io, *stream->file, w->start, size, stream->nextOffset);
+    }
+    if(request) {
+        groundedAsyncIoSubmit(stream->io);
+        stream->requests[index] = request;
+    } else if(!groundedFileWriteAt(*stream->file, w->start, size, stream->nextOffset, 0)) {
+        // No request slot left so write synchronously
+        writeBehindSetError(w);
+    }
+    stream->nextOffset += size;
+
+    // Continue in the buffer that was handed off the longest time ago
+    index = (index + 1) % stream->bufferCount;
+    writeBehindWaitForBuffer(w, index);
+    stream->currentBuffer = index;
+    w->start = stream->buffers[index];
+    w->head = w->start;
+    w->end = w->start + stream->bufferSize;
+    return w->error;
+}
+
+static void writeBehindClose(BufferedStreamWriter* w) {
+    struct WriteBehindStream* stream = (struct WriteBehindStream*)w->implementationPointer;
+    if(w->head > w->start) {
+        writeBehindSubmit(w, w->head);
+    }
+    for(u32 i = 0; i < stream->bufferCount; ++i) {
+        writeBehindWaitForBuffer(w, i);
+    }
+    if(stream->syncOnClose && !groundedFileSync(*stream->file, false)) {
+        writeBehindSetError(w);
+    }
+    if(stream->io == &stream->ownIo) {
+        groundedDestroyAsyncIo(&stream->ownIo);
+    }
+    groundedCloseFile(stream->file);
+}
+
+GROUNDED_FUNCTION BufferedStreamWriter groundedFileGetWriteBehindStreamWriterFromFile(MemoryArena* arena, GroundedAsyncIo* io, GroundedFile* file, GroundedWriteBehindParameters* parameters) {
+    if(!parameters) {
+        static GroundedWriteBehindParameters defaultParameters = {0};
+        parameters = &defaultParameters;
+    }
+    BufferedStreamWriter result = {
+        .error = GROUNDED_STREAM_IO_ERROR,
+        .submit = submitScratch,
+    };
+    u64 bufferSize = parameters->bufferSize ? parameters->bufferSize : KB(64);
+    u32 bufferCount = MAX(parameters->bufferCount ? parameters->bufferCount : 4, 2);
+
+    struct WriteBehindStream* stream = ARENA_PUSH_STRUCT(arena, struct WriteBehindStream);
+    if(stream) {
+        stream->buffers = ARENA_PUSH_ARRAY(arena, bufferCount, u8*);
+        stream->requests = ARENA_PUSH_ARRAY(arena, bufferCount, GroundedAsyncIoRequest);
+    }
+    bool allocated = stream && stream->buffers && stream->requests;
+    for(u32 i = 0; allocated && i < bufferCount; ++i) {
+        stream->buffers[i] = ARENA_PUSH_ARRAY_NO_CLEAR(arena, bufferSize, u8);
+        allocated = stream->buffers[i] != 0;
+    }
+    if(!allocated) {
+        GROUNDED_LOG_ERROR("Could not allocate buffers for write behind stream");
+        submitScratch(&result, 0);
+        return result;
+    }
+
+    if(!io) {
+        GroundedAsyncIoParameters ioParameters = {
+            .maxRequestCount = bufferCount,
+            .fallbackThreadCount = 1,
+        };
+        if(!groundedCreateAsyncIo(&stream->ownIo, &ioParameters)) {
+            submitScratch(&result, 0);
+            return result;
+        }
+        io = &stream->ownIo;
+    }
+    stream->io = io;
+    stream->file = file;
+    stream->bufferCount = bufferCount;
+    stream->bufferSize = bufferSize;
+    stream->syncOnClose = parameters->syncOnClose;
+
+    result.start = stream->buffers[0];
+    result.head = result.start;
+    result.end = result.start + bufferSize;
+    result.implementationPointer = stream;
+    result.error = GROUNDED_STREAM_SUCCESS;
+    result.submit = writeBehindSubmit;
+    result.close = writeBehindClose;
+    return result;
+}
+
+GROUNDED_FUNCTION BufferedStreamWriter groundedFileGetWriteBehindStreamWriterFromFilename(MemoryArena* arena, GroundedAsyncIo* io, String8 filename, GroundedWriteBehindParameters* parameters) {
+    GroundedFile file = groundedOpenFile(filename, FILE_MODE_WRITE);
+    GroundedFile* filePointer = ARENA_PUSH_COPY(arena, GroundedFile, &file);
+    BufferedStreamWriter result = groundedFileGetWriteBehindStreamWriterFromFile(arena, io, filePointer, parameters);
+    if(!result.implementationPointer) {
+        // The stream has not taken ownership of the file
+        groundedCloseFile(filePointer);
+    }
+    return result;
+}
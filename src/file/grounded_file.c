@@ -2,4 +2,17 @@
 #include "grounded_win32_file.c"
 #else
 #include "grounded_linux_file.c"
-#endif
\ No newline at end of file
+#endif
+
+GROUNDED_FUNCTION u64 groundedFileGetStreamBufferSize(GroundedFile file) {
+    u64 fileSize = groundedFileGetSize(file);
+    if(!fileSize) {
+        // Size is unknown for pipes and similar
+        return KB(64);
+    }
+    u64 result = KB(4);
+    while(result < fileSize && result < MB(1)) {
+        result *= 2;
+    }
+    return result;
+}
@@ -10,8 +10,8 @@
 #include <stdlib.h> // getenv
 #include <pwd.h> // getpwuid
 #include <errno.h>
-
-//#include <liburing.h>
+#include <stdio.h> // snprintf
+#include <sys/syscall.h>
 
 GROUNDED_FUNCTION  u8* groundedReadFile(MemoryArena* arena, String8 filename, u64* size) {
     MemoryArena* scratch = threadContextGetScratch(arena);
@@ -229,13 +229,14 @@ GROUNDED_FUNCTION GroundedFile groundedOpenFile(String8 filename, enum FileMode
     MemoryArena* scratch = threadContextGetScratch(0);
     ArenaTempMemory temp = arenaBeginTemp(scratch);
 
-    int flags = O_CREAT;
+    // Reading must not create the file. This matches OPEN_EXISTING on win32
+    int flags = 0;
     if(fileMode == FILE_MODE_READ) {
         flags |= O_RDONLY;
     } else if(fileMode == FILE_MODE_READ_WRITE) {
-        flags |= O_RDWR;
+        flags |= O_RDWR | O_CREAT;
     } else if(fileMode == FILE_MODE_WRITE) {
-        flags |= O_WRONLY | O_TRUNC;
+        flags |= O_WRONLY | O_CREAT | O_TRUNC;
     }
 
     result.fd = openat(AT_FDCWD, str8GetCstr(scratch, filename), flags, 0664);
@@ -263,6 +264,65 @@ GROUNDED_FUNCTION u64 groundedFileWrite(GroundedFile file, u8* buffer, u64 size)
     return (u64) bytesWritten;
 }
 
+GROUNDED_FUNCTION bool groundedFileReadAt(GroundedFile file, u8* buffer, u64 size, u64 offset, u64* bytesRead) {
+    u64 total = 0;
+    bool result = true;
+    while(total < size) {
+        ssize_t count = pread(file.fd, buffer + total, size - total, (off_t)(offset + total));
+        if(count < 0) {
+            if(errno == EINTR) continue;
+            result = false;
+            break;
+        } else if(count == 0) {
+            // End of file
+            break;
+        }
+        total += count;
+    }
+    if(bytesRead) {
+        *bytesRead = total;
+    }
+    return result;
+}
+
+GROUNDED_FUNCTION bool groundedFileWriteAt(GroundedFile file, const u8* buffer, u64 size, u64 offset, u64* bytesWritten) {
+    u64 total = 0;
+    bool result = true;
+    while(total < size) {
+        ssize_t count = pwrite(file.fd, buffer + total, size - total, (off_t)(offset + total));
+        if(count < 0 && errno == EINTR) continue;
+        if(count <= 0) {
+            result = false;
+            break;
+        }
+        total += count;
+    }
+    if(bytesWritten) {
+        *bytesWritten = total;
+    }
+    return result;
+}
+
+GROUNDED_FUNCTION u64 groundedFileGetSize(GroundedFile file) {
+    struct stat fileStats;
+    if(fstat(file.fd, &fileStats) < 0) {
+        return 0;
+    }
+    return fileStats.st_size;
+}
+
+GROUNDED_FUNCTION bool groundedFileIsValid(GroundedFile file) {
+    return file.fd >= 0;
+}
+
+GROUNDED_FUNCTION bool groundedFileSync(GroundedFile file, bool dataOnly) {
+    int result = dataOnly ? fdatasync(file.fd) : fsync(file.fd);
+    if(result < 0) {
+        GROUNDED_LOG_ERROR("Could not sync file");
+    }
+    return result == 0;
+}
+
 static enum GroundedStreamErrorCode fileRefill(BufferedStreamReader* r) {
     struct GroundedFile* f = (struct GroundedFile*)r->implementationPointer;
     s64 bytesRead = read(f->fd, (void*)r->start, r->end - r->start);
@@ -290,9 +350,9 @@ static void groundedFileStreamReaderClose(BufferedStreamReader* reader) {
 }
 
 GROUNDED_FUNCTION BufferedStreamReader groundedFileGetStreamReaderFromFile(MemoryArena* arena, GroundedFile* file, u64 bufferSize) {
-    // Default buffer size of 4KB
+    // Default buffer size depends on the file size
     if(!bufferSize) {
-        bufferSize = KB(4);
+        bufferSize = groundedFileGetStreamBufferSize(*file);
     }
 
     u8* buffer = ARENA_PUSH_ARRAY(arena, bufferSize, u8);
@@ -325,11 +385,24 @@ GROUNDED_FUNCTION BufferedStreamReader groundedFileGetStreamReaderFromFilename(M
 static enum GroundedStreamErrorCode fileSubmit(BufferedStreamWriter* w, u8* opl) {
     enum GroundedStreamErrorCode result = GROUNDED_STREAM_SUCCESS;
     struct GroundedFile* f = (struct GroundedFile*)w->implementationPointer;
-    u64 size = opl - w->start;
-    s64 written = write(f->fd, w->start, size);
-    if(written < size) {
-        result = GROUNDED_STREAM_IO_ERROR;
+    const u8* cursor = w->start;
+    u64 sizeLeft = opl - w->start;
+    // write might transfer less than requested which is not an error
+    while(sizeLeft > 0) {
+        ssize_t written = write(f->fd, cursor, sizeLeft);
+        if(written < 0 && errno == EINTR) continue;
+        if(written <= 0) {
+            result = GROUNDED_STREAM_IO_ERROR;
+            if(w->error == GROUNDED_STREAM_SUCCESS) {
+                w->error = result;
+            }
+            break;
+        }
+        sizeLeft -= written;
+        cursor += written;
     }
+    // The whole buffer can be filled again
+    w->head = w->start;
     return result;
 }
 
@@ -371,6 +444,339 @@ GROUNDED_FUNCTION BufferedStreamWriter groundedFileGetStreamWriterFromFilename(M
     return result;
 }
 
+// Not exposed by glibc without _GNU_SOURCE. Value for all architectures except alpha, parisc and sparc
+#ifndef O_TMPFILE
+#define O_TMPFILE (020000000 | O_DIRECTORY)
+#endif
+#ifndef AT_EMPTY_PATH
+#define AT_EMPTY_PATH 0x1000
+#endif
+
+struct AtomicFile {
+    GroundedFile file; // Must be first as fileSubmit treats the implementation pointer as GroundedFile
+    int directoryFd;
+    const char* targetName; // Relative to directoryFd
+    const char* tempName;
+    u64 preallocatedSize;
+    bool anonymous; // Created with O_TMPFILE so there is no name to clean up
+};
+
+static bool atomicFileBegin(MemoryArena* arena, String8 filename, u64 preallocateSize, struct AtomicFile* f) {
+    static volatile u32 tempCounter = 0;
+    MEMORY_CLEAR_STRUCT(f);
+    f->file.fd = -1;
+
+    String8 directory = STR8_LITERAL(".");
+    String8 name = filename;
+    u64 slash = str8GetLastOccurence(filename, '/');
+    if(slash != UINT64_MAX) {
+        directory = slash ? str8Prefix(filename, slash) : STR8_LITERAL("/");
+        name = str8Skip(filename, slash + 1);
+    }
+    if(!name.size) {
+        GROUNDED_LOG_ERROR("Atomic write needs a filename");
+        return false;
+    }
+    f->targetName = str8GetCstr(arena, name);
+    u32 counter = groundedAtomicFetchAdd32(&tempCounter, 1, GROUNDED_MEMORY_ORDER_RELAXED);
+    f->tempName = (const char*)str8FromFormat(arena, ".%.*s.%d_%u.tmp", (int)name.size, (const char*)name.base, (int)getpid(), counter).base;
+
+    f->directoryFd = openat(AT_FDCWD, str8GetCstr(arena, directory), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(f->directoryFd < 0) {
+        GROUNDED_LOG_ERROR("Could not open directory for atomic write");
+        return false;
+    }
+
+    // An unnamed file never shows up in the directory and vanishes on its own if we crash before the commit.
+    // Not all filesystems support it so fall back to a hidden file with a unique name
+    // Readable so the contents can be copied if the file can not be linked into the directory
+    f->file.fd = openat(f->directoryFd, ".", O_TMPFILE | O_RDWR | O_CLOEXEC, 0664);
+    f->anonymous = f->file.fd >= 0;
+    if(!f->anonymous) {
+        f->file.fd = openat(f->directoryFd, f->tempName, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0664);
+    }
+    if(f->file.fd < 0) {
+        GROUNDED_LOG_ERROR("Could not create temporary file for atomic write");
+        close(f->directoryFd);
+        return false;
+    }
+
+    struct stat targetStat;
+    if(fstatat(f->directoryFd, f->targetName, &targetStat, 0) == 0) {
+        fchmod(f->file.fd, targetStat.st_mode & 07777);
+    }
+
+    // Reserving the space up front avoids fragmentation and reports a full disk before anything is written.
+    // Failure is not an error as not all filesystems support it
+    if(preallocateSize && syscall(SYS_fallocate, f->file.fd, 0, (off_t)0, (off_t)preallocateSize) == 0) {
+        f->preallocatedSize = preallocateSize;
+    }
+    return true;
+}
+
+static void atomicFileDiscard(struct AtomicFile* f) {
+    close(f->file.fd);
+    f->file.fd = -1;
+    if(!f->anonymous) {
+        unlinkat(f->directoryFd, f->tempName, 0);
+    }
+    close(f->directoryFd);
+}
+
+// Gives the unnamed file its temporary name. Returns false if the data could not be given any name
+static bool atomicFileLinkAnonymous(struct AtomicFile* f) {
+    // Linking the descriptor directly needs CAP_DAC_READ_SEARCH on older kernels so /proc is tried as well
+    if(linkat(f->file.fd, "", f->directoryFd, f->tempName, AT_EMPTY_PATH) == 0) {
+        return true;
+    }
+    char procPath[64];
+    snprintf(procPath, sizeof(procPath), "/proc/self/fd/%d", f->file.fd);
+    if(linkat(AT_FDCWD, procPath, f->directoryFd, f->tempName, AT_SYMLINK_FOLLOW) == 0) {
+        return true;
+    }
+
+    // Neither works (e.g. /proc is not mounted) so the data is copied into a named temporary file instead
+    GroundedFile named = {.fd = openat(f->directoryFd, f->tempName, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0664)};
+    if(named.fd < 0) {
+        return false;
+    }
+    struct stat anonymousStat;
+    if(fstat(f->file.fd, &anonymousStat) == 0) {
+        fchmod(named.fd, anonymousStat.st_mode & 07777);
+    }
+    u8 buffer[KB(16)];
+    u64 offset = 0;
+    bool success = true;
+    while(success) {
+        u64 bytesRead = 0;
+        success = groundedFileReadAt(f->file, buffer, sizeof(buffer), offset, &bytesRead);
+        if(!success || bytesRead == 0) {
+            break;
+        }
+        u64 bytesWritten = 0;
+        success = groundedFileWriteAt(named, buffer, bytesRead, offset, &bytesWritten) && bytesWritten == bytesRead;
+        offset += bytesRead;
+    }
+    if(!success || fdatasync(named.fd) != 0) {
+        close(named.fd);
+        unlinkat(f->directoryFd, f->tempName, 0);
+        return false;
+    }
+    close(f->file.fd);
+    f->file = named;
+    return true;
+}
+
+static bool atomicFileCommit(struct AtomicFile* f, u64 size) {
+    if(size < f->preallocatedSize && ftruncate(f->file.fd, (off_t)size) != 0) {
+        GROUNDED_LOG_ERROR("Could not trim preallocated space of atomic write");
+    } else if(fdatasync(f->file.fd) != 0) {
+        GROUNDED_LOG_ERROR("Could not sync atomic write");
+    } else {
+        // linkat can not replace an existing file so the unnamed file gets its temporary name first
+        bool named = !f->anonymous;
+        if(f->anonymous) {
+            named = atomicFileLinkAnonymous(f);
+            f->anonymous = !named;
+        }
+        if(!named) {
+            GROUNDED_LOG_ERROR("Could not link temporary file of atomic write");
+        } else if(renameat(f->directoryFd, f->tempName, f->directoryFd, f->targetName) != 0) {
+            GROUNDED_LOG_ERROR("Could not replace file with atomic write");
+        } else {
+            // The rename itself is only durable once the directory has been synced
+            if(fsync(f->directoryFd) != 0) {
+                GROUNDED_LOG_ERROR("Could not sync directory of atomic write");
+            }
+            close(f->file.fd);
+            f->file.fd = -1;
+            close(f->directoryFd);
+            return true;
+        }
+    }
+    atomicFileDiscard(f);
+    return false;
+}
+
+GROUNDED_FUNCTION bool groundedWriteFileAtomic(String8 filename, const void* data, u64 size) {
+    MemoryArena* scratch = threadContextGetScratch(0);
+    ArenaTempMemory temp = arenaBeginTemp(scratch);
+
+    struct AtomicFile f;
+    bool result = atomicFileBegin(scratch, filename, size, &f);
+    if(result) {
+        u64 bytesWritten = 0;
+        if(groundedFileWriteAt(f.file, data, size, 0, &bytesWritten) && bytesWritten == size) {
+            result = atomicFileCommit(&f, size);
+        } else {
+            GROUNDED_LOG_ERROR("Error while writing data to file");
+            atomicFileDiscard(&f);
+            result = false;
+        }
+    }
+
+    arenaEndTemp(temp);
+    return result;
+}
+
+static void atomicStreamWriterClose(BufferedStreamWriter* writer) {
+    struct AtomicFile* f = (struct AtomicFile*)writer->implementationPointer;
+    if(f->file.fd < 0) {
+        // Already closed
+        return;
+    }
+    off_t size = lseek(f->file.fd, 0, SEEK_CUR);
+    if(writer->error != GROUNDED_STREAM_SUCCESS) {
+        atomicFileDiscard(f);
+    } else if(size < 0) {
+        atomicFileDiscard(f);
+        writer->error = GROUNDED_STREAM_IO_ERROR;
+    } else if(!atomicFileCommit(f, (u64)size)) {
+        writer->error = GROUNDED_STREAM_IO_ERROR;
+    }
+}
+
+GROUNDED_FUNCTION BufferedStreamWriter groundedFileGetAtomicStreamWriter(MemoryArena* arena, String8 filename, u64 bufferSize, u64 expectedSize) {
+    // Default buffer size of 4KB
+    if(!bufferSize) {
+        bufferSize = KB(4);
+    }
+
+    struct AtomicFile* f = ARENA_PUSH_STRUCT(arena, struct AtomicFile);
+    u8* buffer = ARENA_PUSH_ARRAY_NO_CLEAR(arena, bufferSize, u8);
+    bool opened = false;
+    if(!f || !buffer) {
+        GROUNDED_LOG_ERROR("Could not allocate buffer for file");
+    } else {
+        opened = atomicFileBegin(arena, filename, expectedSize, f);
+    }
+    if(!opened) {
+        buffer = 0;
+        bufferSize = 0;
+    }
+
+    BufferedStreamWriter result = {
+        .start = buffer,
+        .head = buffer,
+        .end = buffer + bufferSize,
+        .implementationPointer = f,
+        .error = opened ? GROUNDED_STREAM_SUCCESS : GROUNDED_STREAM_IO_ERROR,
+        .submit = opened ? fileSubmit : submitScratch,
+        .close = opened ? atomicStreamWriterClose : 0,
+    };
+    return result;
+}
+
+struct MappedStream {
+    int fd;
+    u64 fileSize;
+    u64 windowSize;
+    u8* region; // Currently mapped part of the file
+    u64 regionOffset; // File offset of region
+    u64 regionSize;
+    u64 windowOffset; // Offset of the next window inside the region
+};
+
+static enum GroundedStreamErrorCode mappedStreamRefill(BufferedStreamReader* r) {
+    struct MappedStream* stream = (struct MappedStream*)r->implementationPointer;
+
+    if(stream->region && r->start < r->end) {
+        // The consumer is done with this window so the pages can be dropped
+        madvise((void*)r->start, r->end - r->start, MADV_DONTNEED);
+    }
+
+    if(stream->windowOffset >= stream->regionSize) {
+        if(stream->region) {
+            munmap(stream->region, stream->regionSize);
+            stream->region = 0;
+        }
+        stream->regionOffset += stream->regionSize;
+        stream->regionSize = 0;
+        stream->windowOffset = 0;
+        if(stream->regionOffset >= stream->fileSize) {
+            refillZeros(r);
+            r->refill = refillZeros;
+            r->error = GROUNDED_STREAM_PAST_EOF;
+            return r->error;
+        }
+
+        u64 regionSize = MIN(stream->fileSize - stream->regionOffset, GROUNDED_MAPPED_STREAM_MAX_REGION_SIZE);
+        void* region = mmap(0, regionSize, PROT_READ, MAP_PRIVATE, stream->fd, (off_t)stream->regionOffset);
+        if(region == MAP_FAILED) {
+            GROUNDED_LOG_ERROR("Could not map file to memory");
+            refillZeros(r);
+            r->refill = refillZeros;
+            r->error = GROUNDED_STREAM_IO_ERROR;
+            return r->error;
+        }
+        madvise(region, regionSize, MADV_SEQUENTIAL);
+        stream->region = region;
+        stream->regionSize = regionSize;
+    }
+
+    u64 windowSize = stream->windowSize ? stream->windowSize : stream->regionSize;
+    u64 size = MIN(windowSize, stream->regionSize - stream->windowOffset);
+    r->start = stream->region + stream->windowOffset;
+    r->cursor = r->start;
+    r->end = r->start + size;
+    stream->windowOffset += size;
+
+    // Start reading ahead the window after this one
+    u64 nextSize = MIN(windowSize, stream->regionSize - stream->windowOffset);
+    if(nextSize) {
+        madvise(stream->region + stream->windowOffset, nextSize, MADV_WILLNEED);
+    } else if(stream->regionOffset + stream->regionSize < stream->fileSize) {
+        posix_fadvise(stream->fd, (off_t)(stream->regionOffset + stream->regionSize), windowSize, POSIX_FADV_WILLNEED);
+    }
+    return GROUNDED_STREAM_SUCCESS;
+}
+
+static void mappedStreamClose(BufferedStreamReader* r) {
+    struct MappedStream* stream = (struct MappedStream*)r->implementationPointer;
+    if(stream->region) {
+        munmap(stream->region, stream->regionSize);
+    }
+    close(stream->fd);
+}
+
+GROUNDED_FUNCTION BufferedStreamReader groundedFileGetMappedStreamReader(MemoryArena* arena, String8 filename, u64 windowSize) {
+    BufferedStreamReader result = {
+        .error = GROUNDED_STREAM_IO_ERROR,
+        .refill = refillZeros,
+        .close = dummyBufferedStreamReaderClose,
+    };
+    refillZeros(&result);
+
+    MemoryArena* scratch = threadContextGetScratch(arena);
+    ArenaTempMemory temp = arenaBeginTemp(scratch);
+    int fd = openat(AT_FDCWD, str8GetCstr(scratch, filename), O_RDONLY | O_CLOEXEC);
+    arenaEndTemp(temp);
+    if(fd < 0) {
+        GROUNDED_LOG_ERROR("Error opening file");
+        return result;
+    }
+    struct stat fileStats;
+    struct MappedStream* stream = ARENA_PUSH_STRUCT(arena, struct MappedStream);
+    if(fstat(fd, &fileStats) < 0 || !stream) {
+        GROUNDED_LOG_ERROR("Could not get filestats");
+        close(fd);
+        return result;
+    }
+
+    stream->fd = fd;
+    stream->fileSize = fileStats.st_size;
+    // Windows must start on page boundaries so consumed ones can be dropped without touching the next one
+    u64 pageSize = sysconf(_SC_PAGESIZE);
+    stream->windowSize = ALIGN_UP_POW2(windowSize, pageSize);
+
+    result.implementationPointer = stream;
+    result.error = GROUNDED_STREAM_SUCCESS;
+    result.refill = mappedStreamRefill;
+    result.close = mappedStreamClose;
+    result.refill(&result);
+    return result;
+}
+
 GROUNDED_FUNCTION void groundedCloseFile(GroundedFile* file) {
     struct GroundedFile* f = (struct GroundedFile*)file;
     close(f->fd);
@@ -287,6 +287,72 @@ GROUNDED_FUNCTION GroundedFile groundedOpenFile(String8 filename, enum FileMode
     return result;
 }
 
+GROUNDED_FUNCTION bool groundedFileReadAt(GroundedFile file, u8* buffer, u64 size, u64 offset, u64* bytesRead) {
+    u64 total = 0;
+    bool result = true;
+    while(total < size) {
+        OVERLAPPED overlapped = {0};
+        overlapped.Offset = (DWORD)(offset + total);
+        overlapped.OffsetHigh = (DWORD)((offset + total) >> 32);
+        DWORD count = 0;
+        DWORD toRead = (DWORD)MIN(size - total, 0x80000000ull);
+        if(!ReadFile(file.handle, buffer + total, toRead, &count, &overlapped)) {
+            // Reading at the end of file is not an error
+            result = GetLastError() == ERROR_HANDLE_EOF;
+            break;
+        }
+        if(count == 0) break;
+        total += count;
+    }
+    if(bytesRead) {
+        *bytesRead = total;
+    }
+    return result;
+}
+
+GROUNDED_FUNCTION bool groundedFileWriteAt(GroundedFile file, const u8* buffer, u64 size, u64 offset, u64* bytesWritten) {
+    u64 total = 0;
+    bool result = true;
+    while(total < size) {
+        OVERLAPPED overlapped = {0};
+        overlapped.Offset = (DWORD)(offset + total);
+        overlapped.OffsetHigh = (DWORD)((offset + total) >> 32);
+        DWORD count = 0;
+        DWORD toWrite = (DWORD)MIN(size - total, 0x80000000ull);
+        if(!WriteFile(file.handle, buffer + total, toWrite, &count, &overlapped) || count == 0) {
+            result = false;
+            break;
+        }
+        total += count;
+    }
+    if(bytesWritten) {
+        *bytesWritten = total;
+    }
+    return result;
+}
+
+GROUNDED_FUNCTION u64 groundedFileGetSize(GroundedFile file) {
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(file.handle, &size)) {
+        return 0;
+    }
+    return size.QuadPart;
+}
+
+GROUNDED_FUNCTION bool groundedFileIsValid(GroundedFile file) {
+    return file.handle != INVALID_HANDLE_VALUE && file.handle != 0;
+}
+
+GROUNDED_FUNCTION bool groundedFileSync(GroundedFile file, bool dataOnly) {
+    // There is no cheaper variant that skips metadata
+    (void)dataOnly;
+    if(!FlushFileBuffers(file.handle)) {
+        GROUNDED_LOG_ERROR("Could not sync file");
+        return false;
+    }
+    return true;
+}
+
 static enum GroundedStreamErrorCode fileRefill(BufferedStreamReader* r) {
     struct GroundedFile* f = (struct GroundedFile*)r->implementationPointer;
     DWORD bytesRead = 0;
@@ -321,9 +387,9 @@ static void groundedFileStreamReaderClose(BufferedStreamReader* reader) {
 }
 
 GROUNDED_FUNCTION BufferedStreamReader groundedFileGetStreamReaderFromFile(MemoryArena* arena, GroundedFile* file, u64 bufferSize) {
-    // Default buffer size of 4KB
+    // Default buffer size depends on the file size
     if(!bufferSize) {
-        bufferSize = KB(4);
+        bufferSize = groundedFileGetStreamBufferSize(*file);
     }
 
     //TODO: Buffer deallocation missing
@@ -354,11 +420,26 @@ GROUNDED_FUNCTION BufferedStreamReader groundedFileGetStreamReaderFromFilename(M
 }
 
 static enum GroundedStreamErrorCode fileSubmit(BufferedStreamWriter* w, u8* opl) {
+    enum GroundedStreamErrorCode result = GROUNDED_STREAM_SUCCESS;
     struct GroundedFile* f = (struct GroundedFile*)w->implementationPointer;
-    u64 size = opl - w->start;
-	//TODO: Handle sizes larger than DWORD
-    WriteFile(f->handle, w->start, (DWORD)size, 0, 0);
-    return NO_ERROR;
+    const u8* cursor = w->start;
+    u64 sizeLeft = opl - w->start;
+    while(sizeLeft > 0) {
+        DWORD written = 0;
+        DWORD toWrite = (DWORD)MIN(sizeLeft, 0x80000000ull);
+        if(!WriteFile(f->handle, cursor, toWrite, &written, 0) || written == 0) {
+            result = GROUNDED_STREAM_IO_ERROR;
+            if(w->error == GROUNDED_STREAM_SUCCESS) {
+                w->error = result;
+            }
+            break;
+        }
+        sizeLeft -= written;
+        cursor += written;
+    }
+    // The whole buffer can be filled again
+    w->head = w->start;
+    return result;
 }
 
 GROUNDED_FUNCTION BufferedStreamWriter groundedFileGetStreamWriterFromFile(MemoryArena* arena, GroundedFile* file, u64 bufferSize) {
@@ -392,6 +473,224 @@ GROUNDED_FUNCTION BufferedStreamWriter groundedFileGetStreamWriterFromFilename(M
     return result;
 }
 
+struct AtomicFile {
+    GroundedFile file; // Must be first as fileSubmit treats the implementation pointer as GroundedFile
+    String16 targetName;
+    String16 tempName;
+};
+
+static bool atomicFileBegin(MemoryArena* arena, String8 filename, u64 preallocateSize, struct AtomicFile* f) {
+    static volatile u32 tempCounter = 0;
+    MEMORY_CLEAR_STRUCT(f);
+    f->file.handle = INVALID_HANDLE_VALUE;
+
+    u32 counter = groundedAtomicFetchAdd32(&tempCounter, 1, GROUNDED_MEMORY_ORDER_RELAXED);
+    String8 tempName = str8FromFormat(arena, "%.*s.%u_%u.tmp", (int)filename.size, (const char*)filename.base, (u32)GetCurrentProcessId(), counter);
+    f->targetName = str16FromStr8(arena, filename);
+    f->tempName = str16FromStr8(arena, tempName);
+
+    // Same directory as the target so the final move is a rename and not a copy
+    f->file.handle = CreateFileW(f->tempName.base, GENERIC_WRITE, 0, 0, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, 0);
+    if(f->file.handle == INVALID_HANDLE_VALUE) {
+        GROUNDED_LOG_ERROR("Could not create temporary file for atomic write");
+        return false;
+    }
+
+    // Reserves disk space without changing the end of file. Failure is not an error
+    if(preallocateSize) {
+        FILE_ALLOCATION_INFO allocationInfo = {0};
+        allocationInfo.AllocationSize.QuadPart = (LONGLONG)preallocateSize;
+        SetFileInformationByHandle(f->file.handle, FileAllocationInfo, &allocationInfo, sizeof(allocationInfo));
+    }
+    return true;
+}
+
+static void atomicFileDiscard(struct AtomicFile* f) {
+    CloseHandle(f->file.handle);
+    f->file.handle = INVALID_HANDLE_VALUE;
+    DeleteFileW(f->tempName.base);
+}
+
+static bool atomicFileCommit(struct AtomicFile* f) {
+    if(!FlushFileBuffers(f->file.handle)) {
+        GROUNDED_LOG_ERROR("Could not sync atomic write");
+        atomicFileDiscard(f);
+        return false;
+    }
+    CloseHandle(f->file.handle);
+    f->file.handle = INVALID_HANDLE_VALUE;
+    // Write through only returns once the rename has been flushed to disk
+    if(!MoveFileExW(f->tempName.base, f->targetName.base, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        GROUNDED_LOG_ERROR("Could not replace file with atomic write");
+        DeleteFileW(f->tempName.base);
+        return false;
+    }
+    return true;
+}
+
+GROUNDED_FUNCTION bool groundedWriteFileAtomic(String8 filename, const void* data, u64 size) {
+    MemoryArena* scratch = threadContextGetScratch(0);
+    ArenaTempMemory temp = arenaBeginTemp(scratch);
+
+    struct AtomicFile f;
+    bool result = atomicFileBegin(scratch, filename, size, &f);
+    if(result) {
+        u64 bytesWritten = 0;
+        if(groundedFileWriteAt(f.file, data, size, 0, &bytesWritten) && bytesWritten == size) {
+            result = atomicFileCommit(&f);
+        } else {
+            GROUNDED_LOG_ERROR("Error while writing data to file");
+            atomicFileDiscard(&f);
+            result = false;
+        }
+    }
+
+    arenaEndTemp(temp);
+    return result;
+}
+
+static void atomicStreamWriterClose(BufferedStreamWriter* writer) {
+    struct AtomicFile* f = (struct AtomicFile*)writer->implementationPointer;
+    if(f->file.handle == INVALID_HANDLE_VALUE) {
+        // Already closed
+        return;
+    }
+    if(writer->error != GROUNDED_STREAM_SUCCESS) {
+        atomicFileDiscard(f);
+    } else if(!atomicFileCommit(f)) {
+        writer->error = GROUNDED_STREAM_IO_ERROR;
+    }
+}
+
+GROUNDED_FUNCTION BufferedStreamWriter groundedFileGetAtomicStreamWriter(MemoryArena* arena, String8 filename, u64 bufferSize, u64 expectedSize) {
+    // Default buffer size of 4KB
+    if(!bufferSize) {
+        bufferSize = KB(4);
+    }
+
+    struct AtomicFile* f = ARENA_PUSH_STRUCT(arena, struct AtomicFile);
+    u8* buffer = ARENA_PUSH_ARRAY_NO_CLEAR(arena, bufferSize, u8);
+    bool opened = false;
+    if(!f || !buffer) {
+        GROUNDED_LOG_ERROR("Could not allocate buffer for file");
+    } else {
+        opened = atomicFileBegin(arena, filename, expectedSize, f);
+    }
+    if(!opened) {
+        buffer = 0;
+        bufferSize = 0;
+    }
+
+    BufferedStreamWriter result = {
+        .start = buffer,
+        .head = buffer,
+        .end = buffer + bufferSize,
+        .implementationPointer = f,
+        .error = opened ? GROUNDED_STREAM_SUCCESS : GROUNDED_STREAM_IO_ERROR,
+        .submit = opened ? fileSubmit : submitScratch,
+        .close = opened ? atomicStreamWriterClose : 0,
+    };
+    return result;
+}
+
+struct MappedStream {
+    HANDLE file;
+    HANDLE mapping;
+    u64 fileSize;
+    u64 windowSize;
+    u8* region; // Currently mapped part of the file
+    u64 regionOffset; // File offset of region
+    u64 regionSize;
+    u64 windowOffset; // Offset of the next window inside the region
+};
+
+static enum GroundedStreamErrorCode mappedStreamRefill(BufferedStreamReader* r) {
+    struct MappedStream* stream = (struct MappedStream*)r->implementationPointer;
+
+    if(stream->windowOffset >= stream->regionSize) {
+        if(stream->region) {
+            UnmapViewOfFile(stream->region);
+            stream->region = 0;
+        }
+        stream->regionOffset += stream->regionSize;
+        stream->regionSize = 0;
+        stream->windowOffset = 0;
+        if(stream->regionOffset >= stream->fileSize) {
+            refillZeros(r);
+            r->refill = refillZeros;
+            r->error = GROUNDED_STREAM_PAST_EOF;
+            return r->error;
+        }
+
+        u64 regionSize = MIN(stream->fileSize - stream->regionOffset, GROUNDED_MAPPED_STREAM_MAX_REGION_SIZE);
+        stream->region = MapViewOfFile(stream->mapping, FILE_MAP_READ, (DWORD)(stream->regionOffset >> 32), (DWORD)stream->regionOffset, regionSize);
+        if(!stream->region) {
+            GROUNDED_LOG_ERROR("Could not map file to memory");
+            refillZeros(r);
+            r->refill = refillZeros;
+            r->error = GROUNDED_STREAM_IO_ERROR;
+            return r->error;
+        }
+        stream->regionSize = regionSize;
+    }
+
+    u64 windowSize = stream->windowSize ? stream->windowSize : stream->regionSize;
+    u64 size = MIN(windowSize, stream->regionSize - stream->windowOffset);
+    r->start = stream->region + stream->windowOffset;
+    r->cursor = r->start;
+    r->end = r->start + size;
+    stream->windowOffset += size;
+    return GROUNDED_STREAM_SUCCESS;
+}
+
+static void mappedStreamClose(BufferedStreamReader* r) {
+    struct MappedStream* stream = (struct MappedStream*)r->implementationPointer;
+    if(stream->region) {
+        UnmapViewOfFile(stream->region);
+    }
+    if(stream->mapping) {
+        CloseHandle(stream->mapping);
+    }
+    CloseHandle(stream->file);
+}
+
+GROUNDED_FUNCTION BufferedStreamReader groundedFileGetMappedStreamReader(MemoryArena* arena, String8 filename, u64 windowSize) {
+    BufferedStreamReader result = {
+        .error = GROUNDED_STREAM_IO_ERROR,
+        .refill = refillZeros,
+        .close = dummyBufferedStreamReaderClose,
+    };
+    refillZeros(&result);
+
+    GroundedFile file = groundedOpenFile(filename, FILE_MODE_READ);
+    if(!groundedFileIsValid(file)) {
+        return result;
+    }
+    u64 fileSize = groundedFileGetSize(file);
+    struct MappedStream* stream = ARENA_PUSH_STRUCT(arena, struct MappedStream);
+    // Mapping an empty file fails so it is simply handled as end of file
+    HANDLE mapping = fileSize ? CreateFileMappingW(file.handle, 0, PAGE_READONLY, 0, 0, 0) : 0;
+    if(!stream || (fileSize && !mapping)) {
+        GROUNDED_LOG_ERROR("Could not create file mapping");
+        if(mapping) CloseHandle(mapping);
+        CloseHandle(file.handle);
+        return result;
+    }
+
+    // Only regions are separate views. Their size is a multiple of the allocation granularity so they start at valid offsets
+    stream->file = file.handle;
+    stream->mapping = mapping;
+    stream->fileSize = fileSize;
+    stream->windowSize = windowSize;
+
+    result.implementationPointer = stream;
+    result.error = GROUNDED_STREAM_SUCCESS;
+    result.refill = mappedStreamRefill;
+    result.close = mappedStreamClose;
+    result.refill(&result);
+    return result;
+}
+
 GROUNDED_FUNCTION void groundedCloseFile(GroundedFile* file) {
     struct GroundedFile* f = (struct GroundedFile*)file;
     CloseHandle(f->handle);
@@ -1,8 +1,11 @@
 #include <grounded/memory/grounded_arena.h>
+#include <grounded/memory/grounded_concurrent_arena.h>
 #include <grounded/memory/grounded_memory.h>
 #include <grounded/logger/grounded_logger.h>
+#include <grounded/string/grounded_string.h>
 
 #include <inttypes.h>
+#include <stdlib.h> // For qsort
 
 GROUNDED_FUNCTION void* fixedSizeArenaGrow(MemoryArena* arena, u64* size, u64 alignment) {
     ASSERT(false);
@@ -22,6 +25,7 @@ GROUNDED_FUNCTION MemoryArena createFixedSizeArena(MemorySubsystem* memorySubsys
     MemoryArena result = {0};
     result.memory = (u8*)memorySubsystem->reserve(memorySubsystem->context, size);
     result.commitPos = size;
+    result.committedSize = size;
     result.grow = (ArenaGrowFunc*)&fixedSizeArenaGrow;
     result.shrink = (ArenaShrinkFunc*)&fixedSizeArenaShrink;
     result.additionalPointer = memorySubsystem;
@@ -36,16 +40,52 @@ typedef struct MemoryBlockFooter {
     u64 prevBlockPos;
 } MemoryBlockFooter;
 
+// Lives behind the footer of the first block
+typedef struct GrowingArenaState {
+    MemorySubsystem* memorySubsystem;
+    u64 minBlockSize;
+    u32 maxSpareBlockCount;
+    u32 spareBlockCount;
+    // Spare blocks are chained through their footers like the blocks of the arena
+    u8* spareBlockMemory;
+    u64 spareBlockCommitPos;
+    u64 spareSize;
+} GrowingArenaState;
+
 GROUNDED_FUNCTION void* growingArenaGrow(MemoryArena* arena, u64* size, u64 alignment) {
-    MemorySubsystem* memorySubsystem = osGetMemorySubsystem();
-    alignment = MAX(ALIGNMENT_OF(MemoryBlockFooter), alignment);
-    u64 blockSize = ALIGN_UP_POW2(MAX(*size, arena->additionalInteger), alignment) + sizeof(MemoryBlockFooter);
-    // Align up to memory pages
-    blockSize  = ALIGN_UP_POW2(blockSize, 4096);
+    GrowingArenaState* state = (GrowingArenaState*) arena->additionalPointer;
+    u8* result = 0;
+
+    // Spare blocks start at a page boundary so they satisfy every alignment
+    u8** link = &state->spareBlockMemory;
+    u64* linkCommitPos = &state->spareBlockCommitPos;
+    while(*link) {
+        MemoryBlockFooter* spareFooter = (MemoryBlockFooter*) (*link + *linkCommitPos);
+        if(*linkCommitPos >= *size) {
+            result = *link;
+            *size = *linkCommitPos;
+            *link = spareFooter->prevBlockMemory;
+            *linkCommitPos = spareFooter->prevBlockCommitPos;
+            state->spareBlockCount--;
+            state->spareSize -= *size + sizeof(MemoryBlockFooter);
+            break;
+        }
+        link = &spareFooter->prevBlockMemory;
+        linkCommitPos = &spareFooter->prevBlockCommitPos;
+    }
 
-    u8* result = (u8*)memorySubsystem->reserve(memorySubsystem->context, blockSize);
-    if(!result) return 0;
-    *size = blockSize - sizeof(MemoryBlockFooter);
+    if(!result) {
+        MemorySubsystem* memorySubsystem = state->memorySubsystem;
+        alignment = MAX(ALIGNMENT_OF(MemoryBlockFooter), alignment);
+        u64 blockSize = ALIGN_UP_POW2(MAX(*size, state->minBlockSize), alignment) + sizeof(MemoryBlockFooter);
+        // Align up to memory pages
+        blockSize  = ALIGN_UP_POW2(blockSize, 4096);
+
+        result = (u8*)memorySubsystem->reserve(memorySubsystem->context, blockSize);
+        if(!result) return 0;
+        *size = blockSize - sizeof(MemoryBlockFooter);
+        arena->committedSize += blockSize;
+    }
 
     MemoryBlockFooter* footer = (MemoryBlockFooter*) (result + *size);
     footer->prevBlockMemory = arena->memory;
@@ -56,12 +96,14 @@ GROUNDED_FUNCTION void* growingArenaGrow(MemoryArena* arena, u64* size, u64 alig
 }
 
 GROUNDED_FUNCTION void growingArenaShrink(MemoryArena* arena, u8* newHead) {
-    MemorySubsystem* memorySubsystem = osGetMemorySubsystem();
+    GrowingArenaState* state = (GrowingArenaState*) arena->additionalPointer;
+    MemorySubsystem* memorySubsystem = state->memorySubsystem;
     MemoryBlockFooter* footer = (MemoryBlockFooter*) (arena->memory + arena->commitPos);
     if(!newHead) {
-        // Completely release the arena
-        u8* memory = arena->memory;
-        u64 commitPos = arena->commitPos;
+        // Completely release the arena. The state lives in the first block so it must be released last
+        GrowingArenaState stateCopy = *state;
+        u8* memory = stateCopy.spareBlockMemory;
+        u64 commitPos = stateCopy.spareBlockCommitPos;
         while(memory) {
             footer = (MemoryBlockFooter*) (memory + commitPos);
             u8* prevMemory = footer->prevBlockMemory;
@@ -70,6 +112,22 @@ GROUNDED_FUNCTION void growingArenaShrink(MemoryArena* arena, u8* newHead) {
             memory = prevMemory;
             commitPos = prevCommitPos;
         }
+        memory = arena->memory;
+        commitPos = arena->commitPos;
+        while(memory) {
+            footer = (MemoryBlockFooter*) (memory + commitPos);
+            u8* prevMemory = footer->prevBlockMemory;
+            u64 prevCommitPos = footer->prevBlockCommitPos;
+            u64 releaseSize = commitPos + sizeof(MemoryBlockFooter);
+            if(!prevMemory) {
+                releaseSize += sizeof(GrowingArenaState);
+            }
+            memorySubsystem->release(memorySubsystem->context, memory, releaseSize);
+            memory = prevMemory;
+            commitPos = prevCommitPos;
+        }
+        arena->committedSize = 0;
+        arena->usedSizeBeforeBlock = 0;
     } else {
         u8* memory = arena->memory;
         u64 commitPos = arena->commitPos;
@@ -78,11 +136,22 @@ GROUNDED_FUNCTION void growingArenaShrink(MemoryArena* arena, u8* newHead) {
         ASSERT(newHead < memory || newHead > memory + commitPos);
 
         while(newHead < memory || newHead > memory + commitPos) {
-            // We have to release a block
+            // We have to give back a block
             footer = (MemoryBlockFooter*) (memory + commitPos);
             arena->memory = footer->prevBlockMemory;
             arena->commitPos = footer->prevBlockCommitPos;
-            memorySubsystem->release(memorySubsystem->context, memory, commitPos+sizeof(MemoryBlockFooter));
+            arena->usedSizeBeforeBlock -= footer->prevBlockPos;
+            if(state->spareBlockCount < state->maxSpareBlockCount) {
+                footer->prevBlockMemory = state->spareBlockMemory;
+                footer->prevBlockCommitPos = state->spareBlockCommitPos;
+                state->spareBlockMemory = memory;
+                state->spareBlockCommitPos = commitPos;
+                state->spareBlockCount++;
+                state->spareSize += commitPos + sizeof(MemoryBlockFooter);
+            } else {
+                memorySubsystem->release(memorySubsystem->context, memory, commitPos+sizeof(MemoryBlockFooter));
+                arena->committedSize -= commitPos + sizeof(MemoryBlockFooter);
+            }
             arena->pos = newHead - arena->memory;
             memory = arena->memory;
             commitPos = arena->commitPos;
@@ -90,6 +159,33 @@ GROUNDED_FUNCTION void growingArenaShrink(MemoryArena* arena, u8* newHead) {
     }
 }
 
+GROUNDED_FUNCTION void growingArenaTrim(MemoryArena* arena, u64 keepSize) {
+    GrowingArenaState* state = (GrowingArenaState*) arena->additionalPointer;
+    MemorySubsystem* memorySubsystem = state->memorySubsystem;
+    u64 keptSize = arena->committedSize - state->spareSize;
+    u8** link = &state->spareBlockMemory;
+    u64* linkCommitPos = &state->spareBlockCommitPos;
+    while(*link) {
+        u8* memory = *link;
+        u64 commitPos = *linkCommitPos;
+        MemoryBlockFooter* footer = (MemoryBlockFooter*) (memory + commitPos);
+        u64 blockSize = commitPos + sizeof(MemoryBlockFooter);
+        if(keptSize < keepSize) {
+            // Still needed to reach keepSize
+            keptSize += blockSize;
+            link = &footer->prevBlockMemory;
+            linkCommitPos = &footer->prevBlockCommitPos;
+        } else {
+            *link = footer->prevBlockMemory;
+            *linkCommitPos = footer->prevBlockCommitPos;
+            memorySubsystem->release(memorySubsystem->context, memory, blockSize);
+            arena->committedSize -= blockSize;
+            state->spareSize -= blockSize;
+            state->spareBlockCount--;
+        }
+    }
+}
+
 //TODO: Make this multithreading safe
 typedef struct DebugAllocationLogEntry {
     String8 filename;
@@ -225,6 +321,8 @@ GROUNDED_FUNCTION void* debugAllocateOverflowDetect(MemoryArena* arena, u64 size
     u8* newBlock = result + dataStart;
 
     // This is always a new block
+    arena->usedSizeBeforeBlock += arena->pos;
+    arena->committedSize += newSize + sizeof(MemoryBlockOverflowDetectHeader);
     arena->memory = newBlock;
     arena->pos = 0;
     arena->commitPos = newSize;
@@ -262,6 +360,8 @@ GROUNDED_FUNCTION void debugDeallocateOverflowDetect(MemoryArena* arena, u8* new
                 // We have to release a block
                 arena->memory = header->prevBlockMemory;
                 arena->commitPos = header->prevBlockCommitPos;
+                arena->usedSizeBeforeBlock -= header->prevBlockPos;
+                arena->committedSize -= commitPos + sizeof(MemoryBlockOverflowDetectHeader);
                 header = header->prevHeader;
                 osFreeGuardedMemory(memory-sizeof(MemoryBlockOverflowDetectHeader), commitPos+sizeof(MemoryBlockOverflowDetectHeader), true);
                 arena->pos = newHead - arena->memory;
@@ -297,6 +397,8 @@ GROUNDED_FUNCTION void* debugAllocateUndeflowDetect(MemoryArena* arena, u64 size
     footer->prevBlockPos = arena->pos;
 
     // This is always a new block
+    arena->usedSizeBeforeBlock += arena->pos;
+    arena->committedSize += usableSize + sizeof(MemoryBlockFooter);
     arena->memory = result;
     arena->commitPos = usableSize;
     arena->pos = size;
@@ -333,6 +435,8 @@ GROUNDED_FUNCTION void debugDeallocateUnderflowDetect(MemoryArena* arena, u8* ne
             footer = (MemoryBlockFooter*) (memory + commitPos);
             arena->memory = footer->prevBlockMemory;
             arena->commitPos = footer->prevBlockCommitPos;
+            arena->usedSizeBeforeBlock -= footer->prevBlockPos;
+            arena->committedSize -= commitPos + sizeof(MemoryBlockFooter);
             osFreeGuardedMemory(memory, commitPos, false);
             arena->pos = newHead - arena->memory;
             ASSERT(arena->memory);
@@ -351,27 +455,423 @@ GROUNDED_FUNCTION void enableDebugMemoryUnderflowDetectForArena(MemoryArena* are
     ASSERT(!arena->debugData);
     arena->debugData = &underflowDetectDebugFunctionTable;
 }
+// Arena profiling.
+// Call sites are identified by the filename pointer and line. Entries are inserted under a spin lock and looked up without locking.
+// Every profiled arena keeps a stack of its live allocations in a separate arena so pops can be attributed to call sites.
+// The stack is not synchronized so like any other arena a profiled arena must only be used by one thread at a time
+#define ARENA_PROFILE_MAX_SITES 4096
+
+typedef struct ArenaProfileSiteEntry {
+    volatile u64 key; // 0 for unused entries. Published after filename and line are written
+    String8 filename;
+    u64 line;
+    volatile u64 allocationCount;
+    volatile u64 allocatedSize;
+    volatile u64 liveCount;
+    volatile u64 liveSize;
+    volatile u64 peakLiveSize;
+} ArenaProfileSiteEntry;
+
+typedef struct ArenaProfileRecord {
+    struct ArenaProfileRecord* prev;
+    u8* base;
+    u64 size;
+    ArenaProfileSiteEntry* site;
+} ArenaProfileRecord;
+
+typedef struct ArenaProfileState {
+    struct MemoryArenaDebugData debugData;
+    MemoryArena recordArena;
+    ArenaMarker recordStart;
+    ArenaProfileRecord* top;
+} ArenaProfileState;
+
+static ArenaProfileSiteEntry arenaProfileSites[ARENA_PROFILE_MAX_SITES];
+// Collects all allocations once the table is full
+static ArenaProfileSiteEntry arenaProfileOverflowSite = {.key = 1, .filename = {(u8*)"<other call sites>", sizeof("<other call sites>") - 1}};
+static volatile u32 arenaProfileInsertLock;
+
+static u64 arenaProfileSiteKey(String8 filename, u64 line) {
+    u64 result = (INT_FROM_PTR(filename.base) ^ (line << 40) ^ line) * 0x9E3779B97F4A7C15ull;
+    return result ? result : 1;
+}
+
+static ArenaProfileSiteEntry* arenaProfileFindSite(String8 filename, u64 line) {
+    u64 key = arenaProfileSiteKey(filename, line);
+    u32 index = (u32)(key >> 52) & (ARENA_PROFILE_MAX_SITES - 1);
+    bool locked = false;
+    for(u32 i = 0; i < ARENA_PROFILE_MAX_SITES; ++i) {
+        ArenaProfileSiteEntry* entry = &arenaProfileSites[(index + i) & (ARENA_PROFILE_MAX_SITES - 1)];
+        u64 entryKey = groundedAtomicLoad64(&entry->key, GROUNDED_MEMORY_ORDER_ACQUIRE);
+        if(entryKey == key && entry->filename.base == filename.base && entry->line == line) {
+            if(locked) groundedAtomicStore32(&arenaProfileInsertLock, 0, GROUNDED_MEMORY_ORDER_RELEASE);
+            return entry;
+        }
+        if(entryKey == 0) {
+            if(!locked) {
+                // Insert under the lock. Another thread might have inserted the site in the meantime so probe again
+                while(groundedAtomicExchange32(&arenaProfileInsertLock, 1, GROUNDED_MEMORY_ORDER_ACQUIRE)) {
+                    groundedPause();
+                }
+                locked = true;
+                i--;
+                continue;
+            }
+            entry->filename = filename;
+            entry->line = line;
+            groundedAtomicStore64(&entry->key, key, GROUNDED_MEMORY_ORDER_RELEASE);
+            groundedAtomicStore32(&arenaProfileInsertLock, 0, GROUNDED_MEMORY_ORDER_RELEASE);
+            return entry;
+        }
+    }
+    if(locked) groundedAtomicStore32(&arenaProfileInsertLock, 0, GROUNDED_MEMORY_ORDER_RELEASE);
+    return &arenaProfileOverflowSite;
+}
+
+static void arenaProfileFreeRecord(ArenaProfileRecord* record, u64 size) {
+    groundedAtomicFetchSub64(&record->site->liveSize, size, GROUNDED_MEMORY_ORDER_RELAXED);
+    if(size == record->size) {
+        groundedAtomicFetchSub64(&record->site->liveCount, 1, GROUNDED_MEMORY_ORDER_RELAXED);
+    }
+}
+
+GROUNDED_FUNCTION void* debugAllocateProfile(MemoryArena* arena, u64 size, u64 alignment, bool clear, u64 line, String8 filename) {
+    ArenaProfileState* state = (ArenaProfileState*) arena->debugData->data;
+    u8* result = (u8*)_arenaPushSizeImpl(arena, size, alignment, clear);
+    if(result) {
+        ArenaProfileSiteEntry* site = arenaProfileFindSite(filename, line);
+        ArenaProfileRecord* record = ARENA_PUSH_STRUCT_NO_CLEAR(&state->recordArena, ArenaProfileRecord);
+        record->prev = state->top;
+        record->base = result;
+        record->size = size;
+        record->site = site;
+        state->top = record;
+
+        groundedAtomicFetchAdd64(&site->allocationCount, 1, GROUNDED_MEMORY_ORDER_RELAXED);
+        groundedAtomicFetchAdd64(&site->allocatedSize, size, GROUNDED_MEMORY_ORDER_RELAXED);
+        groundedAtomicFetchAdd64(&site->liveCount, 1, GROUNDED_MEMORY_ORDER_RELAXED);
+        u64 liveSize = groundedAtomicFetchAdd64(&site->liveSize, size, GROUNDED_MEMORY_ORDER_RELAXED) + size;
+        u64 peakLiveSize = groundedAtomicLoad64(&site->peakLiveSize, GROUNDED_MEMORY_ORDER_RELAXED);
+        while(liveSize > peakLiveSize && !groundedAtomicCompareExchange64(&site->peakLiveSize, &peakLiveSize, liveSize, GROUNDED_MEMORY_ORDER_RELAXED)) {}
+    }
+    return result;
+}
+
+GROUNDED_FUNCTION void debugDeallocateProfile(MemoryArena* arena, u8* newHead) {
+    ArenaProfileState* state = (ArenaProfileState*) arena->debugData->data;
+
+    // Same attribution rules as the logging mode
+    while(state->top) {
+        ArenaProfileRecord* record = state->top;
+        if(newHead == record->base) {
+            arenaProfileFreeRecord(record, record->size);
+            state->top = record->prev;
+            break;
+        } else if(newHead > record->base && newHead <= record->base + record->size) {
+            // Head is inside this allocation which effectively shrinks it
+            u64 newSize = newHead - record->base;
+            if(newSize != record->size) {
+                arenaProfileFreeRecord(record, record->size - newSize);
+                record->size = newSize;
+            }
+            break;
+        } else {
+            arenaProfileFreeRecord(record, record->size);
+            state->top = record->prev;
+        }
+    }
+    if(state->top) {
+        arenaPopTo(&state->recordArena, (u8*)(state->top + 1));
+    } else {
+        arenaResetToMarker(state->recordStart);
+    }
+
+    _arenaPopTo(arena, newHead);
+}
+
+GROUNDED_FUNCTION void debugReleaseProfile(MemoryArena* arena) {
+    ArenaProfileState* state = (ArenaProfileState*) arena->debugData->data;
+    for(ArenaProfileRecord* record = state->top; record; record = record->prev) {
+        arenaProfileFreeRecord(record, record->size);
+    }
+    arena->debugData = 0;
+    arenaRelease(arena);
+    // The state lives in its own record arena
+    MemoryArena recordArena = state->recordArena;
+    arenaRelease(&recordArena);
+}
+
+GROUNDED_FUNCTION void enableDebugMemoryProfilingForArena(MemoryArena* arena) {
+    ASSERT(!arena->debugData);
+    ArenaProfileState* state = ARENA_BOOTSTRAP_PUSH_STRUCT(createGrowingArena(osGetMemorySubsystem(), KB(64)), ArenaProfileState, recordArena);
+    state->recordStart = arenaCreateMarker(&state->recordArena);
+    state->debugData.debugAllocate = debugAllocateProfile;
+    state->debugData.debugDeallocate = debugDeallocateProfile;
+    state->debugData.debugRelease = debugReleaseProfile;
+    state->debugData.data = state;
+    arena->debugData = &state->debugData;
+}
+
+// qsort has no context parameter so there is one comparator per sort key. All of them sort in descending order
+#define ARENA_PROFILE_COMPARE_FUNCTION(name, member) \
+static int name(const void* a, const void* b) { \
+    u64 valueA = ((ArenaProfileSite*)a)->member; \
+    u64 valueB = ((ArenaProfileSite*)b)->member; \
+    return (valueA < valueB) - (valueA > valueB); \
+}
+ARENA_PROFILE_COMPARE_FUNCTION(arenaProfileCompareLiveSize, liveSize)
+ARENA_PROFILE_COMPARE_FUNCTION(arenaProfileComparePeakLiveSize, peakLiveSize)
+ARENA_PROFILE_COMPARE_FUNCTION(arenaProfileCompareAllocatedSize, allocatedSize)
+ARENA_PROFILE_COMPARE_FUNCTION(arenaProfileCompareAllocationCount, allocationCount)
+#undef ARENA_PROFILE_COMPARE_FUNCTION
+
+static int arenaProfileCompareLocations(const void* a, const void* b) {
+    ArenaProfileSite* siteA = (ArenaProfileSite*)a;
+    ArenaProfileSite* siteB = (ArenaProfileSite*)b;
+    u64 size = MIN(siteA->filename.size, siteB->filename.size);
+    int result = size ? memcmp(siteA->filename.base, siteB->filename.base, size) : 0;
+    if(!result) result = (siteA->filename.size > siteB->filename.size) - (siteA->filename.size < siteB->filename.size);
+    if(!result) result = (siteA->line > siteB->line) - (siteA->line < siteB->line);
+    return result;
+}
+
+static void arenaProfileCopySite(ArenaProfileSite* site, ArenaProfileSiteEntry* entry) {
+    site->filename = entry->filename;
+    site->line = entry->line;
+    site->allocationCount = groundedAtomicLoad64(&entry->allocationCount, GROUNDED_MEMORY_ORDER_RELAXED);
+    site->allocatedSize = groundedAtomicLoad64(&entry->allocatedSize, GROUNDED_MEMORY_ORDER_RELAXED);
+    site->liveCount = groundedAtomicLoad64(&entry->liveCount, GROUNDED_MEMORY_ORDER_RELAXED);
+    site->liveSize = groundedAtomicLoad64(&entry->liveSize, GROUNDED_MEMORY_ORDER_RELAXED);
+    site->peakLiveSize = groundedAtomicLoad64(&entry->peakLiveSize, GROUNDED_MEMORY_ORDER_RELAXED);
+}
+
+GROUNDED_FUNCTION ArenaProfileSite* arenaProfileGetSnapshot(MemoryArena* arena, ArenaProfileSortKey sortKey, u64* siteCount) {
+    ArenaProfileSite* result = ARENA_PUSH_ARRAY(arena, ARENA_PROFILE_MAX_SITES + 1, ArenaProfileSite);
+    u64 count = 0;
+    for(u32 i = 0; i < ARENA_PROFILE_MAX_SITES; ++i) {
+        if(groundedAtomicLoad64(&arenaProfileSites[i].key, GROUNDED_MEMORY_ORDER_ACQUIRE)) {
+            arenaProfileCopySite(&result[count++], &arenaProfileSites[i]);
+        }
+    }
+    if(groundedAtomicLoad64(&arenaProfileOverflowSite.allocationCount, GROUNDED_MEMORY_ORDER_RELAXED)) {
+        arenaProfileCopySite(&result[count++], &arenaProfileOverflowSite);
+    }
+
+    // The same file included in multiple translation units has distinct filename pointers so merge by content
+    if(count) {
+        qsort(result, count, sizeof(ArenaProfileSite), arenaProfileCompareLocations);
+        u64 mergedCount = 1;
+        for(u64 i = 1; i < count; ++i) {
+            ArenaProfileSite* last = &result[mergedCount - 1];
+            if(arenaProfileCompareLocations(last, &result[i]) == 0) {
+                last->allocationCount += result[i].allocationCount;
+                last->allocatedSize += result[i].allocatedSize;
+                last->liveCount += result[i].liveCount;
+                last->liveSize += result[i].liveSize;
+                last->peakLiveSize += result[i].peakLiveSize;
+            } else {
+                result[mergedCount++] = result[i];
+            }
+        }
+        count = mergedCount;
+    }
+
+    int (*compare)(const void*, const void*) = arenaProfileCompareLiveSize;
+    switch(sortKey) {
+        case ARENA_PROFILE_SORT_LIVE_SIZE: compare = arenaProfileCompareLiveSize; break;
+        case ARENA_PROFILE_SORT_PEAK_LIVE_SIZE: compare = arenaProfileComparePeakLiveSize; break;
+        case ARENA_PROFILE_SORT_ALLOCATED_SIZE: compare = arenaProfileCompareAllocatedSize; break;
+        case ARENA_PROFILE_SORT_ALLOCATION_COUNT: compare = arenaProfileCompareAllocationCount; break;
+    }
+    qsort(result, count, sizeof(ArenaProfileSite), compare);
+
+    // Give back the unused part of the array
+    arenaPopTo(arena, (u8*)(result + count));
+    *siteCount = count;
+    return result;
+}
+
+GROUNDED_FUNCTION String8 arenaProfileFormatReport(MemoryArena* arena, ArenaProfileSortKey sortKey, u64 maxSites) {
+    MemoryArena* scratch = threadContextGetScratch(arena);
+    ArenaTempMemory temp = arenaBeginTemp(scratch);
+
+    u64 siteCount = 0;
+    ArenaProfileSite* sites = arenaProfileGetSnapshot(scratch, sortKey, &siteCount);
+    if(maxSites && maxSites < siteCount) {
+        siteCount = maxSites;
+    }
+    String8List lines = {0};
+    str8ListPush(scratch, &lines, str8FromFormat(scratch, "%14s %10s %14s %14s %10s  %s\n", "live size", "live count", "peak live size", "allocated size", "count", "call site"));
+    for(u64 i = 0; i < siteCount; ++i) {
+        ArenaProfileSite* site = &sites[i];
+        str8ListPush(scratch, &lines, str8FromFormat(scratch, "%14llu %10llu %14llu %14llu %10llu  %S:%llu\n", site->liveSize, site->liveCount, site->peakLiveSize, site->allocatedSize, site->allocationCount, site->filename, site->line));
+    }
+    String8 result = str8ListJoin(arena, &lines, 0);
+
+    arenaEndTemp(temp);
+    return result;
+}
+
+GROUNDED_FUNCTION String8 arenaProfileFormatCsv(MemoryArena* arena, ArenaProfileSortKey sortKey) {
+    MemoryArena* scratch = threadContextGetScratch(arena);
+    ArenaTempMemory temp = arenaBeginTemp(scratch);
+
+    u64 siteCount = 0;
+    ArenaProfileSite* sites = arenaProfileGetSnapshot(scratch, sortKey, &siteCount);
+    String8List lines = {0};
+    str8ListPush(scratch, &lines, STR8_LITERAL("filename,line,allocationCount,allocatedSize,liveCount,liveSize,peakLiveSize\n"));
+    for(u64 i = 0; i < siteCount; ++i) {
+        ArenaProfileSite* site = &sites[i];
+        str8ListPush(scratch, &lines, str8FromFormat(scratch, "%S,%llu,%llu,%llu,%llu,%llu,%llu\n", site->filename, site->line, site->allocationCount, site->allocatedSize, site->liveCount, site->liveSize, site->peakLiveSize));
+    }
+    String8 result = str8ListJoin(arena, &lines, 0);
+
+    arenaEndTemp(temp);
+    return result;
+}
+
 // End Arena Debug stuff
 
 
 
 
 
-GROUNDED_FUNCTION MemoryArena createGrowingArena(MemorySubsystem* memorySubsystem, u64 minBlockSize) {
+GROUNDED_FUNCTION MemoryArena createGrowingArenaWithSpareBlocks(MemorySubsystem* memorySubsystem, u64 minBlockSize, u32 spareBlockCount) {
     MemoryArena result = {0};
     // Round up to page size
-    u64 size = ALIGN_UP_POW2(minBlockSize, 4096);
+    u64 size = ALIGN_UP_POW2(minBlockSize + sizeof(MemoryBlockFooter) + sizeof(GrowingArenaState), 4096);
     result.memory = (u8*)memorySubsystem->reserve(memorySubsystem->context, size);
-    result.commitPos = size - sizeof(MemoryBlockFooter);
+    if(!result.memory) {
+        return (MemoryArena){0};
+    }
+    result.commitPos = size - sizeof(MemoryBlockFooter) - sizeof(GrowingArenaState);
+    result.committedSize = size;
 
     result.grow = (ArenaGrowFunc*)&growingArenaGrow;
     result.shrink = (ArenaShrinkFunc*)&growingArenaShrink;
-    result.additionalInteger = minBlockSize;
+    result.trim = (ArenaTrimFunc*)&growingArenaTrim;
 
     MemoryBlockFooter* footer = (MemoryBlockFooter*) (result.memory + result.commitPos);
     footer->prevBlockMemory = 0;
     footer->prevBlockCommitPos = 0;
     footer->prevBlockPos = 0;
+
+    GrowingArenaState* state = (GrowingArenaState*) (footer + 1);
+    *state = (GrowingArenaState){0};
+    state->memorySubsystem = memorySubsystem;
+    state->minBlockSize = minBlockSize;
+    state->maxSpareBlockCount = spareBlockCount;
+    result.additionalPointer = state;
     
     return result;
 }
+
+GROUNDED_FUNCTION MemoryArena createGrowingArena(MemorySubsystem* memorySubsystem, u64 minBlockSize) {
+    return createGrowingArenaWithSpareBlocks(memorySubsystem, minBlockSize, 0);
+}
+
+
+///////////////////
+// Concurrent arena
+
+GROUNDED_FUNCTION void createConcurrentArena(ConcurrentMemoryArena* arena, MemoryArena* backingArena, u64 blockSize) {
+    *arena = (ConcurrentMemoryArena){0};
+    arena->blockSize = MAX(blockSize, KB(4));
+    arena->mutex = groundedCreateMutex();
+    arena->backingArena = backingArena;
+    arena->resetMarker = arenaCreateMarker(backingArena);
+}
+
+GROUNDED_FUNCTION void concurrentArenaReset(ConcurrentMemoryArena* arena) {
+    groundedLockMutex(&arena->mutex);
+    groundedAtomicStorePointer((void* volatile*)&arena->currentBlock, 0, GROUNDED_MEMORY_ORDER_RELEASE);
+    arenaResetToMarker(arena->resetMarker);
+    groundedUnlockMutex(&arena->mutex);
+}
+
+GROUNDED_FUNCTION void destroyConcurrentArena(ConcurrentMemoryArena* arena) {
+    concurrentArenaReset(arena);
+    groundedDestroyMutex(&arena->mutex);
+    *arena = (ConcurrentMemoryArena){0};
+}
+
+GROUNDED_FUNCTION void* _concurrentArenaPushSizeSlow(ConcurrentMemoryArena* arena, u64 size, u64 alignment, u64 line, String8 filename) {
+    void* result = 0;
+    groundedLockMutex(&arena->mutex);
+
+    // Another thread might have replaced the block while we were waiting for the lock
+    ConcurrentArenaBlock* block = (ConcurrentArenaBlock*)groundedAtomicLoadPointer((void* volatile*)&arena->currentBlock, GROUNDED_MEMORY_ORDER_RELAXED);
+    if(block) {
+        result = _concurrentArenaTryPushToBlock(block, size, alignment);
+    }
+
+    if(!result) {
+        if(size > arena->blockSize / 4) {
+            // Large allocations would waste most of the current block so they get their own memory
+            result = _arenaPushSize(arena->backingArena, size, alignment, false, line, filename);
+        } else {
+            ConcurrentArenaBlock* newBlock = ARENA_PUSH_STRUCT_NO_CLEAR(arena->backingArena, ConcurrentArenaBlock);
+            u8* memory = ARENA_PUSH_ARRAY_NO_CLEAR_ALIGNED(arena->backingArena, arena->blockSize, u8, 64);
+            if(newBlock && memory) {
+                newBlock->memory = memory;
+                newBlock->size = arena->blockSize;
+                newBlock->offset = 0;
+                result = _concurrentArenaTryPushToBlock(newBlock, size, alignment);
+                // Publishing the block makes its initialization visible to all threads that load it
+                groundedAtomicStorePointer((void* volatile*)&arena->currentBlock, newBlock, GROUNDED_MEMORY_ORDER_RELEASE);
+            }
+        }
+    }
+
+    groundedUnlockMutex(&arena->mutex);
+    return result;
+}
+
+// Thread arenas chain their chunks with the same footer as growing arenas but never release memory themselves
+GROUNDED_FUNCTION void* concurrentThreadArenaGrow(MemoryArena* arena, u64* size, u64 alignment) {
+    ConcurrentMemoryArena* concurrentArena = (ConcurrentMemoryArena*)arena->additionalPointer;
+    alignment = MAX(ALIGNMENT_OF(MemoryBlockFooter), alignment);
+    u64 chunkSize = ALIGN_UP_POW2(MAX(*size, concurrentArena->blockSize / 8), alignment) + sizeof(MemoryBlockFooter);
+
+    u8* result = (u8*)_concurrentArenaPushSize(concurrentArena, chunkSize, alignment, false, __LINE__, STR8_LITERAL(__FILE__));
+    if(!result) return 0;
+    *size = chunkSize - sizeof(MemoryBlockFooter);
+    arena->committedSize += chunkSize;
+
+    MemoryBlockFooter* footer = (MemoryBlockFooter*) (result + *size);
+    footer->prevBlockMemory = arena->memory;
+    footer->prevBlockCommitPos = arena->commitPos;
+    footer->prevBlockPos = arena->pos;
+
+    return result;
+}
+
+GROUNDED_FUNCTION void concurrentThreadArenaShrink(MemoryArena* arena, u8* newHead) {
+    if(!newHead) {
+        // Memory belongs to the concurrent arena. Just forget about all chunks
+        arena->memory = 0;
+        arena->pos = 0;
+        arena->commitPos = 0;
+        arena->committedSize = 0;
+        arena->usedSizeBeforeBlock = 0;
+    } else {
+        while(arena->memory && (newHead < arena->memory || newHead > arena->memory + arena->commitPos)) {
+            MemoryBlockFooter* footer = (MemoryBlockFooter*) (arena->memory + arena->commitPos);
+            arena->committedSize -= arena->commitPos + sizeof(MemoryBlockFooter);
+            arena->usedSizeBeforeBlock -= footer->prevBlockPos;
+            arena->memory = footer->prevBlockMemory;
+            arena->commitPos = footer->prevBlockCommitPos;
+        }
+        ASSERT(arena->memory);
+        arena->pos = newHead - arena->memory;
+    }
+}
+
+GROUNDED_FUNCTION MemoryArena concurrentArenaCreateThreadArena(ConcurrentMemoryArena* arena) {
+    MemoryArena result = {0};
+    result.grow = (ArenaGrowFunc*)&concurrentThreadArenaGrow;
+    result.shrink = (ArenaShrinkFunc*)&concurrentThreadArenaShrink;
+    result.additionalPointer = arena;
+    return result;
+}
+
@@ -0,0 +1,600 @@
+#include <grounded/memory/grounded_heap.h>
+#include <grounded/logger/grounded_logger.h>
+
+// Every block starts with this header and is directly followed by its payload.
+// The header of the next block directly follows the payload.
+struct GroundedHeapBlock {
+    GroundedHeapBlock* prevPhysical; // 0 for the first block in a pool
+    u64 size; // Payload size. The lowest bit marks free blocks
+
+    // Only valid while the block is free. Blocks held by caches use nextFree as well
+    GroundedHeapBlock* nextFree;
+    GroundedHeapBlock* prevFree;
+};
+
+// Pool memory layout: pool header, blocks, sentinel block header with size 0
+struct GroundedHeapPool {
+    GroundedHeapPool* next;
+    GroundedHeapPool* prev;
+    u64 size;
+    u64 padding;
+};
+
+struct GroundedHeapDebugAllocation {
+    GroundedHeapDebugAllocation* next;
+    u8* pointer;
+    u64 size;
+    u64 line;
+    String8 filename;
+};
+
+#define HEAP_BLOCK_HEADER_SIZE (OFFSET_OF_MEMBER(GroundedHeapBlock, nextFree))
+#define HEAP_BLOCK_MIN_SIZE (sizeof(GroundedHeapBlock) - HEAP_BLOCK_HEADER_SIZE)
+#define HEAP_BLOCK_FREE_BIT 1ull
+#define HEAP_MAX_BLOCK_SIZE (1ull << (GROUNDED_HEAP_FIRST_LEVEL_COUNT + GROUNDED_HEAP_FIRST_LEVEL_SHIFT - 1))
+#define HEAP_DEBUG_BUCKET_COUNT_LOG2 10
+
+STATIC_ASSERT(HEAP_BLOCK_HEADER_SIZE == GROUNDED_HEAP_ALIGNMENT);
+STATIC_ASSERT(sizeof(GroundedHeapPool) % GROUNDED_HEAP_ALIGNMENT == 0);
+STATIC_ASSERT(GROUNDED_HEAP_FIRST_LEVEL_SHIFT == GROUNDED_HEAP_SECOND_LEVEL_COUNT_LOG2 + 4);
+
+static u64 heapBlockSize(GroundedHeapBlock* block) {
+    return block->size & ~HEAP_BLOCK_FREE_BIT;
+}
+
+static bool heapBlockIsFree(GroundedHeapBlock* block) {
+    return block->size & HEAP_BLOCK_FREE_BIT;
+}
+
+static u8* heapBlockPayload(GroundedHeapBlock* block) {
+    return ((u8*)block) + HEAP_BLOCK_HEADER_SIZE;
+}
+
+static GroundedHeapBlock* heapBlockFromPayload(void* payload) {
+    return (GroundedHeapBlock*)(((u8*)payload) - HEAP_BLOCK_HEADER_SIZE);
+}
+
+static GroundedHeapBlock* heapNextBlock(GroundedHeapBlock* block) {
+    return (GroundedHeapBlock*)(heapBlockPayload(block) + heapBlockSize(block));
+}
+
+static u64 heapAdjustSize(u64 size) {
+    return MAX(ALIGN_UP_POW2(size, GROUNDED_HEAP_ALIGNMENT), HEAP_BLOCK_MIN_SIZE);
+}
+
+// Size class a block of the given size is stored in
+static void heapMapping(u64 size, u32* firstLevel, u32* secondLevel) {
+    if(size < (1ull << GROUNDED_HEAP_FIRST_LEVEL_SHIFT)) {
+        // Small sizes are spread linearly over the first class
+        *firstLevel = 0;
+        *secondLevel = (u32)(size / GROUNDED_HEAP_ALIGNMENT);
+    } else {
+        u32 log2 = groundedLog2u64(size);
+        *secondLevel = (u32)(size >> (log2 - GROUNDED_HEAP_SECOND_LEVEL_COUNT_LOG2)) ^ GROUNDED_HEAP_SECOND_LEVEL_COUNT;
+        *firstLevel = log2 - GROUNDED_HEAP_FIRST_LEVEL_SHIFT + 1;
+    }
+}
+
+// Rounds up to the start of the next size class so every block in the class found for the result is large enough
+static u64 heapRoundUpSearchSize(u64 size) {
+    if(size >= (1ull << GROUNDED_HEAP_FIRST_LEVEL_SHIFT)) {
+        u64 round = (1ull << (groundedLog2u64(size) - GROUNDED_HEAP_SECOND_LEVEL_COUNT_LOG2)) - 1;
+        size += round;
+    }
+    return size;
+}
+
+static void heapInsertFreeBlock(GroundedHeap* heap, GroundedHeapBlock* block) {
+    u32 firstLevel, secondLevel;
+    heapMapping(heapBlockSize(block), &firstLevel, &secondLevel);
+    ASSERT(firstLevel < GROUNDED_HEAP_FIRST_LEVEL_COUNT);
+    block->size |= HEAP_BLOCK_FREE_BIT;
+    GroundedHeapBlock* head = heap->freeBlocks[firstLevel][secondLevel];
+    block->nextFree = head;
+    block->prevFree = 0;
+    if(head) {
+        head->prevFree = block;
+    }
+    heap->freeBlocks[firstLevel][secondLevel] = block;
+    heap->firstLevelBitmap |= 1u << firstLevel;
+    heap->secondLevelBitmap[firstLevel] |= 1u << secondLevel;
+}
+
+static void heapRemoveFreeBlock(GroundedHeap* heap, GroundedHeapBlock* block) {
+    ASSERT(heapBlockIsFree(block));
+    u32 firstLevel, secondLevel;
+    heapMapping(heapBlockSize(block), &firstLevel, &secondLevel);
+    if(block->prevFree) {
+        block->prevFree->nextFree = block->nextFree;
+    } else {
+        ASSERT(heap->freeBlocks[firstLevel][secondLevel] == block);
+        heap->freeBlocks[firstLevel][secondLevel] = block->nextFree;
+        if(!block->nextFree) {
+            heap->secondLevelBitmap[firstLevel] &= ~(1u << secondLevel);
+            if(!heap->secondLevelBitmap[firstLevel]) {
+                heap->firstLevelBitmap &= ~(1u << firstLevel);
+            }
+        }
+    }
+    if(block->nextFree) {
+        block->nextFree->prevFree = block->prevFree;
+    }
+    block->size &= ~HEAP_BLOCK_FREE_BIT;
+}
+
+// Removes and returns a free block with at least size bytes
+static GroundedHeapBlock* heapTakeFreeBlock(GroundedHeap* heap, u64 size) {
+    u64 searchSize = heapRoundUpSearchSize(size);
+    if(searchSize >= HEAP_MAX_BLOCK_SIZE) {
+        return 0;
+    }
+    u32 firstLevel, secondLevel;
+    heapMapping(searchSize, &firstLevel, &secondLevel);
+    u32 secondLevelMap = heap->secondLevelBitmap[firstLevel] & (~0u << secondLevel);
+    if(!secondLevelMap) {
+        // No block in this first level class. Take the smallest one of a larger class
+        u32 firstLevelMap = firstLevel + 1 < GROUNDED_HEAP_FIRST_LEVEL_COUNT ? heap->firstLevelBitmap & (~0u << (firstLevel + 1)) : 0;
+        if(!firstLevelMap) {
+            return 0;
+        }
+        firstLevel = groundedCountTrailingZeros32(firstLevelMap);
+        secondLevelMap = heap->secondLevelBitmap[firstLevel];
+    }
+    secondLevel = groundedCountTrailingZeros32(secondLevelMap);
+    GroundedHeapBlock* result = heap->freeBlocks[firstLevel][secondLevel];
+    ASSERT(result && heapBlockSize(result) >= size);
+    heapRemoveFreeBlock(heap, result);
+    return result;
+}
+
+static bool heapAddPool(GroundedHeap* heap, u64 minimumBlockSize) {
+    u64 overhead = sizeof(GroundedHeapPool) + 2 * HEAP_BLOCK_HEADER_SIZE;
+    u64 size = MAX(heap->poolSize, ALIGN_UP_POW2(minimumBlockSize + overhead, KB(4)));
+    GroundedHeapPool* pool = (GroundedHeapPool*)heap->memorySubsystem->reserve(heap->memorySubsystem->context, size);
+    if(!pool) {
+        GROUNDED_LOG_ERROR("Heap could not reserve memory for a new pool");
+        return false;
+    }
+    ASSERT(INT_FROM_PTR(pool) % GROUNDED_HEAP_ALIGNMENT == 0);
+    pool->size = size;
+    pool->prev = 0;
+    pool->next = heap->pools;
+    if(heap->pools) {
+        heap->pools->prev = pool;
+    }
+    heap->pools = pool;
+    heap->reservedSize += size;
+
+    GroundedHeapBlock* block = (GroundedHeapBlock*)(pool + 1);
+    block->prevPhysical = 0;
+    block->size = ALIGN_DOWN_POW2(size - overhead, GROUNDED_HEAP_ALIGNMENT);
+    GroundedHeapBlock* sentinel = heapNextBlock(block);
+    sentinel->prevPhysical = block;
+    sentinel->size = 0;
+    heapInsertFreeBlock(heap, block);
+    return true;
+}
+
+static void heapReleasePool(GroundedHeap* heap, GroundedHeapPool* pool) {
+    if(pool->prev) {
+        pool->prev->next = pool->next;
+    } else {
+        heap->pools = pool->next;
+    }
+    if(pool->next) {
+        pool->next->prev = pool->prev;
+    }
+    heap->reservedSize -= pool->size;
+    heap->memorySubsystem->release(heap->memorySubsystem->context, pool, pool->size);
+}
+
+// Coalesces a block that is not part of any free list with its free neighbours and makes it available again
+static void heapReleaseBlock(GroundedHeap* heap, GroundedHeapBlock* block) {
+    GroundedHeapBlock* prev = block->prevPhysical;
+    if(prev && heapBlockIsFree(prev)) {
+        heapRemoveFreeBlock(heap, prev);
+        prev->size += HEAP_BLOCK_HEADER_SIZE + heapBlockSize(block);
+        block = prev;
+    }
+    GroundedHeapBlock* next = heapNextBlock(block);
+    if(heapBlockIsFree(next)) {
+        heapRemoveFreeBlock(heap, next);
+        block->size += HEAP_BLOCK_HEADER_SIZE + heapBlockSize(next);
+        next = heapNextBlock(block);
+    }
+    next->prevPhysical = block;
+
+    GroundedHeapPool* pool = ((GroundedHeapPool*)block) - 1;
+    if(!block->prevPhysical && next->size == 0 && (pool->prev || pool->next)) {
+        // Block spans a whole pool. Always keep one pool around so alternating allocations do not hit the memory subsystem
+        heapReleasePool(heap, pool);
+    } else {
+        heapInsertFreeBlock(heap, block);
+    }
+}
+
+// Shrinks a used block to size and releases the remainder if it is large enough to form a block
+static void heapTrimBlock(GroundedHeap* heap, GroundedHeapBlock* block, u64 size) {
+    u64 blockSize = heapBlockSize(block);
+    if(blockSize >= size + HEAP_BLOCK_HEADER_SIZE + HEAP_BLOCK_MIN_SIZE) {
+        block->size = size;
+        GroundedHeapBlock* remainder = heapNextBlock(block);
+        remainder->prevPhysical = block;
+        remainder->size = blockSize - size - HEAP_BLOCK_HEADER_SIZE;
+        heapNextBlock(remainder)->prevPhysical = remainder;
+        heapReleaseBlock(heap, remainder);
+    }
+}
+
+// Must be called with the mutex held. Size must already be adjusted
+static GroundedHeapBlock* heapAllocateBlockLocked(GroundedHeap* heap, u64 size, u64 alignment) {
+    u64 searchSize = size;
+    if(alignment > GROUNDED_HEAP_ALIGNMENT) {
+        // Leave room to split off a leading free block in front of the aligned payload
+        searchSize += alignment + sizeof(GroundedHeapBlock);
+    }
+    GroundedHeapBlock* block = heapTakeFreeBlock(heap, searchSize);
+    if(!block) {
+        if(!heapAddPool(heap, heapRoundUpSearchSize(searchSize))) {
+            return 0;
+        }
+        block = heapTakeFreeBlock(heap, searchSize);
+        if(!block) {
+            GROUNDED_LOG_ERROR("Heap allocation exceeds maximum block size");
+            return 0;
+        }
+    }
+
+    if(alignment > GROUNDED_HEAP_ALIGNMENT) {
+        u8* payload = heapBlockPayload(block);
+        u8* alignedPayload = (u8*)ALIGN_POINTER_UP_POW2(payload, alignment);
+        if(alignedPayload != payload && (u64)(alignedPayload - payload) < sizeof(GroundedHeapBlock)) {
+            // Gap is too small to hold a free block
+            alignedPayload = (u8*)ALIGN_POINTER_UP_POW2(payload + sizeof(GroundedHeapBlock), alignment);
+        }
+        u64 gap = alignedPayload - payload;
+        if(gap) {
+            GroundedHeapBlock* alignedBlock = heapBlockFromPayload(alignedPayload);
+            alignedBlock->prevPhysical = block;
+            alignedBlock->size = heapBlockSize(block) - gap;
+            heapNextBlock(alignedBlock)->prevPhysical = alignedBlock;
+            block->size = gap - HEAP_BLOCK_HEADER_SIZE;
+            // Neighbours of a free block are always in use so no coalescing is necessary
+            heapInsertFreeBlock(heap, block);
+            block = alignedBlock;
+        }
+    }
+    heapTrimBlock(heap, block, size);
+
+    heap->allocatedSize += HEAP_BLOCK_HEADER_SIZE + heapBlockSize(block);
+    heap->allocationCount++;
+    return block;
+}
+
+static void heapFreeBlockLocked(GroundedHeap* heap, GroundedHeapBlock* block) {
+    // Detects double frees and most corruptions of the header
+    ASSERT(!heapBlockIsFree(block));
+    ASSERT(heap->allocationCount);
+    heap->allocatedSize -= HEAP_BLOCK_HEADER_SIZE + heapBlockSize(block);
+    heap->allocationCount--;
+    heapReleaseBlock(heap, block);
+}
+
+GROUNDED_FUNCTION bool groundedCreateHeap(GroundedHeap* heap, MemorySubsystem* memorySubsystem, u64 poolSize) {
+    *heap = (GroundedHeap){0};
+    heap->mutex = groundedCreateMutex();
+    heap->memorySubsystem = memorySubsystem;
+    heap->poolSize = ALIGN_UP_POW2(poolSize ? poolSize : MB(1), KB(4));
+    if(!heapAddPool(heap, 0)) {
+        groundedDestroyMutex(&heap->mutex);
+        return false;
+    }
+    return true;
+}
+
+//////////////
+// Debug modes
+
+static u64 heapDebugBucket(void* pointer) {
+    return (INT_FROM_PTR(pointer) * 0x9E3779B97F4A7C15ull) >> (64 - HEAP_DEBUG_BUCKET_COUNT_LOG2);
+}
+
+static void heapEnableDebugMode(GroundedHeap* heap, GroundedHeapDebugMode mode) {
+    ASSERT(heap->debugMode == GROUNDED_HEAP_DEBUG_NONE);
+    ASSERT(heap->allocationCount == 0);
+    heap->debugArena = createGrowingArena(osGetMemorySubsystem(), KB(16));
+    heap->debugAllocations = ARENA_PUSH_ARRAY(&heap->debugArena, 1ull << HEAP_DEBUG_BUCKET_COUNT_LOG2, GroundedHeapDebugAllocation*);
+    heap->debugMode = mode;
+}
+
+GROUNDED_FUNCTION void enableDebugMemoryLoggingForHeap(GroundedHeap* heap) {
+    heapEnableDebugMode(heap, GROUNDED_HEAP_DEBUG_LOG);
+}
+
+GROUNDED_FUNCTION void enableDebugMemoryOverflowDetectForHeap(GroundedHeap* heap) {
+    heapEnableDebugMode(heap, GROUNDED_HEAP_DEBUG_OVERFLOW_DETECT);
+}
+
+GROUNDED_FUNCTION void enableDebugMemoryUnderflowDetectForHeap(GroundedHeap* heap) {
+    heapEnableDebugMode(heap, GROUNDED_HEAP_DEBUG_UNDERFLOW_DETECT);
+}
+
+// Must be called with the mutex held
+static GroundedHeapDebugAllocation* heapDebugFind(GroundedHeap* heap, void* pointer, bool remove) {
+    GroundedHeapDebugAllocation** link = &heap->debugAllocations[heapDebugBucket(pointer)];
+    while(*link) {
+        GroundedHeapDebugAllocation* allocation = *link;
+        if(allocation->pointer == pointer) {
+            if(remove) {
+                *link = allocation->next;
+            }
+            return allocation;
+        }
+        link = &allocation->next;
+    }
+    return 0;
+}
+
+static void* heapDebugAllocate(GroundedHeap* heap, u64 size, u64 alignment, bool clear, u64 line, String8 filename) {
+    u8* result = 0;
+    groundedLockMutex(&heap->mutex);
+    if(heap->debugMode == GROUNDED_HEAP_DEBUG_LOG) {
+        GroundedHeapBlock* block = heapAllocateBlockLocked(heap, heapAdjustSize(size), alignment);
+        result = block ? heapBlockPayload(block) : 0;
+    } else {
+        ASSERT(alignment <= KB(4));
+        bool overflow = heap->debugMode == GROUNDED_HEAP_DEBUG_OVERFLOW_DETECT;
+        result = (u8*)osAllocateGuardedMemory(MAX(size, 1), alignment, overflow);
+        if(result) {
+            heap->allocatedSize += size;
+            heap->allocationCount++;
+        }
+    }
+    if(result) {
+        GroundedHeapDebugAllocation* allocation = heap->freeDebugAllocations;
+        if(allocation) {
+            heap->freeDebugAllocations = allocation->next;
+        } else {
+            allocation = ARENA_PUSH_STRUCT(&heap->debugArena, GroundedHeapDebugAllocation);
+        }
+        u64 bucket = heapDebugBucket(result);
+        *allocation = (GroundedHeapDebugAllocation){
+            .next = heap->debugAllocations[bucket],
+            .pointer = result,
+            .size = size,
+            .line = line,
+            .filename = filename,
+        };
+        heap->debugAllocations[bucket] = allocation;
+    }
+    groundedUnlockMutex(&heap->mutex);
+
+    if(result) {
+        if(clear) {
+            groundedClearMemory(result, size);
+        } else if(heap->debugMode != GROUNDED_HEAP_DEBUG_LOG) {
+            groundedSetMemory(result, 27, size);
+        }
+        if(heap->debugMode == GROUNDED_HEAP_DEBUG_LOG) {
+            GROUNDED_LOG_INFOF("Heap allocate: at %S:%llu\t %llu bytes\n", filename, line, size);
+        }
+    }
+    return result;
+}
+
+static void heapDebugFree(GroundedHeap* heap, void* pointer) {
+    groundedLockMutex(&heap->mutex);
+    GroundedHeapDebugAllocation* allocation = heapDebugFind(heap, pointer, true);
+    if(!allocation) {
+        groundedUnlockMutex(&heap->mutex);
+        GROUNDED_LOG_ERROR("Free of a pointer that is not a live allocation of this heap");
+        return;
+    }
+    GroundedHeapDebugAllocation info = *allocation;
+    allocation->next = heap->freeDebugAllocations;
+    heap->freeDebugAllocations = allocation;
+    if(heap->debugMode == GROUNDED_HEAP_DEBUG_LOG) {
+        heapFreeBlockLocked(heap, heapBlockFromPayload(pointer));
+    } else {
+        osFreeGuardedMemory(pointer, MAX(info.size, 1), heap->debugMode == GROUNDED_HEAP_DEBUG_OVERFLOW_DETECT);
+        heap->allocatedSize -= info.size;
+        heap->allocationCount--;
+    }
+    groundedUnlockMutex(&heap->mutex);
+
+    if(heap->debugMode == GROUNDED_HEAP_DEBUG_LOG) {
+        GROUNDED_LOG_INFOF("Heap free: at %S:%llu\t %llu bytes\n", info.filename, info.line, info.size);
+    }
+}
+
+GROUNDED_FUNCTION void groundedDestroyHeap(GroundedHeap* heap) {
+    if(heap->debugMode != GROUNDED_HEAP_DEBUG_NONE) {
+        for(u64 i = 0; i < (1ull << HEAP_DEBUG_BUCKET_COUNT_LOG2); ++i) {
+            for(GroundedHeapDebugAllocation* allocation = heap->debugAllocations[i]; allocation; allocation = allocation->next) {
+                GROUNDED_LOG_WARNINGF("Heap leak: at %S:%llu\t %llu bytes\n", allocation->filename, allocation->line, allocation->size);
+                if(heap->debugMode != GROUNDED_HEAP_DEBUG_LOG) {
+                    osFreeGuardedMemory(allocation->pointer, MAX(allocation->size, 1), heap->debugMode == GROUNDED_HEAP_DEBUG_OVERFLOW_DETECT);
+                }
+            }
+        }
+        arenaRelease(&heap->debugArena);
+    }
+    while(heap->pools) {
+        heapReleasePool(heap, heap->pools);
+    }
+    groundedDestroyMutex(&heap->mutex);
+    *heap = (GroundedHeap){0};
+}
+
+/////////////
+// Allocation
+
+GROUNDED_FUNCTION void* _groundedHeapAllocate(GroundedHeap* heap, u64 size, u64 alignment, bool clear, u64 line, String8 filename) {
+    ASSERT(IS_POW2(alignment));
+    if(heap->debugMode != GROUNDED_HEAP_DEBUG_NONE) {
+        return heapDebugAllocate(heap, size, alignment, clear, line, filename);
+    }
+
+    groundedLockMutex(&heap->mutex);
+    GroundedHeapBlock* block = heapAllocateBlockLocked(heap, heapAdjustSize(size), alignment);
+    groundedUnlockMutex(&heap->mutex);
+
+    void* result = 0;
+    if(block) {
+        result = heapBlockPayload(block);
+        if(clear) { groundedClearMemory(result, size); }
+    }
+    return result;
+}
+
+GROUNDED_FUNCTION void groundedHeapFree(GroundedHeap* heap, void* pointer) {
+    if(!pointer) return;
+    if(heap->debugMode != GROUNDED_HEAP_DEBUG_NONE) {
+        heapDebugFree(heap, pointer);
+        return;
+    }
+
+    groundedLockMutex(&heap->mutex);
+    heapFreeBlockLocked(heap, heapBlockFromPayload(pointer));
+    groundedUnlockMutex(&heap->mutex);
+}
+
+GROUNDED_FUNCTION u64 groundedHeapGetAllocationSize(GroundedHeap* heap, void* pointer) {
+    u64 result = 0;
+    if(heap->debugMode != GROUNDED_HEAP_DEBUG_NONE) {
+        groundedLockMutex(&heap->mutex);
+        GroundedHeapDebugAllocation* allocation = heapDebugFind(heap, pointer, false);
+        ASSERT(allocation);
+        if(allocation) {
+            result = allocation->size;
+        }
+        groundedUnlockMutex(&heap->mutex);
+    } else {
+        // Only the owner of an allocation changes its size so no lock is required
+        result = heapBlockSize(heapBlockFromPayload(pointer));
+    }
+    return result;
+}
+
+GROUNDED_FUNCTION void* _groundedHeapReallocate(GroundedHeap* heap, void* pointer, u64 size, u64 alignment, u64 line, String8 filename) {
+    if(!pointer) {
+        return _groundedHeapAllocate(heap, size, alignment, false, line, filename);
+    }
+
+    u64 oldSize = 0;
+    if(heap->debugMode == GROUNDED_HEAP_DEBUG_NONE) {
+        GroundedHeapBlock* block = heapBlockFromPayload(pointer);
+        u64 newSize = heapAdjustSize(size);
+        bool inPlace = false;
+
+        groundedLockMutex(&heap->mutex);
+        oldSize = heapBlockSize(block);
+        heap->allocatedSize -= oldSize;
+        if(newSize > oldSize) {
+            // Try to grow into the following block
+            GroundedHeapBlock* next = heapNextBlock(block);
+            if(heapBlockIsFree(next) && oldSize + HEAP_BLOCK_HEADER_SIZE + heapBlockSize(next) >= newSize) {
+                heapRemoveFreeBlock(heap, next);
+                block->size = oldSize + HEAP_BLOCK_HEADER_SIZE + heapBlockSize(next);
+                heapNextBlock(block)->prevPhysical = block;
+                inPlace = true;
+            }
+        } else {
+            inPlace = true;
+        }
+        if(inPlace) {
+            heapTrimBlock(heap, block, newSize);
+        }
+        heap->allocatedSize += heapBlockSize(block);
+        groundedUnlockMutex(&heap->mutex);
+
+        if(inPlace) {
+            return pointer;
+        }
+    } else {
+        oldSize = groundedHeapGetAllocationSize(heap, pointer);
+    }
+
+    void* result = _groundedHeapAllocate(heap, size, alignment, false, line, filename);
+    if(result) {
+        MEMORY_COPY(result, pointer, MIN(oldSize, size));
+        groundedHeapFree(heap, pointer);
+    }
+    return result;
+}
+
+/////////
+// Caches
+
+// Returns GROUNDED_HEAP_CACHE_CLASS_COUNT for sizes that are not cached
+static u32 heapCacheClass(u64 size) {
+    return (u32)MIN(heapAdjustSize(size) / GROUNDED_HEAP_ALIGNMENT - 1, GROUNDED_HEAP_CACHE_CLASS_COUNT);
+}
+
+GROUNDED_FUNCTION void* _groundedHeapCacheAllocate(GroundedHeap* heap, GroundedHeapCache* cache, u64 size, u64 alignment, u64 line, String8 filename) {
+    u32 cacheClass = heapCacheClass(size);
+    if(heap->debugMode != GROUNDED_HEAP_DEBUG_NONE || alignment > GROUNDED_HEAP_ALIGNMENT || cacheClass >= GROUNDED_HEAP_CACHE_CLASS_COUNT) {
+        return _groundedHeapAllocate(heap, size, alignment, false, line, filename);
+    }
+
+    if(!cache->freeBlocks[cacheClass]) {
+        // Refill a whole batch with a single lock
+        groundedLockMutex(&heap->mutex);
+        for(u32 i = 0; i < GROUNDED_HEAP_CACHE_BATCH_SIZE; ++i) {
+            GroundedHeapBlock* block = heapAllocateBlockLocked(heap, (cacheClass + 1) * GROUNDED_HEAP_ALIGNMENT, GROUNDED_HEAP_ALIGNMENT);
+            if(!block) break;
+            block->nextFree = cache->freeBlocks[cacheClass];
+            cache->freeBlocks[cacheClass] = block;
+            cache->counts[cacheClass]++;
+        }
+        groundedUnlockMutex(&heap->mutex);
+    }
+
+    GroundedHeapBlock* result = cache->freeBlocks[cacheClass];
+    if(!result) {
+        return 0;
+    }
+    cache->freeBlocks[cacheClass] = result->nextFree;
+    cache->counts[cacheClass]--;
+    return heapBlockPayload(result);
+}
+
+GROUNDED_FUNCTION void groundedHeapCacheFree(GroundedHeap* heap, GroundedHeapCache* cache, void* pointer) {
+    if(!pointer) return;
+    GroundedHeapBlock* block = heapBlockFromPayload(pointer);
+    // Blocks might be slightly larger than their class so they are put into the class they can fully satisfy
+    u32 cacheClass = heap->debugMode == GROUNDED_HEAP_DEBUG_NONE ? heapCacheClass(heapBlockSize(block)) : GROUNDED_HEAP_CACHE_CLASS_COUNT;
+    if(cacheClass >= GROUNDED_HEAP_CACHE_CLASS_COUNT) {
+        groundedHeapFree(heap, pointer);
+        return;
+    }
+    ASSERT(!heapBlockIsFree(block));
+    block->nextFree = cache->freeBlocks[cacheClass];
+    cache->freeBlocks[cacheClass] = block;
+    cache->counts[cacheClass]++;
+
+    if(cache->counts[cacheClass] >= 2 * GROUNDED_HEAP_CACHE_BATCH_SIZE) {
+        // Give a batch back so blocks freed on this thread become available to others
+        groundedLockMutex(&heap->mutex);
+        for(u32 i = 0; i < GROUNDED_HEAP_CACHE_BATCH_SIZE; ++i) {
+            GroundedHeapBlock* returned = cache->freeBlocks[cacheClass];
+            cache->freeBlocks[cacheClass] = returned->nextFree;
+            cache->counts[cacheClass]--;
+            heapFreeBlockLocked(heap, returned);
+        }
+        groundedUnlockMutex(&heap->mutex);
+    }
+}
+
+GROUNDED_FUNCTION void groundedHeapCacheFlush(GroundedHeap* heap, GroundedHeapCache* cache) {
+    groundedLockMutex(&heap->mutex);
+    for(u32 i = 0; i < GROUNDED_HEAP_CACHE_CLASS_COUNT; ++i) {
+        while(cache->freeBlocks[i]) {
+            GroundedHeapBlock* returned = cache->freeBlocks[i];
+            cache->freeBlocks[i] = returned->nextFree;
+            heapFreeBlockLocked(heap, returned);
+        }
+        cache->counts[i] = 0;
+    }
+    groundedUnlockMutex(&heap->mutex);
+}
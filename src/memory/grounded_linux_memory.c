@@ -1,6 +1,8 @@
 #include <grounded/memory/grounded_memory.h>
+#include <grounded/logger/grounded_logger.h>
 
 #include <sys/mman.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 
 #include <stdlib.h> // For strtoul, strtof
@@ -30,6 +32,60 @@ GROUNDED_FUNCTION void* osReserveMemory(u64 size) {
     return memory;
 }
 
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+#ifndef MPOL_BIND
+#define MPOL_BIND 2
+#endif
+
+GROUNDED_FUNCTION void* osReserveMemoryWithFlags(u64 size, u32 flags, u32 numaNode) {
+    u8* memory = 0;
+    bool hugePages = flags & (GROUNDED_VIRTUAL_MEMORY_HUGE_PAGES | GROUNDED_VIRTUAL_MEMORY_HUGE_PAGES_EXPLICIT);
+    if(hugePages) {
+        size = ALIGN_UP_POW2(size, GROUNDED_HUGE_PAGE_SIZE);
+    }
+
+    if(flags & GROUNDED_VIRTUAL_MEMORY_HUGE_PAGES_EXPLICIT) {
+        // Huge pages for the whole range are reserved from the pool up front. Otherwise faulting in a page would raise SIGBUS once the pool is exhausted
+        memory = (u8*)mmap(0, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if(memory == (void*)-1) {
+            memory = 0;
+            GROUNDED_LOG_WARNING("Explicit huge pages are not available. Falling back to transparent huge pages");
+        }
+    }
+    if(!memory && hugePages) {
+        // Reserve one additional huge page so the range can be aligned to the huge page size
+        u8* base = (u8*)mmap(0, size + GROUNDED_HUGE_PAGE_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if(base != (void*)-1) {
+            memory = (u8*)ALIGN_POINTER_UP_POW2(base, GROUNDED_HUGE_PAGE_SIZE);
+            if(memory > base) {
+                munmap(base, memory - base);
+            }
+            u64 tailSize = (base + size + GROUNDED_HUGE_PAGE_SIZE) - (memory + size);
+            if(tailSize) {
+                munmap(memory + size, tailSize);
+            }
+            // Fails on kernels without transparent huge pages in which case we simply get normal pages
+            madvise(memory, size, MADV_HUGEPAGE);
+        }
+    } else if(!memory) {
+        memory = (u8*)osReserveMemory(size);
+    }
+
+    if(memory && (flags & GROUNDED_VIRTUAL_MEMORY_NUMA_BIND)) {
+        ASSERT(numaNode <= GROUNDED_VIRTUAL_MEMORY_MAX_NUMA_NODE);
+        // Called directly so there is no dependency on libnuma
+        unsigned long nodeMask[(GROUNDED_VIRTUAL_MEMORY_MAX_NUMA_NODE + 1) / (8 * sizeof(unsigned long))] = {0};
+        nodeMask[numaNode / (8 * sizeof(unsigned long))] = 1ul << (numaNode % (8 * sizeof(unsigned long)));
+        if(syscall(SYS_mbind, memory, size, MPOL_BIND, nodeMask, (unsigned long)(8 * sizeof(nodeMask)), 0) != 0) {
+            GROUNDED_LOG_WARNINGF("Could not bind memory to NUMA node %u\n", numaNode);
+        }
+    }
+
+    return memory;
+}
+
 //TODO: Do not assume page size and use u64 pageSize = getpagesize(); instead
 
 GROUNDED_FUNCTION void* osAllocateGuardedMemory(u64 size, u64 alignment, bool overflow) {
@@ -58,6 +114,8 @@ GROUNDED_FUNCTION void osCommitMemory(void* memory, u64 size) {
     mprotect(memory, size, PROT_READ | PROT_WRITE);
 }
 GROUNDED_FUNCTION void osDecommitMemory(void* memory, u64 size) {
+    // mprotect alone keeps the physical pages
+    madvise(memory, size, MADV_DONTNEED);
     mprotect(memory, size, PROT_NONE);
 }
 GROUNDED_FUNCTION void osReleaseMemory(void* memory, u64 size) {
@@ -83,10 +141,39 @@ GROUNDED_FUNCTION void osRelease(void* context, void* ptr, u64 size) {
 
 
 
+// Touches all pages so they are backed by physical memory
+GROUNDED_FUNCTION void osPrefaultMemory(void* memory, u64 size) {
+    if(madvise(memory, size, MADV_POPULATE_WRITE) != 0) {
+        // Kernels before 5.14 do not support populating with madvise
+        for(u64 offset = 0; offset < size; offset += 4096) {
+            ((volatile u8*)memory)[offset] = 0;
+        }
+    }
+}
+
+// The reservation size is page aligned so the low bits of additionalInteger hold the flags and the NUMA node
+#define CONTIGOUS_VIRTUAL_MEMORY_RESERVE_SIZE(arena) ((arena)->additionalInteger & ~0xFFFull)
+#define CONTIGOUS_VIRTUAL_MEMORY_FLAGS(arena) ((u32)(arena)->additionalInteger & GROUNDED_VIRTUAL_MEMORY_FLAG_MASK)
+
 GROUNDED_FUNCTION void* contigousVirtualMemoryArenaGrow(MemoryArena* arena, u64* size, u64 alignment) {
     ASSERT(arena->pos + *size > arena->commitPos);
-    u64 commitSize = ALIGN_UP_POW2(*size, 4096);
+    u32 flags = CONTIGOUS_VIRTUAL_MEMORY_FLAGS(arena);
+    u64 reserveSize = CONTIGOUS_VIRTUAL_MEMORY_RESERVE_SIZE(arena);
+    u64 granularity = (flags & (GROUNDED_VIRTUAL_MEMORY_HUGE_PAGES | GROUNDED_VIRTUAL_MEMORY_HUGE_PAGES_EXPLICIT)) ? GROUNDED_HUGE_PAGE_SIZE : 4096;
+    u64 commitSize = ALIGN_UP_POW2(*size, granularity);
+    if(arena->commitPos + commitSize > reserveSize) {
+        if(arena->commitPos + *size > reserveSize) {
+            GROUNDED_LOG_ERROR("Contigous virtual memory arena exceeded its reserved size");
+            *size = 0;
+            return 0;
+        }
+        commitSize = reserveSize - arena->commitPos;
+    }
     osCommitMemory(arena->memory + arena->commitPos, commitSize);
+    if(flags & GROUNDED_VIRTUAL_MEMORY_PREFAULT) {
+        osPrefaultMemory(arena->memory + arena->commitPos, commitSize);
+    }
+    arena->committedSize += commitSize;
     *size = commitSize;
     return arena->memory + arena->commitPos;
 }
@@ -96,20 +183,43 @@ GROUNDED_FUNCTION void contigousVirtualMemoryArenaShrink(MemoryArena* arena, u8*
     if(newHead == 0) {
         // Decommit not necessary
         //osDecommitMemory(arena->memory, arena->commitPos);
-        osReleaseMemory(arena->memory, arena->additionalInteger);
+        osReleaseMemory(arena->memory, CONTIGOUS_VIRTUAL_MEMORY_RESERVE_SIZE(arena));
+        arena->committedSize = 0;
     }
 }
 
-GROUNDED_FUNCTION MemoryArena createContigousVirtualMemoryArena(u64 maxVirtualMemorySize) {
+GROUNDED_FUNCTION void contigousVirtualMemoryArenaTrim(MemoryArena* arena, u64 keepSize) {
+    u32 flags = CONTIGOUS_VIRTUAL_MEMORY_FLAGS(arena);
+    u64 granularity = (flags & (GROUNDED_VIRTUAL_MEMORY_HUGE_PAGES | GROUNDED_VIRTUAL_MEMORY_HUGE_PAGES_EXPLICIT)) ? GROUNDED_HUGE_PAGE_SIZE : 4096;
+    u64 keepCommitPos = ALIGN_UP_POW2(MAX(keepSize, arena->pos), granularity);
+    if(keepCommitPos < arena->commitPos) {
+        osDecommitMemory(arena->memory + keepCommitPos, arena->commitPos - keepCommitPos);
+        arena->committedSize -= arena->commitPos - keepCommitPos;
+        arena->commitPos = keepCommitPos;
+    }
+}
+
+GROUNDED_FUNCTION MemoryArena createContigousVirtualMemoryArenaWithFlags(u64 maxVirtualMemorySize, u32 flags, u32 numaNode) {
     ASSERT(sizeof(void*) >= 8);
+    ASSERT(!(flags & ~GROUNDED_VIRTUAL_MEMORY_FLAG_MASK));
+    ASSERT(numaNode <= GROUNDED_VIRTUAL_MEMORY_MAX_NUMA_NODE);
+    u64 reserveSize = ALIGN_UP_POW2(maxVirtualMemorySize, 4096);
+    if(flags & (GROUNDED_VIRTUAL_MEMORY_HUGE_PAGES | GROUNDED_VIRTUAL_MEMORY_HUGE_PAGES_EXPLICIT)) {
+        reserveSize = ALIGN_UP_POW2(reserveSize, GROUNDED_HUGE_PAGE_SIZE);
+    }
     MemoryArena result = {};
-    result.memory = osReserveMemory(maxVirtualMemorySize);
-    result.additionalInteger = maxVirtualMemorySize;
+    result.memory = osReserveMemoryWithFlags(reserveSize, flags, numaNode);
+    result.additionalInteger = reserveSize | flags | ((u64)numaNode << 4);
     result.grow = (ArenaGrowFunc*) &contigousVirtualMemoryArenaGrow;
     result.shrink = (ArenaShrinkFunc*) &contigousVirtualMemoryArenaShrink;
+    result.trim = (ArenaTrimFunc*) &contigousVirtualMemoryArenaTrim;
     return result;
 }
 
+GROUNDED_FUNCTION MemoryArena createContigousVirtualMemoryArena(u64 maxVirtualMemorySize) {
+    return createContigousVirtualMemoryArenaWithFlags(maxVirtualMemorySize, 0, 0);
+}
+
 
 GROUNDED_FUNCTION MemorySubsystem* osGetMemorySubsystem() {
     static MemorySubsystem memorySubsystem = {};
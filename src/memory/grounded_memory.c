@@ -2,4 +2,114 @@
 #include "grounded_win32_memory.c"
 #else
 #include "grounded_linux_memory.c"
-#endif
\ No newline at end of file
+#endif
+
+////////////////////////////////////
+// Virtual memory backed growing arena
+
+// Lives in the first page of every reservation. Arena memory starts at the following page so it satisfies every alignment
+typedef struct VirtualMemoryRegionHeader {
+    u8* prevRegionMemory;
+    u64 prevRegionCommitPos;
+    u64 prevRegionPos;
+    u64 reserveSize; // Including the header page
+} VirtualMemoryRegionHeader;
+
+#define VIRTUAL_MEMORY_REGION_HEADER(memory) ((VirtualMemoryRegionHeader*)((memory) - 4096))
+#define VIRTUAL_MEMORY_GROWING_ARENA_MIN_COMMIT KB(64)
+
+// Returns the start of the arena memory of the region
+static u8* virtualMemoryGrowingArenaReserveRegion(u64 reserveSize) {
+    u8* region = (u8*)osReserveMemory(reserveSize);
+    if(!region) return 0;
+    osCommitMemory(region, 4096);
+    VirtualMemoryRegionHeader* header = (VirtualMemoryRegionHeader*)region;
+    *header = (VirtualMemoryRegionHeader){0};
+    header->reserveSize = reserveSize;
+    return region + 4096;
+}
+
+GROUNDED_FUNCTION void* virtualMemoryGrowingArenaGrow(MemoryArena* arena, u64* size, u64 alignment) {
+    VirtualMemoryRegionHeader* header = VIRTUAL_MEMORY_REGION_HEADER(arena->memory);
+    u64 capacity = header->reserveSize - 4096;
+    if(arena->commitPos < capacity) {
+        // Commit in power of two steps. If the requested size does not fit anymore the rest of the reservation is committed
+        // and the arena calls grow again for a new region once that is used up
+        u64 requiredCommitPos = arena->commitPos + *size;
+        u64 newCommitPos = VIRTUAL_MEMORY_GROWING_ARENA_MIN_COMMIT;
+        if(requiredCommitPos > newCommitPos) {
+            newCommitPos = 1ull << (groundedLog2u64(requiredCommitPos - 1) + 1);
+        }
+        newCommitPos = MIN(newCommitPos, capacity);
+        u64 commitSize = newCommitPos - arena->commitPos;
+        osCommitMemory(arena->memory + arena->commitPos, commitSize);
+        arena->committedSize += commitSize;
+        *size = commitSize;
+        return arena->memory + arena->commitPos;
+    }
+
+    // Reservation is exhausted so we fall back to chaining another one
+    u64 reserveSize = MAX(arena->additionalInteger, ALIGN_UP_POW2(*size, 4096) + 4096);
+    u8* result = virtualMemoryGrowingArenaReserveRegion(reserveSize);
+    if(!result) {
+        GROUNDED_LOG_ERROR("Could not reserve virtual memory for growing arena");
+        *size = 0;
+        return 0;
+    }
+    header = VIRTUAL_MEMORY_REGION_HEADER(result);
+    header->prevRegionMemory = arena->memory;
+    header->prevRegionCommitPos = arena->commitPos;
+    header->prevRegionPos = arena->pos;
+    // Only the first step is committed. The arena grows the new region in place if that is not enough
+    u64 commitSize = MIN(VIRTUAL_MEMORY_GROWING_ARENA_MIN_COMMIT, reserveSize - 4096);
+    osCommitMemory(result, commitSize);
+    arena->committedSize += commitSize + 4096;
+    *size = commitSize;
+    return result;
+}
+
+GROUNDED_FUNCTION void virtualMemoryGrowingArenaShrink(MemoryArena* arena, u8* newHead) {
+    while(arena->memory && (!newHead || newHead < arena->memory || newHead > arena->memory + arena->commitPos)) {
+        VirtualMemoryRegionHeader* header = VIRTUAL_MEMORY_REGION_HEADER(arena->memory);
+        VirtualMemoryRegionHeader headerCopy = *header;
+        osReleaseMemory(header, headerCopy.reserveSize);
+        arena->committedSize -= arena->commitPos + 4096;
+        arena->memory = headerCopy.prevRegionMemory;
+        arena->commitPos = headerCopy.prevRegionCommitPos;
+        if(arena->memory) {
+            arena->usedSizeBeforeBlock -= headerCopy.prevRegionPos;
+            arena->pos = newHead - arena->memory;
+        }
+    }
+    if(!newHead) {
+        arena->pos = 0;
+        arena->usedSizeBeforeBlock = 0;
+    }
+}
+
+GROUNDED_FUNCTION void virtualMemoryGrowingArenaTrim(MemoryArena* arena, u64 keepSize) {
+    // Previous regions are completely in use so only the current one can be trimmed
+    u64 keepPos = keepSize > arena->usedSizeBeforeBlock ? keepSize - arena->usedSizeBeforeBlock : 0;
+    u64 keepCommitPos = ALIGN_UP_POW2(MAX(keepPos, arena->pos), 4096);
+    if(keepCommitPos < arena->commitPos) {
+        osDecommitMemory(arena->memory + keepCommitPos, arena->commitPos - keepCommitPos);
+        arena->committedSize -= arena->commitPos - keepCommitPos;
+        arena->commitPos = keepCommitPos;
+    }
+}
+
+GROUNDED_FUNCTION MemoryArena createVirtualMemoryGrowingArena(u64 reserveSize) {
+    ASSERT(sizeof(void*) >= 8);
+    reserveSize = MAX(ALIGN_UP_POW2(reserveSize, 4096), VIRTUAL_MEMORY_GROWING_ARENA_MIN_COMMIT) + 4096;
+    MemoryArena result = {0};
+    result.memory = virtualMemoryGrowingArenaReserveRegion(reserveSize);
+    if(!result.memory) {
+        return (MemoryArena){0};
+    }
+    result.committedSize = 4096;
+    result.additionalInteger = reserveSize;
+    result.grow = (ArenaGrowFunc*) &virtualMemoryGrowingArenaGrow;
+    result.shrink = (ArenaShrinkFunc*) &virtualMemoryGrowingArenaShrink;
+    result.trim = (ArenaTrimFunc*) &virtualMemoryGrowingArenaTrim;
+    return result;
+}
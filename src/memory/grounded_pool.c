@@ -0,0 +1,229 @@
+#include <grounded/memory/grounded_pool.h>
+#include <grounded/memory/grounded_memory.h>
+
+static u32 poolGetChunkIndex(GroundedPool* pool, u64 slotIndex, u64* chunkStart) {
+    // Chunk k starts at slot slotsPerChunk * (2^k - 1)
+    u64 q = slotIndex / pool->slotsPerChunk + 1;
+    u32 chunkIndex = 0;
+    while(q >>= 1) chunkIndex++;
+    *chunkStart = pool->slotsPerChunk * ((1ull << chunkIndex) - 1);
+    return chunkIndex;
+}
+
+static u8* poolGetSlot(GroundedPool* pool, u64 slotIndex) {
+    ASSERT(slotIndex < pool->usedSlotCount);
+    u64 chunkStart = 0;
+    u32 chunkIndex = poolGetChunkIndex(pool, slotIndex, &chunkStart);
+    if(chunkIndex >= GROUNDED_POOL_MAX_CHUNKS) return 0;
+    u8* chunk = (u8*)groundedAtomicLoadPointer((void* volatile*)&pool->chunks[chunkIndex], GROUNDED_MEMORY_ORDER_ACQUIRE);
+    if(!chunk) return 0;
+    return chunk + (slotIndex - chunkStart) * pool->stride;
+}
+
+// Returns slot index + 1 or 0 if the object does not belong to the pool
+static u64 poolFindSlotIndex(GroundedPool* pool, void* object) {
+    u8* pointer = (u8*)object;
+    for(u32 i = 0; i < GROUNDED_POOL_MAX_CHUNKS; ++i) {
+        u8* chunk = (u8*)groundedAtomicLoadPointer((void* volatile*)&pool->chunks[i], GROUNDED_MEMORY_ORDER_ACQUIRE);
+        if(!chunk) break;
+        u64 slotCount = pool->slotsPerChunk << i;
+        if(pointer >= chunk && pointer < chunk + slotCount * pool->stride) {
+            ASSERT((pointer - chunk) % pool->stride == 0);
+            return pool->slotsPerChunk * ((1ull << i) - 1) + (pointer - chunk) / pool->stride + 1;
+        }
+    }
+    return 0;
+}
+
+#ifdef GROUNDED_POOL_HANDLE_CHECK
+static volatile u32* poolGetGeneration(GroundedPool* pool, u64 slotIndex) {
+    u64 chunkStart = 0;
+    u32 chunkIndex = poolGetChunkIndex(pool, slotIndex, &chunkStart);
+    return &pool->generations[chunkIndex][slotIndex - chunkStart];
+}
+
+// Switches the slot between free (even) and allocated (odd)
+static void poolToggleGeneration(GroundedPool* pool, void* object, bool allocate) {
+    u64 slotIndex = poolFindSlotIndex(pool, object);
+    ASSERT(slotIndex);
+    u32 previous = groundedAtomicFetchAdd32(poolGetGeneration(pool, slotIndex - 1), 1, GROUNDED_MEMORY_ORDER_RELEASE);
+    // Detects double frees and corrupted free lists
+    ASSERT((previous & 1) == (allocate ? 0 : 1));
+}
+#endif
+
+GROUNDED_FUNCTION void groundedCreatePool(GroundedPool* pool, MemoryArena* arena, u64 objectSize, u64 alignment, u64 slotsPerChunk) {
+    ASSERT(IS_POW2(alignment));
+    *pool = (GroundedPool){0};
+    pool->mutex = groundedCreateMutex();
+    pool->arena = arena;
+    pool->arenaMarker = arenaCreateMarker(arena);
+    // Free slots store the free list link in place
+    pool->alignment = MAX(alignment, ALIGNMENT_OF(GroundedPoolFreeSlot));
+    pool->stride = ALIGN_UP_POW2(MAX(objectSize, sizeof(GroundedPoolFreeSlot)), pool->alignment);
+    pool->slotsPerChunk = slotsPerChunk ? slotsPerChunk : 64;
+}
+
+GROUNDED_FUNCTION void groundedDestroyPool(GroundedPool* pool) {
+    ASSERT(pool->allocatedCount == 0);
+    arenaResetToMarker(pool->arenaMarker);
+    groundedDestroyMutex(&pool->mutex);
+    *pool = (GroundedPool){0};
+}
+
+// Must be called with the mutex held
+static GroundedPoolFreeSlot* poolTakeSlotLocked(GroundedPool* pool) {
+    GroundedPoolFreeSlot* result = pool->freeList;
+    if(result) {
+        pool->freeList = result->next;
+    } else {
+        u64 slotIndex = pool->usedSlotCount;
+        if(slotIndex >= 0xFFFFFFFF) {
+            GROUNDED_LOG_ERROR("Pool exceeded maximum number of slots addressable by handles");
+            return 0;
+        }
+        u64 chunkStart = 0;
+        u32 chunkIndex = poolGetChunkIndex(pool, slotIndex, &chunkStart);
+        if(chunkIndex >= GROUNDED_POOL_MAX_CHUNKS) {
+            GROUNDED_LOG_ERROR("Pool exceeded maximum number of chunks");
+            return 0;
+        }
+        if(!pool->chunks[chunkIndex]) {
+            u64 slotCount = pool->slotsPerChunk << chunkIndex;
+            u8* chunk = ARENA_PUSH_ARRAY_NO_CLEAR_ALIGNED(pool->arena, slotCount * pool->stride, u8, pool->alignment);
+            if(!chunk) return 0;
+#ifdef GROUNDED_POOL_HANDLE_CHECK
+            u32* generations = ARENA_PUSH_ARRAY(pool->arena, slotCount, u32);
+            if(!generations) return 0;
+            pool->generations[chunkIndex] = generations;
+#endif
+            groundedAtomicStorePointer((void* volatile*)&pool->chunks[chunkIndex], chunk, GROUNDED_MEMORY_ORDER_RELEASE);
+        }
+        result = (GroundedPoolFreeSlot*)(pool->chunks[chunkIndex] + (slotIndex - chunkStart) * pool->stride);
+        pool->usedSlotCount++;
+    }
+    pool->allocatedCount++;
+    return result;
+}
+
+static void poolReturnSlotLocked(GroundedPool* pool, GroundedPoolFreeSlot* slot) {
+    slot->next = pool->freeList;
+    pool->freeList = slot;
+    pool->allocatedCount--;
+}
+
+GROUNDED_FUNCTION void* groundedPoolAllocate(GroundedPool* pool) {
+    groundedLockMutex(&pool->mutex);
+    void* result = poolTakeSlotLocked(pool);
+    groundedUnlockMutex(&pool->mutex);
+    if(result) {
+#ifdef GROUNDED_POOL_HANDLE_CHECK
+        poolToggleGeneration(pool, result, true);
+#endif
+        groundedClearMemory(result, pool->stride);
+    }
+    return result;
+}
+
+GROUNDED_FUNCTION void groundedPoolFree(GroundedPool* pool, void* object) {
+    if(!object) return;
+#ifdef GROUNDED_POOL_HANDLE_CHECK
+    poolToggleGeneration(pool, object, false);
+#endif
+    groundedLockMutex(&pool->mutex);
+    poolReturnSlotLocked(pool, (GroundedPoolFreeSlot*)object);
+    groundedUnlockMutex(&pool->mutex);
+}
+
+GROUNDED_FUNCTION void* groundedPoolCacheAllocate(GroundedPool* pool, GroundedPoolCache* cache) {
+    if(!cache->freeList) {
+        // Refill a whole batch with a single lock
+        groundedLockMutex(&pool->mutex);
+        for(u32 i = 0; i < GROUNDED_POOL_CACHE_BATCH_SIZE; ++i) {
+            GroundedPoolFreeSlot* slot = poolTakeSlotLocked(pool);
+            if(!slot) break;
+            slot->next = cache->freeList;
+            cache->freeList = slot;
+            cache->count++;
+        }
+        groundedUnlockMutex(&pool->mutex);
+    }
+
+    GroundedPoolFreeSlot* result = cache->freeList;
+    if(result) {
+        cache->freeList = result->next;
+        cache->count--;
+#ifdef GROUNDED_POOL_HANDLE_CHECK
+        poolToggleGeneration(pool, result, true);
+#endif
+        groundedClearMemory(result, pool->stride);
+    }
+    return result;
+}
+
+GROUNDED_FUNCTION void groundedPoolCacheFree(GroundedPool* pool, GroundedPoolCache* cache, void* object) {
+    if(!object) return;
+#ifdef GROUNDED_POOL_HANDLE_CHECK
+    poolToggleGeneration(pool, object, false);
+#endif
+    GroundedPoolFreeSlot* slot = (GroundedPoolFreeSlot*)object;
+    slot->next = cache->freeList;
+    cache->freeList = slot;
+    cache->count++;
+
+    if(cache->count >= 2 * GROUNDED_POOL_CACHE_BATCH_SIZE) {
+        // Give a batch back so slots freed on this thread become available to others
+        groundedLockMutex(&pool->mutex);
+        for(u32 i = 0; i < GROUNDED_POOL_CACHE_BATCH_SIZE; ++i) {
+            GroundedPoolFreeSlot* returned = cache->freeList;
+            cache->freeList = returned->next;
+            cache->count--;
+            poolReturnSlotLocked(pool, returned);
+        }
+        groundedUnlockMutex(&pool->mutex);
+    }
+}
+
+GROUNDED_FUNCTION void groundedPoolCacheFlush(GroundedPool* pool, GroundedPoolCache* cache) {
+    if(!cache->freeList) return;
+    groundedLockMutex(&pool->mutex);
+    while(cache->freeList) {
+        GroundedPoolFreeSlot* returned = cache->freeList;
+        cache->freeList = returned->next;
+        poolReturnSlotLocked(pool, returned);
+    }
+    cache->count = 0;
+    groundedUnlockMutex(&pool->mutex);
+}
+
+GROUNDED_FUNCTION GroundedPoolHandle groundedPoolGetHandle(GroundedPool* pool, void* object) {
+    u64 slotIndex = poolFindSlotIndex(pool, object);
+    ASSERT(slotIndex);
+    // The lower 32 bits always hold the index so handles do not depend on GROUNDED_POOL_HANDLE_CHECK
+    ASSERT(slotIndex <= 0xFFFFFFFF);
+    GroundedPoolHandle result = slotIndex & 0xFFFFFFFF;
+#ifdef GROUNDED_POOL_HANDLE_CHECK
+    if(slotIndex) {
+        u32 generation = groundedAtomicLoad32(poolGetGeneration(pool, slotIndex - 1), GROUNDED_MEMORY_ORDER_ACQUIRE);
+        ASSERT(generation & 1);
+        result |= (u64)generation << 32;
+    }
+#endif
+    return result;
+}
+
+GROUNDED_FUNCTION void* groundedPoolGet(GroundedPool* pool, GroundedPoolHandle handle) {
+    u64 slotIndex = handle & 0xFFFFFFFF;
+    if(!slotIndex) return 0;
+    u8* result = poolGetSlot(pool, slotIndex - 1);
+#ifdef GROUNDED_POOL_HANDLE_CHECK
+    if(result) {
+        u32 generation = groundedAtomicLoad32(poolGetGeneration(pool, slotIndex - 1), GROUNDED_MEMORY_ORDER_ACQUIRE);
+        if(generation != (u32)(handle >> 32)) {
+            GROUNDED_LOG_WARNING("Access to pool object through stale handle");
+            result = 0;
+        }
+    }
+#endif
+    return result;
+}
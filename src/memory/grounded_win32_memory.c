@@ -1,6 +1,7 @@
 #include <grounded/memory/grounded_memory.h>
 #include <grounded/memory/grounded_arena.h>
 #include <grounded/memory/grounded_stream.h>
+#include <grounded/logger/grounded_logger.h>
 
 #include <windows.h>
 
@@ -17,6 +18,21 @@ GROUNDED_FUNCTION void* osReserveMemory(u64 size) {
     return memory;
 }
 
+// Large pages on windows can not be reserved without committing them and require the SeLockMemoryPrivilege.
+// So huge page flags only change the reservation and commit granularity
+GROUNDED_FUNCTION void* osReserveMemoryWithFlags(u64 size, u32 flags, u32 numaNode) {
+    void* memory = 0;
+    if(flags & (GROUNDED_VIRTUAL_MEMORY_HUGE_PAGES | GROUNDED_VIRTUAL_MEMORY_HUGE_PAGES_EXPLICIT)) {
+        size = ALIGN_UP_POW2(size, GROUNDED_HUGE_PAGE_SIZE);
+    }
+    if(flags & GROUNDED_VIRTUAL_MEMORY_NUMA_BIND) {
+        memory = VirtualAllocExNuma(GetCurrentProcess(), 0, size, MEM_RESERVE, PAGE_READWRITE, numaNode);
+    } else {
+        memory = osReserveMemory(size);
+    }
+    return memory;
+}
+
 GROUNDED_FUNCTION void* osAllocateGuardedMemory(u64 size, u64 alignment, bool overflow) {
     u64 allocateSize = ALIGN_UP_POW2(size, 4096) + 4096;
     u8* memory = (u8*)VirtualAlloc(0, allocateSize, MEM_COMMIT, PAGE_READWRITE);
@@ -69,12 +85,39 @@ GROUNDED_FUNCTION void osRelease(void* context, void* ptr, u64 size) {
 
 
 
+// The reservation size is page aligned so the low bits of additionalInteger hold the flags and the NUMA node
+#define CONTIGOUS_VIRTUAL_MEMORY_RESERVE_SIZE(arena) ((arena)->additionalInteger & ~0xFFFull)
+#define CONTIGOUS_VIRTUAL_MEMORY_FLAGS(arena) ((u32)(arena)->additionalInteger & GROUNDED_VIRTUAL_MEMORY_FLAG_MASK)
+#define CONTIGOUS_VIRTUAL_MEMORY_NUMA_NODE(arena) ((u32)((arena)->additionalInteger >> 4) & 0xFF)
+
 GROUNDED_FUNCTION void* contigousVirtualMemoryArenaGrow(MemoryArena* arena, u64* size, u64 alignment) {
     ASSERT(arena->pos + *size > arena->commitPos);
-    u64 commitSize = ALIGN_UP_POW2(*size, 4096);
-    osCommitMemory(arena->memory + arena->commitPos, commitSize);
+    u32 flags = CONTIGOUS_VIRTUAL_MEMORY_FLAGS(arena);
+    u64 reserveSize = CONTIGOUS_VIRTUAL_MEMORY_RESERVE_SIZE(arena);
+    u64 granularity = (flags & (GROUNDED_VIRTUAL_MEMORY_HUGE_PAGES | GROUNDED_VIRTUAL_MEMORY_HUGE_PAGES_EXPLICIT)) ? GROUNDED_HUGE_PAGE_SIZE : 4096;
+    u64 commitSize = ALIGN_UP_POW2(*size, granularity);
+    if(arena->commitPos + commitSize > reserveSize) {
+        if(arena->commitPos + *size > reserveSize) {
+            GROUNDED_LOG_ERROR("Contigous virtual memory arena exceeded its reserved size");
+            *size = 0;
+            return 0;
+        }
+        commitSize = reserveSize - arena->commitPos;
+    }
+    u8* commitStart = arena->memory + arena->commitPos;
+    if(flags & GROUNDED_VIRTUAL_MEMORY_NUMA_BIND) {
+        VirtualAllocExNuma(GetCurrentProcess(), commitStart, commitSize, MEM_COMMIT, PAGE_READWRITE, CONTIGOUS_VIRTUAL_MEMORY_NUMA_NODE(arena));
+    } else {
+        osCommitMemory(commitStart, commitSize);
+    }
+    if(flags & GROUNDED_VIRTUAL_MEMORY_PREFAULT) {
+        for(u64 offset = 0; offset < commitSize; offset += 4096) {
+            ((volatile u8*)commitStart)[offset] = 0;
+        }
+    }
+    arena->committedSize += commitSize;
     *size = commitSize;
-    return arena->memory + arena->commitPos;
+    return commitStart;
 }
 
 GROUNDED_FUNCTION void contigousVirtualMemoryArenaShrink(MemoryArena* arena, u8* newHead) {
@@ -82,20 +125,43 @@ GROUNDED_FUNCTION void contigousVirtualMemoryArenaShrink(MemoryArena* arena, u8*
     if(newHead == 0) {
         // Decommit not necessary
         //osDecommitMemory(arena->memory, arena->commitPos);
-        osReleaseMemory(arena->memory, arena->additionalInteger);
+        osReleaseMemory(arena->memory, CONTIGOUS_VIRTUAL_MEMORY_RESERVE_SIZE(arena));
+        arena->committedSize = 0;
     }
 }
 
-GROUNDED_FUNCTION MemoryArena createContigousVirtualMemoryArena(u64 maxVirtualMemorySize) {
+GROUNDED_FUNCTION void contigousVirtualMemoryArenaTrim(MemoryArena* arena, u64 keepSize) {
+    u32 flags = CONTIGOUS_VIRTUAL_MEMORY_FLAGS(arena);
+    u64 granularity = (flags & (GROUNDED_VIRTUAL_MEMORY_HUGE_PAGES | GROUNDED_VIRTUAL_MEMORY_HUGE_PAGES_EXPLICIT)) ? GROUNDED_HUGE_PAGE_SIZE : 4096;
+    u64 keepCommitPos = ALIGN_UP_POW2(MAX(keepSize, arena->pos), granularity);
+    if(keepCommitPos < arena->commitPos) {
+        osDecommitMemory(arena->memory + keepCommitPos, arena->commitPos - keepCommitPos);
+        arena->committedSize -= arena->commitPos - keepCommitPos;
+        arena->commitPos = keepCommitPos;
+    }
+}
+
+GROUNDED_FUNCTION MemoryArena createContigousVirtualMemoryArenaWithFlags(u64 maxVirtualMemorySize, u32 flags, u32 numaNode) {
     ASSERT(sizeof(void*) >= 8);
+    ASSERT(!(flags & ~GROUNDED_VIRTUAL_MEMORY_FLAG_MASK));
+    ASSERT(numaNode <= GROUNDED_VIRTUAL_MEMORY_MAX_NUMA_NODE);
+    u64 reserveSize = ALIGN_UP_POW2(maxVirtualMemorySize, 4096);
+    if(flags & (GROUNDED_VIRTUAL_MEMORY_HUGE_PAGES | GROUNDED_VIRTUAL_MEMORY_HUGE_PAGES_EXPLICIT)) {
+        reserveSize = ALIGN_UP_POW2(reserveSize, GROUNDED_HUGE_PAGE_SIZE);
+    }
     MemoryArena result = {0};
-    result.memory = osReserveMemory(maxVirtualMemorySize);
-    result.additionalInteger = maxVirtualMemorySize;
+    result.memory = osReserveMemoryWithFlags(reserveSize, flags, numaNode);
+    result.additionalInteger = reserveSize | flags | ((u64)numaNode << 4);
     result.grow = (ArenaGrowFunc*) &contigousVirtualMemoryArenaGrow;
     result.shrink = (ArenaShrinkFunc*) &contigousVirtualMemoryArenaShrink;
+    result.trim = (ArenaTrimFunc*) &contigousVirtualMemoryArenaTrim;
     return result;
 }
 
+GROUNDED_FUNCTION MemoryArena createContigousVirtualMemoryArena(u64 maxVirtualMemorySize) {
+    return createContigousVirtualMemoryArenaWithFlags(maxVirtualMemorySize, 0, 0);
+}
+
 
 GROUNDED_FUNCTION MemorySubsystem* osGetMemorySubsystem() {
     static MemorySubsystem memorySubsystem = {0};
@@ -0,0 +1,179 @@
+#include <grounded/string/grounded_intern.h>
+#include <grounded/memory/grounded_memory.h>
+
+#define INTERN_INITIAL_CAPACITY_LOG2 8
+
+static GroundedInternEntry* internGetEntry(GroundedInternTable* table, GroundedStringId id) {
+    // Chunk k starts at entry GROUNDED_INTERN_FIRST_CHUNK_SIZE * (2^k - 1)
+    u64 index = id - 1;
+    u32 chunkIndex = groundedLog2u64(index / GROUNDED_INTERN_FIRST_CHUNK_SIZE + 1);
+    u64 chunkStart = GROUNDED_INTERN_FIRST_CHUNK_SIZE * ((1ull << chunkIndex) - 1);
+    GroundedInternEntry* chunk = (GroundedInternEntry*)groundedAtomicLoadPointer((void* volatile*)&table->chunks[chunkIndex], GROUNDED_MEMORY_ORDER_ACQUIRE);
+    return &chunk[index - chunkStart];
+}
+
+// Fibonacci hashing spreads the hash over the whole table independent of the quality of its low bits
+static u64 internGetPosition(GroundedInternHashTable* hashTable, u64 hash) {
+    return (hash * 0x9E3779B97F4A7C15ull) >> (64 - hashTable->capacityLog2);
+}
+
+static GroundedStringId internFindInHashTable(GroundedInternTable* table, GroundedInternHashTable* hashTable, String8 string, u64 hash) {
+    u64 mask = hashTable->capacity - 1;
+    u64 position = internGetPosition(hashTable, hash);
+    while(true) {
+        u64 slot = groundedAtomicLoad64(&hashTable->slots[position], GROUNDED_MEMORY_ORDER_ACQUIRE);
+        if(!slot) {
+            return 0;
+        }
+        if((slot >> 32) == (hash >> 32)) {
+            GroundedStringId id = (GroundedStringId)slot;
+            GroundedInternEntry* entry = internGetEntry(table, id);
+            if(entry->hash == hash && str8IsEqual(entry->string, string)) {
+                return id;
+            }
+        }
+        position = (position + 1) & mask;
+    }
+}
+
+static void internInsertIntoHashTable(GroundedInternHashTable* hashTable, u64 hash, GroundedStringId id) {
+    u64 mask = hashTable->capacity - 1;
+    u64 position = internGetPosition(hashTable, hash);
+    while(hashTable->slots[position]) {
+        position = (position + 1) & mask;
+    }
+    // Publishes the entry to readers
+    groundedAtomicStore64(&hashTable->slots[position], ((hash >> 32) << 32) | id, GROUNDED_MEMORY_ORDER_RELEASE);
+}
+
+static GroundedInternHashTable* internCreateHashTable(MemoryArena* arena, u32 capacityLog2) {
+    u64 capacity = 1ull << capacityLog2;
+    GroundedInternHashTable* result = (GroundedInternHashTable*)_arenaPushSize(arena, sizeof(GroundedInternHashTable) + capacity * sizeof(u64), ALIGNMENT_OF(GroundedInternHashTable), true, __LINE__, STR8_LITERAL(__FILE__));
+    if(result) {
+        result->capacity = capacity;
+        result->capacityLog2 = capacityLog2;
+    }
+    return result;
+}
+
+GROUNDED_FUNCTION void groundedCreateInternTable(GroundedInternTable* table, MemoryArena* arena) {
+    *table = (GroundedInternTable){0};
+    table->mutex = groundedCreateMutex();
+    table->arena = arena;
+    table->arenaMarker = arenaCreateMarker(arena);
+    table->hashTable = internCreateHashTable(arena, INTERN_INITIAL_CAPACITY_LOG2);
+}
+
+GROUNDED_FUNCTION void groundedDestroyInternTable(GroundedInternTable* table) {
+    arenaResetToMarker(table->arenaMarker);
+    groundedDestroyMutex(&table->mutex);
+    *table = (GroundedInternTable){0};
+}
+
+static GroundedStringId internFind(GroundedInternTable* table, String8 string, u64 hash) {
+    GroundedInternHashTable* hashTable = (GroundedInternHashTable*)groundedAtomicLoadPointer((void* volatile*)&table->hashTable, GROUNDED_MEMORY_ORDER_ACQUIRE);
+    if(!hashTable) return 0;
+    return internFindInHashTable(table, hashTable, string, hash);
+}
+
+static GroundedStringId internInsert(GroundedInternTable* table, String8 string, u64 hash) {
+    GroundedStringId result = internFind(table, string, hash);
+    if(result) {
+        return result;
+    }
+
+    groundedLockMutex(&table->mutex);
+    // Another thread might have inserted the string in the meantime
+    result = internFind(table, string, hash);
+    if(!result && table->hashTable) {
+        GroundedInternHashTable* hashTable = table->hashTable;
+        u32 count = table->count;
+        u64 index = count;
+        u32 chunkIndex = groundedLog2u64(index / GROUNDED_INTERN_FIRST_CHUNK_SIZE + 1);
+        if(count == UINT32_MAX || chunkIndex >= GROUNDED_INTERN_MAX_CHUNKS) {
+            GROUNDED_LOG_ERROR("Intern table is full");
+            groundedUnlockMutex(&table->mutex);
+            return 0;
+        }
+
+        // Readers never see a table above half load so probe sequences stay short
+        if((u64)(count + 1) * 2 > hashTable->capacity) {
+            GroundedInternHashTable* newHashTable = internCreateHashTable(table->arena, hashTable->capacityLog2 + 1);
+            if(!newHashTable) {
+                groundedUnlockMutex(&table->mutex);
+                return 0;
+            }
+            for(u32 i = 0; i < count; ++i) {
+                internInsertIntoHashTable(newHashTable, internGetEntry(table, i + 1)->hash, i + 1);
+            }
+            // The old table stays valid for readers that are still using it
+            groundedAtomicStorePointer((void* volatile*)&table->hashTable, newHashTable, GROUNDED_MEMORY_ORDER_RELEASE);
+            hashTable = newHashTable;
+        }
+
+        if(!table->chunks[chunkIndex]) {
+            GroundedInternEntry* chunk = ARENA_PUSH_ARRAY_NO_CLEAR(table->arena, GROUNDED_INTERN_FIRST_CHUNK_SIZE << chunkIndex, GroundedInternEntry);
+            if(!chunk) {
+                groundedUnlockMutex(&table->mutex);
+                return 0;
+            }
+            groundedAtomicStorePointer((void* volatile*)&table->chunks[chunkIndex], chunk, GROUNDED_MEMORY_ORDER_RELEASE);
+        }
+        u8* copy = ARENA_PUSH_ARRAY_NO_CLEAR(table->arena, string.size + 1, u8);
+        if(!copy) {
+            groundedUnlockMutex(&table->mutex);
+            return 0;
+        }
+        memcpy(copy, string.base, string.size);
+        copy[string.size] = '\0';
+
+        result = count + 1;
+        GroundedInternEntry* entry = internGetEntry(table, result);
+        entry->string = (String8){copy, string.size};
+        entry->hash = hash;
+        groundedAtomicStore32(&table->count, count + 1, GROUNDED_MEMORY_ORDER_RELEASE);
+        internInsertIntoHashTable(hashTable, hash, result);
+    }
+    groundedUnlockMutex(&table->mutex);
+    return result;
+}
+
+GROUNDED_FUNCTION GroundedStringId groundedInternString(GroundedInternTable* table, String8 string) {
+    return internInsert(table, string, atomHashBytes(string.base, string.size));
+}
+
+GROUNDED_FUNCTION GroundedStringId groundedInternAtom(GroundedInternTable* table, StringAtom atom) {
+    return internInsert(table, atom.string, atom.hash);
+}
+
+GROUNDED_FUNCTION GroundedStringId groundedInternFind(GroundedInternTable* table, String8 string) {
+    return internFind(table, string, atomHashBytes(string.base, string.size));
+}
+
+GROUNDED_FUNCTION String8 groundedInternGetString(GroundedInternTable* table, GroundedStringId id) {
+    ASSERT(id > 0 && id <= groundedAtomicLoad32(&table->count, GROUNDED_MEMORY_ORDER_ACQUIRE));
+    return internGetEntry(table, id)->string;
+}
+
+GROUNDED_FUNCTION u32 groundedInternGetCount(GroundedInternTable* table) {
+    return groundedAtomicLoad32(&table->count, GROUNDED_MEMORY_ORDER_ACQUIRE);
+}
+
+GROUNDED_FUNCTION GroundedInternTable* groundedGetGlobalInternTable() {
+    static GroundedInternTable globalTable;
+    static MemoryArena globalArena;
+    static volatile u32 state; // 0 = not created, 1 = being created, 2 = ready
+    if(groundedAtomicLoad32(&state, GROUNDED_MEMORY_ORDER_ACQUIRE) != 2) {
+        u32 expected = 0;
+        if(groundedAtomicCompareExchange32(&state, &expected, 1, GROUNDED_MEMORY_ORDER_ACQ_REL)) {
+            globalArena = createGrowingArena(osGetMemorySubsystem(), KB(64));
+            groundedCreateInternTable(&globalTable, &globalArena);
+            groundedAtomicStore32(&state, 2, GROUNDED_MEMORY_ORDER_RELEASE);
+        } else {
+            while(groundedAtomicLoad32(&state, GROUNDED_MEMORY_ORDER_ACQUIRE) != 2) {
+                groundedPause();
+            }
+        }
+    }
+    return &globalTable;
+}
@@ -11,6 +11,29 @@
 #undef STB_SPRINTF_IMPLEMENTATION
 #undef STB_SPRINTF_NOUNALIGNED
 
+#include "grounded_string_simd.inl"
+#include "grounded_string_utf.inl"
+
+// Index into the deltas of a generated case table. 0 means the codepoint has no mapping
+#define CASE_MAPPING_INDEX(table, codepoint) (((codepoint) >> UNICODE_CASE_BLOCK_SHIFT) < ARRAY_COUNT(table##Blocks) ? \
+    table##Indices[((u32)table##Blocks[(codepoint) >> UNICODE_CASE_BLOCK_SHIFT] << UNICODE_CASE_BLOCK_SHIFT) | ((codepoint) & UNICODE_CASE_BLOCK_MASK)] : 0)
+
+// Returns UINT32_MAX if the codepoint has no mapping
+static inline u32 lookupLowercase(u32 codepoint) {
+    u32 index = CASE_MAPPING_INDEX(toLower, codepoint);
+    return index ? codepoint + toLowerDeltas[index] : UINT32_MAX;
+}
+
+static inline u32 lookupUppercase(u32 codepoint) {
+    u32 index = CASE_MAPPING_INDEX(toUpper, codepoint);
+    return index ? codepoint + toUpperDeltas[index] : UINT32_MAX;
+}
+
+static inline u32 codepointToLower(u32 codepoint) {
+    u32 result = lookupLowercase(codepoint);
+    return result == UINT32_MAX ? codepoint : result;
+}
+
 GROUNDED_FUNCTION String8 str8Prefix(String8 str, u64 size) {
     ASSERT(size <= str.size);
     u64 sizeClamped = CLAMP_TOP(size, str.size);
@@ -57,10 +80,7 @@ GROUNDED_FUNCTION String8 str8Join(struct MemoryArena* arena, String8 first, Str
 
 GROUNDED_FUNCTION bool str8IsEqual(String8 a, String8 b) {
     if(a.size == b.size) {
-        if(a.size == 0) {
-            return true;
-        }
-        return groundedCompareMemory(a.base, b.base, a.size);
+        return strFindMismatch(a.base, b.base, a.size) == a.size;
     }
     return false;
 }
@@ -71,12 +91,17 @@ GROUNDED_FUNCTION bool str8IsEqualCaseInsensitive(String8 a, String8 b) {
         u64 offsetB = 0;
 
         while(offsetA < a.size && offsetB < b.size) {
+            u64 equal = strFindAsciiCaseInsensitiveMismatch(a.base + offsetA, b.base + offsetB, MIN(a.size - offsetA, b.size - offsetB));
+            offsetA += equal;
+            offsetB += equal;
+            if(offsetA >= a.size || offsetB >= b.size) break;
+
             StringDecode decodeA = strDecodeUtf8(a.base + offsetA, a.size - offsetA);
             offsetA += decodeA.size;
             StringDecode decodeB = strDecodeUtf8(b.base + offsetB, b.size - offsetB);
             offsetB += decodeB.size;
-            u32 codepointA = strCodepointToLower(decodeA.codepoint);
-            u32 codepointB = strCodepointToLower(decodeB.codepoint);
+            u32 codepointA = codepointToLower(decodeA.codepoint);
+            u32 codepointB = codepointToLower(decodeB.codepoint);
             if(codepointA != codepointB) {
                 return false;
             }
@@ -88,12 +113,9 @@ GROUNDED_FUNCTION bool str8IsEqualCaseInsensitive(String8 a, String8 b) {
 
 GROUNDED_FUNCTION int str8Compare(String8 a, String8 b) {
     u64 size = MIN(a.size, b.size);
-    for(u64 i = 0; i < size; ++i) {
-        if(a.base[i] < b.base[i]) {
-            return -1;
-        } else if(a.base[i] > b.base[i]) {
-            return 1;
-        }
+    u64 mismatch = strFindMismatch(a.base, b.base, size);
+    if(mismatch < size) {
+        return a.base[mismatch] < b.base[mismatch] ? -1 : 1;
     }
     return a.size < b.size ? -1 : ((a.size > b.size) ? 1 : 0);
 }
@@ -103,12 +125,18 @@ GROUNDED_FUNCTION int str8CompareCaseInsensitive(String8 a, String8 b) {
     u64 offsetB = 0;
 
     while(offsetA < a.size && offsetB < b.size) {
+        // Equal ASCII prefixes are skipped a vector at a time
+        u64 equal = strFindAsciiCaseInsensitiveMismatch(a.base + offsetA, b.base + offsetB, MIN(a.size - offsetA, b.size - offsetB));
+        offsetA += equal;
+        offsetB += equal;
+        if(offsetA >= a.size || offsetB >= b.size) break;
+
         StringDecode decodeA = strDecodeUtf8(a.base + offsetA, a.size - offsetA);
         offsetA += decodeA.size;
         StringDecode decodeB = strDecodeUtf8(b.base + offsetB, b.size - offsetB);
         offsetB += decodeB.size;
-        u32 codepointA = strCodepointToLower(decodeA.codepoint);
-        u32 codepointB = strCodepointToLower(decodeB.codepoint);
+        u32 codepointA = codepointToLower(decodeA.codepoint);
+        u32 codepointB = codepointToLower(decodeB.codepoint);
         if(codepointA < codepointB) {
             return -1;
         } else if(codepointA > codepointB) {
@@ -119,29 +147,21 @@ GROUNDED_FUNCTION int str8CompareCaseInsensitive(String8 a, String8 b) {
 }
 
 GROUNDED_FUNCTION u64 str8GetFirstOccurence(String8 str, char c) {
-    for(u64 i = 0; i < str.size; ++i) {
-        if(str.base[i] == c) return i;
-    }
-    return UINT64_MAX;
+    return strFindByte(str.base, str.size, (u8)c);
 }
 
 GROUNDED_FUNCTION u64 str8GetLastOccurence(String8 str, char c) {
-    for(u64 i = str.size; i > 0; --i) {
-        if(str.base[i-1] == c) return i-1;
-    }
-    return UINT64_MAX;
+    return strFindLastByte(str.base, str.size, (u8)c);
+}
+
+GROUNDED_FUNCTION u64 str8GetFirstOccurenceOfSubstring(String8 str, String8 substring) {
+    return strFindSubstring(str.base, str.size, substring.base, substring.size);
 }
 
 GROUNDED_FUNCTION bool str8IsPrefixOf(String8 prefix, String8 str) {
     bool result = false;
     if(prefix.size <= str.size) {
-        result = true;
-        for(u64 i = 0; i < prefix.size; ++i) {
-            if(prefix.base[i] != str.base[i]) {
-                result = false;
-                break;
-            }
-        }
+        result = strFindMismatch(prefix.base, str.base, prefix.size) == prefix.size;
     }
     return result;
 }
@@ -157,59 +177,13 @@ GROUNDED_FUNCTION bool str8IsPrefixOfCaseInsensitive(String8 prefix, String8 str
 GROUNDED_FUNCTION bool str8IsPostfixOf(String8 postfix, String8 str) {
     bool result = false;
     if(postfix.size <= str.size) {
-        result = true;
-        for(u64 i = 0; i < postfix.size; ++i) {
-            if(postfix.base[postfix.size-i-1] != str.base[str.size-i-1]) {
-                result = false;
-                break;
-            }
-        }
+        result = strFindMismatch(postfix.base, str.base + str.size - postfix.size, postfix.size) == postfix.size;
     }
     return result;
 }
 
 GROUNDED_FUNCTION bool str8IsSubstringOf(String8 substring, String8 str) {
-    bool result = false;
-    if(substring.size <= str.size) {
-        for(u64 i = 0; i < (str.size - substring.size + 1); ++i) {
-            result = true;
-            for(u64 j = 0; j < substring.size; ++j) {
-                ASSERT(i+j < str.size);
-                if(substring.base[j] != str.base[i+j]) {
-                    result = false;
-                    break;
-                }
-            }
-            if(result) {
-                break;
-            }
-        }
-    }
-    return result;
-}
-
-static u32 lookupCodepointConversion(const UnicodeMapping* mappings, u32 mappingCount, u32 codepoint) {
-    u32 result = UINT32_MAX;
-    if(mappingCount > 0 && mappingCount <= INT32_MAX && codepoint >= mappings[0].source) {
-        s32 left = 0;
-        s32 right = MIN((codepoint - mappings[0].source), mappingCount - 1);
-        while(left <= right) {
-            s32 middle = left + (right - left) / 2;
-            // Skewed midpoint: give more weight to the left side
-            // int middle = left + (right - left) / 2 - (right - left) / 8;  // Adjust by a bias factor
-
-            if(toLower[middle].source == codepoint) {
-                result = toLower[middle].target;
-                break;
-            }
-            if (toLower[middle].source < codepoint) {
-                left = middle + 1;
-            } else {
-                right = middle - 1;
-            }
-        }
-    }
-    return result;
+    return strFindSubstring(str.base, str.size, substring.base, substring.size) != UINT64_MAX;
 }
 
 GROUNDED_FUNCTION bool str8IsLowercase(String8 str) {
@@ -222,9 +196,7 @@ GROUNDED_FUNCTION bool str8IsLowercase(String8 str) {
         StringDecode decode = strDecodeUtf8(ptr, (u32)(opl - ptr));
         if(decode.size == 0) break;
 
-        // Lookup in toLower table
-        u32 target = lookupCodepointConversion(toLower, ARRAY_COUNT(toLower), decode.codepoint);
-        if(target != UINT32_MAX) {
+        if(lookupLowercase(decode.codepoint) != UINT32_MAX) {
             result = false;
             break;
         }
@@ -244,9 +216,7 @@ GROUNDED_FUNCTION bool str8IsUppercase(String8 str) {
         StringDecode decode = strDecodeUtf8(ptr, (u32)(opl - ptr));
         if(decode.size == 0) break;
 
-        // Lookup in toUpper table
-        u32 target = lookupCodepointConversion(toUpper, ARRAY_COUNT(toUpper), decode.codepoint);
-        if(target != UINT32_MAX) {
+        if(lookupUppercase(decode.codepoint) != UINT32_MAX) {
             result = false;
             break;
         }
@@ -276,33 +246,13 @@ GROUNDED_FUNCTION s64 str8DeltaToNextWordBoundary(String8 str, u64 cursor, s64 i
     return result;
 }
 
+static bool str8BuilderAppendFormatVaList(String8Builder* builder, const char* format, va_list args);
+
 String8 str8FromFormatVaList(struct MemoryArena* arena, const char* format, va_list args) {
-    // In case we need to try a second time
-    va_list args2;
-    va_copy(args2, args);
-    
-    // Try to build the string in 1024 bytes
-    u64 bufferSize = 1024;
-    ArenaMarker firstBufferMarker = arenaCreateMarker(arena);
-    u8* buffer = ARENA_PUSH_ARRAY(arena, bufferSize, u8);
-    u64 actualSize = stbsp_vsnprintf((char*)buffer, bufferSize, format, args);
-    
-    String8 result = {0};
-    if (actualSize < bufferSize){
-        // Release excess memory
-        arenaPopTo(arena, buffer + actualSize + 1);
-        result = str8FromBlock(buffer, actualSize);
-    } else {
-        // If first try failed, reset and try again with correct size
-        arenaResetToMarker(firstBufferMarker);
-        u8* fixedBuffer = ARENA_PUSH_ARRAY(arena, actualSize + 1, u8);
-        u64 finalSize = stbsp_vsnprintf((char*)fixedBuffer, actualSize + 1, format, args2);
-        result = str8FromBlock(fixedBuffer, finalSize);
-    }
-    
-    va_end(args2);
-    
-    return result;
+    // Nothing else touches the arena while formatting so the builder writes everything in place
+    String8Builder builder = str8BuilderCreate(arena);
+    str8BuilderAppendFormatVaList(&builder, format, args);
+    return str8BuilderFinish(&builder);
 }
 
 GROUNDED_FUNCTION String8 str8FromFormat(struct MemoryArena* arena, const char* format, ...) {
@@ -348,31 +298,34 @@ GROUNDED_FUNCTION char* str8GetCstrOrNull(struct MemoryArena* arena, String8 str
     }
 }
 
-// Data for uppercase / lowercase conversion: https://www.unicode.org/Public/16.0.0/ucd/UnicodeData.txt
-GROUNDED_FUNCTION String8 str8ToLower(struct MemoryArena* arena, String8 str) {
+static String8 str8ConvertCase(MemoryArena* arena, String8 str, bool upper) {
     u8* ptr = str.base;
     u8* opl = str.base + str.size;
 
     u64 allocated = str.size*4+1;
-    u8* memory = ARENA_PUSH_ARRAY(arena, allocated, u8);
+    u8* memory = ARENA_PUSH_ARRAY_NO_CLEAR(arena, allocated, u8);
     u8* dptr = memory;
 
-    for(;ptr < opl;) {
-        StringDecode decode = strDecodeUtf8(ptr, (u32)(opl - ptr));
-        if(decode.size == 0) break;
-
-        // Lookup in toLower table
-        u32 target = lookupCodepointConversion(toLower, ARRAY_COUNT(toLower), decode.codepoint);
-        if(target == UINT32_MAX) {
-            // Character not found so we do not need to convert and simply copy source
-            MEMORY_COPY(dptr, ptr, decode.size);
-            dptr += decode.size;
-        } else {
-            u32 length = strEncodeUtf8(dptr, target);
-            dptr += length;
+    while(ptr < opl) {
+        u64 converted = strConvertAsciiCase(dptr, ptr, (u64)(opl - ptr), upper ? 'a' : 'A');
+        ptr += converted;
+        dptr += converted;
+
+        // The vector that stopped the ASCII fast path is converted codepoint by codepoint
+        u8* blockEnd = ptr + MIN(32, (u64)(opl - ptr));
+        while(ptr < blockEnd) {
+            StringDecode decode = strDecodeUtf8(ptr, (u32)(opl - ptr));
+            u32 target = upper ? lookupUppercase(decode.codepoint) : lookupLowercase(decode.codepoint);
+            if(target == UINT32_MAX) {
+                // Character has no mapping so we do not need to convert and simply copy source
+                MEMORY_COPY(dptr, ptr, decode.size);
+                dptr += decode.size;
+            } else {
+                u32 length = strEncodeUtf8(dptr, target);
+                dptr += length;
+            }
+            ptr += decode.size;
         }
-
-        ptr += decode.size;
     }
 
     // Null terminate and release overallocation
@@ -385,40 +338,13 @@ GROUNDED_FUNCTION String8 str8ToLower(struct MemoryArena* arena, String8 str) {
     return result;
 }
 
-GROUNDED_FUNCTION String8 str8ToUpper(struct MemoryArena* arena, String8 str) {
-    u8* ptr = str.base;
-    u8* opl = str.base + str.size;
-
-    u64 allocated = str.size*4+1;
-    u8* memory = ARENA_PUSH_ARRAY(arena, allocated, u8);
-    u8* dptr = memory;
-
-    for(;ptr < opl;) {
-        StringDecode decode = strDecodeUtf8(ptr, (u32)(opl - ptr));
-        if(decode.size == 0) break;
-
-        // Lookup in toUpper table
-        u32 target = lookupCodepointConversion(toUpper, ARRAY_COUNT(toUpper), decode.codepoint);
-        if(target == UINT32_MAX) {
-            // Character not found so we do not need to convert and simply copy source
-            MEMORY_COPY(dptr, ptr, decode.size);
-            dptr += decode.size;
-        } else {
-            u32 length = strEncodeUtf8(dptr, target);
-            dptr += length;
-        }
-
-        ptr += decode.size;
-    }
-
-    // Null terminate and release overallocation
-    ASSERT(dptr < memory + allocated);
-    *dptr = 0;
-    u64 stringCount = (u64)(dptr - memory);
-    arenaPopTo(arena, dptr+1);
+// Data for uppercase / lowercase conversion: https://www.unicode.org/Public/16.0.0/ucd/UnicodeData.txt
+GROUNDED_FUNCTION String8 str8ToLower(struct MemoryArena* arena, String8 str) {
+    return str8ConvertCase(arena, str, false);
+}
 
-    String8 result = {memory, stringCount};
-    return result;
+GROUNDED_FUNCTION String8 str8ToUpper(struct MemoryArena* arena, String8 str) {
+    return str8ConvertCase(arena, str, true);
 }
 
 GROUNDED_FUNCTION String8 str8ReplaceCharacter(struct MemoryArena* arena, String8 str, u8 oldCharacter, u8 newCharacter) {
@@ -524,32 +450,156 @@ GROUNDED_FUNCTION String8 str8ListJoin(MemoryArena* arena, String8List* list, St
     return result;
 }
 
-GROUNDED_FUNCTION String8List str8Split(MemoryArena* arena, String8 str, u8* splitCharacters, u64 splitCharacterCount) {
-    String8List result = {0};
+//////////////////
+// String builder
+#define STR8_BUILDER_MIN_CAPACITY 256
 
-    u8* ptr = str.base;
-    u8* wordFirst = ptr;
-    u8* opl = str.base + str.size;
-    for(;ptr < opl; ptr += 1) {
-        u8 byte = *ptr;
-        bool isSplitByte = false;
-        for(u64 i = 0; i < splitCharacterCount; ++i) {
-            if(byte == splitCharacters[i]) {
-                isSplitByte = true;
-                break;
+GROUNDED_FUNCTION String8Builder str8BuilderCreate(MemoryArena* arena) {
+    String8Builder result = {0};
+    result.arena = arena;
+    return result;
+}
+
+// Makes sure that size bytes can be written behind the current chunk
+static bool str8BuilderEnsure(String8Builder* builder, u64 size) {
+    u64 available = builder->chunkCapacity - builder->chunkSize;
+    if(available >= size) return true;
+    if(builder->outOfMemory) return false;
+
+    MemoryArena* arena = builder->arena;
+    // Doubling keeps the number of grow calls logarithmic. Unused space is popped again by str8BuilderFinish
+    u64 growSize = MAX(size - available, MAX(builder->chunkCapacity, STR8_BUILDER_MIN_CAPACITY));
+    u8* chunkEnd = builder->chunk + builder->chunkCapacity;
+    if(builder->chunk && arena->memory + arena->pos == chunkEnd) {
+        // The builder made the last allocation so it can grow in place
+        u8* memory = ARENA_PUSH_ARRAY_NO_CLEAR(arena, growSize, u8);
+        if(memory == chunkEnd) {
+            builder->chunkCapacity += growSize;
+            return true;
+        }
+        if(!memory) {
+            builder->outOfMemory = true;
+            return false;
+        }
+        // The arena continued in a new block. Give it back so the node of the closed chunk goes in front of the new chunk
+        arenaPopTo(arena, memory);
+    }
+
+    if(builder->chunkSize) {
+        String8Node* node = ARENA_PUSH_STRUCT(arena, String8Node);
+        if(!node) {
+            builder->outOfMemory = true;
+            return false;
+        }
+        str8ListPushExplicit(&builder->closedChunks, str8FromBlock(builder->chunk, builder->chunkSize), node);
+    }
+    u64 capacity = MAX(size, MAX(builder->chunkCapacity, STR8_BUILDER_MIN_CAPACITY));
+    u8* chunk = ARENA_PUSH_ARRAY_NO_CLEAR(arena, capacity, u8);
+    if(!chunk) {
+        builder->outOfMemory = true;
+        // The closed chunk is kept in the list
+        builder->chunk = 0;
+        builder->chunkSize = 0;
+        builder->chunkCapacity = 0;
+        return false;
+    }
+    builder->chunk = chunk;
+    builder->chunkSize = 0;
+    builder->chunkCapacity = capacity;
+    return true;
+}
+
+GROUNDED_FUNCTION bool str8BuilderAppend(String8Builder* builder, String8 str) {
+    if(!str8BuilderEnsure(builder, str.size)) return false;
+    // Copy of 0 bytes is UB
+    if(str.size) {
+        MEMORY_COPY(builder->chunk + builder->chunkSize, str.base, str.size);
+        builder->chunkSize += str.size;
+    }
+    return true;
+}
+
+GROUNDED_FUNCTION bool str8BuilderAppendCharacter(String8Builder* builder, u8 character) {
+    if(!str8BuilderEnsure(builder, 1)) return false;
+    builder->chunk[builder->chunkSize++] = character;
+    return true;
+}
+
+GROUNDED_FUNCTION u8* str8BuilderReserve(String8Builder* builder, u64 size) {
+    if(!str8BuilderEnsure(builder, size)) return 0;
+    return builder->chunk + builder->chunkSize;
+}
+
+GROUNDED_FUNCTION void str8BuilderCommit(String8Builder* builder, u64 size) {
+    ASSERT(size <= builder->chunkCapacity - builder->chunkSize);
+    builder->chunkSize += size;
+}
+
+GROUNDED_FUNCTION u64 str8BuilderGetSize(String8Builder* builder) {
+    return builder->closedChunks.totalSize + builder->chunkSize;
+}
+
+// stb_sprintf hands over every STB_SPRINTF_MIN bytes. They have already been written into the chunk
+static char* str8BuilderFormatCallback(const char* buffer, void* userData, int length) {
+    String8Builder* builder = (String8Builder*)userData;
+    ASSERT((u8*)buffer == builder->chunk + builder->chunkSize);
+    builder->chunkSize += (u64)length;
+    if(!str8BuilderEnsure(builder, STB_SPRINTF_MIN)) return 0;
+    return (char*)(builder->chunk + builder->chunkSize);
+}
+
+static bool str8BuilderAppendFormatVaList(String8Builder* builder, const char* format, va_list args) {
+    if(!str8BuilderEnsure(builder, STB_SPRINTF_MIN)) return false;
+    stbsp_vsprintfcb(str8BuilderFormatCallback, builder, (char*)(builder->chunk + builder->chunkSize), format, args);
+    return !builder->outOfMemory;
+}
+
+GROUNDED_FUNCTION bool str8BuilderAppendFormat(String8Builder* builder, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    bool result = str8BuilderAppendFormatVaList(builder, format, args);
+    va_end(args);
+    return result;
+}
+
+GROUNDED_FUNCTION String8 str8BuilderFinish(String8Builder* builder) {
+    String8 result = {0};
+    if(!builder->closedChunks.numNodes) {
+        if(str8BuilderEnsure(builder, 1)) {
+            builder->chunk[builder->chunkSize] = 0;
+            result = str8FromBlock(builder->chunk, builder->chunkSize);
+            MemoryArena* arena = builder->arena;
+            if(arena->memory + arena->pos == builder->chunk + builder->chunkCapacity) {
+                arenaPopTo(arena, builder->chunk + builder->chunkSize + 1);
             }
         }
-        if(isSplitByte) {
-            if(wordFirst < ptr) {
-                str8ListPush(arena, &result, str8FromRange(wordFirst, ptr));
+    } else {
+        if(builder->chunkSize) {
+            String8Node* node = ARENA_PUSH_STRUCT(builder->arena, String8Node);
+            if(node) {
+                str8ListPushExplicit(&builder->closedChunks, str8FromBlock(builder->chunk, builder->chunkSize), node);
             }
-            wordFirst = ptr+1;
         }
+        result = str8ListJoin(builder->arena, &builder->closedChunks, 0);
     }
+    *builder = (String8Builder){0};
+    return result;
+}
+
+GROUNDED_FUNCTION String8List str8Split(MemoryArena* arena, String8 str, u8* splitCharacters, u64 splitCharacterCount) {
+    String8List result = {0};
+    StrByteSet separators;
+    strByteSetInit(&separators, splitCharacters, splitCharacterCount);
 
-    // Emit final word
-    if(wordFirst < ptr) {
-        str8ListPush(arena, &result, str8FromRange(wordFirst, ptr));
+    u8* wordFirst = str.base;
+    u8* opl = str.base + str.size;
+    while(wordFirst < opl) {
+        u64 offset = strByteSetFindFirst(&separators, wordFirst, opl - wordFirst);
+        u8* wordOpl = offset == UINT64_MAX ? opl : wordFirst + offset;
+        if(wordFirst < wordOpl) {
+            str8ListPush(arena, &result, str8FromRange(wordFirst, wordOpl));
+        }
+        wordFirst = wordOpl + 1;
     }
 
     return result;
@@ -597,42 +647,8 @@ GROUNDED_FUNCTION String8* str8SplitToArray(MemoryArena* arena, String8 str, u8*
 //////////
 // Unicode
 
-// This implementation is quite efficient for strings containing mostly ASCII
-// but suffers from branch mispredictions in unicode heavy strings
-// Alternative would be SIMD version. See simdjson https://www.youtube.com/watch?v=wlvKAT7SZIQ
 GROUNDED_FUNCTION bool str8IsValidUtf8(String8 str) {
-    u64 sizeLeft = str.size;
-    u8* currentyBase = str.base;
-    
-    while(sizeLeft > 0) {
-        if(currentyBase[0] < 0x80) {
-            currentyBase++;
-            sizeLeft--;
-            continue;
-        } else if((currentyBase[0] & 0b11100000) == 0b11000000) {
-            if(sizeLeft < 2) return false;
-            if((currentyBase[1] & 0b11000000) != 0b10000000) return false;
-            sizeLeft -= 2;
-            currentyBase += 2;
-        } else if((currentyBase[0] & 0b11110000) == 0b11100000) {
-            if(sizeLeft < 3) return false;
-            if((currentyBase[1] & 0b11000000) != 0b10000000) return false;
-            if((currentyBase[2] & 0b11000000) != 0b10000000) return false;
-            sizeLeft -= 3;
-            currentyBase += 3;
-        } else if((currentyBase[0] & 0b11111000) == 0b11110000) {
-            if(sizeLeft < 4) return false;
-            if((currentyBase[1] & 0b11000000) != 0b10000000) return false;
-            if((currentyBase[2] & 0b11000000) != 0b10000000) return false;
-            if((currentyBase[3] & 0b11000000) != 0b10000000) return false;
-            sizeLeft -= 4;
-            currentyBase += 4;
-        } else {
-            // Invalid first byte
-            return false;
-        }
-    }
-    return true;
+    return strValidateUtf8(str.base, str.size);
 }
 
 GROUNDED_FUNCTION u32 strEncodeUtf8(u8* dst, u32 codepoint) {
@@ -698,15 +714,11 @@ GROUNDED_FUNCTION u32 strEncodeUtf16(u16* dst, u32 codepoint) {
 }
 
 GROUNDED_FUNCTION u32 strCodepointToLower(u32 codepoint) {
-    u32 result = lookupCodepointConversion(toLower, ARRAY_COUNT(toLower), codepoint);
-    if(result == UINT32_MAX) {
-        result = codepoint;
-    }
-    return result;
+    return codepointToLower(codepoint);
 }
 
 GROUNDED_FUNCTION u32 strCodepointToUpper(u32 codepoint) {
-    u32 result = lookupCodepointConversion(toUpper, ARRAY_COUNT(toUpper), codepoint);
+    u32 result = lookupUppercase(codepoint);
     if(result == UINT32_MAX) {
         result = codepoint;
     }
@@ -714,31 +726,25 @@ GROUNDED_FUNCTION u32 strCodepointToUpper(u32 codepoint) {
 }
 
 GROUNDED_FUNCTION String8 str8FromStr16(MemoryArena* arena, String16 str) {
-    u64 allocated = str.size*3+1;
-    u8* memory = ARENA_PUSH_ARRAY(arena, allocated, u8);
-    u8* dptr = memory;
-    u16* ptr = str.base;
-    u16* opl = str.base + str.size;
-
-    for(;ptr < opl;) {
-        StringDecode decode = strDecodeUtf16(ptr, (u32)(opl - ptr));
-        if(decode.size == 0) break;
-        u32 encodedSize = strEncodeUtf8(dptr, decode.codepoint);
-        ptr += decode.size;
-        dptr += encodedSize;
-    }
-
-    *dptr = 0;
-    u64 stringCount = (u64)(dptr - memory);
-    arenaPopTo(arena, dptr+1);
+    u64 stringCount = 0;
+    u64 codepointCount = 0;
+    u64 validCount = strUtf16Measure(str.base, str.size, &stringCount, &codepointCount);
+    u8* memory = ARENA_PUSH_ARRAY_NO_CLEAR(arena, stringCount + 1, u8);
+    strUtf16ToUtf8(str.base, validCount, memory);
+    memory[stringCount] = 0;
 
     String8 result = {memory, stringCount};
     return result;
 }
 
 GROUNDED_FUNCTION String8 str8FromStr32(MemoryArena* arena, String32 str) {
-    u64 allocated = str.size*4+1;
-    u8* memory = ARENA_PUSH_ARRAY(arena, allocated, u8);
+    // Must match the sizes of strEncodeUtf8
+    u64 stringCount = 0;
+    for(u64 i = 0; i < str.size; ++i) {
+        u32 codepoint = str.base[i];
+        stringCount += codepoint < (1 << 7) ? 1 : codepoint < (1 << 11) ? 2 : codepoint < (1 << 16) ? 3 : codepoint < (1 << 21) ? 4 : 1;
+    }
+    u8* memory = ARENA_PUSH_ARRAY_NO_CLEAR(arena, stringCount + 1, u8);
     u8* dptr = memory;
     u32* ptr = str.base;
     u32* opl = str.base + str.size;
@@ -750,39 +756,30 @@ GROUNDED_FUNCTION String8 str8FromStr32(MemoryArena* arena, String32 str) {
     }
 
     *dptr = 0;
-    u64 stringCount = (u64)(dptr - memory);
-    arenaPopTo(arena, dptr+1);
+    ASSERT((u64)(dptr - memory) == stringCount);
 
     String8 result = {memory, stringCount};
     return result;
 }
 
 GROUNDED_FUNCTION String16 str16FromStr8(MemoryArena* arena, String8 str) {
-    u64 allocated = str.size*2+1;
-    u16* memory = ARENA_PUSH_ARRAY(arena, allocated, u16);
-    u16* dptr = memory;
-    u8* ptr = str.base;
-    u8* opl = str.base + str.size;
-
-    for(;ptr < opl;) {
-        StringDecode decode = strDecodeUtf8(ptr, (u32)(opl - ptr));
-        if(decode.size == 0) break;
-        u32 encodedSize = strEncodeUtf16(dptr, decode.codepoint);
-        ptr += decode.size;
-        dptr += encodedSize;
-    }
-
-    *dptr = 0;
-    u64 stringCount = (u64)(dptr - memory);
-    arenaPopTo(arena, (u8*)(dptr+1));
+    // Invalid input is converted with the same replacements as strDecodeUtf8 but can not be measured with the vector kernels
+    bool valid = strValidateUtf8(str.base, str.size);
+    u64 stringCount = valid ? strUtf8TranscodedLength(str.base, str.size, true) : strUtf8TranscodedLengthLenient(str.base, str.size, true);
+    u16* memory = ARENA_PUSH_ARRAY_NO_CLEAR(arena, stringCount + 1, u16);
+    strUtf8ToUtf16(str.base, str.size, memory);
+    memory[stringCount] = 0;
 
     String16 result = {memory, stringCount};
     return result;
 }
 
 GROUNDED_FUNCTION String16 str16FromStr32(struct MemoryArena* arena, String32 str) {
-    u64 allocated = str.size*2+1;
-    u16* memory = ARENA_PUSH_ARRAY(arena, allocated, u16);
+    u64 stringCount = str.size;
+    for(u64 i = 0; i < str.size; ++i) {
+        stringCount += str.base[i] >= 0x10000;
+    }
+    u16* memory = ARENA_PUSH_ARRAY_NO_CLEAR(arena, stringCount + 1, u16);
     u16* dptr = memory;
     u32* ptr = str.base;
     u32* opl = str.base + str.size;
@@ -794,54 +791,40 @@ GROUNDED_FUNCTION String16 str16FromStr32(struct MemoryArena* arena, String32 st
     }
 
     *dptr = 0;
-    u64 stringCount = (u64)(dptr - memory);
-    arenaPopTo(arena, (u8*)(dptr+1));
+    ASSERT((u64)(dptr - memory) == stringCount);
     
     String16 result = {memory, stringCount};
     return result;
 }
 
 GROUNDED_FUNCTION String32 str32FromStr8(MemoryArena* arena, String8 str) {
-    u64 allocated = str.size+1;
-    u32* memory = ARENA_PUSH_ARRAY(arena, allocated, u32);
-    u32* dptr = memory;
-    u8* ptr = str.base;
-    u8* opl = str.base + str.size;
-
-    for(;ptr < opl;) {
-        StringDecode decode = strDecodeUtf8(ptr, (u32)(opl - ptr));
-        if(decode.size == 0) break;
-        *dptr = decode.codepoint;
-        ptr += decode.size;
-        dptr += 1;
-    }
-
-    *dptr = 0;
-    u64 stringCount = (u64)(dptr - memory);
-    arenaPopTo(arena, (u8*)(dptr+1));
+    bool valid = strValidateUtf8(str.base, str.size);
+    u64 stringCount = valid ? strUtf8TranscodedLength(str.base, str.size, false) : strUtf8TranscodedLengthLenient(str.base, str.size, false);
+    u32* memory = ARENA_PUSH_ARRAY_NO_CLEAR(arena, stringCount + 1, u32);
+    strUtf8ToUtf32(str.base, str.size, memory);
+    memory[stringCount] = 0;
 
     String32 result = {memory, stringCount};
     return result;
 }
 
 GROUNDED_FUNCTION String32 str32FromStr16(struct MemoryArena* arena, String16 str) {
-    u64 allocated = str.size+1;
-    u32* memory = ARENA_PUSH_ARRAY(arena, allocated, u32);
+    u64 utf8Size = 0;
+    u64 stringCount = 0;
+    u64 validCount = strUtf16Measure(str.base, str.size, &utf8Size, &stringCount);
+    u32* memory = ARENA_PUSH_ARRAY_NO_CLEAR(arena, stringCount + 1, u32);
     u32* dptr = memory;
     u16* ptr = str.base;
-    u16* opl = str.base + str.size;
+    u16* opl = str.base + validCount;
 
     for(;ptr < opl;) {
         StringDecode decode = strDecodeUtf16(ptr, (u32)(opl - ptr));
-        if(decode.size == 0) break;
         *dptr = decode.codepoint;
         ptr += decode.size;
         dptr += 1;    
     }
 
     *dptr = 0;
-    u64 stringCount = (u64)(dptr - memory);
-    arenaPopTo(arena, (u8*)(dptr+1));
 
     String32 result = {memory, stringCount};
     return result;
@@ -0,0 +1,249 @@
+// Byte scanning kernels for String8 functions.
+// The instruction set is chosen at build time. AVX2 is only used if the compiler targets it (eg. -mavx2).
+// Every kernel processes whole vectors with unaligned loads and finishes the remainder with a scalar loop
+// so it never reads outside of the given range.
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define STR_SIMD_WIDTH 32
+#define STR_SIMD_MASK_BITS 1
+typedef __m256i StrSimdVector;
+static inline StrSimdVector strSimdLoad(const u8* p) { return _mm256_loadu_si256((const __m256i*)p); }
+static inline StrSimdVector strSimdSplat(u8 c) { return _mm256_set1_epi8((char)c); }
+static inline StrSimdVector strSimdEqual(StrSimdVector a, StrSimdVector b) { return _mm256_cmpeq_epi8(a, b); }
+static inline StrSimdVector strSimdOr(StrSimdVector a, StrSimdVector b) { return _mm256_or_si256(a, b); }
+static inline StrSimdVector strSimdAnd(StrSimdVector a, StrSimdVector b) { return _mm256_and_si256(a, b); }
+static inline u64 strSimdMask(StrSimdVector v) { return (u32)_mm256_movemask_epi8(v); }
+static inline void strSimdStore(u8* p, StrSimdVector v) { _mm256_storeu_si256((__m256i*)p, v); }
+static inline StrSimdVector strSimdXor(StrSimdVector a, StrSimdVector b) { return _mm256_xor_si256(a, b); }
+static inline StrSimdVector strSimdAdd(StrSimdVector a, StrSimdVector b) { return _mm256_add_epi8(a, b); }
+static inline StrSimdVector strSimdMinUnsigned(StrSimdVector a, StrSimdVector b) { return _mm256_min_epu8(a, b); }
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define STR_SIMD_WIDTH 16
+#define STR_SIMD_MASK_BITS 1
+typedef __m128i StrSimdVector;
+static inline StrSimdVector strSimdLoad(const u8* p) { return _mm_loadu_si128((const __m128i*)p); }
+static inline StrSimdVector strSimdSplat(u8 c) { return _mm_set1_epi8((char)c); }
+static inline StrSimdVector strSimdEqual(StrSimdVector a, StrSimdVector b) { return _mm_cmpeq_epi8(a, b); }
+static inline StrSimdVector strSimdOr(StrSimdVector a, StrSimdVector b) { return _mm_or_si128(a, b); }
+static inline StrSimdVector strSimdAnd(StrSimdVector a, StrSimdVector b) { return _mm_and_si128(a, b); }
+static inline u64 strSimdMask(StrSimdVector v) { return (u32)_mm_movemask_epi8(v); }
+static inline void strSimdStore(u8* p, StrSimdVector v) { _mm_storeu_si128((__m128i*)p, v); }
+static inline StrSimdVector strSimdXor(StrSimdVector a, StrSimdVector b) { return _mm_xor_si128(a, b); }
+static inline StrSimdVector strSimdAdd(StrSimdVector a, StrSimdVector b) { return _mm_add_epi8(a, b); }
+static inline StrSimdVector strSimdMinUnsigned(StrSimdVector a, StrSimdVector b) { return _mm_min_epu8(a, b); }
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define STR_SIMD_WIDTH 16
+// NEON has no movemask. Narrowing shifts give 4 bits per byte instead
+#define STR_SIMD_MASK_BITS 4
+typedef uint8x16_t StrSimdVector;
+static inline StrSimdVector strSimdLoad(const u8* p) { return vld1q_u8(p); }
+static inline StrSimdVector strSimdSplat(u8 c) { return vdupq_n_u8(c); }
+static inline StrSimdVector strSimdEqual(StrSimdVector a, StrSimdVector b) { return vceqq_u8(a, b); }
+static inline StrSimdVector strSimdOr(StrSimdVector a, StrSimdVector b) { return vorrq_u8(a, b); }
+static inline StrSimdVector strSimdAnd(StrSimdVector a, StrSimdVector b) { return vandq_u8(a, b); }
+static inline u64 strSimdMask(StrSimdVector v) { return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(v), 4)), 0); }
+static inline void strSimdStore(u8* p, StrSimdVector v) { vst1q_u8(p, v); }
+static inline StrSimdVector strSimdXor(StrSimdVector a, StrSimdVector b) { return veorq_u8(a, b); }
+static inline StrSimdVector strSimdAdd(StrSimdVector a, StrSimdVector b) { return vaddq_u8(a, b); }
+static inline StrSimdVector strSimdMinUnsigned(StrSimdVector a, StrSimdVector b) { return vminq_u8(a, b); }
+#endif
+
+#ifdef STR_SIMD_WIDTH
+static inline u64 strSimdFirstIndex(u64 mask) { return groundedCountTrailingZeros64(mask) / STR_SIMD_MASK_BITS; }
+static inline u64 strSimdLastIndex(u64 mask) { return (63 - groundedCountLeadingZeros64(mask)) / STR_SIMD_MASK_BITS; }
+static inline u64 strSimdAllBits(void) { return STR_SIMD_WIDTH * STR_SIMD_MASK_BITS == 64 ? UINT64_MAX : ((1ull << (STR_SIMD_WIDTH * STR_SIMD_MASK_BITS)) - 1); }
+static inline bool strSimdIsAscii(StrSimdVector v) {
+    StrSimdVector highBit = strSimdSplat(0x80);
+    return strSimdMask(strSimdEqual(strSimdAnd(v, highBit), highBit)) == 0;
+}
+// Toggles bit 5 of all bytes between first and first + 25. With 'A' this converts ASCII to lowercase, with 'a' to uppercase
+static inline StrSimdVector strSimdToggleAsciiCase(StrSimdVector v, u8 first) {
+    StrSimdVector offset = strSimdAdd(v, strSimdSplat((u8)(0 - first)));
+    StrSimdVector isLetter = strSimdEqual(strSimdMinUnsigned(offset, strSimdSplat(25)), offset);
+    return strSimdXor(v, strSimdAnd(isLetter, strSimdSplat(0x20)));
+}
+#endif
+
+// Returns UINT64_MAX if not found
+static u64 strFindByte(const u8* data, u64 size, u8 c) {
+    u64 i = 0;
+#ifdef STR_SIMD_WIDTH
+    StrSimdVector needle = strSimdSplat(c);
+    for(; i + STR_SIMD_WIDTH <= size; i += STR_SIMD_WIDTH) {
+        u64 mask = strSimdMask(strSimdEqual(strSimdLoad(data + i), needle));
+        if(mask) return i + strSimdFirstIndex(mask);
+    }
+#endif
+    for(; i < size; ++i) {
+        if(data[i] == c) return i;
+    }
+    return UINT64_MAX;
+}
+
+// Returns UINT64_MAX if not found
+static u64 strFindLastByte(const u8* data, u64 size, u8 c) {
+    u64 end = size;
+#ifdef STR_SIMD_WIDTH
+    StrSimdVector needle = strSimdSplat(c);
+    for(; end >= STR_SIMD_WIDTH; end -= STR_SIMD_WIDTH) {
+        u64 mask = strSimdMask(strSimdEqual(strSimdLoad(data + end - STR_SIMD_WIDTH), needle));
+        if(mask) return end - STR_SIMD_WIDTH + strSimdLastIndex(mask);
+    }
+#endif
+    for(; end > 0; --end) {
+        if(data[end - 1] == c) return end - 1;
+    }
+    return UINT64_MAX;
+}
+
+// Index of the first byte that differs or size if both are equal
+static u64 strFindMismatch(const u8* a, const u8* b, u64 size) {
+    u64 i = 0;
+#ifdef STR_SIMD_WIDTH
+    for(; i + STR_SIMD_WIDTH <= size; i += STR_SIMD_WIDTH) {
+        // Mask of equal bytes so all bits set means no mismatch
+        u64 equal = strSimdMask(strSimdEqual(strSimdLoad(a + i), strSimdLoad(b + i)));
+        if(equal != strSimdAllBits()) return i + strSimdFirstIndex(~equal);
+    }
+#endif
+    for(; i < size; ++i) {
+        if(a[i] != b[i]) return i;
+    }
+    return size;
+}
+
+// Classifier for a set of bytes. Built once so repeated scans (eg. one per token when splitting) do not redo the setup
+typedef struct StrByteSet {
+    u64 count;
+#ifdef STR_SIMD_WIDTH
+    // Small sets are classified by comparing against every member. This covers all common separator lists
+    StrSimdVector members[8];
+#endif
+    bool table[256];
+} StrByteSet;
+
+static void strByteSetInit(StrByteSet* result, const u8* set, u64 setCount) {
+    result->count = setCount;
+#ifdef STR_SIMD_WIDTH
+    if(setCount && setCount <= 8) {
+        for(u64 j = 0; j < 8; ++j) {
+            // Unused members repeat the first one
+            result->members[j] = strSimdSplat(set[j < setCount ? j : 0]);
+        }
+    }
+#endif
+    MEMORY_CLEAR_ARRAY(result->table);
+    for(u64 j = 0; j < setCount; ++j) {
+        result->table[set[j]] = true;
+    }
+}
+
+// Index of the first byte that is in set or UINT64_MAX if none is found
+static u64 strByteSetFindFirst(const StrByteSet* set, const u8* data, u64 size) {
+    if(set->count == 0) return UINT64_MAX;
+
+    u64 i = 0;
+#ifdef STR_SIMD_WIDTH
+    if(set->count == 1) {
+        for(; i + STR_SIMD_WIDTH <= size; i += STR_SIMD_WIDTH) {
+            u64 mask = strSimdMask(strSimdEqual(strSimdLoad(data + i), set->members[0]));
+            if(mask) return i + strSimdFirstIndex(mask);
+        }
+    } else if(set->count <= 8) {
+        const StrSimdVector* members = set->members;
+        for(; i + STR_SIMD_WIDTH <= size; i += STR_SIMD_WIDTH) {
+            StrSimdVector block = strSimdLoad(data + i);
+            StrSimdVector match = strSimdOr(strSimdOr(strSimdOr(strSimdEqual(block, members[0]), strSimdEqual(block, members[1])),
+                                                      strSimdOr(strSimdEqual(block, members[2]), strSimdEqual(block, members[3]))),
+                                            strSimdOr(strSimdOr(strSimdEqual(block, members[4]), strSimdEqual(block, members[5])),
+                                                      strSimdOr(strSimdEqual(block, members[6]), strSimdEqual(block, members[7]))));
+            u64 mask = strSimdMask(match);
+            if(mask) return i + strSimdFirstIndex(mask);
+        }
+    }
+#endif
+    for(; i < size; ++i) {
+        if(set->table[data[i]]) return i;
+    }
+    return UINT64_MAX;
+}
+
+// Returns the index of the first occurence of needle or UINT64_MAX if there is none
+static u64 strFindSubstring(const u8* haystack, u64 haystackSize, const u8* needle, u64 needleSize) {
+    if(needleSize == 0) return 0;
+    if(needleSize > haystackSize) return UINT64_MAX;
+    if(needleSize == 1) return strFindByte(haystack, haystackSize, needle[0]);
+
+    u64 lastStart = haystackSize - needleSize;
+    u64 i = 0;
+#ifdef STR_SIMD_WIDTH
+    // Candidates must match the first and the last byte of the needle. Only those are compared completely
+    StrSimdVector first = strSimdSplat(needle[0]);
+    StrSimdVector last = strSimdSplat(needle[needleSize - 1]);
+    for(; i + STR_SIMD_WIDTH <= lastStart + 1; i += STR_SIMD_WIDTH) {
+        StrSimdVector firstMatch = strSimdEqual(strSimdLoad(haystack + i), first);
+        StrSimdVector lastMatch = strSimdEqual(strSimdLoad(haystack + i + needleSize - 1), last);
+        u64 mask = strSimdMask(strSimdAnd(firstMatch, lastMatch));
+        while(mask) {
+            u64 candidate = i + strSimdFirstIndex(mask);
+            if(strFindMismatch(haystack + candidate + 1, needle + 1, needleSize - 2) == needleSize - 2) {
+                return candidate;
+            }
+            // Clear all mask bits of this byte
+            mask &= ~(((1ull << STR_SIMD_MASK_BITS) - 1) << ((candidate - i) * STR_SIMD_MASK_BITS));
+        }
+    }
+#endif
+    while(i <= lastStart) {
+        u64 offset = strFindByte(haystack + i, lastStart + 1 - i, needle[0]);
+        if(offset == UINT64_MAX) break;
+        i += offset;
+        if(haystack[i + needleSize - 1] == needle[needleSize - 1] && strFindMismatch(haystack + i + 1, needle + 1, needleSize - 2) == needleSize - 2) {
+            return i;
+        }
+        i++;
+    }
+    return UINT64_MAX;
+}
+
+// Copies src to dst and toggles the case of ASCII letters like strSimdToggleAsciiCase.
+// Stops before the first vector that contains a non-ASCII byte. Returns the number of bytes converted
+static u64 strConvertAsciiCase(u8* dst, const u8* src, u64 size, u8 first) {
+    u64 i = 0;
+#ifdef STR_SIMD_WIDTH
+    for(; i + STR_SIMD_WIDTH <= size; i += STR_SIMD_WIDTH) {
+        StrSimdVector block = strSimdLoad(src + i);
+        if(!strSimdIsAscii(block)) break;
+        strSimdStore(dst + i, strSimdToggleAsciiCase(block, first));
+    }
+#else
+    (void)dst;
+    (void)src;
+    (void)size;
+    (void)first;
+#endif
+    return i;
+}
+
+// Number of leading bytes that are equal when ASCII letters are compared case insensitively.
+// Stops before the first vector pair that contains a non-ASCII byte or a difference
+static u64 strFindAsciiCaseInsensitiveMismatch(const u8* a, const u8* b, u64 size) {
+    u64 i = 0;
+#ifdef STR_SIMD_WIDTH
+    for(; i + STR_SIMD_WIDTH <= size; i += STR_SIMD_WIDTH) {
+        StrSimdVector blockA = strSimdLoad(a + i);
+        StrSimdVector blockB = strSimdLoad(b + i);
+        if(!strSimdIsAscii(strSimdOr(blockA, blockB))) break;
+        u64 equal = strSimdMask(strSimdEqual(strSimdToggleAsciiCase(blockA, 'A'), strSimdToggleAsciiCase(blockB, 'A')));
+        if(equal != strSimdAllBits()) return i + strSimdFirstIndex(~equal);
+    }
+#else
+    (void)a;
+    (void)b;
+    (void)size;
+#endif
+    return i;
+}
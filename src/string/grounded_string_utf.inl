@@ -0,0 +1,414 @@
+// UTF-8 validation and transcoding kernels. Uses the vector layer of grounded_string_simd.inl.
+// Validation follows the lookup algorithm of simdutf (Keiser and Lemire, "Validating UTF-8 In Less Than One Instruction Per Byte"):
+// Three 16 entry tables indexed by the nibbles of every byte and its predecessor classify all errors that are visible in
+// two consecutive bytes. Continuation bytes in third and fourth position are checked with saturating subtractions.
+// The tables need a byte shuffle so this is only used with AVX2, SSSE3 or AArch64 NEON.
+// Everywhere else whole ASCII vectors are skipped and the remaining bytes are validated with a scalar loop.
+//
+// Transcoding always measures the exact output length first so the result is pushed onto the arena exactly once.
+// Runs of 16 ASCII characters are widened or narrowed with vector instructions.
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define STR_UTF_SSE2
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define STR_UTF_NEON
+#endif
+
+#if defined(__AVX2__)
+#define STR_UTF8_LOOKUP
+static inline StrSimdVector strUtf8Table(const u8* table) { return _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)table)); }
+static inline StrSimdVector strUtf8Lookup(StrSimdVector table, StrSimdVector index) { return _mm256_shuffle_epi8(table, index); }
+static inline StrSimdVector strUtf8HighNibbles(StrSimdVector v) { return _mm256_and_si256(_mm256_srli_epi16(v, 4), _mm256_set1_epi8(0x0F)); }
+static inline StrSimdVector strUtf8SaturatingSub(StrSimdVector a, StrSimdVector b) { return _mm256_subs_epu8(a, b); }
+static inline bool strUtf8IsZero(StrSimdVector v) { return _mm256_testz_si256(v, v); }
+// Bytes n positions before every byte of input. The first n come from the end of previous
+#define STR_UTF8_PREVIOUS(input, previous, n) _mm256_alignr_epi8(input, _mm256_permute2x128_si256(previous, input, 0x21), 16 - (n))
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#define STR_UTF8_LOOKUP
+static inline StrSimdVector strUtf8Table(const u8* table) { return _mm_loadu_si128((const __m128i*)table); }
+static inline StrSimdVector strUtf8Lookup(StrSimdVector table, StrSimdVector index) { return _mm_shuffle_epi8(table, index); }
+static inline StrSimdVector strUtf8HighNibbles(StrSimdVector v) { return _mm_and_si128(_mm_srli_epi16(v, 4), _mm_set1_epi8(0x0F)); }
+static inline StrSimdVector strUtf8SaturatingSub(StrSimdVector a, StrSimdVector b) { return _mm_subs_epu8(a, b); }
+static inline bool strUtf8IsZero(StrSimdVector v) { return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128())) == 0xFFFF; }
+#define STR_UTF8_PREVIOUS(input, previous, n) _mm_alignr_epi8(input, previous, 16 - (n))
+#elif defined(STR_UTF_NEON) && (defined(__aarch64__) || defined(_M_ARM64))
+#define STR_UTF8_LOOKUP
+static inline StrSimdVector strUtf8Table(const u8* table) { return vld1q_u8(table); }
+static inline StrSimdVector strUtf8Lookup(StrSimdVector table, StrSimdVector index) { return vqtbl1q_u8(table, index); }
+static inline StrSimdVector strUtf8HighNibbles(StrSimdVector v) { return vshrq_n_u8(v, 4); }
+static inline StrSimdVector strUtf8SaturatingSub(StrSimdVector a, StrSimdVector b) { return vqsubq_u8(a, b); }
+static inline bool strUtf8IsZero(StrSimdVector v) { return vmaxvq_u8(v) == 0; }
+#define STR_UTF8_PREVIOUS(input, previous, n) vextq_u8(previous, input, 16 - (n))
+#endif
+
+// Length of the sequence starting at data or 0 if it is not valid according to RFC 3629.
+// Rejects overlong encodings, surrogates and codepoints above U+10FFFF
+static inline u64 strUtf8SequenceLength(const u8* data, u64 size) {
+    u8 lead = data[0];
+    if(lead < 0x80) return 1;
+    u64 length = 0;
+    // Range of the second byte. Stricter than a continuation byte for some lead bytes
+    u8 min = 0x80;
+    u8 max = 0xBF;
+    if(lead >= 0xC2 && lead <= 0xDF) {
+        length = 2;
+    } else if(lead >= 0xE0 && lead <= 0xEF) {
+        length = 3;
+        if(lead == 0xE0) min = 0xA0;
+        else if(lead == 0xED) max = 0x9F;
+    } else if(lead >= 0xF0 && lead <= 0xF4) {
+        length = 4;
+        if(lead == 0xF0) min = 0x90;
+        else if(lead == 0xF4) max = 0x8F;
+    } else {
+        return 0;
+    }
+    if(size < length) return 0;
+    if(data[1] < min || data[1] > max) return 0;
+    for(u64 i = 2; i < length; ++i) {
+        if((data[i] & 0xC0) != 0x80) return 0;
+    }
+    return length;
+}
+
+#ifdef STR_UTF8_LOOKUP
+// Error classes of the lookup tables. Every error is the intersection of the classes of both bytes
+#define UTF8_TOO_SHORT (1 << 0) // Lead byte followed by ASCII or another lead byte
+#define UTF8_TOO_LONG (1 << 1) // ASCII followed by a continuation byte
+#define UTF8_OVERLONG_3 (1 << 2)
+#define UTF8_TOO_LARGE (1 << 3)
+#define UTF8_SURROGATE (1 << 4)
+#define UTF8_OVERLONG_2 (1 << 5)
+#define UTF8_TOO_LARGE_1000 (1 << 6)
+#define UTF8_OVERLONG_4 (1 << 6)
+#define UTF8_TWO_CONTINUATIONS (1 << 7) // Two continuation bytes are only valid in third or fourth position
+#define UTF8_CARRY (UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTINUATIONS)
+
+// Indexed by the high nibble of the first byte
+static const u8 utf8FirstHighTable[16] = {
+    // ASCII
+    UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+    UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+    // Continuation
+    UTF8_TWO_CONTINUATIONS, UTF8_TWO_CONTINUATIONS, UTF8_TWO_CONTINUATIONS, UTF8_TWO_CONTINUATIONS,
+    // 1100 and 1101: two byte lead
+    UTF8_TOO_SHORT | UTF8_OVERLONG_2,
+    UTF8_TOO_SHORT,
+    // 1110: three byte lead
+    UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,
+    // 1111: four byte lead
+    UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4,
+};
+
+// Indexed by the low nibble of the first byte
+static const u8 utf8FirstLowTable[16] = {
+    UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4,
+    UTF8_CARRY | UTF8_OVERLONG_2,
+    UTF8_CARRY,
+    UTF8_CARRY,
+    UTF8_CARRY | UTF8_TOO_LARGE,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_SURROGATE,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+};
+
+// Indexed by the high nibble of the second byte
+static const u8 utf8SecondHighTable[16] = {
+    // ASCII
+    UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+    UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+    // 1000
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTINUATIONS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4,
+    // 1001
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTINUATIONS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE,
+    // 101x
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTINUATIONS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTINUATIONS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+    // Lead bytes
+    UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+};
+
+static bool strValidateUtf8(const u8* data, u64 size) {
+    StrSimdVector firstHigh = strUtf8Table(utf8FirstHighTable);
+    StrSimdVector firstLow = strUtf8Table(utf8FirstLowTable);
+    StrSimdVector secondHigh = strUtf8Table(utf8SecondHighTable);
+    StrSimdVector lowNibbleMask = strSimdSplat(0x0F);
+    StrSimdVector thirdByteLimit = strSimdSplat(0xE0 - 0x80);
+    StrSimdVector fourthByteLimit = strSimdSplat(0xF0 - 0x80);
+    StrSimdVector highBit = strSimdSplat(0x80);
+
+    // Lead bytes in the last three positions of a block whose sequence continues in the next block
+    u8 incompleteLimits[STR_SIMD_WIDTH];
+    memset(incompleteLimits, 0xFF, sizeof(incompleteLimits));
+    incompleteLimits[STR_SIMD_WIDTH - 3] = 0xF0 - 1;
+    incompleteLimits[STR_SIMD_WIDTH - 2] = 0xE0 - 1;
+    incompleteLimits[STR_SIMD_WIDTH - 1] = 0xC0 - 1;
+    StrSimdVector incompleteLimit = strSimdLoad(incompleteLimits);
+
+    StrSimdVector zero = strSimdSplat(0);
+    StrSimdVector error = zero;
+    StrSimdVector previous = zero;
+    StrSimdVector previousIncomplete = zero;
+    for(u64 i = 0; i < size; i += STR_SIMD_WIDTH) {
+        StrSimdVector input;
+        if(i + STR_SIMD_WIDTH <= size) {
+            input = strSimdLoad(data + i);
+        } else {
+            // Padding with zeros makes sequences that are cut off at the end too short
+            u8 tail[STR_SIMD_WIDTH] = {0};
+            MEMORY_COPY(tail, data + i, size - i);
+            input = strSimdLoad(tail);
+        }
+
+        if(strSimdIsAscii(input)) {
+            error = strSimdOr(error, previousIncomplete);
+            previousIncomplete = zero;
+        } else {
+            StrSimdVector previous1 = STR_UTF8_PREVIOUS(input, previous, 1);
+            StrSimdVector specialCases = strSimdAnd(strSimdAnd(strUtf8Lookup(firstHigh, strUtf8HighNibbles(previous1)),
+                                                               strUtf8Lookup(firstLow, strSimdAnd(previous1, lowNibbleMask))),
+                                                    strUtf8Lookup(secondHigh, strUtf8HighNibbles(input)));
+            // The high bit is set where the byte two or three positions before is a three or four byte lead.
+            // Exactly those continuation bytes are allowed to follow another continuation byte
+            StrSimdVector previous2 = STR_UTF8_PREVIOUS(input, previous, 2);
+            StrSimdVector previous3 = STR_UTF8_PREVIOUS(input, previous, 3);
+            StrSimdVector mustBeContinuation = strSimdOr(strUtf8SaturatingSub(previous2, thirdByteLimit), strUtf8SaturatingSub(previous3, fourthByteLimit));
+            error = strSimdOr(error, strSimdXor(strSimdAnd(mustBeContinuation, highBit), specialCases));
+            previousIncomplete = strUtf8SaturatingSub(input, incompleteLimit);
+        }
+        previous = input;
+    }
+    error = strSimdOr(error, previousIncomplete);
+    return strUtf8IsZero(error);
+}
+#else
+static bool strValidateUtf8(const u8* data, u64 size) {
+    u64 i = 0;
+    while(i < size) {
+        u64 end = size;
+#ifdef STR_SIMD_WIDTH
+        if(i + STR_SIMD_WIDTH <= size) {
+            if(strSimdIsAscii(strSimdLoad(data + i))) {
+                i += STR_SIMD_WIDTH;
+                continue;
+            }
+            end = i + STR_SIMD_WIDTH;
+        }
+#endif
+        while(i < end) {
+            u64 length = strUtf8SequenceLength(data + i, size - i);
+            if(!length) return false;
+            i += length;
+        }
+    }
+    return true;
+}
+#endif
+
+// Output length of valid UTF-8 in UTF-32 or UTF-16 code units.
+// Every byte that is not a continuation byte starts a codepoint and four byte sequences become surrogate pairs in UTF-16
+static u64 strUtf8TranscodedLength(const u8* data, u64 size, bool utf16) {
+    u64 result = 0;
+    u64 i = 0;
+#ifdef STR_SIMD_WIDTH
+    StrSimdVector continuationMask = strSimdSplat(0xC0);
+    StrSimdVector continuation = strSimdSplat(0x80);
+    StrSimdVector fourByteLead = strSimdSplat(0xF0);
+    for(; i + STR_SIMD_WIDTH <= size; i += STR_SIMD_WIDTH) {
+        StrSimdVector block = strSimdLoad(data + i);
+        u64 continuations = groundedPopCount64(strSimdMask(strSimdEqual(strSimdAnd(block, continuationMask), continuation))) / STR_SIMD_MASK_BITS;
+        result += STR_SIMD_WIDTH - continuations;
+        if(utf16) {
+            result += groundedPopCount64(strSimdMask(strSimdEqual(strSimdAnd(block, fourByteLead), fourByteLead))) / STR_SIMD_MASK_BITS;
+        }
+    }
+#endif
+    for(; i < size; ++i) {
+        result += (data[i] & 0xC0) != 0x80;
+        if(utf16) result += data[i] >= 0xF0;
+    }
+    return result;
+}
+
+// Same for UTF-8 that failed validation. Follows strDecodeUtf8 which replaces invalid bytes with '#'
+static u64 strUtf8TranscodedLengthLenient(u8* data, u64 size, bool utf16) {
+    u64 result = 0;
+    for(u64 i = 0; i < size;) {
+        StringDecode decode = strDecodeUtf8(data + i, (s64)(size - i));
+        result += (utf16 && decode.codepoint >= 0x10000) ? 2 : 1;
+        i += decode.size;
+    }
+    return result;
+}
+
+// Returns the number of u16 before the first unpaired surrogate. Like strDecodeUtf16 based conversions, conversion stops there.
+// Also returns the UTF-8 size and the codepoint count of that prefix
+static u64 strUtf16Measure(const u16* data, u64 size, u64* utf8Size, u64* codepointCount) {
+    u64 bytes = 0;
+    u64 codepoints = 0;
+    u64 i = 0;
+    while(i < size) {
+        u16 x = data[i];
+        if(x < 0x80) {
+            bytes += 1;
+        } else if(x < 0x800) {
+            bytes += 2;
+        } else if(x < 0xD800 || x > 0xDFFF) {
+            bytes += 3;
+        } else if(x < 0xDC00 && i + 1 < size && data[i + 1] >= 0xDC00 && data[i + 1] < 0xE000) {
+            bytes += 4;
+            i++;
+        } else {
+            break;
+        }
+        codepoints++;
+        i++;
+    }
+    *utf8Size = bytes;
+    *codepointCount = codepoints;
+    return i;
+}
+
+// The following helpers convert 16 characters if all of them are ASCII and return false without writing anything otherwise
+static inline bool strWidenAsciiToUtf16(const u8* src, u16* dst) {
+#if defined(STR_UTF_SSE2)
+    __m128i block = _mm_loadu_si128((const __m128i*)src);
+    if(_mm_movemask_epi8(block)) return false;
+    __m128i zero = _mm_setzero_si128();
+    _mm_storeu_si128((__m128i*)dst, _mm_unpacklo_epi8(block, zero));
+    _mm_storeu_si128((__m128i*)(dst + 8), _mm_unpackhi_epi8(block, zero));
+#elif defined(STR_UTF_NEON)
+    uint8x16_t block = vld1q_u8(src);
+    if(!strSimdIsAscii(block)) return false;
+    vst1q_u16(dst, vmovl_u8(vget_low_u8(block)));
+    vst1q_u16(dst + 8, vmovl_u8(vget_high_u8(block)));
+#else
+    u64 words[2];
+    MEMORY_COPY(words, src, sizeof(words));
+    if((words[0] | words[1]) & 0x8080808080808080ull) return false;
+    for(u32 i = 0; i < 16; ++i) {
+        dst[i] = src[i];
+    }
+#endif
+    return true;
+}
+
+static inline bool strWidenAsciiToUtf32(const u8* src, u32* dst) {
+#if defined(STR_UTF_SSE2)
+    __m128i block = _mm_loadu_si128((const __m128i*)src);
+    if(_mm_movemask_epi8(block)) return false;
+    __m128i zero = _mm_setzero_si128();
+    __m128i low = _mm_unpacklo_epi8(block, zero);
+    __m128i high = _mm_unpackhi_epi8(block, zero);
+    _mm_storeu_si128((__m128i*)dst, _mm_unpacklo_epi16(low, zero));
+    _mm_storeu_si128((__m128i*)(dst + 4), _mm_unpackhi_epi16(low, zero));
+    _mm_storeu_si128((__m128i*)(dst + 8), _mm_unpacklo_epi16(high, zero));
+    _mm_storeu_si128((__m128i*)(dst + 12), _mm_unpackhi_epi16(high, zero));
+#elif defined(STR_UTF_NEON)
+    uint8x16_t block = vld1q_u8(src);
+    if(!strSimdIsAscii(block)) return false;
+    uint16x8_t low = vmovl_u8(vget_low_u8(block));
+    uint16x8_t high = vmovl_u8(vget_high_u8(block));
+    vst1q_u32(dst, vmovl_u16(vget_low_u16(low)));
+    vst1q_u32(dst + 4, vmovl_u16(vget_high_u16(low)));
+    vst1q_u32(dst + 8, vmovl_u16(vget_low_u16(high)));
+    vst1q_u32(dst + 12, vmovl_u16(vget_high_u16(high)));
+#else
+    u64 words[2];
+    MEMORY_COPY(words, src, sizeof(words));
+    if((words[0] | words[1]) & 0x8080808080808080ull) return false;
+    for(u32 i = 0; i < 16; ++i) {
+        dst[i] = src[i];
+    }
+#endif
+    return true;
+}
+
+static inline bool strNarrowAsciiFromUtf16(const u16* src, u8* dst) {
+#if defined(STR_UTF_SSE2)
+    __m128i low = _mm_loadu_si128((const __m128i*)src);
+    __m128i high = _mm_loadu_si128((const __m128i*)(src + 8));
+    __m128i nonAscii = _mm_and_si128(_mm_or_si128(low, high), _mm_set1_epi16((short)0xFF80));
+    if(_mm_movemask_epi8(_mm_cmpeq_epi16(nonAscii, _mm_setzero_si128())) != 0xFFFF) return false;
+    _mm_storeu_si128((__m128i*)dst, _mm_packus_epi16(low, high));
+#elif defined(STR_UTF_NEON)
+    uint16x8_t low = vld1q_u16(src);
+    uint16x8_t high = vld1q_u16(src + 8);
+    uint64x2_t nonAscii = vreinterpretq_u64_u16(vandq_u16(vorrq_u16(low, high), vdupq_n_u16(0xFF80)));
+    if(vgetq_lane_u64(nonAscii, 0) | vgetq_lane_u64(nonAscii, 1)) return false;
+    vst1q_u8(dst, vcombine_u8(vmovn_u16(low), vmovn_u16(high)));
+#else
+    u16 combined = 0;
+    for(u32 i = 0; i < 16; ++i) {
+        combined |= src[i];
+    }
+    if(combined >= 0x80) return false;
+    for(u32 i = 0; i < 16; ++i) {
+        dst[i] = (u8)src[i];
+    }
+#endif
+    return true;
+}
+
+// Transcoders for input that has been measured. They write exactly the measured length.
+// Decoding falls back to the scalar functions for every 16 character block that is not pure ASCII
+static void strUtf8ToUtf16(u8* src, u64 size, u16* dst) {
+    u64 i = 0;
+    while(i < size) {
+        if(i + 16 <= size && strWidenAsciiToUtf16(src + i, dst)) {
+            i += 16;
+            dst += 16;
+            continue;
+        }
+        u64 end = MIN(i + 16, size);
+        while(i < end) {
+            StringDecode decode = strDecodeUtf8(src + i, (s64)(size - i));
+            dst += strEncodeUtf16(dst, decode.codepoint);
+            i += decode.size;
+        }
+    }
+}
+
+static void strUtf8ToUtf32(u8* src, u64 size, u32* dst) {
+    u64 i = 0;
+    while(i < size) {
+        if(i + 16 <= size && strWidenAsciiToUtf32(src + i, dst)) {
+            i += 16;
+            dst += 16;
+            continue;
+        }
+        u64 end = MIN(i + 16, size);
+        while(i < end) {
+            StringDecode decode = strDecodeUtf8(src + i, (s64)(size - i));
+            *dst++ = decode.codepoint;
+            i += decode.size;
+        }
+    }
+}
+
+// count must not include unpaired surrogates
+static void strUtf16ToUtf8(u16* src, u64 count, u8* dst) {
+    u64 i = 0;
+    while(i < count) {
+        if(i + 16 <= count && strNarrowAsciiFromUtf16(src + i, dst)) {
+            i += 16;
+            dst += 16;
+            continue;
+        }
+        u64 end = MIN(i + 16, count);
+        while(i < end) {
+            StringDecode decode = strDecodeUtf16(src + i, (s64)(count - i));
+            dst += strEncodeUtf8(dst, decode.codepoint);
+            i += decode.size;
+        }
+    }
+}
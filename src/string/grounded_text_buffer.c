@@ -0,0 +1,446 @@
+#include <grounded/string/grounded_text_buffer.h>
+#include <grounded/memory/grounded_memory.h>
+#include <grounded/logger/grounded_logger.h>
+
+static u32 textRandom(GroundedTextBuffer* buffer) {
+    // xorshift32
+    u32 x = buffer->randomState;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    buffer->randomState = x;
+    return x;
+}
+
+static void textCount(const u8* data, u64 size, u64* codepointCount, u64* lineCount) {
+    u64 codepoints = 0;
+    u64 lines = 0;
+    for(u64 i = 0; i < size; ++i) {
+        codepoints += (data[i] & 0xC0) != 0x80;
+        lines += data[i] == '\n';
+    }
+    *codepointCount = codepoints;
+    *lineCount = lines;
+}
+
+static void textUpdate(GroundedTextPiece* node) {
+    node->subtreeSize = node->size;
+    node->subtreeCodepointCount = node->codepointCount;
+    node->subtreeLineCount = node->lineCount;
+    if(node->left) {
+        node->subtreeSize += node->left->subtreeSize;
+        node->subtreeCodepointCount += node->left->subtreeCodepointCount;
+        node->subtreeLineCount += node->left->subtreeLineCount;
+    }
+    if(node->right) {
+        node->subtreeSize += node->right->subtreeSize;
+        node->subtreeCodepointCount += node->right->subtreeCodepointCount;
+        node->subtreeLineCount += node->right->subtreeLineCount;
+    }
+}
+
+// Makes sure count nodes can be taken from the free list so the tree is never left half modified
+static bool textReservePieces(GroundedTextBuffer* buffer, u64 count) {
+    while(buffer->freePieceCount < count) {
+        GroundedTextPiece* piece = ARENA_PUSH_STRUCT_NO_CLEAR(buffer->arena, GroundedTextPiece);
+        if(!piece) {
+            GROUNDED_LOG_ERROR("Text buffer arena is out of memory");
+            return false;
+        }
+        piece->left = buffer->freePieces;
+        buffer->freePieces = piece;
+        buffer->freePieceCount++;
+    }
+    return true;
+}
+
+// Must be reserved
+static GroundedTextPiece* textTakePiece(GroundedTextBuffer* buffer, u8* base, u64 size, u64 codepointCount, u64 lineCount, u32 priority) {
+    ASSERT(buffer->freePieces);
+    GroundedTextPiece* result = buffer->freePieces;
+    buffer->freePieces = result->left;
+    buffer->freePieceCount--;
+    *result = (GroundedTextPiece){0};
+    result->base = base;
+    result->size = size;
+    result->codepointCount = codepointCount;
+    result->lineCount = lineCount;
+    result->priority = priority;
+    textUpdate(result);
+    return result;
+}
+
+static void textFreeSubtree(GroundedTextBuffer* buffer, GroundedTextPiece* node) {
+    if(!node) return;
+    textFreeSubtree(buffer, node->left);
+    textFreeSubtree(buffer, node->right);
+    node->left = buffer->freePieces;
+    buffer->freePieces = node;
+    buffer->freePieceCount++;
+}
+
+static GroundedTextPiece* textMerge(GroundedTextPiece* a, GroundedTextPiece* b) {
+    if(!a) return b;
+    if(!b) return a;
+    if(a->priority > b->priority) {
+        a->right = textMerge(a->right, b);
+        textUpdate(a);
+        return a;
+    } else {
+        b->left = textMerge(a, b->left);
+        textUpdate(b);
+        return b;
+    }
+}
+
+// Afterwards left holds the first offset bytes. Splits at most one piece which needs one reserved node
+static void textSplit(GroundedTextBuffer* buffer, GroundedTextPiece* node, u64 offset, GroundedTextPiece** left, GroundedTextPiece** right) {
+    if(!node) {
+        *left = 0;
+        *right = 0;
+        return;
+    }
+    u64 leftSize = node->left ? node->left->subtreeSize : 0;
+    if(offset <= leftSize) {
+        textSplit(buffer, node->left, offset, left, &node->left);
+        textUpdate(node);
+        *right = node;
+    } else if(offset >= leftSize + node->size) {
+        textSplit(buffer, node->right, offset - leftSize - node->size, &node->right, right);
+        textUpdate(node);
+        *left = node;
+    } else {
+        // Offset is inside of this piece. Only the shorter half is counted
+        u64 headSize = offset - leftSize;
+        u64 tailSize = node->size - headSize;
+        u64 headCodepoints, headLines, tailCodepoints, tailLines;
+        if(headSize < tailSize) {
+            textCount(node->base, headSize, &headCodepoints, &headLines);
+            tailCodepoints = node->codepointCount - headCodepoints;
+            tailLines = node->lineCount - headLines;
+        } else {
+            textCount(node->base + headSize, tailSize, &tailCodepoints, &tailLines);
+            headCodepoints = node->codepointCount - tailCodepoints;
+            headLines = node->lineCount - tailLines;
+        }
+        // The tail takes over the right subtree. Sharing the priority keeps the heap order intact
+        GroundedTextPiece* tail = textTakePiece(buffer, node->base + headSize, tailSize, tailCodepoints, tailLines, node->priority);
+        tail->right = node->right;
+        textUpdate(tail);
+        node->right = 0;
+        node->size = headSize;
+        node->codepointCount = headCodepoints;
+        node->lineCount = headLines;
+        textUpdate(node);
+        *left = node;
+        *right = tail;
+    }
+}
+
+// Finds the piece that contains offset which must be smaller than the size of the tree.
+// Returns the offset, codepoints and lines in front of the piece
+static GroundedTextPiece* textFindByOffset(GroundedTextPiece* node, u64 offset, u64* pieceOffset, u64* codepointsBefore, u64* linesBefore) {
+    u64 startOffset = 0;
+    u64 codepoints = 0;
+    u64 lines = 0;
+    while(node) {
+        u64 leftSize = 0;
+        if(node->left) {
+            leftSize = node->left->subtreeSize;
+            if(offset < leftSize) {
+                node = node->left;
+                continue;
+            }
+        }
+        if(node->left) {
+            codepoints += node->left->subtreeCodepointCount;
+            lines += node->left->subtreeLineCount;
+        }
+        offset -= leftSize;
+        startOffset += leftSize;
+        if(offset < node->size) break;
+        offset -= node->size;
+        startOffset += node->size;
+        codepoints += node->codepointCount;
+        lines += node->lineCount;
+        node = node->right;
+    }
+    *pieceOffset = startOffset;
+    *codepointsBefore = codepoints;
+    *linesBefore = lines;
+    return node;
+}
+
+// Copies text into the current block. Every call returns contiguous memory
+static u8* textPushBytes(GroundedTextBuffer* buffer, String8 text) {
+    if(!buffer->block || buffer->blockUsed + text.size > buffer->blockSize) {
+        u64 blockSize = MAX(GROUNDED_TEXT_BUFFER_BLOCK_SIZE, text.size);
+        u8* block = ARENA_PUSH_ARRAY_NO_CLEAR(buffer->arena, blockSize, u8);
+        if(!block) {
+            GROUNDED_LOG_ERROR("Text buffer arena is out of memory");
+            return 0;
+        }
+        buffer->block = block;
+        buffer->blockSize = blockSize;
+        buffer->blockUsed = 0;
+    }
+    u8* result = buffer->block + buffer->blockUsed;
+    MEMORY_COPY(result, text.base, text.size);
+    buffer->blockUsed += text.size;
+    return result;
+}
+
+// Treap of pieces for text. Returns false if the arena is out of memory
+static bool textBuildPieces(GroundedTextBuffer* buffer, String8 text, GroundedTextPiece** result) {
+    u64 pieceCount = (text.size + GROUNDED_TEXT_BUFFER_MAX_PIECE_SIZE - 1) / GROUNDED_TEXT_BUFFER_MAX_PIECE_SIZE;
+    // One more for a split during insertion
+    if(!textReservePieces(buffer, pieceCount + 1)) return false;
+
+    GroundedTextPiece* pieces = 0;
+    for(u64 done = 0; done < text.size;) {
+        u64 size = MIN(GROUNDED_TEXT_BUFFER_MAX_PIECE_SIZE, text.size - done);
+        u8* base = textPushBytes(buffer, str8FromBlock(text.base + done, size));
+        if(!base) {
+            textFreeSubtree(buffer, pieces);
+            return false;
+        }
+        u64 codepoints, lines;
+        textCount(base, size, &codepoints, &lines);
+        pieces = textMerge(pieces, textTakePiece(buffer, base, size, codepoints, lines, textRandom(buffer)));
+        done += size;
+    }
+    *result = pieces;
+    return true;
+}
+
+GROUNDED_FUNCTION bool groundedCreateTextBuffer(GroundedTextBuffer* buffer, MemoryArena* arena, String8 text) {
+    *buffer = (GroundedTextBuffer){0};
+    buffer->arena = arena;
+    buffer->arenaMarker = arenaCreateMarker(arena);
+    buffer->randomState = 0x9E3779B9u ^ (u32)INT_FROM_PTR(buffer);
+    if(!buffer->randomState) buffer->randomState = 1;
+    if(!textBuildPieces(buffer, text, &buffer->root)) {
+        groundedDestroyTextBuffer(buffer);
+        return false;
+    }
+    return true;
+}
+
+GROUNDED_FUNCTION void groundedDestroyTextBuffer(GroundedTextBuffer* buffer) {
+    if(buffer->arena) {
+        arenaResetToMarker(buffer->arenaMarker);
+    }
+    *buffer = (GroundedTextBuffer){0};
+}
+
+// Typing appends directly behind the last inserted bytes. In that case the piece in front of offset is extended
+static bool textTryExtendPiece(GroundedTextBuffer* buffer, u64 offset, String8 text) {
+    if(offset == 0 || !buffer->block || buffer->blockUsed + text.size > buffer->blockSize) return false;
+    u64 pieceOffset, codepointsBefore, linesBefore;
+    GroundedTextPiece* piece = textFindByOffset(buffer->root, offset - 1, &pieceOffset, &codepointsBefore, &linesBefore);
+    if(!piece || pieceOffset + piece->size != offset) return false;
+    if(piece->base + piece->size != buffer->block + buffer->blockUsed) return false;
+    if(piece->size + text.size > GROUNDED_TEXT_BUFFER_MAX_PIECE_SIZE) return false;
+
+    textPushBytes(buffer, text);
+    u64 codepoints, lines;
+    textCount(text.base, text.size, &codepoints, &lines);
+    piece->size += text.size;
+    piece->codepointCount += codepoints;
+    piece->lineCount += lines;
+
+    // All subtree counts on the path to the piece grow
+    GroundedTextPiece* node = buffer->root;
+    u64 remaining = offset - 1;
+    while(node) {
+        node->subtreeSize += text.size;
+        node->subtreeCodepointCount += codepoints;
+        node->subtreeLineCount += lines;
+        if(node == piece) break;
+        u64 leftSize = node->left ? node->left->subtreeSize : 0;
+        if(remaining < leftSize) {
+            node = node->left;
+        } else {
+            remaining -= leftSize + node->size;
+            node = node->right;
+        }
+    }
+    return true;
+}
+
+GROUNDED_FUNCTION bool groundedTextBufferInsert(GroundedTextBuffer* buffer, u64 offset, String8 text) {
+    u64 size = groundedTextBufferGetSize(buffer);
+    ASSERT(offset <= size);
+    offset = CLAMP_TOP(offset, size);
+    if(!text.size) return true;
+    if(textTryExtendPiece(buffer, offset, text)) return true;
+
+    GroundedTextPiece* pieces = 0;
+    if(!textBuildPieces(buffer, text, &pieces)) return false;
+    GroundedTextPiece* left = 0;
+    GroundedTextPiece* right = 0;
+    textSplit(buffer, buffer->root, offset, &left, &right);
+    buffer->root = textMerge(textMerge(left, pieces), right);
+    return true;
+}
+
+GROUNDED_FUNCTION bool groundedTextBufferDelete(GroundedTextBuffer* buffer, u64 offset, u64 size) {
+    u64 bufferSize = groundedTextBufferGetSize(buffer);
+    ASSERT(offset <= bufferSize && size <= bufferSize - offset);
+    offset = CLAMP_TOP(offset, bufferSize);
+    size = CLAMP_TOP(size, bufferSize - offset);
+    if(!size) return true;
+    if(!textReservePieces(buffer, 2)) return false;
+
+    GroundedTextPiece* left = 0;
+    GroundedTextPiece* middle = 0;
+    GroundedTextPiece* right = 0;
+    textSplit(buffer, buffer->root, offset, &left, &right);
+    textSplit(buffer, right, size, &middle, &right);
+    textFreeSubtree(buffer, middle);
+    buffer->root = textMerge(left, right);
+    return true;
+}
+
+GROUNDED_FUNCTION bool groundedTextBufferReplace(GroundedTextBuffer* buffer, u64 offset, u64 size, String8 text) {
+    return groundedTextBufferDelete(buffer, offset, size) && groundedTextBufferInsert(buffer, offset, text);
+}
+
+GROUNDED_FUNCTION u64 groundedTextBufferGetSize(GroundedTextBuffer* buffer) {
+    return buffer->root ? buffer->root->subtreeSize : 0;
+}
+
+GROUNDED_FUNCTION u64 groundedTextBufferGetCodepointCount(GroundedTextBuffer* buffer) {
+    return buffer->root ? buffer->root->subtreeCodepointCount : 0;
+}
+
+GROUNDED_FUNCTION u64 groundedTextBufferGetLineCount(GroundedTextBuffer* buffer) {
+    return (buffer->root ? buffer->root->subtreeLineCount : 0) + 1;
+}
+
+GROUNDED_FUNCTION u64 groundedTextBufferGetOffsetOfCodepoint(GroundedTextBuffer* buffer, u64 codepointIndex) {
+    if(codepointIndex >= groundedTextBufferGetCodepointCount(buffer)) {
+        return groundedTextBufferGetSize(buffer);
+    }
+    GroundedTextPiece* node = buffer->root;
+    u64 offset = 0;
+    while(true) {
+        u64 leftCodepoints = node->left ? node->left->subtreeCodepointCount : 0;
+        if(codepointIndex < leftCodepoints) {
+            node = node->left;
+            continue;
+        }
+        codepointIndex -= leftCodepoints;
+        offset += node->left ? node->left->subtreeSize : 0;
+        if(codepointIndex < node->codepointCount) break;
+        codepointIndex -= node->codepointCount;
+        offset += node->size;
+        node = node->right;
+    }
+    for(u64 i = 0; i < node->size; ++i) {
+        if((node->base[i] & 0xC0) != 0x80) {
+            if(codepointIndex == 0) return offset + i;
+            codepointIndex--;
+        }
+    }
+    ASSERT(false);
+    return offset + node->size;
+}
+
+GROUNDED_FUNCTION u64 groundedTextBufferGetCodepointIndex(GroundedTextBuffer* buffer, u64 offset) {
+    if(offset >= groundedTextBufferGetSize(buffer)) {
+        return groundedTextBufferGetCodepointCount(buffer);
+    }
+    u64 pieceOffset, codepointsBefore, linesBefore;
+    GroundedTextPiece* piece = textFindByOffset(buffer->root, offset, &pieceOffset, &codepointsBefore, &linesBefore);
+    u64 codepoints, lines;
+    textCount(piece->base, offset - pieceOffset, &codepoints, &lines);
+    return codepointsBefore + codepoints;
+}
+
+GROUNDED_FUNCTION u64 groundedTextBufferGetOffsetOfLine(GroundedTextBuffer* buffer, u64 line) {
+    if(line == 0) return 0;
+    ASSERT(line < groundedTextBufferGetLineCount(buffer));
+    if(line >= groundedTextBufferGetLineCount(buffer)) {
+        return groundedTextBufferGetSize(buffer);
+    }
+    // Line n starts behind the n-th '\n'
+    u64 newlineIndex = line - 1;
+    GroundedTextPiece* node = buffer->root;
+    u64 offset = 0;
+    while(true) {
+        u64 leftLines = node->left ? node->left->subtreeLineCount : 0;
+        if(newlineIndex < leftLines) {
+            node = node->left;
+            continue;
+        }
+        newlineIndex -= leftLines;
+        offset += node->left ? node->left->subtreeSize : 0;
+        if(newlineIndex < node->lineCount) break;
+        newlineIndex -= node->lineCount;
+        offset += node->size;
+        node = node->right;
+    }
+    for(u64 i = 0; i < node->size; ++i) {
+        if(node->base[i] == '\n') {
+            if(newlineIndex == 0) return offset + i + 1;
+            newlineIndex--;
+        }
+    }
+    ASSERT(false);
+    return offset + node->size;
+}
+
+GROUNDED_FUNCTION u64 groundedTextBufferGetLineIndex(GroundedTextBuffer* buffer, u64 offset) {
+    if(offset >= groundedTextBufferGetSize(buffer)) {
+        return groundedTextBufferGetLineCount(buffer) - 1;
+    }
+    u64 pieceOffset, codepointsBefore, linesBefore;
+    GroundedTextPiece* piece = textFindByOffset(buffer->root, offset, &pieceOffset, &codepointsBefore, &linesBefore);
+    u64 codepoints, lines;
+    textCount(piece->base, offset - pieceOffset, &codepoints, &lines);
+    return linesBefore + lines;
+}
+
+GROUNDED_FUNCTION String8 groundedTextBufferGetSlice(GroundedTextBuffer* buffer, u64 offset) {
+    String8 result = {0};
+    if(offset < groundedTextBufferGetSize(buffer)) {
+        u64 pieceOffset, codepointsBefore, linesBefore;
+        GroundedTextPiece* piece = textFindByOffset(buffer->root, offset, &pieceOffset, &codepointsBefore, &linesBefore);
+        result = str8FromBlock(piece->base + (offset - pieceOffset), piece->size - (offset - pieceOffset));
+    }
+    return result;
+}
+
+GROUNDED_FUNCTION GroundedTextIterator groundedTextBufferIterate(GroundedTextBuffer* buffer, u64 offset, u64 size) {
+    u64 bufferSize = groundedTextBufferGetSize(buffer);
+    offset = CLAMP_TOP(offset, bufferSize);
+    size = CLAMP_TOP(size, bufferSize - offset);
+    GroundedTextIterator result = {buffer, offset, offset + size};
+    return result;
+}
+
+GROUNDED_FUNCTION bool groundedTextIteratorNext(GroundedTextIterator* iterator, String8* slice) {
+    if(iterator->offset >= iterator->end) return false;
+    String8 result = groundedTextBufferGetSlice(iterator->buffer, iterator->offset);
+    result.size = MIN(result.size, iterator->end - iterator->offset);
+    iterator->offset += result.size;
+    *slice = result;
+    return true;
+}
+
+GROUNDED_FUNCTION String8 groundedTextBufferCopy(GroundedTextBuffer* buffer, MemoryArena* arena, u64 offset, u64 size) {
+    GroundedTextIterator iterator = groundedTextBufferIterate(buffer, offset, size);
+    u64 count = iterator.end - iterator.offset;
+    u8* memory = ARENA_PUSH_ARRAY_NO_CLEAR(arena, count + 1, u8);
+    if(!memory) return (String8){0};
+    u8* dptr = memory;
+    String8 slice;
+    while(groundedTextIteratorNext(&iterator, &slice)) {
+        MEMORY_COPY(dptr, slice.base, slice.size);
+        dptr += slice.size;
+    }
+    *dptr = 0;
+    String8 result = {memory, count};
+    return result;
+}
@@ -0,0 +1,858 @@
+#include <grounded/threading/grounded_async.h>
+#include <grounded/string/grounded_string.h>
+
+#define ASYNC_CACHE_LINE_SIZE 64
+
+////////////////
+// Internal data
+
+enum AsyncNodeState {
+    ASYNC_NODE_STATE_FREE,
+    ASYNC_NODE_STATE_PENDING,
+    ASYNC_NODE_STATE_RUNNING,
+    ASYNC_NODE_STATE_CANCELED,
+};
+
+// Nodes are referenced by index + 1 so 0 can be used as the invalid index
+struct AsyncNode {
+    struct AsyncTaskData data;
+    volatile u32 generation; // Incremented once the task has finished. Task handles store the generation they were created with
+    volatile u32 state;
+    volatile u64 nextFree;
+
+    volatile u32 unfinishedCount; // The task itself + all unfinished children. The task is finished once this reaches 0
+    volatile u32 dependencyCount; // Number of unfinished dependencies. The task is scheduled once this reaches 0
+    u32 parent;
+
+    // Tasks that depend on this task. Guarded by continuationLock
+    volatile u32 continuationLock;
+    u32 continuationHead;
+    bool continuationsClosed;
+};
+
+// Every node owns GROUNDED_ASYNC_MAX_DEPENDENCIES links. Link i of a node is inserted into the continuation list of its i-th dependency.
+// Referenced by index + 1
+struct AsyncDependencyLink {
+    u32 next;
+    u32 nodeIndex;
+};
+
+// Slot of the bounded MPMC injection queue (Vyukov)
+struct AsyncInjectionCell {
+    volatile u64 sequence;
+    volatile u64 nodeIndex;
+};
+
+struct AsyncSharedState {
+    // Tagged head of the free node stack. Low 32 bits are the node index + 1 and high 32 bits are an ABA tag
+    volatile u64 freeListHead;
+    u8 pad0[ASYNC_CACHE_LINE_SIZE - sizeof(u64)];
+    volatile u64 injectionEnqueuePos;
+    u8 pad1[ASYNC_CACHE_LINE_SIZE - sizeof(u64)];
+    volatile u64 injectionDequeuePos;
+    u8 pad2[ASYNC_CACHE_LINE_SIZE - sizeof(u64)];
+    volatile u64 pendingTaskCount;
+    volatile u32 sleepingWorkerCount;
+    volatile u32 stopRequested;
+    u8 pad3[ASYNC_CACHE_LINE_SIZE - 2 * sizeof(u64)];
+    struct AsyncInjectionCell* injectionCells;
+};
+
+// Chase-Lev work stealing deque. Only the owning worker pushes and pops at the bottom. Other threads steal from the top.
+// The deque has the same capacity as the system has nodes so it can never overflow.
+struct AsyncWorker {
+    volatile u64 top;
+    u8 pad0[ASYNC_CACHE_LINE_SIZE - sizeof(u64)];
+    volatile u64 bottom;
+    u8 pad1[ASYNC_CACHE_LINE_SIZE - sizeof(u64)];
+    volatile u64* buffer;
+    GroundedAsyncSystem* system;
+    GroundedThread* thread;
+    u64 randomState;
+    u32 index;
+    MemoryArena threadArena; // Holds the platform thread data
+    MemoryArena scratchArenas[2];
+};
+
+// The worker the current thread is running as. 0 for all threads that are not workers of any system
+#ifdef _WIN32
+static __declspec(thread) struct AsyncWorker* currentAsyncWorker;
+#else
+static __thread struct AsyncWorker* currentAsyncWorker;
+#endif
+
+#define ASYNC_IDLE_SPIN_COUNT 64
+
+static inline u32 asyncTaskGetNodeIndex(GroundedAsyncTask task) {
+    return (u32)(task & 0xFFFFFFFF);
+}
+
+static inline u32 asyncTaskGetGeneration(GroundedAsyncTask task) {
+    return (u32)(task >> 32);
+}
+
+static inline void asyncLockContinuations(struct AsyncNode* node) {
+    while(groundedAtomicExchange32(&node->continuationLock, 1, GROUNDED_MEMORY_ORDER_ACQUIRE)) {
+        groundedPause();
+    }
+}
+
+static inline void asyncUnlockContinuations(struct AsyncNode* node) {
+    groundedAtomicStore32(&node->continuationLock, 0, GROUNDED_MEMORY_ORDER_RELEASE);
+}
+
+static inline struct AsyncNode* asyncGetNode(GroundedAsyncSystem* system, GroundedAsyncTask task) {
+    struct AsyncNode* result = 0;
+    u32 nodeIndex = asyncTaskGetNodeIndex(task);
+    if(nodeIndex > 0 && nodeIndex <= system->nodeCount) {
+        result = &system->nodes[nodeIndex - 1];
+    }
+    return result;
+}
+
+////////////
+// Free list
+
+static u32 asyncAllocateNode(GroundedAsyncSystem* system) {
+    struct AsyncSharedState* shared = system->shared;
+    u64 head = groundedAtomicLoad64(&shared->freeListHead, GROUNDED_MEMORY_ORDER_ACQUIRE);
+    while(true) {
+        u32 nodeIndex = (u32)(head & 0xFFFFFFFF);
+        if(!nodeIndex) {
+            return 0;
+        }
+        u64 next = groundedAtomicLoad64(&system->nodes[nodeIndex - 1].nextFree, GROUNDED_MEMORY_ORDER_ACQUIRE);
+        u64 newHead = (((head >> 32) + 1) << 32) | next;
+        if(groundedAtomicCompareExchange64(&shared->freeListHead, &head, newHead, GROUNDED_MEMORY_ORDER_SEQ_CST)) {
+            return nodeIndex;
+        }
+    }
+}
+
+static void asyncFreeNode(GroundedAsyncSystem* system, u32 nodeIndex) {
+    struct AsyncSharedState* shared = system->shared;
+    u64 head = groundedAtomicLoad64(&shared->freeListHead, GROUNDED_MEMORY_ORDER_ACQUIRE);
+    while(true) {
+        groundedAtomicStore64(&system->nodes[nodeIndex - 1].nextFree, head & 0xFFFFFFFF, GROUNDED_MEMORY_ORDER_RELEASE);
+        u64 newHead = (((head >> 32) + 1) << 32) | nodeIndex;
+        if(groundedAtomicCompareExchange64(&shared->freeListHead, &head, newHead, GROUNDED_MEMORY_ORDER_SEQ_CST)) {
+            return;
+        }
+    }
+}
+
+//////////////////
+// Injection queue
+
+static void asyncInjectionEnqueue(GroundedAsyncSystem* system, u32 nodeIndex) {
+    struct AsyncSharedState* shared = system->shared;
+    u64 pos = groundedAtomicLoad64(&shared->injectionEnqueuePos, GROUNDED_MEMORY_ORDER_RELAXED);
+    struct AsyncInjectionCell* cell = 0;
+    while(true) {
+        cell = &shared->injectionCells[pos & system->queueMask];
+        u64 sequence = groundedAtomicLoad64(&cell->sequence, GROUNDED_MEMORY_ORDER_ACQUIRE);
+        s64 diff = (s64)(sequence - pos);
+        if(diff == 0) {
+            if(groundedAtomicCompareExchange64(&shared->injectionEnqueuePos, &pos, pos + 1, GROUNDED_MEMORY_ORDER_SEQ_CST)) {
+                break;
+            }
+        } else if(diff < 0) {
+            // A dequeuer has claimed this cell but not released it yet
+            groundedPause();
+            pos = groundedAtomicLoad64(&shared->injectionEnqueuePos, GROUNDED_MEMORY_ORDER_RELAXED);
+        } else {
+            pos = groundedAtomicLoad64(&shared->injectionEnqueuePos, GROUNDED_MEMORY_ORDER_RELAXED);
+        }
+    }
+    groundedAtomicStore64(&cell->nodeIndex, nodeIndex, GROUNDED_MEMORY_ORDER_RELAXED);
+    groundedAtomicStore64(&cell->sequence, pos + 1, GROUNDED_MEMORY_ORDER_RELEASE);
+}
+
+static u32 asyncInjectionDequeue(GroundedAsyncSystem* system) {
+    struct AsyncSharedState* shared = system->shared;
+    u64 pos = groundedAtomicLoad64(&shared->injectionDequeuePos, GROUNDED_MEMORY_ORDER_RELAXED);
+    struct AsyncInjectionCell* cell = 0;
+    while(true) {
+        cell = &shared->injectionCells[pos & system->queueMask];
+        u64 sequence = groundedAtomicLoad64(&cell->sequence, GROUNDED_MEMORY_ORDER_ACQUIRE);
+        s64 diff = (s64)(sequence - (pos + 1));
+        if(diff == 0) {
+            if(groundedAtomicCompareExchange64(&shared->injectionDequeuePos, &pos, pos + 1, GROUNDED_MEMORY_ORDER_SEQ_CST)) {
+                break;
+            }
+        } else if(diff < 0) {
+            // Queue is empty
+            return 0;
+        } else {
+            pos = groundedAtomicLoad64(&shared->injectionDequeuePos, GROUNDED_MEMORY_ORDER_RELAXED);
+        }
+    }
+    u32 result = (u32)groundedAtomicLoad64(&cell->nodeIndex, GROUNDED_MEMORY_ORDER_RELAXED);
+    groundedAtomicStore64(&cell->sequence, pos + system->queueMask + 1, GROUNDED_MEMORY_ORDER_RELEASE);
+    return result;
+}
+
+static bool asyncInjectionIsEmpty(GroundedAsyncSystem* system) {
+    struct AsyncSharedState* shared = system->shared;
+    return groundedAtomicLoad64(&shared->injectionDequeuePos, GROUNDED_MEMORY_ORDER_ACQUIRE) >= groundedAtomicLoad64(&shared->injectionEnqueuePos, GROUNDED_MEMORY_ORDER_ACQUIRE);
+}
+
+/////////////////////
+// Chase-Lev deque
+
+static void asyncDequePush(struct AsyncWorker* worker, u32 nodeIndex) {
+    u64 bottom = groundedAtomicLoad64(&worker->bottom, GROUNDED_MEMORY_ORDER_RELAXED);
+    ASSERT(bottom - groundedAtomicLoad64(&worker->top, GROUNDED_MEMORY_ORDER_ACQUIRE) <= worker->system->queueMask);
+    groundedAtomicStore64(&worker->buffer[bottom & worker->system->queueMask], nodeIndex, GROUNDED_MEMORY_ORDER_RELAXED);
+    groundedAtomicStore64(&worker->bottom, bottom + 1, GROUNDED_MEMORY_ORDER_RELEASE);
+}
+
+static u32 asyncDequePop(struct AsyncWorker* worker) {
+    u64 bottom = groundedAtomicLoad64(&worker->bottom, GROUNDED_MEMORY_ORDER_RELAXED);
+    if(bottom == groundedAtomicLoad64(&worker->top, GROUNDED_MEMORY_ORDER_ACQUIRE)) {
+        // Fast path for empty deque. Only the owner modifies bottom and top can only grow so this is safe
+        return 0;
+    }
+    bottom -= 1;
+    groundedAtomicStore64(&worker->bottom, bottom, GROUNDED_MEMORY_ORDER_RELAXED);
+    groundedAtomicThreadFence(GROUNDED_MEMORY_ORDER_SEQ_CST);
+    u64 top = groundedAtomicLoad64(&worker->top, GROUNDED_MEMORY_ORDER_RELAXED);
+    u32 result = 0;
+    if((s64)(bottom - top) >= 0) {
+        result = (u32)groundedAtomicLoad64(&worker->buffer[bottom & worker->system->queueMask], GROUNDED_MEMORY_ORDER_RELAXED);
+        if(top == bottom) {
+            // Last element so we race against thieves
+            if(!groundedAtomicCompareExchange64(&worker->top, &top, top + 1, GROUNDED_MEMORY_ORDER_SEQ_CST)) {
+                result = 0;
+            }
+            groundedAtomicStore64(&worker->bottom, bottom + 1, GROUNDED_MEMORY_ORDER_RELAXED);
+        }
+    } else {
+        groundedAtomicStore64(&worker->bottom, bottom + 1, GROUNDED_MEMORY_ORDER_RELAXED);
+    }
+    return result;
+}
+
+static u32 asyncDequeSteal(struct AsyncWorker* victim) {
+    u64 top = groundedAtomicLoad64(&victim->top, GROUNDED_MEMORY_ORDER_ACQUIRE);
+    groundedAtomicThreadFence(GROUNDED_MEMORY_ORDER_SEQ_CST);
+    u64 bottom = groundedAtomicLoad64(&victim->bottom, GROUNDED_MEMORY_ORDER_ACQUIRE);
+    u32 result = 0;
+    if((s64)(bottom - top) > 0) {
+        result = (u32)groundedAtomicLoad64(&victim->buffer[top & victim->system->queueMask], GROUNDED_MEMORY_ORDER_RELAXED);
+        if(!groundedAtomicCompareExchange64(&victim->top, &top, top + 1, GROUNDED_MEMORY_ORDER_SEQ_CST)) {
+            // Lost the race against the owner or another thief
+            result = 0;
+        }
+    }
+    return result;
+}
+
+static bool asyncDequeIsEmpty(struct AsyncWorker* worker) {
+    return (s64)(groundedAtomicLoad64(&worker->bottom, GROUNDED_MEMORY_ORDER_ACQUIRE) - groundedAtomicLoad64(&worker->top, GROUNDED_MEMORY_ORDER_ACQUIRE)) <= 0;
+}
+
+///////////////
+// Scheduling
+
+static u64 asyncNextRandom(u64* state) {
+    // xorshift64
+    u64 x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+static bool asyncHasWork(GroundedAsyncSystem* system) {
+    if(!asyncInjectionIsEmpty(system)) {
+        return true;
+    }
+    for(u32 i = 0; i < system->workerCount; ++i) {
+        if(!asyncDequeIsEmpty(&system->workers[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void asyncWakeWorker(GroundedAsyncSystem* system) {
+    struct AsyncSharedState* shared = system->shared;
+    // Make sure the pushed task is visible before checking for sleepers. Pairs with the fence in asyncWorkerSleep
+    groundedAtomicThreadFence(GROUNDED_MEMORY_ORDER_SEQ_CST);
+    u32 sleeping = groundedAtomicLoad32(&shared->sleepingWorkerCount, GROUNDED_MEMORY_ORDER_ACQUIRE);
+    while(sleeping > 0) {
+        if(groundedAtomicCompareExchange32(&shared->sleepingWorkerCount, &sleeping, sleeping - 1, GROUNDED_MEMORY_ORDER_SEQ_CST)) {
+            groundedIncrementSemaphore(&system->wakeSemaphore);
+            break;
+        }
+    }
+}
+
+static void asyncWorkerSleep(GroundedAsyncSystem* system) {
+    struct AsyncSharedState* shared = system->shared;
+    groundedAtomicFetchAdd32(&shared->sleepingWorkerCount, 1, GROUNDED_MEMORY_ORDER_SEQ_CST);
+    groundedAtomicThreadFence(GROUNDED_MEMORY_ORDER_SEQ_CST);
+    if(asyncHasWork(system) || groundedAtomicLoad32(&shared->stopRequested, GROUNDED_MEMORY_ORDER_ACQUIRE)) {
+        // Work arrived in the meantime. Try to revoke our sleep announcement
+        u32 sleeping = groundedAtomicLoad32(&shared->sleepingWorkerCount, GROUNDED_MEMORY_ORDER_ACQUIRE);
+        while(sleeping > 0) {
+            if(groundedAtomicCompareExchange32(&shared->sleepingWorkerCount, &sleeping, sleeping - 1, GROUNDED_MEMORY_ORDER_SEQ_CST)) {
+                return;
+            }
+        }
+        // Somebody already consumed our announcement and is about to post the semaphore
+    }
+    groundedDecrementSemaphore(&system->wakeSemaphore);
+}
+
+// Tries to get a task from the own deque, the injection queue and finally by stealing from other workers
+static u32 asyncFindTask(GroundedAsyncSystem* system, struct AsyncWorker* worker) {
+    u32 result = 0;
+    if(worker) {
+        result = asyncDequePop(worker);
+    }
+    if(!result) {
+        result = asyncInjectionDequeue(system);
+    }
+    if(!result && system->workerCount > 0) {
+        u64 randomSeed = worker ? asyncNextRandom(&worker->randomState) : groundedGetCounter();
+        u32 start = (u32)(randomSeed % system->workerCount);
+        for(u32 i = 0; i < system->workerCount && !result; ++i) {
+            struct AsyncWorker* victim = &system->workers[(start + i) % system->workerCount];
+            if(victim != worker) {
+                result = asyncDequeSteal(victim);
+            }
+        }
+    }
+    return result;
+}
+
+static void asyncScheduleNode(GroundedAsyncSystem* system, u32 nodeIndex) {
+    struct AsyncWorker* worker = currentAsyncWorker;
+    if(worker && worker->system == system) {
+        asyncDequePush(worker, nodeIndex);
+    } else {
+        asyncInjectionEnqueue(system, nodeIndex);
+    }
+    asyncWakeWorker(system);
+}
+
+static void asyncReleaseDependency(GroundedAsyncSystem* system, u32 nodeIndex) {
+    if(groundedAtomicFetchSub32(&system->nodes[nodeIndex - 1].dependencyCount, 1, GROUNDED_MEMORY_ORDER_SEQ_CST) == 1) {
+        asyncScheduleNode(system, nodeIndex);
+    }
+}
+
+// Called once the unfinished count of a node has reached 0. Releases all continuations and propagates completion to the parent
+static void asyncFinishNode(GroundedAsyncSystem* system, u32 nodeIndex) {
+    while(nodeIndex) {
+        struct AsyncNode* node = &system->nodes[nodeIndex - 1];
+
+        asyncLockContinuations(node);
+        node->continuationsClosed = true;
+        u32 linkIndex = node->continuationHead;
+        node->continuationHead = 0;
+        asyncUnlockContinuations(node);
+
+        while(linkIndex) {
+            struct AsyncDependencyLink* link = &system->links[linkIndex - 1];
+            // The dependent might run and get reused as soon as it is released so read everything before
+            u32 next = link->next;
+            asyncReleaseDependency(system, link->nodeIndex);
+            linkIndex = next;
+        }
+
+        u32 parent = node->parent;
+
+        // Publish completion. Waiters compare the generation against the one stored in their handle
+        groundedAtomicStore32(&node->state, ASYNC_NODE_STATE_FREE, GROUNDED_MEMORY_ORDER_RELEASE);
+        groundedAtomicStore32(&node->generation, node->generation + 1, GROUNDED_MEMORY_ORDER_RELEASE);
+        groundedAtomicFetchSub64(&system->shared->pendingTaskCount, 1, GROUNDED_MEMORY_ORDER_SEQ_CST);
+        asyncFreeNode(system, nodeIndex);
+
+        nodeIndex = 0;
+        if(parent && groundedAtomicFetchSub32(&system->nodes[parent - 1].unfinishedCount, 1, GROUNDED_MEMORY_ORDER_SEQ_CST) == 1) {
+            nodeIndex = parent;
+        }
+    }
+}
+
+static void asyncExecuteTask(GroundedAsyncSystem* system, u32 nodeIndex) {
+    struct AsyncNode* node = &system->nodes[nodeIndex - 1];
+    u32 expectedState = ASYNC_NODE_STATE_PENDING;
+    if(groundedAtomicCompareExchange32(&node->state, &expectedState, ASYNC_NODE_STATE_RUNNING, GROUNDED_MEMORY_ORDER_ACQ_REL)) {
+        MemoryArena* scratch = threadContextGetScratch(0);
+        ArenaTempMemory temp = arenaBeginTemp(scratch);
+        node->data.proc(&node->data);
+        arenaEndTemp(temp);
+    }
+
+    if(groundedAtomicFetchSub32(&node->unfinishedCount, 1, GROUNDED_MEMORY_ORDER_SEQ_CST) == 1) {
+        asyncFinishNode(system, nodeIndex);
+    }
+}
+
+// Executes a single pending task if there is one. Used by waiting threads so they contribute instead of blocking
+static bool asyncHelp(GroundedAsyncSystem* system) {
+    struct AsyncWorker* worker = currentAsyncWorker;
+    if(worker && worker->system != system) {
+        worker = 0;
+    }
+    u32 nodeIndex = asyncFindTask(system, worker);
+    if(nodeIndex) {
+        asyncExecuteTask(system, nodeIndex);
+        return true;
+    }
+    return false;
+}
+
+static GROUNDED_THREAD_PROC(asyncWorkerThreadProc) {
+    struct AsyncWorker* worker = (struct AsyncWorker*)userData;
+    GroundedAsyncSystem* system = worker->system;
+    struct AsyncSharedState* shared = system->shared;
+
+    // groundedStartThread already set up a thread context. Its second scratch arena belongs to this thread and would
+    // leak when replaced. The first one is a view of threadArena which is released by destroyAsyncSystem
+    arenaRelease(threadContextGetScratch(threadContextGetScratch(0)));
+    threadContextInit(worker->scratchArenas[0], worker->scratchArenas[1], system->logFunction);
+    currentAsyncWorker = worker;
+
+    u32 idleCount = 0;
+    while(!groundedAtomicLoad32(&shared->stopRequested, GROUNDED_MEMORY_ORDER_ACQUIRE)) {
+        u32 nodeIndex = asyncFindTask(system, worker);
+        if(nodeIndex) {
+            asyncExecuteTask(system, nodeIndex);
+            idleCount = 0;
+        } else if(idleCount < ASYNC_IDLE_SPIN_COUNT) {
+            groundedPause();
+            idleCount++;
+        } else {
+            asyncWorkerSleep(system);
+            idleCount = 0;
+        }
+    }
+
+    currentAsyncWorker = 0;
+    groundedFlushErrors();
+    // Copy first as the thread context itself might live inside of scratch memory
+    MemoryArena scratch0 = *threadContextGetScratch(0);
+    MemoryArena scratch1 = *threadContextGetScratch(threadContextGetScratch(0));
+    arenaRelease(&scratch1);
+    arenaRelease(&scratch0);
+}
+
+// Joins all workers. Tasks that have not been executed yet are dropped
+static void asyncStopWorkers(GroundedAsyncSystem* system) {
+    groundedAtomicStore32(&system->shared->stopRequested, 1, GROUNDED_MEMORY_ORDER_RELEASE);
+    // Wake up every worker so it can observe the stop request
+    for(u32 i = 0; i < system->workerCount; ++i) {
+        groundedIncrementSemaphore(&system->wakeSemaphore);
+    }
+    for(u32 i = 0; i < system->workerCount; ++i) {
+        struct AsyncWorker* worker = &system->workers[i];
+        if(worker->thread) {
+            groundedThreadWaitForFinish(worker->thread, 0);
+            groundedDestroyThread(worker->thread);
+        }
+        arenaRelease(&worker->threadArena);
+    }
+
+    groundedDestroySemaphore(&system->wakeSemaphore);
+}
+
+/////////////
+// Public API
+
+GROUNDED_FUNCTION bool createAsyncSystem(GroundedAsyncSystem* system, GroundedAsyncSystemParameters* parameters) {
+    if(!parameters) {
+        static GroundedAsyncSystemParameters defaultParameters = {0};
+        parameters = &defaultParameters;
+    }
+    *system = (GroundedAsyncSystem){0};
+
+    u32 workerCount = parameters->workerCount;
+    if(!workerCount) {
+        workerCount = groundedGetLogicalCoreCount();
+        if(!workerCount) workerCount = 1;
+    }
+    u64 maxTaskCount = parameters->maxTaskCount ? parameters->maxTaskCount : 4096;
+    ASSERT(maxTaskCount < UINT32_MAX);
+    u64 maxUserDataSize = ALIGN_UP_POW2(parameters->maxUserDataSize ? parameters->maxUserDataSize : 128, 16);
+    u64 queueSize = groundedNextPow2u32((u32)maxTaskCount);
+
+    system->arena = createGrowingArena(osGetMemorySubsystem(), KB(64));
+    system->shared = ARENA_PUSH_STRUCT_ALIGNED(&system->arena, struct AsyncSharedState, ASYNC_CACHE_LINE_SIZE);
+    system->shared->injectionCells = ARENA_PUSH_ARRAY_ALIGNED(&system->arena, queueSize, struct AsyncInjectionCell, ASYNC_CACHE_LINE_SIZE);
+    system->nodes = ARENA_PUSH_ARRAY_ALIGNED(&system->arena, maxTaskCount, struct AsyncNode, ASYNC_CACHE_LINE_SIZE);
+    system->nodeUserData = ARENA_PUSH_ARRAY_ALIGNED(&system->arena, maxTaskCount * maxUserDataSize, u8, 16);
+    system->links = ARENA_PUSH_ARRAY(&system->arena, maxTaskCount * GROUNDED_ASYNC_MAX_DEPENDENCIES, struct AsyncDependencyLink);
+    system->workers = ARENA_PUSH_ARRAY_ALIGNED(&system->arena, workerCount, struct AsyncWorker, ASYNC_CACHE_LINE_SIZE);
+    if(!system->shared || !system->shared->injectionCells || !system->nodes || !system->nodeUserData || !system->links || !system->workers) {
+        GROUNDED_LOG_ERROR("Could not allocate memory for async system");
+        arenaRelease(&system->arena);
+        *system = (GroundedAsyncSystem){0};
+        return false;
+    }
+    system->nodeCount = maxTaskCount;
+    system->maxUserDataSize = maxUserDataSize;
+    system->queueMask = queueSize - 1;
+    system->workerCount = workerCount;
+    system->logFunction = threadContextGetLogFunction();
+    system->wakeSemaphore = groundedCreateSemaphore(0, workerCount);
+
+    for(u64 i = 0; i < queueSize; ++i) {
+        system->shared->injectionCells[i].sequence = i;
+    }
+
+    // Build free list in reverse so the first nodes are handed out first
+    for(u64 i = maxTaskCount; i > 0; --i) {
+        system->nodes[i - 1].data.userData = system->nodeUserData + (i - 1) * maxUserDataSize;
+        asyncFreeNode(system, (u32)i);
+    }
+
+    MemoryArena* scratch = threadContextGetScratch(0);
+    ArenaTempMemory temp = arenaBeginTemp(scratch);
+    for(u32 i = 0; i < workerCount; ++i) {
+        struct AsyncWorker* worker = &system->workers[i];
+        worker->system = system;
+        worker->index = i;
+        worker->randomState = 0x9E3779B97F4A7C15ull * (i + 1);
+        worker->buffer = ARENA_PUSH_ARRAY_ALIGNED(&system->arena, queueSize, u64, ASYNC_CACHE_LINE_SIZE);
+        worker->threadArena = createGrowingArena(osGetMemorySubsystem(), KB(4));
+        worker->scratchArenas[0] = createGrowingArena(osGetMemorySubsystem(), KB(256));
+        worker->scratchArenas[1] = createGrowingArena(osGetMemorySubsystem(), KB(16));
+        String8 threadName = str8FromFormat(scratch, "AsyncWorker%u", i);
+        worker->thread = groundedStartThread(&worker->threadArena, &asyncWorkerThreadProc, worker, (const char*)threadName.base);
+        if(!worker->thread) {
+            GROUNDED_LOG_ERROR("Could not start async worker thread");
+            arenaRelease(&worker->scratchArenas[0]);
+            arenaRelease(&worker->scratchArenas[1]);
+            arenaRelease(&worker->threadArena);
+            // Only the workers that are already running have to be stopped
+            system->workerCount = i;
+            asyncStopWorkers(system);
+            arenaRelease(&system->arena);
+            *system = (GroundedAsyncSystem){0};
+            arenaEndTemp(temp);
+            return false;
+        }
+    }
+    arenaEndTemp(temp);
+
+    return true;
+}
+
+GROUNDED_FUNCTION void destroyAsyncSystem(GroundedAsyncSystem* system) {
+    if(!system->shared) return;
+
+    groundedAsyncWaitForAll(system, 0);
+
+    asyncStopWorkers(system);
+    arenaRelease(&system->arena);
+    *system = (GroundedAsyncSystem){0};
+}
+
+static GroundedAsyncTask asyncPushTask(GroundedAsyncSystem* system, GroundedAsyncProc* proc, void* userData, u64 userDataSize, GroundedAsyncTask parent, GroundedAsyncTask* dependencies, u32 dependencyCount) {
+    GroundedAsyncTask result = 0;
+    ASSERT(proc);
+    if(userDataSize > system->maxUserDataSize) {
+        GROUNDED_LOG_ERROR("Async task user data exceeds maximum user data size");
+        return 0;
+    }
+    if(dependencyCount > GROUNDED_ASYNC_MAX_DEPENDENCIES) {
+        GROUNDED_LOG_ERROR("Async task exceeds maximum dependency count");
+        return 0;
+    }
+
+    u32 parentIndex = 0;
+    if(parent) {
+        // The parent must not finish between the check and registering the new child
+        struct AsyncNode* parentNode = asyncGetNode(system, parent);
+        if(parentNode) {
+            asyncLockContinuations(parentNode);
+            if(groundedAtomicLoad32(&parentNode->generation, GROUNDED_MEMORY_ORDER_ACQUIRE) == asyncTaskGetGeneration(parent)) {
+                u32 unfinished = groundedAtomicLoad32(&parentNode->unfinishedCount, GROUNDED_MEMORY_ORDER_ACQUIRE);
+                while(unfinished > 0) {
+                    if(groundedAtomicCompareExchange32(&parentNode->unfinishedCount, &unfinished, unfinished + 1, GROUNDED_MEMORY_ORDER_SEQ_CST)) {
+                        parentIndex = asyncTaskGetNodeIndex(parent);
+                        break;
+                    }
+                }
+            }
+            asyncUnlockContinuations(parentNode);
+        }
+        if(!parentIndex) {
+            GROUNDED_LOG_ERROR("Parent of async task has already finished");
+            return 0;
+        }
+    }
+
+    u32 nodeIndex = asyncAllocateNode(system);
+    if(nodeIndex) {
+        struct AsyncNode* node = &system->nodes[nodeIndex - 1];
+        result = ((u64)node->generation << 32) | nodeIndex;
+
+        if(userDataSize) {
+            MEMORY_COPY(node->data.userData, userData, userDataSize);
+        }
+        node->data.proc = proc;
+        node->data.userDataSize = userDataSize;
+        node->data.system = system;
+        node->data.task = result;
+        node->parent = parentIndex;
+        node->continuationHead = 0;
+        node->continuationsClosed = false;
+        groundedAtomicStore32(&node->unfinishedCount, 1, GROUNDED_MEMORY_ORDER_RELEASE);
+        // The pusher holds one dependency itself so the task can not be scheduled while dependencies are still being registered
+        groundedAtomicStore32(&node->dependencyCount, 1, GROUNDED_MEMORY_ORDER_RELEASE);
+        groundedAtomicStore32(&node->state, ASYNC_NODE_STATE_PENDING, GROUNDED_MEMORY_ORDER_RELEASE);
+        groundedAtomicFetchAdd64(&system->shared->pendingTaskCount, 1, GROUNDED_MEMORY_ORDER_SEQ_CST);
+
+        for(u32 i = 0; i < dependencyCount; ++i) {
+            struct AsyncNode* dependency = asyncGetNode(system, dependencies[i]);
+            if(!dependency) continue;
+            asyncLockContinuations(dependency);
+            if(groundedAtomicLoad32(&dependency->generation, GROUNDED_MEMORY_ORDER_ACQUIRE) == asyncTaskGetGeneration(dependencies[i]) && !dependency->continuationsClosed) {
+                u32 linkIndex = (nodeIndex - 1) * GROUNDED_ASYNC_MAX_DEPENDENCIES + i + 1;
+                struct AsyncDependencyLink* link = &system->links[linkIndex - 1];
+                link->nodeIndex = nodeIndex;
+                link->next = dependency->continuationHead;
+                dependency->continuationHead = linkIndex;
+                groundedAtomicFetchAdd32(&node->dependencyCount, 1, GROUNDED_MEMORY_ORDER_SEQ_CST);
+            }
+            asyncUnlockContinuations(dependency);
+        }
+
+        asyncReleaseDependency(system, nodeIndex);
+    } else if(parentIndex) {
+        // Undo child registration
+        if(groundedAtomicFetchSub32(&system->nodes[parentIndex - 1].unfinishedCount, 1, GROUNDED_MEMORY_ORDER_SEQ_CST) == 1) {
+            asyncFinishNode(system, parentIndex);
+        }
+    }
+
+    return result;
+}
+
+GROUNDED_FUNCTION GroundedAsyncTask groundedPushAsyncTask(GroundedAsyncSystem* system, GroundedAsyncProc* proc, void* userData, u64 userDataSize) {
+    return asyncPushTask(system, proc, userData, userDataSize, 0, 0, 0);
+}
+
+GROUNDED_FUNCTION GroundedAsyncTask groundedPushAsyncTaskWithDependencies(GroundedAsyncSystem* system, GroundedAsyncProc* proc, void* userData, u64 userDataSize, GroundedAsyncTask* dependencies, u32 dependencyCount) {
+    return asyncPushTask(system, proc, userData, userDataSize, 0, dependencies, dependencyCount);
+}
+
+GROUNDED_FUNCTION GroundedAsyncTask groundedPushAsyncChildTask(GroundedAsyncSystem* system, GroundedAsyncTask parent, GroundedAsyncProc* proc, void* userData, u64 userDataSize) {
+    return asyncPushTask(system, proc, userData, userDataSize, parent, 0, 0);
+}
+
+GROUNDED_FUNCTION bool groundedAsyncTaskIsFinished(GroundedAsyncSystem* system, GroundedAsyncTask task) {
+    struct AsyncNode* node = asyncGetNode(system, task);
+    if(!node) return true;
+    return groundedAtomicLoad32(&node->generation, GROUNDED_MEMORY_ORDER_ACQUIRE) != asyncTaskGetGeneration(task);
+}
+
+static u32 asyncGetTaskState(GroundedAsyncSystem* system, GroundedAsyncTask task) {
+    u32 result = ASYNC_NODE_STATE_FREE;
+    struct AsyncNode* node = asyncGetNode(system, task);
+    if(node) {
+        result = groundedAtomicLoad32(&node->state, GROUNDED_MEMORY_ORDER_ACQUIRE);
+        // The node might already be reused by another task
+        if(groundedAtomicLoad32(&node->generation, GROUNDED_MEMORY_ORDER_ACQUIRE) != asyncTaskGetGeneration(task)) {
+            result = ASYNC_NODE_STATE_FREE;
+        }
+    }
+    return result;
+}
+
+GROUNDED_FUNCTION bool groundedAsyncTaskIsRunning(GroundedAsyncSystem* system, GroundedAsyncTask task) {
+    return asyncGetTaskState(system, task) == ASYNC_NODE_STATE_RUNNING;
+}
+
+GROUNDED_FUNCTION bool groundedAsyncTaskIsPending(GroundedAsyncSystem* system, GroundedAsyncTask task) {
+    return asyncGetTaskState(system, task) == ASYNC_NODE_STATE_PENDING;
+}
+
+GROUNDED_FUNCTION void groundedAsyncTaskCancel(GroundedAsyncSystem* system, GroundedAsyncTask task) {
+    struct AsyncNode* node = asyncGetNode(system, task);
+    if(node && groundedAtomicLoad32(&node->generation, GROUNDED_MEMORY_ORDER_ACQUIRE) == asyncTaskGetGeneration(task)) {
+        // Fails if the task is already running or finished. The executing thread skips canceled tasks
+        u32 expectedState = ASYNC_NODE_STATE_PENDING;
+        groundedAtomicCompareExchange32(&node->state, &expectedState, ASYNC_NODE_STATE_CANCELED, GROUNDED_MEMORY_ORDER_ACQ_REL);
+    }
+}
+
+GROUNDED_FUNCTION bool groundedAsyncTaskWait(GroundedAsyncSystem* system, GroundedAsyncTask task, u64 timeout) {
+    //TRACY_ZONE_HELPER(groundedAsyncTaskWait);
+
+    u64 startTime = timeout ? groundedGetCounter() : 0;
+    u32 spinCount = 0;
+    while(!groundedAsyncTaskIsFinished(system, task)) {
+        if(asyncHelp(system)) {
+            spinCount = 0;
+        } else if(spinCount++ < ASYNC_IDLE_SPIN_COUNT) {
+            groundedPause();
+        } else {
+            groundedYield();
+        }
+        if(timeout && groundedGetCounter() - startTime >= timeout * 1000000) {
+            return groundedAsyncTaskIsFinished(system, task);
+        }
+    }
+    return true;
+}
+
+GROUNDED_FUNCTION bool groundedAsyncWaitForAll(GroundedAsyncSystem* system, u64 timeout) {
+    //TRACY_ZONE_HELPER(groundedAsyncWaitForAll);
+
+    u64 startTime = timeout ? groundedGetCounter() : 0;
+    u32 spinCount = 0;
+    while(groundedAtomicLoad64(&system->shared->pendingTaskCount, GROUNDED_MEMORY_ORDER_ACQUIRE) > 0) {
+        if(asyncHelp(system)) {
+            spinCount = 0;
+        } else if(spinCount++ < ASYNC_IDLE_SPIN_COUNT) {
+            groundedPause();
+        } else {
+            groundedYield();
+        }
+        if(timeout && groundedGetCounter() - startTime >= timeout * 1000000) {
+            return groundedAtomicLoad64(&system->shared->pendingTaskCount, GROUNDED_MEMORY_ORDER_ACQUIRE) == 0;
+        }
+    }
+    return true;
+}
+
+///////////////////////////
+// Parallel for and reduce
+
+struct AsyncParallelForData {
+    u64 first;
+    u64 opl;
+    u64 grainSize;
+    GroundedParallelForProc* proc;
+    void* userData;
+};
+
+struct AsyncParallelReduceData {
+    u64 first;
+    u64 opl;
+    u64 grainSize;
+    GroundedParallelReduceProc* reduceProc;
+    GroundedParallelCombineProc* combineProc;
+    void* identity;
+    u64 resultSize;
+    void* result;
+    void* userData;
+};
+
+static u64 asyncGetGrainSize(GroundedAsyncSystem* system, u64 count, u64 grainSize) {
+    if(!grainSize) {
+        // Aim for a few chunks per worker so stealing can balance uneven chunks
+        grainSize = count / ((system->workerCount + 1) * 8);
+    }
+    return MAX(grainSize, 1);
+}
+
+static GROUNDED_ASYNC_PROC(asyncParallelForTask) {
+    struct AsyncParallelForData data = *(struct AsyncParallelForData*)task->userData;
+
+    // Split off the upper half as a child task until the remaining range is small enough.
+    // Children keep this task unfinished so waiting for the root task waits for the whole range
+    while(data.opl - data.first > data.grainSize) {
+        struct AsyncParallelForData upper = data;
+        upper.first = data.first + (data.opl - data.first) / 2;
+        if(!groundedPushAsyncChildTask(task->system, task->task, &asyncParallelForTask, &upper, sizeof(upper))) {
+            // No free tasks. Process the rest of the range on this thread
+            break;
+        }
+        data.opl = upper.first;
+    }
+
+    MemoryArena* scratch = threadContextGetScratch(0);
+    ArenaTempMemory temp = arenaBeginTemp(scratch);
+    data.proc(data.first, data.opl, scratch, data.userData);
+    arenaEndTemp(temp);
+}
+
+GROUNDED_FUNCTION void groundedParallelFor(GroundedAsyncSystem* system, u64 first, u64 opl, u64 grainSize, GroundedParallelForProc* proc, void* userData) {
+    if(opl <= first) return;
+
+    struct AsyncParallelForData data = {
+        .first = first,
+        .opl = opl,
+        .grainSize = asyncGetGrainSize(system, opl - first, grainSize),
+        .proc = proc,
+        .userData = userData,
+    };
+
+    GroundedAsyncTask root = 0;
+    if(sizeof(data) <= system->maxUserDataSize) {
+        root = groundedPushAsyncTask(system, &asyncParallelForTask, &data, sizeof(data));
+    }
+    if(root) {
+        groundedAsyncTaskWait(system, root, 0);
+    } else {
+        MemoryArena* scratch = threadContextGetScratch(0);
+        ArenaTempMemory temp = arenaBeginTemp(scratch);
+        proc(first, opl, scratch, userData);
+        arenaEndTemp(temp);
+    }
+}
+
+static void asyncParallelReduceRange(GroundedAsyncSystem* system, struct AsyncParallelReduceData* data);
+
+static GROUNDED_ASYNC_PROC(asyncParallelReduceTask) {
+    asyncParallelReduceRange(task->system, (struct AsyncParallelReduceData*)task->userData);
+}
+
+// Reduces the range into data->result which must already contain the identity
+static void asyncParallelReduceRange(GroundedAsyncSystem* system, struct AsyncParallelReduceData* data) {
+    MemoryArena* scratch = threadContextGetScratch(0);
+    ArenaTempMemory temp = arenaBeginTemp(scratch);
+
+    bool split = false;
+    if(data->opl - data->first > data->grainSize && sizeof(*data) <= system->maxUserDataSize) {
+        // The upper half gets its own accumulator which is combined once it has finished
+        struct AsyncParallelReduceData upper = *data;
+        upper.first = data->first + (data->opl - data->first) / 2;
+        upper.result = ARENA_PUSH_ARRAY_NO_CLEAR_ALIGNED(scratch, data->resultSize, u8, 16);
+        MEMORY_COPY(upper.result, data->identity, data->resultSize);
+        GroundedAsyncTask upperTask = groundedPushAsyncTask(system, &asyncParallelReduceTask, &upper, sizeof(upper));
+        if(upperTask) {
+            struct AsyncParallelReduceData lower = *data;
+            lower.opl = upper.first;
+            asyncParallelReduceRange(system, &lower);
+            groundedAsyncTaskWait(system, upperTask, 0);
+            data->combineProc(data->result, upper.result, data->userData);
+            split = true;
+        }
+    }
+
+    if(!split) {
+        ArenaTempMemory procTemp = arenaBeginTemp(scratch);
+        data->reduceProc(data->first, data->opl, data->result, scratch, data->userData);
+        arenaEndTemp(procTemp);
+    }
+
+    arenaEndTemp(temp);
+}
+
+GROUNDED_FUNCTION void groundedParallelReduce(GroundedAsyncSystem* system, u64 first, u64 opl, u64 grainSize, void* result, void* identity, u64 resultSize, GroundedParallelReduceProc* reduceProc, GroundedParallelCombineProc* combineProc, void* userData) {
+    MEMORY_COPY(result, identity, resultSize);
+    if(opl <= first) return;
+
+    struct AsyncParallelReduceData data = {
+        .first = first,
+        .opl = opl,
+        .grainSize = asyncGetGrainSize(system, opl - first, grainSize),
+        .reduceProc = reduceProc,
+        .combineProc = combineProc,
+        .identity = identity,
+        .resultSize = resultSize,
+        .result = result,
+        .userData = userData,
+    };
+    asyncParallelReduceRange(system, &data);
+}
@@ -4,6 +4,9 @@
 #include <pthread.h>
 #include <semaphore.h>
 #include <stdarg.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
 /////////////////
 // Thread context
@@ -17,6 +20,11 @@ GROUNDED_FUNCTION void threadContextInit(MemoryArena arena0, MemoryArena arena1,
     threadContext.scratchArenas[0] = arena0;
     threadContext.scratchArenas[1] = arena1;
     threadContext.logFunction = logFunction;
+    if(threadContext.errorArena.memory) {
+        // Threads started with groundedStartThread already own an error arena
+        groundedFlushErrors();
+        arenaRelease(&threadContext.errorArena);
+    }
     threadContext.errorArena = createFixedSizeArena(osGetMemorySubsystem(), KB(8));
     threadContext.errorMarker = arenaCreateMarker(&threadContext.errorArena);
     threadContext.unhandledErrorHandler = &groundedDefaultUnhandledErrorHandler;
@@ -124,6 +132,17 @@ GROUNDED_HANDLE_ERROR_FUNCTION(groundedDefaultUnhandledErrorHandler) {
     arenaEndTemp(temp);
 }
 
+#ifndef GROUNDED_THREADING_PTHREAD
+GROUNDED_FUNCTION void groundedFutexWait(volatile u32* address, u32 expectedValue) {
+    // Returns immediately with EAGAIN if the value has already changed. EINTR is handled by the callers retry loop
+    syscall(SYS_futex, address, FUTEX_WAIT_PRIVATE, expectedValue, 0, 0, 0);
+}
+
+GROUNDED_FUNCTION void groundedFutexWake(volatile u32* address, u32 count) {
+    syscall(SYS_futex, address, FUTEX_WAKE_PRIVATE, count, 0, 0, 0);
+}
+#endif // GROUNDED_THREADING_PTHREAD
+
 struct LinuxThread {
     pthread_t thread;
     pthread_mutex_t terminateMutex;
@@ -264,3 +283,11 @@ GROUNDED_FUNCTION bool groundedThreadShouldStop(GroundedThread* opaqueThread) {
 }
 
 #endif // GROUNDED_SINGLETHREADED
+
+GROUNDED_FUNCTION u32 groundedGetLogicalCoreCount() {
+    long result = sysconf(_SC_NPROCESSORS_ONLN);
+    if(result < 1) {
+        result = 1;
+    }
+    return (u32)result;
+}
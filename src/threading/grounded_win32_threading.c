@@ -248,3 +248,9 @@ GROUNDED_FUNCTION bool groundedThreadShouldStop(GroundedThread* opaqueThread) {
     groundedReadAcquireFence();
     return thread->stopRequested;
 }
+
+GROUNDED_FUNCTION u32 groundedGetLogicalCoreCount() {
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+    return systemInfo.dwNumberOfProcessors;
+}